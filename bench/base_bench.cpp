@@ -0,0 +1,114 @@
+#include "bench/benchmarks.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base/base64.h"
+#include "base/command_line.h"
+#include "base/hash.h"
+#include "base/output_timeline.h"
+#include "bench/harness.h"
+
+namespace oven {
+namespace bench {
+namespace {
+const size_t kBase64Sizes[] = {64, 4 * 1024, 256 * 1024, 4 * 1024 * 1024};
+const size_t kHashSizes[] = {64, 1024 * 1024};
+// Command line takes up to 1024 arguments, response files included.
+const size_t kResponseFileArguments[] = {16, 1000};
+const size_t kResponseFileArgumentSize = 100;
+const size_t kTimelineChunks = 4096;
+
+void BenchmarkBase64Encode(State& state, const size_t size) {
+  const std::string data = GenerateData(size);
+  std::string output(base::Base64EncodedSize(size), '\0');
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    base::Base64Encode(data, output.data());
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+
+void BenchmarkHash(State& state, const size_t size) {
+  const std::string data = GenerateData(size);
+  std::uint64_t sum = 0;
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    base::Hasher hasher;
+    hasher.Update(data);
+    sum += hasher.Finish();
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+  // Keeps hashing from being optimized away.
+  state.SetCounter("sum_parity", static_cast<std::int64_t>(sum & 1));
+}
+
+// Response file holds a few oven arguments followed by the child ones, like
+// the ones test runners pass gtest filters in.
+void BenchmarkResponseFileParse(State& state, const size_t arguments) {
+  ScopedTemporaryDirectory directory;
+  const std::filesystem::path response_file = directory.path() / "arguments.rsp";
+  {
+    std::ofstream file(response_file);
+    file << "--child-path=child --child-timeout=1000 --output-head-limit=1024 --\n";
+    for (size_t argument = 0; argument < arguments; ++argument) {
+      file << "--gtest_filter=" << std::string(kResponseFileArgumentSize, 'a' + argument % 26)
+           << '\n';
+    }
+  }
+  std::wstring executable = L"oven";
+  std::wstring response_file_argument = L"@" + response_file.wstring();
+  wchar_t* argv[] = {executable.data(), response_file_argument.data()};
+
+  size_t unparsed = 0;
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    base::CommandLine command_line(2, argv);
+    command_line.AddOptionalArgument(L"child-path", L"",
+                                     base::CommandLine::ArgumentType::kString);
+    command_line.AddOptionalArgument(L"child-timeout", L"",
+                                     base::CommandLine::ArgumentType::kInt);
+    command_line.AddOptionalArgument(L"output-head-limit", L"",
+                                     base::CommandLine::ArgumentType::kInt);
+    if (!command_line.Parse().empty()) {
+      state.SetError("Unable to parse response file");
+      return;
+    }
+    unparsed = command_line.GetUnparsed().size();
+  }
+  state.SetCounter("child_arguments", static_cast<std::int64_t>(unparsed));
+}
+
+// Reader records a chunk on every wakeup, so its cost adds to each read.
+void BenchmarkTimelineRecord(State& state) {
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    base::OutputTimeline timeline;
+    const auto time = std::chrono::steady_clock::now();
+    for (size_t chunk = 0; chunk < kTimelineChunks; ++chunk) {
+      timeline.Record(chunk % 2 ? base::OutputTimeline::Stream::kStderr
+                                : base::OutputTimeline::Stream::kStdout,
+                      time, 4096);
+    }
+  }
+  state.SetCounter("chunks", kTimelineChunks);
+}
+}  // anonymous namespace
+
+void RegisterBaseBenchmarks() {
+  for (const size_t size : kBase64Sizes) {
+    Register("base64_encode/" + std::to_string(size),
+             [size](State& state) { BenchmarkBase64Encode(state, size); });
+  }
+  for (const size_t size : kHashSizes) {
+    Register("hash/" + std::to_string(size),
+             [size](State& state) { BenchmarkHash(state, size); });
+  }
+  for (const size_t arguments : kResponseFileArguments) {
+    Register("command_line_parse/response_file/" + std::to_string(arguments),
+             [arguments](State& state) { BenchmarkResponseFileParse(state, arguments); });
+  }
+  Register("output_timeline_record/" + std::to_string(kTimelineChunks),
+           BenchmarkTimelineRecord);
+}
+
+}  // namespace bench
+}  // namespace oven
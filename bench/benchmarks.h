@@ -0,0 +1,45 @@
+#ifndef _OVEN_BENCH_BENCHMARKS_H_
+#define _OVEN_BENCH_BENCHMARKS_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace oven {
+namespace bench {
+
+// Arguments of oven_bench which make it a synthetic child of benchmarks.
+extern const wchar_t kWriteOutputArgument[];
+extern const wchar_t kSleepArgument[];
+extern const wchar_t kSpawnChildrenArgument[];
+
+// Path of oven_bench itself, to run it as a child.
+const std::wstring& GetBenchExecutable();
+
+// Directory removed along with everything benchmark has put into it.
+class ScopedTemporaryDirectory {
+ public:
+  ScopedTemporaryDirectory();
+  ~ScopedTemporaryDirectory();
+
+  ScopedTemporaryDirectory(const ScopedTemporaryDirectory&) = delete;
+  ScopedTemporaryDirectory& operator=(const ScopedTemporaryDirectory&) = delete;
+
+  const std::filesystem::path& path() const noexcept { return path_; }
+
+ private:
+  std::filesystem::path path_;
+};
+
+// Returns |size| bytes of pseudo-random data, the same for the same size.
+std::string GenerateData(const size_t size);
+
+void RegisterBaseBenchmarks();
+void RegisterResultBenchmarks();
+void RegisterChildBenchmarks();
+
+}  // namespace bench
+}  // namespace oven
+
+#endif  // _OVEN_BENCH_BENCHMARKS_H_
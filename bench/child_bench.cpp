@@ -0,0 +1,281 @@
+#include "bench/benchmarks.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <TlHelp32.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bench/harness.h"
+#include "system/child_process.h"
+#include "system/job.h"
+#include "system/reactor.h"
+
+namespace oven {
+namespace bench {
+namespace {
+const size_t kCaptureSizes[] = {1024 * 1024, 64 * 1024 * 1024};
+const size_t kPassthroughSize = 64 * 1024 * 1024;
+const size_t kSpawnedChildren = 2000;
+// Processes job sees per run: the child and the ones it spawns.
+const std::int64_t kSpawnedProcesses = kSpawnedChildren + 1;
+const size_t kParallelChildren = 64;
+const int kParallelChildSleep = 100;
+// How often thread count is sampled while waiting for parallel children.
+const std::chrono::milliseconds kThreadSampleInterval{5};
+const std::chrono::milliseconds kChildTimeout{60000};
+
+#if defined(_WIN32)
+const wchar_t kNullDevice[] = L"NUL";
+#else
+const wchar_t kNullDevice[] = L"/dev/null";
+#endif
+
+class ProcessCounter : public system::Job::Observer {
+ public:
+  void OnNewProcess(const unsigned long /* process_id */) override { ++new_processes; }
+  void OnExitProcess(const unsigned long /* process_id */) override { ++exited_processes; }
+
+  std::atomic<std::int64_t> new_processes{0};
+  std::atomic<std::int64_t> exited_processes{0};
+};
+
+// Returns number of threads of the current process.
+std::int64_t CountThreads() {
+  std::int64_t threads = 0;
+#if defined(_WIN32)
+  const HANDLE snapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+  if (snapshot == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+  THREADENTRY32 thread = {};
+  thread.dwSize = sizeof(thread);
+  for (BOOL found = ::Thread32First(snapshot, &thread); found;
+       found = ::Thread32Next(snapshot, &thread)) {
+    threads += thread.th32OwnerProcessID == ::GetCurrentProcessId();
+  }
+  ::CloseHandle(snapshot);
+#else
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "Threads:") {
+      status >> threads;
+      break;
+    }
+  }
+#endif
+  return threads;
+}
+
+// Returns CPU time the current process has consumed, all of its threads
+// together and excluding children.
+std::chrono::microseconds GetProcessCpuTime() {
+#if defined(_WIN32)
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!::GetProcessTimes(::GetCurrentProcess(), &creation_time, &exit_time,
+                         &kernel_time, &user_time)) {
+    return std::chrono::microseconds(0);
+  }
+  // Times are in 100 nanosecond units.
+  auto to_microseconds = [](const FILETIME& time) {
+    return std::chrono::microseconds(
+        ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) |
+         time.dwLowDateTime) / 10);
+  };
+  return to_microseconds(kernel_time) + to_microseconds(user_time);
+#else
+  rusage usage = {};
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return std::chrono::microseconds(0);
+  }
+  auto to_microseconds = [](const timeval& time) {
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+  };
+  return to_microseconds(usage.ru_utime) + to_microseconds(usage.ru_stime);
+#endif
+}
+
+std::vector<std::wstring> MakeArguments(const wchar_t* argument, const size_t value) {
+  return {std::wstring(L"--") + argument + L"=" + std::to_wstring(value)};
+}
+
+// Runs oven_bench as a child with |arguments| inside of |job| and waits for
+// it. Returns its outputs, nothing if it couldn't be run or has failed.
+std::optional<system::ChildProcess::Outputs> RunChild(
+    system::Job& job, const std::vector<std::wstring>& arguments,
+    const system::ChildProcess::Passthrough& passthrough = {}) {
+  system::ChildProcess child(GetBenchExecutable());
+  child.SetArguments(arguments);
+  child.SetOutputPassthrough(passthrough);
+  if (!child.Run(job) || child.Wait(kChildTimeout) != 0) {
+    return std::optional<system::ChildProcess::Outputs>();
+  }
+  return child.TakeOutputs();
+}
+
+// Time from creating child process to collecting its exit code, for a child
+// that exits right away. On Linux child is either cloned right into the job
+// cgroup, or forked and held until it joins the job if |use_fork| is set.
+void BenchmarkSpawn(State& state, const bool use_fork) {
+#if !defined(_WIN32)
+  system::ChildProcess::SetForkFallbackForTesting(use_fork);
+#endif
+  const std::vector<std::wstring> arguments = MakeArguments(kWriteOutputArgument, 0);
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    system::Job job;
+    if (!RunChild(job, arguments)) {
+      state.SetError("Unable to run child");
+      break;
+    }
+  }
+#if !defined(_WIN32)
+  system::ChildProcess::SetForkFallbackForTesting(false);
+#endif
+}
+
+// Child writes |size| bytes to stdout as fast as it can, so that reading
+// them is the bottleneck.
+void BenchmarkCapture(State& state, const size_t size,
+                      const system::ChildProcess::Passthrough& passthrough) {
+  const std::vector<std::wstring> arguments = MakeArguments(kWriteOutputArgument, size);
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    system::Job job;
+    const auto outputs = RunChild(job, arguments, passthrough);
+    if (!outputs || outputs->stdoutput.total_size() != size) {
+      state.SetError("Child output wasn't captured");
+      return;
+    }
+    state.SetCounter("chunks", static_cast<std::int64_t>(outputs->timeline.chunks().size()));
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+
+// Child spawns short living processes one after another. Every process,
+// the child included, should be reported as created and as exited, which on
+// Linux takes the process connector: cgroup scans miss processes living
+// shorter than the interval between them.
+void BenchmarkJobNotifications(State& state) {
+  const std::vector<std::wstring> arguments =
+      MakeArguments(kSpawnChildrenArgument, kSpawnedChildren);
+  std::int64_t lost_notifications = 0;
+  std::int64_t new_processes = 0;
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    ProcessCounter counter;
+    system::Job job;
+    job.AddObserver(&counter);
+    if (!RunChild(job, arguments)) {
+      state.SetError("Unable to run child");
+      return;
+    }
+    // Events job has posted by now are dispatched to the counter.
+    system::Reactor::Get().WaitForDeferred();
+    new_processes += counter.new_processes;
+    lost_notifications += 2 * kSpawnedProcesses - counter.new_processes -
+                          counter.exited_processes;
+  }
+  const std::int64_t spawned_processes =
+      static_cast<std::int64_t>(state.iterations()) * kSpawnedProcesses;
+  state.SetCounter("spawned_processes", spawned_processes);
+  state.SetCounter("new_processes", new_processes);
+  state.SetCounter("lost_notifications", lost_notifications);
+  if (lost_notifications != 0) {
+    state.SetError("Job has lost " + std::to_string(lost_notifications) +
+                   " notifications");
+  }
+}
+
+// Children sleep at once, each in a job of its own, with their exits
+// waited for by the reactor rather than by a thread per child. Peak thread
+// count and CPU time of oven while children run show that.
+void BenchmarkParallelChildren(State& state) {
+  const std::vector<std::wstring> arguments =
+      MakeArguments(kSleepArgument, kParallelChildSleep);
+  std::int64_t peak_threads = CountThreads();
+  const std::chrono::microseconds start_cpu_time = GetProcessCpuTime();
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    std::vector<std::unique_ptr<system::Job>> jobs;
+    std::vector<std::unique_ptr<system::ChildProcess>> children;
+    std::mutex guard;
+    std::condition_variable child_exited;
+    size_t children_left = 0;
+    bool failed = false;
+    for (size_t index = 0; index < kParallelChildren; ++index) {
+      jobs.push_back(std::make_unique<system::Job>());
+      children.push_back(std::make_unique<system::ChildProcess>(GetBenchExecutable()));
+      children.back()->SetArguments(arguments);
+      if (!children.back()->Run(*jobs.back())) {
+        std::lock_guard lock(guard);
+        failed = true;
+        break;
+      }
+      {
+        std::lock_guard lock(guard);
+        ++children_left;
+      }
+      peak_threads = std::max(peak_threads, CountThreads());
+      children.back()->WaitAsync(kChildTimeout, [&](const std::optional<int> exit_code) {
+        std::lock_guard lock(guard);
+        failed = failed || exit_code != 0;
+        if (--children_left == 0) {
+          child_exited.notify_one();
+        }
+      });
+    }
+    std::unique_lock lock(guard);
+    while (!child_exited.wait_for(lock, kThreadSampleInterval,
+                                  [&]() { return children_left == 0; })) {
+      peak_threads = std::max(peak_threads, CountThreads());
+    }
+    if (failed) {
+      state.SetError("Unable to run children");
+      return;
+    }
+  }
+  const std::chrono::microseconds cpu_time = GetProcessCpuTime() - start_cpu_time;
+  state.SetCounter("children", kParallelChildren);
+  state.SetCounter("peak_threads", peak_threads);
+  state.SetCounter("cpu_time_us_per_iteration",
+                   cpu_time.count() / static_cast<std::int64_t>(state.iterations()));
+}
+}  // anonymous namespace
+
+void RegisterChildBenchmarks() {
+#if defined(_WIN32)
+  Register("child_spawn", [](State& state) { BenchmarkSpawn(state, false); });
+#else
+  Register("child_spawn/clone3", [](State& state) { BenchmarkSpawn(state, false); });
+  Register("child_spawn/fork", [](State& state) { BenchmarkSpawn(state, true); });
+#endif
+  for (const size_t size : kCaptureSizes) {
+    Register("child_capture/" + std::to_string(size), [size](State& state) {
+      BenchmarkCapture(state, size, system::ChildProcess::Passthrough());
+    });
+  }
+  Register("child_capture_passthrough/" + std::to_string(kPassthroughSize), [](State& state) {
+    const auto passthrough = system::ChildProcess::Passthrough::OpenFile(kNullDevice);
+    if (!passthrough) {
+      state.SetError("Unable to open null device");
+      return;
+    }
+    BenchmarkCapture(state, kPassthroughSize, *passthrough);
+  });
+  Register("job_notifications/" + std::to_string(kSpawnedChildren),
+           BenchmarkJobNotifications);
+  Register("parallel_children/" + std::to_string(kParallelChildren),
+           BenchmarkParallelChildren);
+}
+
+}  // namespace bench
+}  // namespace oven
@@ -0,0 +1,131 @@
+#include "bench/harness.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/json_writer.h"
+
+namespace oven {
+namespace bench {
+namespace {
+// Keeps benchmarks of fast operations from running for ever if their body
+// is optimized away.
+const std::uint64_t kMaxIterations = 1000000000;
+// Number of iterations grows by at most this factor between runs.
+const std::uint64_t kMaxGrowth = 10;
+
+struct RegisteredBenchmark {
+  std::string name;
+  Benchmark benchmark;
+};
+
+std::vector<RegisteredBenchmark>& GetBenchmarks() {
+  static std::vector<RegisteredBenchmark> benchmarks;
+  return benchmarks;
+}
+}  // anonymous namespace
+
+State::State(const std::uint64_t iterations) : iterations_(iterations) {
+}
+
+void State::PauseTiming() {
+  pause_time_ = std::chrono::steady_clock::now();
+}
+
+void State::ResumeTiming() {
+  paused_time_ += std::chrono::steady_clock::now() - pause_time_;
+}
+
+// Runs benchmark once, with the number of iterations its state has.
+class Runner {
+ public:
+  static std::chrono::nanoseconds Run(const Benchmark& benchmark, State& state) {
+    state.start_time_ = std::chrono::steady_clock::now();
+    benchmark(state);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - state.start_time_ - state.paused_time_);
+  }
+
+  // Time is in nanoseconds, throughput in bytes per second.
+  static void Write(base::JsonWriter& writer, const std::string& name,
+                    const State& state, const std::chrono::nanoseconds time) {
+    const std::uint64_t nanoseconds =
+        static_cast<std::uint64_t>(std::max<std::int64_t>(1, time.count()));
+    writer.BeginObject();
+    writer.Key("name");
+    writer.String(name);
+    writer.Key("iterations");
+    writer.Uint(state.iterations_);
+    writer.Key("time");
+    writer.Uint(nanoseconds);
+    writer.Key("time_per_iteration");
+    writer.Uint(nanoseconds / state.iterations_);
+    writer.Key("bytes_per_second");
+    if (state.bytes_processed_) {
+      writer.Uint(static_cast<std::uint64_t>(static_cast<double>(*state.bytes_processed_) *
+                                             1e9 / static_cast<double>(nanoseconds)));
+    } else {
+      writer.Null();
+    }
+    writer.Key("counters");
+    writer.BeginObject();
+    for (const auto& [counter, value] : state.counters_) {
+      writer.Key(counter);
+      writer.Int(value);
+    }
+    writer.EndObject();
+    writer.Key("error");
+    if (state.error_) {
+      writer.String(*state.error_);
+    } else {
+      writer.Null();
+    }
+    writer.EndObject();
+  }
+
+  static bool HasFailed(const State& state) { return state.error_.has_value(); }
+};
+
+void Register(const std::string_view name, Benchmark benchmark) {
+  GetBenchmarks().push_back(RegisteredBenchmark{std::string(name), std::move(benchmark)});
+}
+
+bool RunBenchmarks(const std::string_view filter,
+                   const std::chrono::milliseconds min_time,
+                   std::ostream& stream) {
+  bool passed = true;
+  base::JsonWriter writer(stream);
+  writer.BeginObject();
+  writer.Key("benchmarks");
+  writer.BeginArray();
+  for (const RegisteredBenchmark& registered : GetBenchmarks()) {
+    if (registered.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    // Next run is estimated to take the minimum time, with some margin.
+    std::uint64_t iterations = 1;
+    while (true) {
+      State state(iterations);
+      const std::chrono::nanoseconds time = Runner::Run(registered.benchmark, state);
+      if (Runner::HasFailed(state) || time >= min_time || iterations >= kMaxIterations) {
+        Runner::Write(writer, registered.name, state, time);
+        passed = passed && !Runner::HasFailed(state);
+        break;
+      }
+      const double estimate = static_cast<double>(iterations) * 1.4 *
+                              std::chrono::duration<double>(min_time).count() /
+                              std::max(1e-9, std::chrono::duration<double>(time).count());
+      iterations = std::clamp<std::uint64_t>(static_cast<std::uint64_t>(estimate),
+                                             iterations + 1, iterations * kMaxGrowth);
+      iterations = std::min(iterations, kMaxIterations);
+    }
+  }
+  writer.EndArray();
+  writer.EndObject();
+  stream << '\n';
+  return passed;
+}
+
+}  // namespace bench
+}  // namespace oven
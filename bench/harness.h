@@ -0,0 +1,70 @@
+#ifndef _OVEN_BENCH_HARNESS_H_
+#define _OVEN_BENCH_HARNESS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace oven {
+namespace bench {
+
+// Measured run of a benchmark: its body repeats the measured operation
+// |iterations| times.
+class State {
+ public:
+  explicit State(const std::uint64_t iterations);
+
+  std::uint64_t iterations() const noexcept { return iterations_; }
+
+  // Excludes what's done in between, e.g. preparing input of the next
+  // iteration, from the measured time.
+  void PauseTiming();
+  void ResumeTiming();
+
+  // Bytes all the iterations have processed, reported as throughput.
+  void SetBytesProcessed(const std::uint64_t bytes) { bytes_processed_ = bytes; }
+
+  // Reports |value| along with the time, e.g. number of lost events.
+  void SetCounter(const std::string& name, const std::int64_t value) {
+    counters_[name] = value;
+  }
+
+  // Reports benchmark as failed, e.g. if its child couldn't be started.
+  // Body should return right away.
+  void SetError(const std::string_view message) { error_ = message; }
+
+ private:
+  friend class Runner;
+
+  const std::uint64_t iterations_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::chrono::steady_clock::time_point pause_time_;
+  std::chrono::steady_clock::duration paused_time_{0};
+  std::optional<std::uint64_t> bytes_processed_;
+  std::map<std::string, std::int64_t> counters_;
+  std::optional<std::string> error_;
+};
+
+using Benchmark = std::function<void(State& state)>;
+
+// Adds benchmark to the ones |RunBenchmarks| runs, in the order they were
+// registered.
+void Register(const std::string_view name, Benchmark benchmark);
+
+// Runs registered benchmarks with |filter| in their names, repeating each
+// one with growing number of iterations until it takes at least |min_time|,
+// and writes results of the last runs to |stream| as json. Returns false if
+// any benchmark has failed.
+bool RunBenchmarks(const std::string_view filter,
+                   const std::chrono::milliseconds min_time,
+                   std::ostream& stream);
+
+}  // namespace bench
+}  // namespace oven
+
+#endif  // _OVEN_BENCH_HARNESS_H_
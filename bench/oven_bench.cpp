@@ -0,0 +1,209 @@
+#if defined(_WIN32)
+#include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/string_conversion.h"
+#include "bench/benchmarks.h"
+#include "bench/harness.h"
+
+namespace arguments {
+const wchar_t kFilter[] = L"filter";
+const wchar_t kMinTime[] = L"min-time";
+}  // arguments namespace
+
+namespace {
+const std::int64_t kDefaultMinTime = 500;
+}  // anonymous namespace
+
+namespace oven {
+namespace bench {
+const wchar_t kWriteOutputArgument[] = L"write-output";
+const wchar_t kSleepArgument[] = L"sleep";
+const wchar_t kSpawnChildrenArgument[] = L"spawn-children";
+
+namespace {
+const size_t kWriteChunkSize = 64 * 1024;
+
+std::wstring& GetBenchExecutableStorage() {
+  static std::wstring executable;
+  return executable;
+}
+
+// Writes |size| bytes to stdout in chunks pipe readers usually get.
+int WriteOutput(const size_t size) {
+#if defined(_WIN32)
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  const std::string chunk(kWriteChunkSize, 'x');
+  for (size_t written = 0; written < size;) {
+    const size_t part = std::min(chunk.size(), size - written);
+    if (std::fwrite(chunk.data(), 1, part, stdout) != part) {
+      return 1;
+    }
+    written += part;
+  }
+  return std::fflush(stdout) == 0 ? 0 : 1;
+}
+
+// Spawns |children| processes one after another, each of them exits right
+// away. No shell is involved, so that the number of processes is exact.
+int SpawnChildren(const size_t children) {
+#if defined(_WIN32)
+  const std::wstring executable = L"\"" + GetBenchExecutable() + L"\"";
+  const std::wstring argument = std::wstring(L"--") + kWriteOutputArgument + L"=0";
+  for (size_t child = 0; child < children; ++child) {
+    if (::_wspawnl(_P_WAIT, GetBenchExecutable().c_str(), executable.c_str(),
+                   argument.c_str(), nullptr) != 0) {
+      return 1;
+    }
+  }
+#else
+  for (size_t child = 0; child < children; ++child) {
+    const pid_t process_id = ::fork();
+    if (process_id == 0) {
+      ::_exit(0);
+    }
+    int status = 0;
+    if (process_id < 0 || ::waitpid(process_id, &status, 0) != process_id ||
+        status != 0) {
+      return 1;
+    }
+  }
+#endif
+  return 0;
+}
+}  // anonymous namespace
+
+const std::wstring& GetBenchExecutable() {
+  return GetBenchExecutableStorage();
+}
+
+ScopedTemporaryDirectory::ScopedTemporaryDirectory() {
+  thread_local static std::mt19937_64 generator{std::random_device{}()};
+  path_ = std::filesystem::temp_directory_path() /
+          ("oven-bench-" + std::to_string(generator()));
+  std::filesystem::create_directories(path_);
+}
+
+ScopedTemporaryDirectory::~ScopedTemporaryDirectory() {
+  std::error_code error;
+  std::filesystem::remove_all(path_, error);
+}
+
+std::string GenerateData(const size_t size) {
+  std::mt19937 generator(static_cast<std::mt19937::result_type>(size));
+  std::string data(size, '\0');
+  for (char& byte : data) {
+    byte = static_cast<char>(generator());
+  }
+  return data;
+}
+
+}  // namespace bench
+}  // namespace oven
+
+int wmain(int argc, wchar_t* argv[]) {
+  using oven::base::CommandLine;
+  CommandLine command_line(argc, argv);
+  command_line.AddOptionalArgument(
+      arguments::kFilter,
+      L"Run only benchmarks with this string in their names",
+      CommandLine::ArgumentType::kString);
+  command_line.AddOptionalArgument(
+      arguments::kMinTime,
+      L"Time each benchmark runs for at least, in milliseconds. Defaults to 500",
+      CommandLine::ArgumentType::kInt);
+  command_line.AddOptionalArgument(
+      oven::bench::kWriteOutputArgument,
+      L"Run as a child writing this many bytes to stdout",
+      CommandLine::ArgumentType::kInt);
+  command_line.AddOptionalArgument(
+      oven::bench::kSleepArgument,
+      L"Run as a child sleeping for this many milliseconds",
+      CommandLine::ArgumentType::kInt);
+  command_line.AddOptionalArgument(
+      oven::bench::kSpawnChildrenArgument,
+      L"Run as a child spawning this many short living processes",
+      CommandLine::ArgumentType::kInt);
+
+  const std::wstring command_line_parse_error = command_line.Parse();
+  if (command_line.ShouldShowUsage()) {
+    command_line.ShowUsage(std::wcout);
+    return 0;
+  }
+  if (!command_line_parse_error.empty()) {
+    std::wclog << L"Unable to parse command line arguments: "
+               << command_line_parse_error << L'\n';
+    command_line.ShowUsage(std::wclog);
+    return 1;
+  }
+
+#if defined(_WIN32)
+  wchar_t executable[MAX_PATH];
+  ::GetModuleFileNameW(nullptr, executable, MAX_PATH);
+  oven::bench::GetBenchExecutableStorage() = executable;
+#else
+  std::error_code error;
+  oven::bench::GetBenchExecutableStorage() =
+      std::filesystem::canonical("/proc/self/exe", error).wstring();
+#endif
+
+  if (const auto size = command_line.GetValue<std::int64_t>(oven::bench::kWriteOutputArgument)) {
+    return oven::bench::WriteOutput(static_cast<size_t>(std::max<std::int64_t>(0, *size)));
+  }
+  if (const auto sleep = command_line.GetValue<std::int64_t>(oven::bench::kSleepArgument)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(*sleep));
+    return 0;
+  }
+  if (const auto children =
+          command_line.GetValue<std::int64_t>(oven::bench::kSpawnChildrenArgument)) {
+    return oven::bench::SpawnChildren(static_cast<size_t>(std::max<std::int64_t>(0, *children)));
+  }
+
+  oven::bench::RegisterBaseBenchmarks();
+  oven::bench::RegisterResultBenchmarks();
+  oven::bench::RegisterChildBenchmarks();
+  const bool passed = oven::bench::RunBenchmarks(
+      oven::base::WideToUtf8(command_line.GetValue(arguments::kFilter, std::wstring())),
+      std::chrono::milliseconds(std::max<std::int64_t>(
+          0, command_line.GetValue(arguments::kMinTime, kDefaultMinTime))),
+      std::cout);
+  return passed ? 0 : 1;
+}
+
+#if !defined(_WIN32)
+int main(int argc, char* argv[]) {
+  std::setlocale(LC_ALL, "");
+
+  // Command line is expected to be UTF-8 encoded.
+  std::vector<std::wstring> arguments;
+  arguments.reserve(argc);
+  for (int arg = 0; arg < argc; ++arg) {
+    arguments.push_back(oven::base::Utf8ToWide(argv[arg]));
+  }
+  std::vector<wchar_t*> wide_argv;
+  wide_argv.reserve(argc + 1);
+  for (std::wstring& argument : arguments) {
+    wide_argv.push_back(argument.data());
+  }
+  wide_argv.push_back(nullptr);
+  return wmain(argc, wide_argv.data());
+}
+#endif
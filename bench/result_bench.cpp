@@ -0,0 +1,75 @@
+#include "bench/benchmarks.h"
+
+#include <string>
+
+#include "base/output_capture.h"
+#include "bench/harness.h"
+#include "execution_result.h"
+#include "result_cache.h"
+
+namespace oven {
+namespace bench {
+namespace {
+const size_t kOutputSizes[] = {1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024};
+const size_t kCachedOutputSize = 64 * 1024;
+
+base::OutputCapture CaptureOutput(const std::string& data) {
+  base::OutputCapture capture;
+  capture.Append(data);
+  capture.Finish();
+  return capture;
+}
+
+// Result of a child with |size| bytes of each output is serialized to file,
+// outputs are base64 encoded on the way.
+void BenchmarkExit(State& state, const size_t size) {
+  ScopedTemporaryDirectory directory;
+  ExecutionResult result(directory.path() / "result.json");
+  const std::string data = GenerateData(size);
+  result.ChildExitCode(0);
+  result.SetChildStdout(CaptureOutput(data));
+  result.SetChildStderr(CaptureOutput(data));
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    if (result.Exit(0) != 0) {
+      state.SetError("Unexpected exit code");
+      return;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * size * 2);
+}
+
+// Cache hit costs hashing the child and its libraries, which are memoized
+// after the first run, and reading the stored result.
+void BenchmarkResultCacheHit(State& state) {
+  ScopedTemporaryDirectory directory;
+  ResultCache::Options options;
+  options.directory = directory.path();
+  ResultCache cache(std::move(options));
+  const std::wstring command_line = GetBenchExecutable() + L" --gtest_filter=*";
+  const auto stored_key = cache.ComputeKey(GetBenchExecutable(), command_line, {});
+  if (!stored_key) {
+    state.SetError("Unable to compute cache key");
+    return;
+  }
+  cache.Store(*stored_key, GenerateData(kCachedOutputSize));
+
+  for (std::uint64_t iteration = 0; iteration < state.iterations(); ++iteration) {
+    const auto key = cache.ComputeKey(GetBenchExecutable(), command_line, {});
+    if (!key || !cache.Find(*key)) {
+      state.SetError("Unable to find cached result");
+      return;
+    }
+  }
+}
+}  // anonymous namespace
+
+void RegisterResultBenchmarks() {
+  for (const size_t size : kOutputSizes) {
+    Register("execution_result_exit/" + std::to_string(size),
+             [size](State& state) { BenchmarkExit(state, size); });
+  }
+  Register("result_cache_hit", BenchmarkResultCacheHit);
+}
+
+}  // namespace bench
+}  // namespace oven
@@ -1,44 +1,253 @@
 #include "base/base64.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define OVEN_BASE64_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows intrinsics of any instruction set without target attributes.
+#define OVEN_TARGET(instruction_set)
+#else
+#include <immintrin.h>
+#define OVEN_TARGET(instruction_set) __attribute__((target(instruction_set)))
+#endif
+#endif
+
+#include <algorithm>
+
 namespace oven {
 namespace base {
+namespace {
+const char kTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Encodes whole 3 byte groups, returns number of bytes consumed.
+size_t EncodeScalar(const unsigned char* data, const size_t size, char* output) {
+  size_t position = 0;
+  for (; position + 3 <= size; position += 3) {
+    const unsigned int group = (data[position] << 16) |
+                               (data[position + 1] << 8) | data[position + 2];
+    *output++ = kTable[(group >> 18) & 0x3F];
+    *output++ = kTable[(group >> 12) & 0x3F];
+    *output++ = kTable[(group >> 6) & 0x3F];
+    *output++ = kTable[group & 0x3F];
+  }
+  return position;
+}
+
+size_t EncodeTail(const unsigned char* data, const size_t size, char* output) {
+  if (size == 0) {
+    return 0;
+  }
+  const unsigned int group = (data[0] << 16) | (size > 1 ? data[1] << 8 : 0);
+  output[0] = kTable[(group >> 18) & 0x3F];
+  output[1] = kTable[(group >> 12) & 0x3F];
+  output[2] = size > 1 ? kTable[(group >> 6) & 0x3F] : '=';
+  output[3] = '=';
+  return 4;
+}
+
+#if defined(OVEN_BASE64_X86)
+// Vectorized encoding follows "Faster Base64 Encoding and Decoding using AVX2
+// Instructions" by Wojciech Muła and Daniel Lemire: every 3 bytes are spread
+// into 4 bytes holding 6 bit indices, which are then turned into characters
+// by adding an offset picked with a byte shuffle.
+OVEN_TARGET("ssse3")
+__m128i EncodeBlock(const __m128i input) {
+  const __m128i spread = _mm_shuffle_epi8(
+      input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i high_indices = _mm_mulhi_epu16(
+      _mm_and_si128(spread, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+  const __m128i low_indices = _mm_mullo_epi16(
+      _mm_and_si128(spread, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+  const __m128i indices = _mm_or_si128(high_indices, low_indices);
+
+  // 0..25 map to offset 13, 26..51 to 0, 52..63 to 1..12.
+  __m128i offset_index = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  offset_index = _mm_or_si128(
+      offset_index, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices),
+                                  _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, offset_index));
+}
+
+OVEN_TARGET("ssse3")
+size_t EncodeSsse3(const unsigned char* data, const size_t size, char* output) {
+  // Every step reads 16 bytes, but consumes only 12 of them.
+  size_t position = 0;
+  for (; position + 16 <= size; position += 12, output += 16) {
+    const __m128i input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), EncodeBlock(input));
+  }
+  return position + EncodeScalar(data + position, size - position, output);
+}
+
+OVEN_TARGET("avx2")
+__m256i EncodeBlock(const __m256i input) {
+  // Same as SSSE3 version, shuffles work within each 128 bit lane.
+  const __m256i spread = _mm256_shuffle_epi8(
+      input, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                             10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m256i high_indices = _mm256_mulhi_epu16(
+      _mm256_and_si256(spread, _mm256_set1_epi32(0x0FC0FC00)),
+      _mm256_set1_epi32(0x04000040));
+  const __m256i low_indices = _mm256_mullo_epi16(
+      _mm256_and_si256(spread, _mm256_set1_epi32(0x003F03F0)),
+      _mm256_set1_epi32(0x01000010));
+  const __m256i indices = _mm256_or_si256(high_indices, low_indices);
+
+  __m256i offset_index = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  offset_index = _mm256_or_si256(
+      offset_index, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices),
+                                     _mm256_set1_epi8(13)));
+  const __m256i offsets = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, offset_index));
+}
+
+OVEN_TARGET("avx2")
+size_t EncodeAvx2(const unsigned char* data, const size_t size, char* output) {
+  // Every step consumes 24 bytes, 12 per lane, reading 28 of them.
+  size_t position = 0;
+  for (; position + 28 <= size; position += 24, output += 32) {
+    const __m256i input = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position + 12)), 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), EncodeBlock(input));
+  }
+  return position + EncodeSsse3(data + position, size - position, output);
+}
+
+#if defined(_MSC_VER)
+bool SupportsSsse3() {
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 9)) != 0;
+}
+
+bool SupportsAvx2() {
+  int info[4];
+  __cpuid(info, 1);
+  // AVX registers have to be saved by the OS as well.
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 ||
+      (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+}
+#else
+bool SupportsSsse3() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3");
+}
+
+bool SupportsAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
+using EncodeFunction = size_t (*)(const unsigned char*, const size_t, char*);
+
+EncodeFunction SelectEncodeFunction() {
+#if defined(OVEN_BASE64_X86)
+  if (SupportsAvx2()) {
+    return EncodeAvx2;
+  }
+  if (SupportsSsse3()) {
+    return EncodeSsse3;
+  }
+#endif
+  return EncodeScalar;
+}
+
+EncodeFunction& GetEncodeFunction() {
+  static EncodeFunction encode = SelectEncodeFunction();
+  return encode;
+}
+
+// Encodes whole 3 byte groups, returns number of bytes consumed.
+size_t EncodeGroups(const unsigned char* data, const size_t size, char* output) {
+  return GetEncodeFunction()(data, size, output);
+}
+}  // anonymous namespace
+
+bool SetBase64ImplementationForTesting(const Base64Implementation implementation) {
+  switch (implementation) {
+    case Base64Implementation::kScalar:
+      GetEncodeFunction() = EncodeScalar;
+      return true;
+#if defined(OVEN_BASE64_X86)
+    case Base64Implementation::kSsse3:
+      if (!SupportsSsse3()) {
+        return false;
+      }
+      GetEncodeFunction() = EncodeSsse3;
+      return true;
+    case Base64Implementation::kAvx2:
+      if (!SupportsAvx2()) {
+        return false;
+      }
+      GetEncodeFunction() = EncodeAvx2;
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+size_t Base64Encode(const std::string_view data, char* output) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+  const size_t encoded = EncodeGroups(bytes, data.size(), output);
+  const size_t written = encoded / 3 * 4;
+  return written + EncodeTail(bytes + encoded, data.size() - encoded, output + written);
+}
 
 std::wstring Base64Encode(const std::string& data) {
-  static const wchar_t table[] = {
-      L'A', L'B', L'C', L'D', L'E', L'F', L'G', L'H', L'I', L'J', L'K', L'L', L'M',
-      L'N', L'O', L'P', L'Q', L'R', L'S', L'T', L'U', L'V', L'W', L'X', L'Y', L'Z',
-      L'a', L'b', L'c', L'd', L'e', L'f', L'g', L'h', L'i', L'j', L'k', L'l', L'm',
-      L'n', L'o', L'p', L'q', L'r', L's', L't', L'u', L'v', L'w', L'x', L'y', L'z',
-      L'0', L'1', L'2', L'3', L'4', L'5', L'6', L'7', L'8', L'9', L'+', L'/'};
-
-  const int output_size = 4 * ((data.size() + 2) / 3);
-  std::wstring result(output_size, 0);
-  int position;
-  wchar_t* encode = result.data();
-
-  for (position = 0; position < static_cast<int>(data.size()) - 2; position += 3) {
-    *encode++ = table[(data[position] >> 2) & 0x3F];
-    *encode++ = table[((data[position] & 0x3) << 4) |
-                      ((int)(data[position + 1] & 0xF0) >> 4)];
-    *encode++ = table[((data[position + 1] & 0xF) << 2) |
-                      ((int)(data[position + 2] & 0xC0) >> 6)];
-    *encode++ = table[data[position + 2] & 0x3F];
-  }
-
-  if (position < static_cast<int>(data.size())) {
-    *encode++ = table[(data[position] >> 2) & 0x3F];
-    if (position == (data.size() - 1)) {
-      *encode++ = table[((data[position] & 0x3) << 4)];
-      *encode++ = L'=';
-    } else {
-      *encode++ = table[((data[position] & 0x3) << 4) |
-                        ((int)(data[position + 1] & 0xF0) >> 4)];
-      *encode++ = table[((data[position + 1] & 0xF) << 2)];
+  std::string encoded(Base64EncodedSize(data.size()), '\0');
+  encoded.resize(Base64Encode(data, encoded.data()));
+  return std::wstring(encoded.begin(), encoded.end());
+}
+
+size_t Base64Encoder::Update(std::string_view data, char* output) {
+  size_t written = 0;
+  // Complete the group started by previous calls first.
+  if (pending_size_) {
+    while (pending_size_ < 3 && !data.empty()) {
+      pending_[pending_size_++] = data.front();
+      data.remove_prefix(1);
+    }
+    if (pending_size_ < 3) {
+      return 0;
     }
-    *encode++ = L'=';
+    written += EncodeScalar(reinterpret_cast<const unsigned char*>(pending_), 3,
+                            output) / 3 * 4;
+    pending_size_ = 0;
   }
 
-  return result;
+  const size_t encoded = EncodeGroups(
+      reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+      output + written);
+  written += encoded / 3 * 4;
+  data.remove_prefix(encoded);
+  std::copy(data.begin(), data.end(), pending_);
+  pending_size_ = data.size();
+  return written;
+}
+
+size_t Base64Encoder::Finish(char* output) {
+  const size_t written = EncodeTail(
+      reinterpret_cast<const unsigned char*>(pending_), pending_size_, output);
+  pending_size_ = 0;
+  return written;
 }
 
 }  // namespace base
@@ -1,13 +1,58 @@
 #ifndef _OVEN_BASE_BASE64_H_
 #define _OVEN_BASE_BASE64_H_
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace oven {
 namespace base {
 
+// Number of characters encoding of |size| bytes takes, including padding.
+constexpr size_t Base64EncodedSize(const size_t size) {
+  return 4 * ((size + 2) / 3);
+}
+
+// Encodes |data| into |output|, which must have room for at least
+// Base64EncodedSize(data.size()) characters. Returns number of characters
+// written. Pieces of data which sizes are multiples of 3 encode independently,
+// so that large buffers can be encoded in chunks (or on several threads) and
+// concatenated afterwards.
+size_t Base64Encode(const std::string_view data, char* output);
+
 std::wstring Base64Encode(const std::string& contents);
 
+// Instruction sets whole 3 byte groups are encoded with, the widest one
+// processor supports is picked by default.
+enum class Base64Implementation {
+  kScalar = 0,
+  kSsse3,
+  kAvx2,
+};
+
+// Makes encoding use |implementation| from now on, returns false if it's not
+// supported by the processor (or build). Not thread safe, meant for tests.
+bool SetBase64ImplementationForTesting(const Base64Implementation implementation);
+
+// Encodes data arriving in pieces of arbitrary sizes.
+class Base64Encoder {
+ public:
+  // Encodes |data| along with bytes left from previous calls, keeping up to 2
+  // trailing bytes for the next call. |output| must have room for at least
+  // Base64EncodedSize(data.size() + 2) characters. Returns number of
+  // characters written.
+  size_t Update(std::string_view data, char* output);
+
+  // Encodes bytes left with padding, |output| must have room for 4
+  // characters. Returns number of characters written.
+  size_t Finish(char* output);
+
+ private:
+  // Start of a 3 byte group, which is incomplete between calls.
+  char pending_[3];
+  size_t pending_size_ = 0;
+};
+
 }  // namespace base
 }  // namespace oven
 
@@ -0,0 +1,153 @@
+#include "base/base64.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace oven {
+namespace base {
+namespace {
+// Encoder oven used before vectorized one, kept as a reference.
+std::wstring ReferenceBase64Encode(const std::string& data) {
+  static const wchar_t table[] = {
+      L'A', L'B', L'C', L'D', L'E', L'F', L'G', L'H', L'I', L'J', L'K', L'L', L'M',
+      L'N', L'O', L'P', L'Q', L'R', L'S', L'T', L'U', L'V', L'W', L'X', L'Y', L'Z',
+      L'a', L'b', L'c', L'd', L'e', L'f', L'g', L'h', L'i', L'j', L'k', L'l', L'm',
+      L'n', L'o', L'p', L'q', L'r', L's', L't', L'u', L'v', L'w', L'x', L'y', L'z',
+      L'0', L'1', L'2', L'3', L'4', L'5', L'6', L'7', L'8', L'9', L'+', L'/'};
+
+  std::wstring result;
+  size_t position = 0;
+  for (; position + 2 < data.size(); position += 3) {
+    result += table[(data[position] >> 2) & 0x3F];
+    result += table[((data[position] & 0x3) << 4) | ((data[position + 1] & 0xF0) >> 4)];
+    result += table[((data[position + 1] & 0xF) << 2) | ((data[position + 2] & 0xC0) >> 6)];
+    result += table[data[position + 2] & 0x3F];
+  }
+  if (position < data.size()) {
+    result += table[(data[position] >> 2) & 0x3F];
+    if (position == data.size() - 1) {
+      result += table[(data[position] & 0x3) << 4];
+      result += L'=';
+    } else {
+      result += table[((data[position] & 0x3) << 4) | ((data[position + 1] & 0xF0) >> 4)];
+      result += table[(data[position + 1] & 0xF) << 2];
+    }
+    result += L'=';
+  }
+  return result;
+}
+
+std::string GenerateData(const size_t size, std::mt19937& generator) {
+  std::string data(size, '\0');
+  for (char& byte : data) {
+    byte = static_cast<char>(generator());
+  }
+  return data;
+}
+
+std::wstring Widen(const std::string& encoded) {
+  return std::wstring(encoded.begin(), encoded.end());
+}
+
+// Sizes cover every remainder modulo 3 around the 12 and 24 byte blocks
+// vectorized paths consume at once, and sizes of several blocks.
+std::vector<size_t> GetSizes() {
+  std::vector<size_t> sizes;
+  for (size_t size = 0; size <= 100; ++size) {
+    sizes.push_back(size);
+  }
+  for (const size_t size : {1000, 1001, 1002, 4096, 65535, 65536, 65537}) {
+    sizes.push_back(size);
+  }
+  return sizes;
+}
+
+class Base64Test : public testing::TestWithParam<Base64Implementation> {
+ protected:
+  void SetUp() override {
+    if (!SetBase64ImplementationForTesting(GetParam())) {
+      GTEST_SKIP() << "Implementation is not supported by the processor";
+    }
+  }
+
+  std::mt19937 generator_{42};
+};
+
+TEST_P(Base64Test, MatchesReference) {
+  for (const size_t size : GetSizes()) {
+    const std::string data = GenerateData(size, generator_);
+    std::string encoded(Base64EncodedSize(size), '\0');
+    ASSERT_EQ(Base64Encode(data, encoded.data()), encoded.size()) << size;
+    EXPECT_EQ(Widen(encoded), ReferenceBase64Encode(data)) << size;
+    EXPECT_EQ(Base64Encode(data), ReferenceBase64Encode(data)) << size;
+  }
+}
+
+TEST_P(Base64Test, EncodesEveryByteValue) {
+  std::string data;
+  for (int repeat = 0; repeat < 3; ++repeat) {
+    for (int byte = 0; byte < 256; ++byte) {
+      data += static_cast<char>(byte + repeat);
+    }
+  }
+  EXPECT_EQ(Base64Encode(data), ReferenceBase64Encode(data));
+}
+
+TEST_P(Base64Test, EncodesInChunks) {
+  std::uniform_int_distribution<size_t> chunk_sizes(0, 70);
+  for (const size_t size : GetSizes()) {
+    const std::string data = GenerateData(size, generator_);
+    Base64Encoder encoder;
+    std::string encoded;
+    for (size_t position = 0; position < data.size();) {
+      const size_t chunk_size = std::min(chunk_sizes(generator_), data.size() - position);
+      std::string output(Base64EncodedSize(chunk_size + 2), '\0');
+      output.resize(encoder.Update(std::string_view(data).substr(position, chunk_size),
+                                   output.data()));
+      encoded += output;
+      position += chunk_size;
+    }
+    std::string tail(4, '\0');
+    tail.resize(encoder.Finish(tail.data()));
+    encoded += tail;
+    EXPECT_EQ(Widen(encoded), ReferenceBase64Encode(data)) << size;
+  }
+}
+
+// Pieces which sizes are multiples of 3 concatenate into the whole encoding.
+TEST_P(Base64Test, ConcatenatesGroupAlignedPieces) {
+  const std::string data = GenerateData(3 * 1000 + 2, generator_);
+  std::string encoded;
+  for (size_t position = 0; position < data.size(); position += 3 * 37) {
+    const std::string_view piece = std::string_view(data).substr(position, 3 * 37);
+    std::string output(Base64EncodedSize(piece.size()), '\0');
+    output.resize(Base64Encode(piece, output.data()));
+    encoded += output;
+  }
+  EXPECT_EQ(Widen(encoded), ReferenceBase64Encode(data));
+}
+
+INSTANTIATE_TEST_SUITE_P(Implementations, Base64Test,
+                         testing::Values(Base64Implementation::kScalar,
+                                         Base64Implementation::kSsse3,
+                                         Base64Implementation::kAvx2),
+                         [](const testing::TestParamInfo<Base64Implementation>& info) {
+                           switch (info.param) {
+                             case Base64Implementation::kScalar:
+                               return "Scalar";
+                             case Base64Implementation::kSsse3:
+                               return "Ssse3";
+                             case Base64Implementation::kAvx2:
+                               return "Avx2";
+                           }
+                           return "Unknown";
+                         });
+
+}  // anonymous namespace
+}  // namespace base
+}  // namespace oven
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <filesystem>
 #include <fstream>
 #include <iterator>
 #include <sstream>
@@ -156,6 +157,15 @@ bool CommandLine::IsSpecified(const std::wstring_view argument) const {
   return arguments_.find(argument) != arguments_.end();
 }
 
+std::vector<std::wstring_view> CommandLine::GetSpecifiedArguments() const {
+  std::vector<std::wstring_view> specified;
+  for (const auto& [name, value] : arguments_) {
+    specified.push_back(name);
+  }
+  std::sort(specified.begin(), specified.end());
+  return specified;
+}
+
 std::wstring CommandLine::TryAddExpectedArgument(
     const std::wstring_view argument,
     const std::wstring_view value) {
@@ -212,7 +222,7 @@ std::wstring CommandLine::CheckRequiredArguments() const {
 
 void CommandLine::ReadReponseFile(const std::wstring_view& filename,
                                   std::vector<std::wstring>* rsp_arguments_storage) {
-  std::wfstream response_file(filename.data());
+  std::wfstream response_file{std::filesystem::path(filename)};
   std::wstring argument;
   while (initial_arguments_.size() < kMaxNumberOfArguments &&
          response_file >> argument) {
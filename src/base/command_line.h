@@ -40,6 +40,8 @@ class CommandLine {
   void ShowUsage(std::wostream& output_stream) const;
 
   bool IsSpecified(const std::wstring_view argument) const;
+  // Returns names of the specified arguments in sorted order.
+  std::vector<std::wstring_view> GetSpecifiedArguments() const;
 
   template <typename ValueType>
   std::optional<ValueType> GetValue(const std::wstring_view argument) const {
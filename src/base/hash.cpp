@@ -0,0 +1,129 @@
+#include "base/hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace oven {
+namespace base {
+namespace {
+const std::uint64_t kPrime1 = 0x9e3779b185ebca87ULL;
+const std::uint64_t kPrime2 = 0xc2b2ae3d27d4eb4fULL;
+const std::uint64_t kPrime3 = 0x165667b19e3779f9ULL;
+const std::uint64_t kPrime4 = 0x85ebca77c2b2ae63ULL;
+const std::uint64_t kPrime5 = 0x27d4eb2f165667c5ULL;
+
+std::uint64_t RotateLeft(const std::uint64_t value, const int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// Hash is defined over little-endian words, which all the supported
+// platforms are.
+std::uint64_t Read64(const char* bytes) {
+  std::uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+std::uint32_t Read32(const char* bytes) {
+  std::uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+std::uint64_t Round(std::uint64_t lane, const std::uint64_t input) {
+  lane += input * kPrime2;
+  return RotateLeft(lane, 31) * kPrime1;
+}
+
+std::uint64_t MergeRound(std::uint64_t hash, const std::uint64_t lane) {
+  hash ^= Round(0, lane);
+  return hash * kPrime1 + kPrime4;
+}
+}  // anonymous namespace
+
+Hasher::Hasher(const std::uint64_t seed)
+    : seed_(seed),
+      lanes_{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1} {}
+
+void Hasher::Update(std::string_view data) {
+  total_size_ += data.size();
+  if (pending_size_ > 0) {
+    const size_t size = std::min(data.size(), sizeof(pending_) - pending_size_);
+    std::memcpy(pending_ + pending_size_, data.data(), size);
+    pending_size_ += size;
+    data.remove_prefix(size);
+    if (pending_size_ < sizeof(pending_)) {
+      return;
+    }
+    ProcessStripe(pending_);
+    pending_size_ = 0;
+  }
+  while (data.size() >= sizeof(pending_)) {
+    ProcessStripe(data.data());
+    data.remove_prefix(sizeof(pending_));
+  }
+  std::memcpy(pending_, data.data(), data.size());
+  pending_size_ = data.size();
+}
+
+void Hasher::Update(const std::uint64_t value) {
+  char bytes[sizeof(value)];
+  std::memcpy(bytes, &value, sizeof(value));
+  Update(std::string_view(bytes, sizeof(bytes)));
+}
+
+std::uint64_t Hasher::Finish() const {
+  std::uint64_t hash;
+  if (total_size_ >= sizeof(pending_)) {
+    hash = RotateLeft(lanes_[0], 1) + RotateLeft(lanes_[1], 7) +
+           RotateLeft(lanes_[2], 12) + RotateLeft(lanes_[3], 18);
+    for (const std::uint64_t lane : lanes_) {
+      hash = MergeRound(hash, lane);
+    }
+  } else {
+    hash = seed_ + kPrime5;
+  }
+  hash += total_size_;
+
+  const char* bytes = pending_;
+  size_t size = pending_size_;
+  for (; size >= 8; bytes += 8, size -= 8) {
+    hash ^= Round(0, Read64(bytes));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (size >= 4) {
+    hash ^= Read32(bytes) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    bytes += 4;
+    size -= 4;
+  }
+  for (; size > 0; ++bytes, --size) {
+    hash ^= static_cast<unsigned char>(*bytes) * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+void Hasher::ProcessStripe(const char* stripe) {
+  for (size_t lane = 0; lane < 4; ++lane) {
+    lanes_[lane] = Round(lanes_[lane], Read64(stripe + lane * 8));
+  }
+}
+
+std::string FormatHash(std::uint64_t value) {
+  const char digits[] = "0123456789abcdef";
+  std::string hash(16, '0');
+  for (size_t digit = hash.size(); digit > 0; --digit, value >>= 4) {
+    hash[digit - 1] = digits[value & 0xf];
+  }
+  return hash;
+}
+
+}  // namespace base
+}  // namespace oven
@@ -0,0 +1,42 @@
+#ifndef _OVEN_BASE_HASH_H_
+#define _OVEN_BASE_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace oven {
+namespace base {
+
+// Fast non-cryptographic 64-bit hash (XXH64) of data arriving in pieces of
+// arbitrary sizes. Hashing the same bytes gives the same value however they
+// are split.
+class Hasher {
+ public:
+  explicit Hasher(const std::uint64_t seed = 0);
+
+  void Update(std::string_view data);
+  // Hashes |value| as 8 little-endian bytes, e.g. to delimit strings.
+  void Update(const std::uint64_t value);
+
+  std::uint64_t Finish() const;
+
+ private:
+  void ProcessStripe(const char* stripe);
+
+  std::uint64_t seed_;
+  std::uint64_t lanes_[4];
+  // Start of a 32 byte stripe, which is incomplete between calls.
+  char pending_[32];
+  size_t pending_size_ = 0;
+  std::uint64_t total_size_ = 0;
+};
+
+// Returns |value| as 16 lowercase hexadecimal digits.
+std::string FormatHash(const std::uint64_t value);
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_HASH_H_
@@ -0,0 +1,185 @@
+#include "base/json_writer.h"
+
+#include <cstdio>
+#include <string>
+
+#include "base/string_conversion.h"
+
+namespace oven {
+namespace base {
+namespace {
+// Multiple of 3, so that every chunk but the last one encodes without
+// padding.
+const size_t kBase64ChunkSize = 48 * 1024;
+}  // anonymous namespace
+
+JsonWriter::JsonWriter(std::ostream& stream) : stream_(stream) {}
+
+void JsonWriter::BeginObject() {
+  BeginValue();
+  stream_.put('{');
+  has_values_.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+  EndContainer('}');
+}
+
+void JsonWriter::BeginArray() {
+  BeginValue();
+  stream_.put('[');
+  has_values_.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+  EndContainer(']');
+}
+
+void JsonWriter::Key(const std::string_view name) {
+  BeginValue();
+  stream_.put('"');
+  stream_.write(name.data(), name.size());
+  stream_.write("\": ", 3);
+  after_key_ = true;
+}
+
+void JsonWriter::String(const std::wstring_view value) {
+  String(WideToUtf8(value));
+}
+
+void JsonWriter::String(const std::string_view value) {
+  BeginValue();
+  stream_.put('"');
+  // Unescaped runs are written at once.
+  size_t run_start = 0;
+  for (size_t position = 0; position < value.size(); ++position) {
+    const unsigned char character = static_cast<unsigned char>(value[position]);
+    if (character >= 0x20 && character != '"' && character != '\\') {
+      continue;
+    }
+    stream_.write(value.data() + run_start, position - run_start);
+    run_start = position + 1;
+    switch (character) {
+      case '"':
+        stream_.write("\\\"", 2);
+        break;
+      case '\\':
+        stream_.write("\\\\", 2);
+        break;
+      case '\n':
+        stream_.write("\\n", 2);
+        break;
+      case '\r':
+        stream_.write("\\r", 2);
+        break;
+      case '\t':
+        stream_.write("\\t", 2);
+        break;
+      default:
+        char code[7];
+        std::snprintf(code, sizeof(code), "\\u%04x", character);
+        stream_.write(code, 6);
+    }
+  }
+  stream_.write(value.data() + run_start, value.size() - run_start);
+  stream_.put('"');
+}
+
+void JsonWriter::Int(const std::int64_t value) {
+  BeginValue();
+  stream_ << value;
+}
+
+void JsonWriter::Uint(const std::uint64_t value) {
+  BeginValue();
+  stream_ << value;
+}
+
+void JsonWriter::Bool(const bool value) {
+  BeginValue();
+  stream_ << (value ? "true" : "false");
+}
+
+void JsonWriter::Null() {
+  BeginValue();
+  stream_ << "null";
+}
+
+void JsonWriter::Fields(const std::string_view document) {
+  const size_t start = document.find('{');
+  const size_t end = document.rfind('}');
+  if (start == document.npos || end == document.npos || end <= start) {
+    return;
+  }
+  std::string_view fields = document.substr(start + 1, end - start - 1);
+  const size_t first = fields.find_first_not_of(" \r\n");
+  if (first == fields.npos) {
+    return;
+  }
+  fields = fields.substr(first, fields.find_last_not_of(" \r\n") + 1 - first);
+  BeginValue();
+  // First field is indented by |BeginValue| already, the rest by their
+  // document one level deep.
+  for (size_t line_end = fields.find('\n'); line_end != fields.npos;
+       line_end = fields.find('\n')) {
+    stream_.write(fields.data(), line_end + 1);
+    Indent(has_values_.size() - 1);
+    fields.remove_prefix(line_end + 1);
+  }
+  stream_.write(fields.data(), fields.size());
+}
+
+void JsonWriter::BeginBase64() {
+  BeginValue();
+  stream_.put('"');
+  base64_buffer_.resize(Base64EncodedSize(kBase64ChunkSize + 2));
+}
+
+void JsonWriter::AppendBase64(std::string_view data) {
+  while (!data.empty()) {
+    const std::string_view chunk = data.substr(0, kBase64ChunkSize);
+    stream_.write(base64_buffer_.data(),
+                  base64_encoder_.Update(chunk, base64_buffer_.data()));
+    data.remove_prefix(chunk.size());
+  }
+}
+
+void JsonWriter::EndBase64() {
+  stream_.write(base64_buffer_.data(), base64_encoder_.Finish(base64_buffer_.data()));
+  stream_.put('"');
+}
+
+void JsonWriter::BeginValue() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (has_values_.empty()) {
+    return;
+  }
+  if (has_values_.back()) {
+    stream_.put(',');
+  }
+  stream_.put('\n');
+  Indent(has_values_.size());
+  has_values_.back() = true;
+}
+
+void JsonWriter::EndContainer(const char closing) {
+  const bool has_values = has_values_.back();
+  has_values_.pop_back();
+  if (has_values) {
+    stream_.put('\n');
+    Indent(has_values_.size());
+  }
+  stream_.put(closing);
+}
+
+void JsonWriter::Indent(const size_t level) {
+  for (size_t indent = 0; indent < level; ++indent) {
+    stream_.write("  ", 2);
+  }
+}
+
+}  // namespace base
+}  // namespace oven
@@ -0,0 +1,84 @@
+#ifndef _OVEN_BASE_JSON_WRITER_H_
+#define _OVEN_BASE_JSON_WRITER_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string_view>
+#include <string>
+#include <vector>
+
+#include "base/base64.h"
+
+namespace oven {
+namespace base {
+
+// Writes indented UTF-8 encoded json straight into |stream|, without
+// building the document in memory. Every value inside of an object has to
+// be preceded by |Key|.
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::ostream& stream);
+
+  JsonWriter(const JsonWriter&) = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  // |name| is expected not to need escaping.
+  void Key(const std::string_view name);
+
+  void String(const std::wstring_view value);
+  // |value| is expected to be UTF-8 encoded.
+  void String(const std::string_view value);
+  void Int(const std::int64_t value);
+  void Uint(const std::uint64_t value);
+  void Bool(const bool value);
+  void Null();
+
+  // Writes fields of another document into the current object: |document|
+  // is a top-level object written by another writer, which fields are
+  // re-indented to the current level of nesting.
+  void Fields(const std::string_view document);
+
+  // Writes base64 encoding of concatenated |parts| as a string, encoding them
+  // chunk by chunk.
+  template <typename Parts>
+  void Base64(const Parts& parts) {
+    BeginBase64();
+    for (const std::string_view part : parts) {
+      AppendBase64(part);
+    }
+    EndBase64();
+  }
+  void Base64(const std::initializer_list<std::string_view> parts) {
+    Base64<std::initializer_list<std::string_view>>(parts);
+  }
+
+  // Base64 string can be written piece by piece as well.
+  void BeginBase64();
+  void AppendBase64(std::string_view data);
+  void EndBase64();
+
+ private:
+  // Writes separator and indentation before a new value.
+  void BeginValue();
+  void EndContainer(const char closing);
+  void Indent(const size_t level);
+
+  std::ostream& stream_;
+  // Whether container on each level of nesting has values already.
+  std::vector<bool> has_values_;
+  // Set by |Key|, value following a key needs no separator.
+  bool after_key_ = false;
+  Base64Encoder base64_encoder_;
+  std::string base64_buffer_;
+};
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_JSON_WRITER_H_
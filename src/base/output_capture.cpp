@@ -0,0 +1,172 @@
+#include "base/output_capture.h"
+
+#include <algorithm>
+#include <random>
+
+namespace oven {
+namespace base {
+namespace {
+std::filesystem::path GenerateSpillFileName() {
+  thread_local static std::mt19937_64 generator{std::random_device{}()};
+  const char digits[] = "0123456789abcdef";
+  std::string name = "oven-output-";
+  std::uint64_t value = generator();
+  for (int digit = 0; digit < 16; ++digit, value >>= 4) {
+    name.push_back(digits[value & 0xf]);
+  }
+  return name;
+}
+}  // anonymous namespace
+
+OutputCapture::OutputCapture(Limits limits) : limits_(std::move(limits)) {}
+
+void OutputCapture::Append(std::string_view data) {
+  total_size_ += data.size();
+
+  while (!data.empty() && head_size_ < limits_.head_size) {
+    if (head_.empty() || head_.back().space() == 0) {
+      head_.emplace_back();
+    }
+    Segment& segment = head_.back();
+    const size_t size = std::min(
+        {data.size(), segment.space(), limits_.head_size - head_size_});
+    std::copy_n(data.data(), size, segment.data() + segment.size());
+    segment.set_size(segment.size() + size);
+    head_size_ += size;
+    data.remove_prefix(size);
+  }
+  if (data.empty()) {
+    return;
+  }
+
+  // Whatever doesn't fit into tail any more leaves it oldest first, so that
+  // spill file gets bytes in the stream order.
+  const size_t tail_size = limits_.tail_size;
+  if (tail_used_ + data.size() > tail_size) {
+    const size_t overflow = tail_used_ + data.size() - tail_size;
+    const size_t evicted = std::min(overflow, tail_used_);
+    EvictFromTail(evicted);
+    Truncate(data.substr(0, overflow - evicted));
+    data.remove_prefix(overflow - evicted);
+  }
+  if (data.empty()) {
+    return;
+  }
+
+  tail_.resize(tail_size);
+  while (!data.empty()) {
+    const size_t end = (tail_start_ + tail_used_) % tail_size;
+    const size_t size = std::min(data.size(), tail_size - end);
+    tail_.replace(end, size, data.data(), size);
+    tail_used_ += size;
+    data.remove_prefix(size);
+  }
+}
+
+void OutputCapture::Skip(const std::uint64_t size) {
+  if (size == 0) {
+    return;
+  }
+  EvictFromTail(tail_used_);
+  total_size_ += size;
+  truncated_size_ += size;
+}
+
+void OutputCapture::Finish() {
+  if (spill_stream_.is_open()) {
+    spill_stream_.close();
+  }
+}
+
+std::vector<std::string_view> OutputCapture::head_parts() const {
+  std::vector<std::string_view> parts;
+  parts.reserve(head_.size());
+  for (const Segment& segment : head_) {
+    parts.push_back(segment.view());
+  }
+  return parts;
+}
+
+std::string OutputCapture::tail() const {
+  const auto parts = tail_parts();
+  std::string tail;
+  tail.reserve(tail_used_);
+  tail.append(parts[0]);
+  tail.append(parts[1]);
+  return tail;
+}
+
+std::array<std::string_view, 2> OutputCapture::tail_parts() const noexcept {
+  const std::string_view tail(tail_);
+  const size_t first_part = std::min(tail_used_, tail.size() - tail_start_);
+  return {tail.substr(tail_start_, first_part),
+          tail.substr(0, tail_used_ - first_part)};
+}
+
+std::string OutputCapture::GetKept(const std::uint64_t offset, const size_t size) const {
+  std::string kept;
+  const std::uint64_t end = offset + size;
+  if (offset < head_size_) {
+    const std::uint64_t head_end = std::min<std::uint64_t>(end, head_size_);
+    for (std::uint64_t position = offset; position < head_end;) {
+      const Segment& segment = head_[position / Segment::kCapacity];
+      const size_t segment_offset = static_cast<size_t>(position % Segment::kCapacity);
+      const size_t part = static_cast<size_t>(std::min<std::uint64_t>(
+          segment.size() - segment_offset, head_end - position));
+      kept.append(segment.data() + segment_offset, part);
+      position += part;
+    }
+  }
+  // Tail holds the last bytes of the stream.
+  const std::uint64_t tail_offset = total_size_ - tail_used_;
+  if (end > tail_offset && tail_used_ > 0) {
+    const std::uint64_t first = std::max(offset, tail_offset);
+    size_t position = static_cast<size_t>(first - tail_offset);
+    size_t remaining = static_cast<size_t>(end - first);
+    for (const std::string_view part : tail_parts()) {
+      if (position >= part.size()) {
+        position -= part.size();
+        continue;
+      }
+      const size_t taken = std::min(remaining, part.size() - position);
+      kept.append(part.substr(position, taken));
+      remaining -= taken;
+      position = 0;
+    }
+  }
+  return kept;
+}
+
+void OutputCapture::EvictFromTail(size_t size) {
+  while (size) {
+    const size_t part = std::min(size, tail_.size() - tail_start_);
+    Truncate(std::string_view(tail_).substr(tail_start_, part));
+    tail_start_ = (tail_start_ + part) % tail_.size();
+    tail_used_ -= part;
+    size -= part;
+  }
+}
+
+void OutputCapture::Truncate(const std::string_view data) {
+  if (data.empty()) {
+    return;
+  }
+  truncated_size_ += data.size();
+  if (limits_.spill_directory.empty()) {
+    return;
+  }
+  if (spill_file_.empty()) {
+    spill_file_ = limits_.spill_directory / GenerateSpillFileName();
+    spill_stream_.open(spill_file_, std::ios::binary);
+    if (!spill_stream_) {
+      // Keep counting dropped bytes at least.
+      spill_file_.clear();
+      limits_.spill_directory.clear();
+      return;
+    }
+  }
+  spill_stream_.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+}  // namespace base
+}  // namespace oven
@@ -0,0 +1,90 @@
+#ifndef _OVEN_BASE_OUTPUT_CAPTURE_H_
+#define _OVEN_BASE_OUTPUT_CAPTURE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base/segment.h"
+
+namespace oven {
+namespace base {
+
+// Captures a stream keeping at most |head_size| first and |tail_size| last
+// bytes of it in memory. Bytes in between are written to a spill file if
+// spill directory is set, and only counted otherwise. Whole stream is head,
+// followed by spilled (or dropped) bytes, followed by tail.
+class OutputCapture {
+ public:
+  struct Limits {
+    size_t head_size = std::numeric_limits<size_t>::max();
+    size_t tail_size = 0;
+    // Directory to create spill file in, bytes are dropped if empty.
+    std::filesystem::path spill_directory;
+  };
+
+  OutputCapture() = default;
+  explicit OutputCapture(Limits limits);
+
+  OutputCapture(const OutputCapture&) = delete;
+  OutputCapture(OutputCapture&&) = default;
+
+  OutputCapture& operator=(const OutputCapture&) = delete;
+  OutputCapture& operator=(OutputCapture&&) = default;
+
+  void Append(std::string_view data);
+
+  // Counts |size| bytes of the stream which are lost already, e.g. dropped
+  // by another capture, as truncated. Head is expected to be full: bytes
+  // kept in tail are truncated as well, as they aren't the last ones anymore.
+  void Skip(const std::uint64_t size);
+
+  // Closes spill file, once the stream has ended.
+  void Finish();
+
+  // Head is kept in a chain of segments, so that it never gets reallocated.
+  std::vector<std::string_view> head_parts() const;
+  std::string tail() const;
+  // Tail without copying: its older part followed by the newer one.
+  std::array<std::string_view, 2> tail_parts() const noexcept;
+
+  // Returns bytes from |size| ones at |offset| of the stream that are kept
+  // in head or tail, in the stream order.
+  std::string GetKept(const std::uint64_t offset, const size_t size) const;
+
+  // Number of bytes stream had in total.
+  std::uint64_t total_size() const noexcept { return total_size_; }
+  // Number of bytes kept neither in head nor in tail.
+  std::uint64_t truncated_size() const noexcept { return truncated_size_; }
+
+  // Empty unless some bytes were spilled.
+  const std::filesystem::path& spill_file() const noexcept { return spill_file_; }
+
+ private:
+  // Moves |size| oldest bytes out of tail.
+  void EvictFromTail(size_t size);
+  void Truncate(std::string_view data);
+
+  Limits limits_;
+  std::vector<Segment> head_;
+  size_t head_size_ = 0;
+  // Ring buffer of |limits_.tail_size| bytes, allocated once needed.
+  std::string tail_;
+  size_t tail_start_ = 0;
+  size_t tail_used_ = 0;
+  std::uint64_t total_size_ = 0;
+  std::uint64_t truncated_size_ = 0;
+  std::filesystem::path spill_file_;
+  std::ofstream spill_stream_;
+};
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_OUTPUT_CAPTURE_H_
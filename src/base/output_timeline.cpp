@@ -0,0 +1,77 @@
+#include "base/output_timeline.h"
+
+#include <iomanip>
+#include <string>
+
+namespace oven {
+namespace base {
+namespace {
+// Writes |time| in seconds with microsecond precision, like "1.250000s".
+void WriteTime(std::ostream& stream, const std::chrono::nanoseconds time) {
+  const auto microseconds =
+      std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+  stream << microseconds / 1000000 << '.' << std::setw(6) << std::setfill('0')
+         << microseconds % 1000000 << std::setfill(' ') << 's';
+}
+}  // anonymous namespace
+
+std::vector<OutputTimeline::Gap> OutputTimeline::FindGaps(
+    const std::chrono::nanoseconds threshold, const std::chrono::nanoseconds end) const {
+  std::vector<Gap> gaps;
+  std::chrono::nanoseconds previous{0};
+  const auto add_gap = [&gaps, &previous, threshold](const std::chrono::nanoseconds next) {
+    if (next - previous > threshold) {
+      gaps.push_back(Gap{previous, next - previous});
+    }
+    previous = next;
+  };
+  for (const Chunk& chunk : chunks_) {
+    add_gap(std::chrono::nanoseconds(chunk.time));
+  }
+  // Dropped chunks have arrived at some unknown time after the last one.
+  if (dropped_chunks_ == 0) {
+    add_gap(end);
+  }
+  return gaps;
+}
+
+void OutputTimeline::Render(std::ostream& stream, const OutputCapture& stdoutput,
+                            const OutputCapture& stderror,
+                            const std::chrono::nanoseconds threshold) const {
+  std::uint64_t offsets[2] = {0, 0};
+  std::chrono::nanoseconds previous{0};
+  for (const Chunk& chunk : chunks_) {
+    const std::chrono::nanoseconds time(chunk.time);
+    if (time - previous > threshold) {
+      stream << "[+";
+      WriteTime(stream, time);
+      stream << "] idle for ";
+      WriteTime(stream, time - previous);
+      stream << '\n';
+    }
+    previous = time;
+
+    const bool is_stdout = chunk.stream == Stream::kStdout;
+    std::uint64_t& offset = offsets[is_stdout ? 0 : 1];
+    const std::string payload =
+        (is_stdout ? stdoutput : stderror).GetKept(offset, chunk.size);
+    offset += chunk.size;
+    stream << "[+";
+    WriteTime(stream, time);
+    stream << "] " << (is_stdout ? "stdout" : "stderr") << ", " << chunk.size
+           << " bytes";
+    if (payload.size() < chunk.size) {
+      stream << ", " << chunk.size - payload.size() << " not kept";
+    }
+    stream << '\n' << payload;
+    if (!payload.empty() && payload.back() != '\n') {
+      stream << '\n';
+    }
+  }
+  if (dropped_chunks_ > 0) {
+    stream << "[...] " << dropped_chunks_ << " more chunks\n";
+  }
+}
+
+}  // namespace base
+}  // namespace oven
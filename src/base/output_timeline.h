@@ -0,0 +1,82 @@
+#ifndef _OVEN_BASE_OUTPUT_TIMELINE_H_
+#define _OVEN_BASE_OUTPUT_TIMELINE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "base/output_capture.h"
+
+namespace oven {
+namespace base {
+
+// Index of chunks both output streams were received in, in the order they
+// were received. Chunks keep no payload, which stays in the captures of the
+// streams: offset of a chunk within its stream is the sum of sizes of the
+// chunks before it. Up to |kMaxChunks| chunks are kept, the rest are only
+// counted.
+class OutputTimeline {
+ public:
+  enum class Stream : std::uint8_t { kStdout, kStderr };
+
+  struct Chunk {
+    // Time since the timeline has started, in nanoseconds.
+    std::uint64_t time;
+    std::uint32_t size;
+    Stream stream;
+  };
+
+  // Stretch of time no chunk was received in.
+  struct Gap {
+    // Time since the timeline has started.
+    std::chrono::nanoseconds start;
+    std::chrono::nanoseconds duration;
+  };
+
+  static const size_t kMaxChunks = 1024 * 1024;
+
+  OutputTimeline() : start_time_(std::chrono::steady_clock::now()) {}
+
+  // Chunks of a single read are recorded with the time of the wakeup they
+  // were read on, so that the clock is read once per wakeup.
+  void Record(const Stream stream, const std::chrono::steady_clock::time_point time,
+              const size_t size) {
+    if (chunks_.size() == kMaxChunks) {
+      ++dropped_chunks_;
+      return;
+    }
+    chunks_.push_back(Chunk{
+        static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(time - start_time_)
+                .count()),
+        static_cast<std::uint32_t>(size), stream});
+  }
+
+  std::chrono::steady_clock::time_point start_time() const noexcept { return start_time_; }
+  const std::vector<Chunk>& chunks() const noexcept { return chunks_; }
+  size_t dropped_chunks() const noexcept { return dropped_chunks_; }
+
+  // Returns gaps longer than |threshold| before each of the chunks and
+  // between the last one and |end|, which is relative to the start.
+  std::vector<Gap> FindGaps(const std::chrono::nanoseconds threshold,
+                            const std::chrono::nanoseconds end) const;
+
+  // Renders chunks of both streams merged into a single timeline, along with
+  // gaps longer than |threshold| in between. Payload of chunks is taken from
+  // the captures, as far as they've kept it.
+  void Render(std::ostream& stream, const OutputCapture& stdoutput,
+              const OutputCapture& stderror,
+              const std::chrono::nanoseconds threshold) const;
+
+ private:
+  std::chrono::steady_clock::time_point start_time_;
+  std::vector<Chunk> chunks_;
+  size_t dropped_chunks_ = 0;
+};
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_OUTPUT_TIMELINE_H_
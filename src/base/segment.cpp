@@ -0,0 +1,70 @@
+#include "base/segment.h"
+
+#include <mutex>
+#include <vector>
+
+namespace oven {
+namespace base {
+namespace {
+// Pool keeps up to 4 MiB of free segments, the rest is freed.
+const size_t kMaxFreeSegments = 64;
+
+struct Pool {
+  Pool() { free_buffers.reserve(kMaxFreeSegments); }
+
+  std::mutex guard;
+  std::vector<std::unique_ptr<char[]>> free_buffers;
+};
+
+// Never destroyed, as segments may outlive static objects.
+Pool& GetPool() {
+  static Pool* pool = new Pool();
+  return *pool;
+}
+}  // anonymous namespace
+
+Segment::Segment() {
+  {
+    Pool& pool = GetPool();
+    std::lock_guard lock(pool.guard);
+    if (!pool.free_buffers.empty()) {
+      buffer_ = std::move(pool.free_buffers.back());
+      pool.free_buffers.pop_back();
+    }
+  }
+  if (!buffer_) {
+    buffer_.reset(new char[kCapacity]);
+  }
+}
+
+Segment::~Segment() {
+  Release();
+}
+
+Segment::Segment(Segment&& other) noexcept
+    : buffer_(std::move(other.buffer_)), size_(other.size_) {
+  other.size_ = 0;
+}
+
+Segment& Segment::operator=(Segment&& other) noexcept {
+  Release();
+  buffer_ = std::move(other.buffer_);
+  size_ = other.size_;
+  other.size_ = 0;
+  return *this;
+}
+
+void Segment::Release() noexcept {
+  if (!buffer_) {
+    return;
+  }
+  Pool& pool = GetPool();
+  std::lock_guard lock(pool.guard);
+  if (pool.free_buffers.size() < kMaxFreeSegments) {
+    pool.free_buffers.push_back(std::move(buffer_));
+  }
+  buffer_.reset();
+}
+
+}  // namespace base
+}  // namespace oven
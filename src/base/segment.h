@@ -0,0 +1,47 @@
+#ifndef _OVEN_BASE_SEGMENT_H_
+#define _OVEN_BASE_SEGMENT_H_
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace oven {
+namespace base {
+
+// Fixed size buffer. Memory of released segments is kept in a process-wide
+// pool and reused by the following ones, so that capturing outputs doesn't
+// keep allocating.
+class Segment {
+ public:
+  static constexpr size_t kCapacity = 64 * 1024;
+
+  Segment();
+  ~Segment();
+
+  Segment(const Segment&) = delete;
+  Segment(Segment&& other) noexcept;
+
+  Segment& operator=(const Segment&) = delete;
+  Segment& operator=(Segment&& other) noexcept;
+
+  char* data() noexcept { return buffer_.get(); }
+  const char* data() const noexcept { return buffer_.get(); }
+
+  // Number of bytes in use, from the beginning of the buffer.
+  size_t size() const noexcept { return size_; }
+  void set_size(const size_t size) noexcept { size_ = size; }
+  size_t space() const noexcept { return kCapacity - size_; }
+
+  std::string_view view() const noexcept { return std::string_view(data(), size_); }
+
+ private:
+  void Release() noexcept;
+
+  std::unique_ptr<char[]> buffer_;
+  size_t size_ = 0;
+};
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_SEGMENT_H_
@@ -0,0 +1,83 @@
+#ifndef _OVEN_BASE_SPSC_QUEUE_H_
+#define _OVEN_BASE_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace oven {
+namespace base {
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Each side caches the last seen index of the other one, so that it only
+// touches the shared cache line when the queue looks full (or empty).
+template <typename T>
+class SpscQueue {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit SpscQueue(const size_t capacity)
+      : buffer_(RoundUpToPowerOfTwo(capacity)), mask_(buffer_.size() - 1) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Producer side, returns false if queue is full.
+  bool TryPush(const T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == buffer_.size()) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == buffer_.size()) {
+        return false;
+      }
+    }
+    buffer_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false if queue is empty.
+  bool TryPop(T* value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    *value = buffer_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const noexcept {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  static size_t RoundUpToPowerOfTwo(const size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  std::vector<T> buffer_;
+  const size_t mask_;
+
+  // Consumer's index and its cached copy of producer's one.
+  alignas(kCacheLineSize) std::atomic_size_t head_ = 0;
+  size_t cached_tail_ = 0;
+
+  // Producer's index and its cached copy of consumer's one.
+  alignas(kCacheLineSize) std::atomic_size_t tail_ = 0;
+  size_t cached_head_ = 0;
+};
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_SPSC_QUEUE_H_
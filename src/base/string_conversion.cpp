@@ -0,0 +1,117 @@
+#include "base/string_conversion.h"
+
+#include <cstdint>
+
+namespace {
+const char32_t kReplacementCharacter = 0xFFFD;
+
+bool IsSurrogate(const char32_t code_point) {
+  return code_point >= 0xD800 && code_point <= 0xDFFF;
+}
+
+void AppendUtf8(const char32_t code_point, std::string* output) {
+  if (code_point < 0x80) {
+    output->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    output->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    output->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    output->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+void AppendWide(const char32_t code_point, std::wstring* output) {
+  if constexpr (sizeof(wchar_t) == 2) {
+    if (code_point >= 0x10000) {
+      const char32_t value = code_point - 0x10000;
+      output->push_back(static_cast<wchar_t>(0xD800 + (value >> 10)));
+      output->push_back(static_cast<wchar_t>(0xDC00 + (value & 0x3FF)));
+      return;
+    }
+  }
+  output->push_back(static_cast<wchar_t>(code_point));
+}
+}  // anonymous namespace
+
+namespace oven {
+namespace base {
+
+std::string WideToUtf8(const std::wstring_view input) {
+  std::string output;
+  output.reserve(input.size());
+  for (size_t position = 0; position < input.size(); ++position) {
+    char32_t code_point = static_cast<char32_t>(input[position]);
+    if constexpr (sizeof(wchar_t) == 2) {
+      code_point &= 0xFFFF;
+      if (code_point >= 0xD800 && code_point <= 0xDBFF &&
+          position + 1 < input.size()) {
+        const char32_t low = static_cast<char32_t>(input[position + 1]) & 0xFFFF;
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+          code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+          ++position;
+        }
+      }
+    }
+    if (IsSurrogate(code_point) || code_point > 0x10FFFF) {
+      code_point = kReplacementCharacter;
+    }
+    AppendUtf8(code_point, &output);
+  }
+  return output;
+}
+
+std::wstring Utf8ToWide(const std::string_view input) {
+  std::wstring output;
+  output.reserve(input.size());
+  size_t position = 0;
+  while (position < input.size()) {
+    const auto lead = static_cast<std::uint8_t>(input[position]);
+    size_t length = 0;
+    char32_t code_point = 0;
+    if (lead < 0x80) {
+      length = 1;
+      code_point = lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+      length = 2;
+      code_point = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+      length = 3;
+      code_point = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+      length = 4;
+      code_point = lead & 0x07;
+    }
+
+    bool valid = length != 0 && position + length <= input.size();
+    for (size_t index = 1; valid && index < length; ++index) {
+      const auto trail = static_cast<std::uint8_t>(input[position + index]);
+      valid = (trail & 0xC0) == 0x80;
+      code_point = (code_point << 6) | (trail & 0x3F);
+    }
+    // Reject overlong forms, surrogates and out of range values.
+    static const char32_t kMinimumForLength[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (valid && (code_point < kMinimumForLength[length] ||
+                  IsSurrogate(code_point) || code_point > 0x10FFFF)) {
+      valid = false;
+    }
+
+    if (!valid) {
+      AppendWide(kReplacementCharacter, &output);
+      ++position;
+      continue;
+    }
+    AppendWide(code_point, &output);
+    position += length;
+  }
+  return output;
+}
+
+}  // namespace base
+}  // namespace oven
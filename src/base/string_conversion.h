@@ -0,0 +1,18 @@
+#ifndef _OVEN_BASE_STRING_CONVERSION_H_
+#define _OVEN_BASE_STRING_CONVERSION_H_
+
+#include <string>
+#include <string_view>
+
+namespace oven {
+namespace base {
+
+// Conversions between UTF-8 and the platform wide encoding (UTF-16 on
+// Windows, UTF-32 elsewhere). Invalid sequences are replaced with U+FFFD.
+std::string WideToUtf8(const std::wstring_view input);
+std::wstring Utf8ToWide(const std::string_view input);
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_STRING_CONVERSION_H_
@@ -0,0 +1,111 @@
+#include "base/work_stealing_pool.h"
+
+#include <algorithm>
+
+namespace oven {
+namespace base {
+namespace {
+// Identifies worker thread |Post| is called from.
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+}  // anonymous namespace
+
+WorkStealingPool::WorkStealingPool(size_t number_of_workers) {
+  if (number_of_workers == 0) {
+    number_of_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers_.reserve(number_of_workers);
+  for (size_t index = 0; index < number_of_workers; ++index) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // Start threads only once all the queues exist, as workers look into
+  // each other's queues.
+  for (size_t index = 0; index < number_of_workers; ++index) {
+    workers_[index]->thread = std::thread(&WorkStealingPool::RunWorker, this, index);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard lock(guard_);
+    stopping_ = true;
+  }
+  task_posted_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void WorkStealingPool::Post(Task task) {
+  size_t index;
+  {
+    std::lock_guard lock(guard_);
+    // Counters go up before the task becomes visible, so that they never
+    // underflow when the task gets taken right away.
+    ++queued_tasks_;
+    ++unfinished_tasks_;
+    index = current_pool == this ? current_worker
+                                 : next_worker_++ % workers_.size();
+  }
+  {
+    std::lock_guard lock(workers_[index]->tasks_guard);
+    workers_[index]->tasks.push_back(std::move(task));
+  }
+  task_posted_.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+  std::unique_lock lock(guard_);
+  tasks_completed_.wait(lock, [this]() { return unfinished_tasks_ == 0; });
+}
+
+void WorkStealingPool::RunWorker(const size_t index) {
+  current_pool = this;
+  current_worker = index;
+  while (true) {
+    std::optional<Task> task = TakeTask(index);
+    if (!task) {
+      std::unique_lock lock(guard_);
+      task_posted_.wait(lock, [this]() { return queued_tasks_ != 0 || stopping_; });
+      if (queued_tasks_ == 0) {
+        return;
+      }
+      continue;
+    }
+
+    (*task)();
+
+    std::lock_guard lock(guard_);
+    if (--unfinished_tasks_ == 0) {
+      tasks_completed_.notify_all();
+    }
+  }
+}
+
+std::optional<WorkStealingPool::Task> WorkStealingPool::TakeTask(const size_t index) {
+  std::optional<Task> task;
+  for (size_t offset = 0; offset < workers_.size() && !task; ++offset) {
+    Worker& worker = *workers_[(index + offset) % workers_.size()];
+    std::lock_guard lock(worker.tasks_guard);
+    if (worker.tasks.empty()) {
+      continue;
+    }
+    // Own queue is used as a stack to keep recently posted work local, while
+    // thieves take the oldest tasks.
+    if (offset == 0) {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    } else {
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+    }
+  }
+  if (task) {
+    std::lock_guard lock(guard_);
+    --queued_tasks_;
+  }
+  return task;
+}
+
+}  // namespace base
+}  // namespace oven
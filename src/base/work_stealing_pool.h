@@ -0,0 +1,67 @@
+#ifndef _OVEN_BASE_WORK_STEALING_POOL_H_
+#define _OVEN_BASE_WORK_STEALING_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace oven {
+namespace base {
+
+// Runs posted tasks on a fixed number of worker threads. Every worker has
+// its own queue: it takes the most recently posted tasks from it and steals
+// the oldest ones from other workers once its own queue is drained.
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  // Zero |number_of_workers| creates a worker per processor.
+  explicit WorkStealingPool(size_t number_of_workers = 0);
+  // Runs all the posted tasks before returning.
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  size_t number_of_workers() const noexcept { return workers_.size(); }
+
+  // Tasks posted from a worker thread go to queue of that worker, others are
+  // spread between workers evenly.
+  void Post(Task task);
+
+  // Blocks until all the posted tasks complete.
+  void Wait();
+
+ private:
+  struct Worker {
+    std::mutex tasks_guard;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void RunWorker(const size_t index);
+  std::optional<Task> TakeTask(const size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t next_worker_ = 0;
+
+  // Guards the counters below, workers sleep on it while there are no tasks.
+  std::mutex guard_;
+  std::condition_variable task_posted_;
+  std::condition_variable tasks_completed_;
+  // Tasks waiting in queues and tasks that were posted but not completed yet.
+  size_t queued_tasks_ = 0;
+  size_t unfinished_tasks_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace base
+}  // namespace oven
+
+#endif  // _OVEN_BASE_WORK_STEALING_POOL_H_
@@ -1,12 +1,49 @@
 #include "execution_result.h"
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <string>
+#include <unordered_map>
 
-#include "base/base64.h"
+#include "base/hash.h"
 #include "system/error.h"
 
 namespace oven {
+namespace {
+const size_t kSpillReadChunkSize = 1024 * 1024;
+
+// Appends the whole stream |output| has captured to |merged|. Truncated
+// bytes are read back from its spill file, which is removed then, and are
+// skipped if they were dropped.
+void AppendOutput(const base::OutputCapture& output, base::OutputCapture& merged) {
+  for (const std::string_view part : output.head_parts()) {
+    merged.Append(part);
+  }
+  std::uint64_t truncated_size = output.truncated_size();
+  if (!output.spill_file().empty()) {
+    std::ifstream spill_file(output.spill_file(), std::ios::binary);
+    std::string chunk(kSpillReadChunkSize, '\0');
+    while (truncated_size > 0) {
+      spill_file.read(chunk.data(), static_cast<std::streamsize>(std::min<std::uint64_t>(
+                                        chunk.size(), truncated_size)));
+      const size_t size = static_cast<size_t>(spill_file.gcount());
+      if (size == 0) {
+        break;
+      }
+      merged.Append(std::string_view(chunk.data(), size));
+      truncated_size -= size;
+    }
+    spill_file.close();
+    std::error_code error;
+    std::filesystem::remove(output.spill_file(), error);
+  }
+  merged.Skip(truncated_size);
+  for (const std::string_view part : output.tail_parts()) {
+    merged.Append(part);
+  }
+}
+}  // anonymous namespace
 
 ExecutionResult::ExecutionResult(
     const std::filesystem::path& result_file)
@@ -14,19 +51,435 @@ ExecutionResult::ExecutionResult(
 }
 
 int ExecutionResult::Exit(const int exit_code) {
-  std::wofstream file(result_file_);
-  file << L"{\n"
-        << LR"RAW(  "internal_error": ")RAW" << internal_error_ << L"\",\n"
-        << LR"RAW(  "child_timed_out": )RAW"
-        << (child_timed_out_ ? L"true,\n" : L"false,\n")
-        << LR"RAW(  "child_exit_code": )RAW" << ExitCodeAsJson() << L",\n"
-        << LR"RAW(  "child_stdout": ")RAW" << base::Base64Encode(child_stdout_) << L"\",\n"
-        << LR"RAW(  "child_stderr": ")RAW" << base::Base64Encode(child_stderr_) << L"\",\n"
-        << LR"RAW(  "exit_code": )RAW" << std::to_wstring(exit_code)
-        << L"\n}";
+  std::ofstream file(result_file_, std::ios::binary);
+  Write(file, exit_code);
   return exit_code;
 }
 
+void ExecutionResult::Write(std::ostream& stream, const int exit_code) const {
+  base::JsonWriter writer(stream);
+  writer.BeginObject();
+  WriteFields(writer, exit_code);
+  writer.EndObject();
+}
+
+void ExecutionResult::WriteFields(base::JsonWriter& writer,
+                                  const int exit_code) const {
+  writer.Key("cached");
+  writer.Bool(replayed_document_.has_value());
+  writer.Key("cache_key");
+  if (cache_key_) {
+    writer.String(base::FormatHash(*cache_key_));
+  } else {
+    writer.Null();
+  }
+  if (replayed_document_) {
+    writer.Fields(*replayed_document_);
+    return;
+  }
+  WriteRunFields(writer, exit_code);
+}
+
+void ExecutionResult::WriteCacheEntry(std::ostream& stream) const {
+  base::JsonWriter writer(stream);
+  writer.BeginObject();
+  WriteRunFields(writer, 0);
+  writer.EndObject();
+}
+
+void ExecutionResult::WriteRunFields(base::JsonWriter& writer,
+                                     const int exit_code) const {
+  writer.Key("internal_error");
+  writer.String(internal_error_);
+  writer.Key("child_timed_out");
+  writer.Bool(child_timed_out_);
+  writer.Key("child_exit_code");
+  if (child_exit_code_) {
+    writer.Int(*child_exit_code_);
+  } else {
+    writer.Null();
+  }
+  WriteOutput(writer, "child_stdout", child_stdout_);
+  WriteOutput(writer, "child_stderr", child_stderr_);
+  WriteOutputTimeline(writer);
+  WriteResourceUsage(writer);
+  WriteTeardown(writer);
+  WriteAffinity(writer);
+  WriteMemoryEvents(writer);
+  writer.Key("resource_samples_file");
+  if (resource_samples_file_.empty()) {
+    writer.Null();
+  } else {
+    writer.String(resource_samples_file_.wstring());
+  }
+  WriteProcessTree(writer);
+  WriteShards(writer);
+  WriteAppliedLimits(writer);
+  writer.Key("exit_code");
+  writer.Int(exit_code);
+}
+
+void ExecutionResult::MergeShards(std::vector<ExecutionResult> shards,
+                                  const base::OutputCapture::Limits& output_limits) {
+  child_stdout_ = base::OutputCapture(output_limits);
+  child_stderr_ = base::OutputCapture(output_limits);
+  child_exit_code_ = 0;
+  for (size_t index = 0; index < shards.size(); ++index) {
+    ExecutionResult& shard = shards[index];
+    if (internal_error_.empty() && !shard.internal_error_.empty()) {
+      internal_error_ = L"Shard " + std::to_wstring(index) + L": " + shard.internal_error_;
+    }
+    child_timed_out_ = child_timed_out_ || shard.child_timed_out_;
+    if (child_exit_code_ == 0) {
+      child_exit_code_ = shard.child_exit_code_;
+    }
+    AppendOutput(shard.child_stdout_, child_stdout_);
+    AppendOutput(shard.child_stderr_, child_stderr_);
+    shard.child_stdout_ = base::OutputCapture();
+    shard.child_stderr_ = base::OutputCapture();
+  }
+  child_stdout_.Finish();
+  child_stderr_.Finish();
+  shards_ = std::move(shards);
+}
+
+// Whole output is |name|, followed by truncated bytes (stored in spill file
+// if there is one), followed by |name|_tail.
+void ExecutionResult::WriteOutput(base::JsonWriter& writer, const std::string& name,
+                                  const base::OutputCapture& output) const {
+  writer.Key(name);
+  writer.Base64(output.head_parts());
+  writer.Key(name + "_tail");
+  const auto tail_parts = output.tail_parts();
+  writer.Base64({tail_parts[0], tail_parts[1]});
+  writer.Key(name + "_size");
+  writer.Uint(output.total_size());
+  writer.Key(name + "_truncated");
+  writer.Uint(output.truncated_size());
+  writer.Key(name + "_spill_file");
+  if (output.spill_file().empty()) {
+    writer.Null();
+  } else {
+    writer.String(output.spill_file().wstring());
+  }
+}
+
+// Gaps are the stretches of time no output was received in, longer than the
+// threshold, times are in microseconds since child start. The whole object
+// is null if child hasn't run.
+void ExecutionResult::WriteOutputTimeline(base::JsonWriter& writer) const {
+  writer.Key("output_timeline");
+  if (!output_chunks_) {
+    writer.Null();
+    return;
+  }
+  writer.BeginObject();
+  writer.Key("chunks");
+  writer.Uint(*output_chunks_);
+  writer.Key("chunks_dropped");
+  writer.Uint(dropped_output_chunks_);
+  writer.Key("gaps");
+  writer.BeginArray();
+  for (const base::OutputTimeline::Gap& gap : output_gaps_) {
+    writer.BeginObject();
+    writer.Key("start");
+    writer.Uint(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(gap.start).count()));
+    writer.Key("duration");
+    writer.Uint(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(gap.duration).count()));
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.Key("file");
+  if (output_timeline_file_.empty()) {
+    writer.Null();
+  } else {
+    writer.String(output_timeline_file_.wstring());
+  }
+  writer.EndObject();
+}
+
+// Times are in microseconds, memory and I/O in bytes. Values that weren't
+// accounted for are null, the whole object is null if child hasn't run.
+void ExecutionResult::WriteResourceUsage(base::JsonWriter& writer) const {
+  auto write_optional = [&writer](const char* key,
+                                  const std::optional<std::uint64_t>& value) {
+    writer.Key(key);
+    if (value) {
+      writer.Uint(*value);
+    } else {
+      writer.Null();
+    }
+  };
+  auto microseconds = [](const std::chrono::microseconds time) {
+    return std::optional<std::uint64_t>(static_cast<std::uint64_t>(time.count()));
+  };
+
+  writer.Key("resource_usage");
+  if (!wall_time_) {
+    writer.Null();
+    return;
+  }
+  using Accounting = system::Job::Accounting;
+  const Accounting accounting = accounting_.value_or(Accounting());
+  const std::optional<Accounting::IoCounters> io = accounting.io;
+  writer.BeginObject();
+  write_optional("wall_time", microseconds(*wall_time_));
+  write_optional("user_time",
+                 accounting_ ? microseconds(accounting.user_time) : std::nullopt);
+  write_optional("kernel_time",
+                 accounting_ ? microseconds(accounting.kernel_time) : std::nullopt);
+  write_optional("peak_memory", accounting.peak_memory);
+  write_optional("peak_process_memory", accounting.peak_process_memory);
+  write_optional("total_processes", accounting.total_processes);
+  write_optional("read_operations",
+                 io ? std::optional(io->read_operations) : std::nullopt);
+  write_optional("write_operations",
+                 io ? std::optional(io->write_operations) : std::nullopt);
+  write_optional("read_bytes", io ? std::optional(io->read_bytes) : std::nullopt);
+  write_optional("write_bytes", io ? std::optional(io->write_bytes) : std::nullopt);
+  writer.EndObject();
+}
+
+// Times are in microseconds, null for phases that weren't reached. The whole
+// object is null unless child has timed out.
+void ExecutionResult::WriteTeardown(base::JsonWriter& writer) const {
+  auto write_time = [&writer](const char* key,
+                              const std::optional<std::chrono::microseconds>& time) {
+    writer.Key(key);
+    if (time) {
+      writer.Uint(static_cast<std::uint64_t>(time->count()));
+    } else {
+      writer.Null();
+    }
+  };
+
+  writer.Key("teardown");
+  if (!teardown_) {
+    writer.Null();
+    return;
+  }
+  writer.BeginObject();
+  write_time("stop_time", teardown_->stop_time);
+  write_time("kill_time", teardown_->kill_time);
+  writer.Key("completed");
+  writer.Bool(teardown_->completed);
+  writer.EndObject();
+}
+
+// Null unless child was pinned, empty lists are not restricted.
+void ExecutionResult::WriteAffinity(base::JsonWriter& writer) const {
+  auto write_ids = [&writer](const char* key, const std::vector<unsigned int>& ids) {
+    writer.Key(key);
+    writer.BeginArray();
+    for (const unsigned int id : ids) {
+      writer.Uint(id);
+    }
+    writer.EndArray();
+  };
+
+  writer.Key("affinity");
+  if (!affinity_) {
+    writer.Null();
+    return;
+  }
+  writer.BeginObject();
+  write_ids("processors", affinity_->processors);
+  write_ids("memory_nodes", affinity_->memory_nodes);
+  writer.EndObject();
+}
+
+// Type is one of "threshold", "job_limit" and "process_limit", time is in
+// microseconds since child start, memory in bytes.
+void ExecutionResult::WriteMemoryEvents(base::JsonWriter& writer) const {
+  writer.Key("memory_events");
+  writer.BeginArray();
+  for (const MemoryEvent& event : memory_events_) {
+    writer.BeginObject();
+    writer.Key("type");
+    switch (event.type) {
+      case system::Job::Event::Type::kJobMemoryLimit:
+        writer.String(L"job_limit");
+        break;
+      case system::Job::Event::Type::kProcessMemoryLimit:
+        writer.String(L"process_limit");
+        break;
+      default:
+        writer.String(L"threshold");
+        break;
+    }
+    writer.Key("time");
+    writer.Uint(static_cast<std::uint64_t>(event.time.count()));
+    writer.Key("process_id");
+    if (event.process_id != 0) {
+      writer.Uint(event.process_id);
+    } else {
+      writer.Null();
+    }
+    writer.Key("memory_used");
+    writer.Uint(event.memory_used);
+    writer.Key("memory_limit");
+    writer.Uint(event.memory_limit);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.Key("memory_events_dropped");
+  writer.Uint(dropped_memory_events_);
+}
+
+// Processes are nested into their parents' "children", the ones with parent
+// outside of the job are at the top level.
+void ExecutionResult::WriteProcessTree(base::JsonWriter& writer) const {
+  using ProcessInfo = system::Job::ProcessInfo;
+  std::unordered_map<unsigned long, std::vector<size_t>> processes_by_id;
+  for (size_t index = 0; index < processes_.size(); ++index) {
+    processes_by_id[processes_[index].process_id].push_back(index);
+  }
+  // Process id may have been reused, parent is the latest process with its
+  // id that had started before the child.
+  std::vector<std::vector<size_t>> children(processes_.size());
+  std::vector<size_t> roots;
+  for (size_t index = 0; index < processes_.size(); ++index) {
+    const ProcessInfo& process = processes_[index];
+    std::optional<size_t> parent;
+    if (const auto candidates = processes_by_id.find(process.parent_process_id);
+        candidates != processes_by_id.end()) {
+      for (const size_t candidate : candidates->second) {
+        if (candidate != index &&
+            processes_[candidate].start_time <= process.start_time) {
+          parent = candidate;
+        }
+      }
+    }
+    (parent ? children[*parent] : roots).push_back(index);
+  }
+
+  auto write_time = [&writer](const std::chrono::microseconds time) {
+    writer.Int(static_cast<std::int64_t>(time.count()));
+  };
+  std::function<void(size_t)> write_process = [&](const size_t index) {
+    const ProcessInfo& process = processes_[index];
+    writer.BeginObject();
+    writer.Key("process_id");
+    writer.Uint(process.process_id);
+    writer.Key("parent_process_id");
+    writer.Uint(process.parent_process_id);
+    writer.Key("image_path");
+    writer.String(process.image_path);
+    writer.Key("command_line");
+    writer.String(process.command_line);
+    writer.Key("start_time");
+    write_time(process.start_time);
+    writer.Key("exit_time");
+    if (process.exit_time) {
+      write_time(*process.exit_time);
+    } else {
+      writer.Null();
+    }
+    writer.Key("exit_code");
+    if (process.exit_code) {
+      writer.Int(*process.exit_code);
+    } else {
+      writer.Null();
+    }
+    writer.Key("user_time");
+    write_time(process.user_time);
+    writer.Key("kernel_time");
+    write_time(process.kernel_time);
+    writer.Key("peak_memory");
+    if (process.peak_memory) {
+      writer.Uint(*process.peak_memory);
+    } else {
+      writer.Null();
+    }
+    writer.Key("children");
+    writer.BeginArray();
+    for (const size_t child : children[index]) {
+      write_process(child);
+    }
+    writer.EndArray();
+    writer.EndObject();
+  };
+
+  writer.Key("processes");
+  writer.BeginArray();
+  for (const size_t root : roots) {
+    write_process(root);
+  }
+  writer.EndArray();
+}
+
+// Each shard has the fields of a single child, except for the outputs merged
+// into the result. Null unless child was split into shards.
+void ExecutionResult::WriteShards(base::JsonWriter& writer) const {
+  writer.Key("shards");
+  if (shards_.empty()) {
+    writer.Null();
+    return;
+  }
+  writer.BeginArray();
+  for (const ExecutionResult& shard : shards_) {
+    writer.BeginObject();
+    writer.Key("internal_error");
+    writer.String(shard.internal_error_);
+    writer.Key("child_timed_out");
+    writer.Bool(shard.child_timed_out_);
+    writer.Key("child_exit_code");
+    if (shard.child_exit_code_) {
+      writer.Int(*shard.child_exit_code_);
+    } else {
+      writer.Null();
+    }
+    shard.WriteResourceUsage(writer);
+    shard.WriteTeardown(writer);
+    shard.WriteAffinity(writer);
+    shard.WriteMemoryEvents(writer);
+    writer.Key("resource_samples_file");
+    if (shard.resource_samples_file_.empty()) {
+      writer.Null();
+    } else {
+      writer.String(shard.resource_samples_file_.wstring());
+    }
+    shard.WriteProcessTree(writer);
+    shard.WriteAppliedLimits(writer);
+    writer.EndObject();
+  }
+  writer.EndArray();
+}
+
+// Source is "history" or "configured", times are in milliseconds, memory in
+// bytes. Null unless limits are derived from history.
+void ExecutionResult::WriteAppliedLimits(base::JsonWriter& writer) const {
+  writer.Key("applied_limits");
+  if (!applied_limits_) {
+    writer.Null();
+    return;
+  }
+  writer.BeginArray();
+  for (const AppliedLimit& limit : *applied_limits_) {
+    writer.BeginObject();
+    writer.Key("name");
+    writer.String(limit.name);
+    writer.Key("value");
+    writer.Uint(limit.value);
+    writer.Key("source");
+    writer.String(limit.from_history ? L"history" : L"configured");
+    writer.Key("history_runs");
+    writer.Uint(limit.history_runs);
+    writer.Key("percentile_value");
+    if (limit.percentile_value) {
+      writer.Uint(*limit.percentile_value);
+    } else {
+      writer.Null();
+    }
+    writer.Key("clamped");
+    writer.Bool(limit.clamped);
+    writer.EndObject();
+  }
+  writer.EndArray();
+}
+
 void ExecutionResult::SetInternalError(
     const std::wstring_view message) {
   internal_error_ = message;
@@ -34,10 +487,48 @@ void ExecutionResult::SetInternalError(
   internal_error_ += system::GetErrorMessage();
 }
 
-std::wstring ExecutionResult::ExitCodeAsJson() const {
-  if (child_exit_code_)
-    return std::to_wstring(*child_exit_code_);
-  return L"null";
+BatchExecutionResult::BatchExecutionResult(
+    const std::filesystem::path& result_file)
+    : result_file_(result_file) {
+}
+
+int BatchExecutionResult::Exit(const int exit_code) {
+  std::ofstream file(result_file_, std::ios::binary);
+  Write(file, exit_code);
+  return exit_code;
+}
+
+void BatchExecutionResult::Write(std::ostream& stream, const int exit_code) const {
+  base::JsonWriter writer(stream);
+  writer.BeginObject();
+  writer.Key("internal_error");
+  writer.String(internal_error_);
+  writer.Key("children");
+  writer.BeginArray();
+  for (const Child& child : children_) {
+    // Command line goes first to identify the child, the rest of the fields
+    // are the same as for a single child.
+    writer.BeginObject();
+    writer.Key("command_line");
+    writer.String(child.command_line);
+    child.result.WriteFields(writer, child.exit_code);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.Key("exit_code");
+  writer.Int(exit_code);
+  writer.EndObject();
+}
+
+void BatchExecutionResult::SetInternalError(const std::wstring_view message) {
+  internal_error_ = message;
+  internal_error_.append(L": ");
+  internal_error_ += system::GetErrorMessage();
+}
+
+size_t BatchExecutionResult::AddChild(const std::wstring_view command_line) {
+  children_.push_back(Child{std::wstring(command_line), ExecutionResult(), 0});
+  return children_.size() - 1;
 }
 
 }  // namespace oven
@@ -1,19 +1,90 @@
 #ifndef _OVEN_EXECUTION_RESULT_H_
 #define _OVEN_EXECUTION_RESULT_H_
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "base/json_writer.h"
+#include "base/output_capture.h"
+#include "base/output_timeline.h"
+#include "system/job.h"
 
 namespace oven {
 
 class ExecutionResult {
  public:
+  // Job has reached one of its memory limits or its threshold.
+  struct MemoryEvent {
+    system::Job::Event::Type type;
+    // Time since child has started.
+    std::chrono::microseconds time{0};
+    unsigned long process_id = 0;
+    std::uint64_t memory_used = 0;
+    std::uint64_t memory_limit = 0;
+  };
+
+  // Limit applied to child and where it comes from: either configured or
+  // derived from |history_runs| past runs, which had |percentile_value| at
+  // the percentile, possibly clamped to the configured one.
+  struct AppliedLimit {
+    std::string name;
+    std::uint64_t value = 0;
+    bool from_history = false;
+    size_t history_runs = 0;
+    std::optional<std::uint64_t> percentile_value;
+    bool clamped = false;
+  };
+
+  // Result that is only written with |Write|.
+  ExecutionResult() = default;
   ExecutionResult(const std::filesystem::path& result_file);
 
   [[nodiscard]] int Exit(const int exit_code);
 
+  // Writes result as UTF-8 encoded json.
+  void Write(std::ostream& stream, const int exit_code) const;
+
+  // Writes fields of result json object, which |writer| has started.
+  void WriteFields(base::JsonWriter& writer, const int exit_code) const;
+
+  // Writes result the way it's stored in result cache, without the fields
+  // that tell whether it was replayed. Only passed results are cached, so
+  // exit code is 0.
+  void WriteCacheEntry(std::ostream& stream) const;
+
   void SetInternalError(const std::wstring_view message);
-  
+
+  // Returns true if child has run to completion and exited with 0.
+  bool HasPassed() const noexcept {
+    return internal_error_.empty() && !child_timed_out_ && child_exit_code_ == 0;
+  }
+
+  // Returns true if result refers to files written next to it (resource
+  // samples, output timeline or spilled output), which a replayed result
+  // can't rely on.
+  bool HasSideFiles() const noexcept {
+    return !resource_samples_file_.empty() || !output_timeline_file_.empty() ||
+           !child_stdout_.spill_file().empty() || !child_stderr_.spill_file().empty();
+  }
+
+  // Records key run was looked up in result cache by, which its result is
+  // stored under if it's cacheable.
+  void SetCacheKey(const std::uint64_t cache_key) {
+    cache_key_ = cache_key;
+  }
+
+  // Makes result the one cached under |cache_key|, written by an identical
+  // run before. The rest of the fields are ignored then.
+  void Replay(const std::uint64_t cache_key, std::string document) {
+    cache_key_ = cache_key;
+    replayed_document_ = std::move(document);
+  }
+
   void ChildTimedOut() {
     child_timed_out_ = true;
   }
@@ -22,22 +93,144 @@ class ExecutionResult {
     child_exit_code_ = exit_code;
   }
 
-  void SetChildStdout(const std::string& contents) {
-    child_stdout_ = contents;
+  // Records resources child has used: |wall_time| it has run for and
+  // |accounting| of its job, if the latter is available.
+  void SetResourceUsage(const std::chrono::microseconds wall_time,
+                        const std::optional<system::Job::Accounting>& accounting) {
+    wall_time_ = wall_time;
+    accounting_ = accounting;
+  }
+
+  // Records processors and memory nodes child was pinned to.
+  void SetAffinity(const system::Job::Affinity& affinity) {
+    affinity_ = affinity;
+  }
+
+  // Records memory events in the order they happened, |dropped_events| is
+  // the number of ones that didn't fit.
+  void SetMemoryEvents(std::vector<MemoryEvent> events, const size_t dropped_events) {
+    memory_events_ = std::move(events);
+    dropped_memory_events_ = dropped_events;
+  }
+
+  // Records limits derived from history of the child and the configured ones
+  // that were kept.
+  void SetAppliedLimits(std::vector<AppliedLimit> limits) {
+    applied_limits_ = std::move(limits);
+  }
+
+  // Records how job of timed out child was torn down.
+  void SetTeardown(const system::Job::TeardownTimes& teardown) {
+    teardown_ = teardown;
+  }
+
+  void SetProcesses(std::vector<system::Job::ProcessInfo> processes) {
+    processes_ = std::move(processes);
   }
-  void SetChildStderr(const std::string& contents) {
-    child_stderr_ = contents;
+
+  void SetResourceSamplesFile(const std::filesystem::path& samples_file) {
+    resource_samples_file_ = samples_file;
+  }
+
+  // Records number of chunks child outputs were received in, gaps between
+  // them and file their merged timeline was rendered to, if any.
+  void SetOutputTimeline(const base::OutputTimeline& timeline,
+                         std::vector<base::OutputTimeline::Gap> gaps,
+                         const std::filesystem::path& timeline_file) {
+    output_chunks_ = timeline.chunks().size();
+    dropped_output_chunks_ = timeline.dropped_chunks();
+    output_gaps_ = std::move(gaps);
+    output_timeline_file_ = timeline_file;
   }
 
+  void SetChildStdout(base::OutputCapture&& contents) {
+    child_stdout_ = std::move(contents);
+  }
+  void SetChildStderr(base::OutputCapture&& contents) {
+    child_stderr_ = std::move(contents);
+  }
+
+  // Makes result the merged one of |shards| child was split into: child has
+  // timed out if any shard has, its exit code and internal error are the
+  // ones of the first shard that failed, and outputs are concatenated in
+  // shard order within |output_limits|. Shards only keep the rest of their
+  // fields, written to "shards".
+  void MergeShards(std::vector<ExecutionResult> shards,
+                   const base::OutputCapture::Limits& output_limits);
+
  private:
-  std::wstring ExitCodeAsJson() const;
+  void WriteOutput(base::JsonWriter& writer, const std::string& name,
+                   const base::OutputCapture& output) const;
+  void WriteResourceUsage(base::JsonWriter& writer) const;
+  void WriteTeardown(base::JsonWriter& writer) const;
+  void WriteAffinity(base::JsonWriter& writer) const;
+  void WriteMemoryEvents(base::JsonWriter& writer) const;
+  void WriteOutputTimeline(base::JsonWriter& writer) const;
+  void WriteProcessTree(base::JsonWriter& writer) const;
+  void WriteShards(base::JsonWriter& writer) const;
+  void WriteAppliedLimits(base::JsonWriter& writer) const;
+  // Writes fields of the run itself, the ones that are cached.
+  void WriteRunFields(base::JsonWriter& writer, const int exit_code) const;
 
   const std::filesystem::path result_file_;
   std::wstring internal_error_;
   bool child_timed_out_ = false;
   std::optional<int> child_exit_code_;
-  std::string child_stdout_;
-  std::string child_stderr_;
+  std::optional<std::chrono::microseconds> wall_time_;
+  std::optional<system::Job::Accounting> accounting_;
+  std::optional<system::Job::TeardownTimes> teardown_;
+  std::optional<system::Job::Affinity> affinity_;
+  std::vector<MemoryEvent> memory_events_;
+  size_t dropped_memory_events_ = 0;
+  std::filesystem::path resource_samples_file_;
+  std::optional<size_t> output_chunks_;
+  size_t dropped_output_chunks_ = 0;
+  std::vector<base::OutputTimeline::Gap> output_gaps_;
+  std::filesystem::path output_timeline_file_;
+  std::vector<system::Job::ProcessInfo> processes_;
+  base::OutputCapture child_stdout_;
+  base::OutputCapture child_stderr_;
+  std::optional<std::uint64_t> cache_key_;
+  std::optional<std::string> replayed_document_;
+  std::vector<ExecutionResult> shards_;
+  std::optional<std::vector<AppliedLimit>> applied_limits_;
+};
+
+// Result of batch mode: an array of results of every child from manifest,
+// each having the same fields as the result of a single child.
+class BatchExecutionResult {
+ public:
+  BatchExecutionResult() = default;
+  BatchExecutionResult(const std::filesystem::path& result_file);
+
+  [[nodiscard]] int Exit(const int exit_code);
+
+  void Write(std::ostream& stream, const int exit_code) const;
+
+  void SetInternalError(const std::wstring_view message);
+
+  // Returns index of the added child. Children results are filled
+  // concurrently, so all of them should be added before any child starts.
+  size_t AddChild(const std::wstring_view command_line);
+
+  ExecutionResult& child(const size_t index) {
+    return children_[index].result;
+  }
+
+  void ChildExited(const size_t index, const int exit_code) {
+    children_[index].exit_code = exit_code;
+  }
+
+ private:
+  struct Child {
+    std::wstring command_line;
+    ExecutionResult result;
+    int exit_code = 0;
+  };
+
+  const std::filesystem::path result_file_;
+  std::wstring internal_error_;
+  std::vector<Child> children_;
 };
 
 }  // namespace oven
@@ -0,0 +1,70 @@
+#include "manifest.h"
+
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+
+#include "base/string_conversion.h"
+
+namespace oven {
+namespace {
+std::vector<std::wstring> SplitCommandLine(const std::wstring_view command_line) {
+  std::vector<std::wstring> arguments;
+  std::wstring argument;
+  bool in_argument = false;
+  bool quoted = false;
+  for (const wchar_t character : command_line) {
+    if (character == L'"') {
+      quoted = !quoted;
+      in_argument = true;
+    } else if (!quoted && std::iswspace(character)) {
+      if (in_argument) {
+        arguments.push_back(std::move(argument));
+        argument.clear();
+        in_argument = false;
+      }
+    } else {
+      argument.push_back(character);
+      in_argument = true;
+    }
+  }
+  if (in_argument) {
+    arguments.push_back(std::move(argument));
+  }
+  return arguments;
+}
+}  // anonymous namespace
+
+std::optional<std::vector<ManifestEntry>> ReadManifest(
+    const std::filesystem::path& manifest_file) {
+  std::ifstream manifest(manifest_file);
+  if (!manifest) {
+    return std::optional<std::vector<ManifestEntry>>();
+  }
+
+  std::vector<ManifestEntry> entries;
+  std::string line;
+  while (std::getline(manifest, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    std::wstring command_line = base::Utf8ToWide(line);
+    std::vector<std::wstring> arguments = SplitCommandLine(command_line);
+    if (arguments.empty() ||
+        (!arguments.front().empty() && arguments.front().front() == L'#')) {
+      continue;
+    }
+    ManifestEntry entry;
+    entry.command_line = std::move(command_line);
+    entry.child_path = std::move(arguments.front());
+    entry.arguments.assign(std::make_move_iterator(arguments.begin() + 1),
+                           std::make_move_iterator(arguments.end()));
+    entries.push_back(std::move(entry));
+  }
+  if (manifest.bad()) {
+    return std::optional<std::vector<ManifestEntry>>();
+  }
+  return entries;
+}
+
+}  // namespace oven
@@ -0,0 +1,27 @@
+#ifndef _OVEN_MANIFEST_H_
+#define _OVEN_MANIFEST_H_
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace oven {
+
+// Manifest lists child command lines to run in batch mode, one per line.
+// Arguments are separated by whitespace, double quotes group an argument
+// containing whitespace. Empty lines and lines starting with '#' are skipped.
+// Manifest is expected to be UTF-8 encoded.
+struct ManifestEntry {
+  // Line as it's written in manifest, used to identify child in results.
+  std::wstring command_line;
+  std::wstring child_path;
+  std::vector<std::wstring> arguments;
+};
+
+std::optional<std::vector<ManifestEntry>> ReadManifest(
+    const std::filesystem::path& manifest_file);
+
+}  // namespace oven
+
+#endif  // _OVEN_MANIFEST_H_
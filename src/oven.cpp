@@ -1,50 +1,148 @@
+#if defined(_WIN32)
 #include <AclAPI.h>
 #include <Windows.h>
+#endif
 
+#include <algorithm>
 #include <cassert>
+#include <clocale>
+#include <condition_variable>
+#include <cstdint>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <list>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "base/command_line.h"
+#include "base/string_conversion.h"
+#include "base/work_stealing_pool.h"
 #include "execution_result.h"
-#include "system/child_process.h"
+#include "manifest.h"
+#include "runner.h"
+#include "server.h"
 #include "system/desktop.h"
 #include "system/error.h"
-#include "system/job.h"
+#include "system/processor_topology.h"
+#if !defined(_WIN32)
+#include "system/display_pool.h"
+#endif
 
 namespace arguments {
 const wchar_t kDesktopName[] = L"desktop-name";
 const wchar_t kDesktopHeapSize[] = L"desktop-heap-size";
 const wchar_t kChildPath[] = L"child-path";
 const wchar_t kChildTimeout[] = L"child-timeout";
+const wchar_t kTeardownGracePeriod[] = L"teardown-grace-period";
 const wchar_t kRequiresActivation[] = L"requires-activation";
 const wchar_t kResultPath[] = L"result-path";
+#if !defined(_WIN32)
+const wchar_t kDisplayPool[] = L"display-pool";
+const wchar_t kDisplayPoolUses[] = L"display-pool-uses";
+const wchar_t kDisplayServer[] = L"display-server";
+#endif
+
+// Batch mode
+const wchar_t kManifest[] = L"manifest";
+const wchar_t kParallelRuns[] = L"parallel-runs";
+
+// Sharding
+const wchar_t kShards[] = L"shards";
+const wchar_t kShardEnvironment[] = L"shard-environment";
+
+// Output capture
+const wchar_t kOutputHeadLimit[] = L"output-head-limit";
+const wchar_t kOutputTailLimit[] = L"output-tail-limit";
+const wchar_t kOutputSpillDirectory[] = L"output-spill-directory";
+const wchar_t kOutputPassthrough[] = L"output-passthrough";
+const wchar_t kOutputGapThreshold[] = L"output-gap-threshold";
+const wchar_t kOutputTimelineDirectory[] = L"output-timeline-directory";
+const wchar_t kPipeBufferSize[] = L"pipe-buffer-size";
+
+// Resource sampling
+const wchar_t kSamplingInterval[] = L"sampling-interval";
+const wchar_t kSamplingDirectory[] = L"sampling-directory";
+
+// Processor affinity
+const wchar_t kCpuAffinity[] = L"cpu-affinity";
+const wchar_t kCpuCores[] = L"cpu-cores";
+const wchar_t kCpuExcludeSiblings[] = L"cpu-exclude-siblings";
+
+// Result cache
+const wchar_t kResultCache[] = L"result-cache";
+const wchar_t kResultCacheSize[] = L"result-cache-size";
+const wchar_t kCacheEnvironment[] = L"cache-environment";
+const wchar_t kCacheInputs[] = L"cache-inputs";
+
+// Run history
+const wchar_t kRunHistory[] = L"run-history";
+const wchar_t kAdaptiveLimits[] = L"adaptive-limits";
+const wchar_t kAdaptivePercentile[] = L"adaptive-percentile";
+const wchar_t kAdaptiveFactor[] = L"adaptive-factor";
+const wchar_t kAdaptiveMinRuns[] = L"adaptive-min-runs";
+
+// Server mode
+const wchar_t kServe[] = L"serve";
+const wchar_t kConnect[] = L"connect";
 
 // Additional limits
 const wchar_t kLimitCPUTime[] = L"limit-cpu-time";
 const wchar_t kLimitOverallMemory[] = L"limit-overall-memory";
 const wchar_t kLimitPerProcessMemory[] = L"limit-per-process-memory";
+const wchar_t kMemoryThreshold[] = L"memory-threshold";
+const wchar_t kLimitReadBandwidth[] = L"limit-read-bandwidth";
+const wchar_t kLimitWriteBandwidth[] = L"limit-write-bandwidth";
+const wchar_t kLimitReadOperations[] = L"limit-read-operations";
+const wchar_t kLimitWriteOperations[] = L"limit-write-operations";
 }  // arguments namespace
 
 namespace {
 const wchar_t kDefaultDesktopName[] = L"OvenDesktop";
-}  // anonymous namespace
-
-class JobObserver : public oven::system::Job::Observer {
- public:
-  void OnNewProcess(const unsigned long process_id) override {
-    std::wcout << L"New process was created inside of job: " << process_id << "\n";
-  }
-
-  void OnExitProcess(const unsigned long process_id) override {
-    std::wcout << L"Process with id " << process_id << L" has exited\n";
+// Lets chatty children write without blocking on oven most of the time.
+const std::int64_t kDefaultPipeBufferSize = 1024 * 1024;
+const std::int64_t kDefaultTeardownGracePeriod = 1000;
+const std::int64_t kDefaultOutputGapThreshold = 1000;
+// Arguments which don't change the outcome of a run, so aren't part of cache
+// keys.
+const wchar_t* const kUncachedArguments[] = {
+    arguments::kResultPath, arguments::kOutputPassthrough, arguments::kManifest,
+    arguments::kParallelRuns, arguments::kResultCache, arguments::kResultCacheSize,
+    arguments::kRunHistory, arguments::kServe, arguments::kConnect};
+
+// Returns positive number |value| holds entirely, nothing otherwise.
+std::optional<double> ParseFactor(const std::wstring& value) {
+  wchar_t* end = nullptr;
+  const double factor = std::wcstod(value.c_str(), &end);
+  if (value.empty() || *end != L'\0' || !(factor > 0)) {
+    return std::optional<double>();
   }
+  return factor;
+}
 
-  void OnActiveProcessZero() override {
-    std::wcout << L"Number of child processes equal zero!\n";
+// Splits comma separated list, leaving out empty items.
+std::vector<std::wstring> SplitList(const std::wstring_view list) {
+  std::vector<std::wstring> items;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(L',', start);
+    if (end == list.npos) {
+      end = list.size();
+    }
+    if (end > start) {
+      items.emplace_back(list.substr(start, end - start));
+    }
+    start = end + 1;
   }
-};
+  return items;
+}
+}  // anonymous namespace
 
 void AddLimitingArguments(oven::base::CommandLine& command_line) {
   command_line.AddOptionalArgument(
@@ -63,15 +161,126 @@ void AddLimitingArguments(oven::base::CommandLine& command_line) {
       L"Specifies the limit for the virtual memory that can be "
       L"committed by any child process",
       oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kMemoryThreshold,
+      L"Memory used by all child processes to report in the result once "
+      L"exceeded, in bytes. On Linux job is throttled above it",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kLimitReadBandwidth,
+      L"Rate child processes may read from block devices at all together, "
+      L"in bytes per second",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kLimitWriteBandwidth,
+      L"Rate child processes may write to block devices at all together, "
+      L"in bytes per second",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kLimitReadOperations,
+      L"Number of read operations per second child processes may issue to "
+      L"block devices all together",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kLimitWriteOperations,
+      L"Number of write operations per second child processes may issue to "
+      L"block devices all together",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kOutputHeadLimit,
+      L"Number of first bytes of each child output stream to keep, "
+      L"defaults to 0 if tail limit is set and to unlimited otherwise",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kOutputTailLimit,
+      L"Number of last bytes of each child output stream to keep",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kOutputSpillDirectory,
+      L"Directory to store bytes of output streams that exceed head and "
+      L"tail limits in, those are dropped otherwise",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kOutputPassthrough,
+      L"File to copy child output streams to as they're captured, so that "
+      L"they can be watched live. Pass - to copy them to oven's own ones",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kOutputGapThreshold,
+      L"Stretches of time child has produced no output for to report, if "
+      L"longer than this, in milliseconds. Defaults to 1000",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kOutputTimelineDirectory,
+      L"Directory to render timeline of child output streams merged in the "
+      L"order they were received to, along with the gaps in between. The "
+      L"file is referenced from the result",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kPipeBufferSize,
+      L"Size of pipe buffers child output streams are written to, in bytes. "
+      L"Defaults to 1 MiB, 0 keeps system default",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kSamplingInterval,
+      L"Interval to sample resource usage of child job at, in milliseconds. "
+      L"Samples are written to a CSV file referenced from the result",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kSamplingDirectory,
+      L"Directory to store resource samples in, defaults to the current one",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kCpuAffinity,
+      L"Processors to pin child job to, as a list like 0-3,8",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kCpuCores,
+      L"Number of whole physical cores of a single NUMA node to pin each "
+      L"child job to. Cores are picked among the ones not used by other oven "
+      L"runs, children that can't get them run unpinned",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kCpuExcludeSiblings,
+      L"Pin child job to one processor of each reserved core, leaving its "
+      L"SMT siblings idle",
+      oven::base::CommandLine::ArgumentType::kBool);
 }
 
-void ParseArguments(oven::base::CommandLine& command_line) {
-  command_line.AddArgument(arguments::kChildPath, L"Path to child executable",
-                           oven::base::CommandLine::ArgumentType::kString);
+void AddArguments(oven::base::CommandLine& command_line) {
+  command_line.AddOptionalArgument(
+      arguments::kChildPath,
+      L"Path to child executable, required unless manifest is passed",
+      oven::base::CommandLine::ArgumentType::kString);
 
-  command_line.AddArgument(arguments::kChildTimeout,
-                           L"Timeout in milliseconds for child process",
-                           oven::base::CommandLine::ArgumentType::kInt);
+  command_line.AddOptionalArgument(
+      arguments::kChildTimeout,
+      L"Timeout in milliseconds for child process, required unless serving",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kTeardownGracePeriod,
+      L"Time processes of timed out child have to stop on their own once "
+      L"asked to, in milliseconds, before they are killed. Defaults to 1000, "
+      L"0 kills them right away",
+      oven::base::CommandLine::ArgumentType::kInt);
 
   command_line.AddOptionalArgument(arguments::kDesktopName,
                                    L"Name of virtual desktop to use",
@@ -92,13 +301,172 @@ void ParseArguments(oven::base::CommandLine& command_line) {
       L"Heap size of created desktop",
       oven::base::CommandLine::ArgumentType::kInt);
 
+#if !defined(_WIN32)
+  command_line.AddOptionalArgument(
+      arguments::kDisplayPool,
+      L"Number of headless X servers to keep running for children, each "
+      L"child gets a display of its own. Servers are shared by all oven "
+      L"processes and outlive them",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kDisplayPoolUses,
+      L"Number of children X server serves before it's restarted, defaults "
+      L"to 50, 0 keeps it running",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kDisplayServer,
+      L"X server executable for display pool, defaults to Xvfb",
+      oven::base::CommandLine::ArgumentType::kString);
+#endif
+
+  command_line.AddOptionalArgument(
+      arguments::kShards,
+      L"Number of shards to split child into, each running at once inside "
+      L"of its own job with limits divided between them, 0 for one per "
+      L"processor. Results of shards are merged into one",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kShardEnvironment,
+      L"Comma separated names of environment variables to pass number of "
+      L"shards and shard index in, defaults to "
+      L"GTEST_TOTAL_SHARDS,GTEST_SHARD_INDEX",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kManifest,
+      L"Path to file listing child command lines to run in parallel, "
+      L"one per line",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kParallelRuns,
+      L"Maximum number of children from manifest (or requests to server) "
+      L"to run at once, defaults to number of processors",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kResultCache,
+      L"Directory to cache results of passed runs in, keyed by child "
+      L"executable, its libraries, command line, oven arguments and cache "
+      L"inputs. Identical runs replay cached result instead of running child",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kResultCacheSize,
+      L"Size of result cache to evict the least recently used results beyond, "
+      L"in bytes. Defaults to 1GiB",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kCacheEnvironment,
+      L"Comma separated names of environment variables result of child "
+      L"depends on",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kCacheInputs,
+      L"Comma separated paths of files result of child depends on, besides "
+      L"its executable and libraries",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kRunHistory,
+      L"Directory to record wall time, processor time and peak memory of "
+      L"passed runs of each child command line to",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kAdaptiveLimits,
+      L"Derive child timeout, processor time and overall memory limits from "
+      L"run history, using the configured ones as maximums. Applied limits "
+      L"are listed in the result",
+      oven::base::CommandLine::ArgumentType::kBool);
+
+  command_line.AddOptionalArgument(
+      arguments::kAdaptivePercentile,
+      L"Percentile of past runs adaptive limits are derived from, defaults "
+      L"to 99",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kAdaptiveFactor,
+      L"Factor percentile of past runs is multiplied by to get adaptive "
+      L"limit, defaults to 3",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kAdaptiveMinRuns,
+      L"Number of past runs needed to derive adaptive limits, configured "
+      L"ones apply until then. Defaults to 5",
+      oven::base::CommandLine::ArgumentType::kInt);
+
+  command_line.AddOptionalArgument(
+      arguments::kServe,
+      L"Run as a server accepting run requests on the given socket path "
+      L"(pipe name on Windows), until interrupted",
+      oven::base::CommandLine::ArgumentType::kString);
+
+  command_line.AddOptionalArgument(
+      arguments::kConnect,
+      L"Socket path (pipe name on Windows) of oven server to run child with",
+      oven::base::CommandLine::ArgumentType::kString);
+
   AddLimitingArguments(command_line);
+}
+
+// Checks arguments that depend on each other.
+std::wstring CheckArguments(const oven::base::CommandLine& command_line) {
+  if (command_line.IsSpecified(arguments::kCpuAffinity) &&
+      !oven::system::ProcessorTopology::ParseList(oven::base::WideToUtf8(
+          *command_line.GetValue<std::wstring>(arguments::kCpuAffinity)))) {
+    return std::wstring(L"Unable to parse processor list of '") +
+           arguments::kCpuAffinity + L"'";
+  }
+  if (command_line.IsSpecified(arguments::kAdaptiveFactor) &&
+      !ParseFactor(*command_line.GetValue<std::wstring>(arguments::kAdaptiveFactor))) {
+    return std::wstring(L"Unable to parse positive number of '") +
+           arguments::kAdaptiveFactor + L"'";
+  }
+  if (command_line.IsSpecified(arguments::kServe)) {
+    return std::wstring();
+  }
+  if (!command_line.IsSpecified(arguments::kChildTimeout)) {
+    return std::wstring(L"Unable to find required argument '") +
+           arguments::kChildTimeout + L"'";
+  }
+  if (command_line.IsSpecified(arguments::kChildPath) ==
+      command_line.IsSpecified(arguments::kManifest)) {
+    return std::wstring(L"Exactly one of '") + arguments::kChildPath +
+           L"' and '" + arguments::kManifest + L"' arguments is expected";
+  }
+  if (command_line.IsSpecified(arguments::kShards) &&
+      command_line.IsSpecified(arguments::kManifest)) {
+    return std::wstring(L"Children from '") + arguments::kManifest +
+           L"' can't be split into shards";
+  }
+  if (command_line.IsSpecified(arguments::kShardEnvironment) &&
+      SplitList(*command_line.GetValue<std::wstring>(arguments::kShardEnvironment))
+              .size() != 2) {
+    return std::wstring(L"Two variable names are expected in '") +
+           arguments::kShardEnvironment + L"'";
+  }
+  return std::wstring();
+}
+
+void ParseArguments(oven::base::CommandLine& command_line) {
+  AddArguments(command_line);
 
-  const std::wstring command_line_parse_error = command_line.Parse();
+  std::wstring command_line_parse_error = command_line.Parse();
   if (command_line.ShouldShowUsage()) {
     command_line.ShowUsage(std::wcout);
     exit(0);
   }
+  if (command_line_parse_error.empty()) {
+    command_line_parse_error = CheckArguments(command_line);
+  }
   if (!command_line_parse_error.empty()) {
     std::wclog << L"Unable to parse command line arguments: "
                << command_line_parse_error << L'\n';
@@ -107,10 +475,299 @@ void ParseArguments(oven::base::CommandLine& command_line) {
   }
 }
 
+// Fills settings specific to a single run: timeout and limits.
+void ReadRunSettings(const oven::base::CommandLine& command_line,
+                     oven::RunSettings& settings) {
+  settings.child_timeout = std::chrono::milliseconds(
+      *command_line.GetValue<std::int64_t>(arguments::kChildTimeout));
+  settings.teardown_policy.grace_period = std::chrono::milliseconds(std::max<std::int64_t>(
+      0, command_line.GetValue(arguments::kTeardownGracePeriod,
+                               kDefaultTeardownGracePeriod)));
+  settings.basic_limits.cpu_time_limit = std::chrono::milliseconds(command_line.GetValue(
+      arguments::kLimitCPUTime,
+      static_cast<std::int64_t>(std::chrono::milliseconds::max().count())));
+
+  settings.basic_limits.overall_memory_limit = command_line.GetValue(
+      arguments::kLimitOverallMemory, std::numeric_limits<std::int64_t>::max());
+  settings.basic_limits.per_process_memory_limit = command_line.GetValue(
+      arguments::kLimitPerProcessMemory, std::numeric_limits<std::int64_t>::max());
+  settings.basic_limits.memory_threshold = command_line.GetValue(
+      arguments::kMemoryThreshold, std::numeric_limits<std::int64_t>::max());
+
+  oven::system::Job::IoLimits& io_limits = settings.basic_limits.io_limits;
+  io_limits.read_bytes_per_second = command_line.GetValue(
+      arguments::kLimitReadBandwidth, std::numeric_limits<std::int64_t>::max());
+  io_limits.write_bytes_per_second = command_line.GetValue(
+      arguments::kLimitWriteBandwidth, std::numeric_limits<std::int64_t>::max());
+  io_limits.read_operations_per_second = command_line.GetValue(
+      arguments::kLimitReadOperations, std::numeric_limits<std::int64_t>::max());
+  io_limits.write_operations_per_second = command_line.GetValue(
+      arguments::kLimitWriteOperations, std::numeric_limits<std::int64_t>::max());
+
+  if (command_line.IsSpecified(arguments::kOutputHeadLimit) ||
+      command_line.IsSpecified(arguments::kOutputTailLimit)) {
+    settings.output_limits.head_size = static_cast<size_t>(std::max<std::int64_t>(
+        0, command_line.GetValue(arguments::kOutputHeadLimit, std::int64_t(0))));
+    settings.output_limits.tail_size = static_cast<size_t>(std::max<std::int64_t>(
+        0, command_line.GetValue(arguments::kOutputTailLimit, std::int64_t(0))));
+  }
+  settings.output_limits.spill_directory =
+      command_line.GetValue(arguments::kOutputSpillDirectory, std::wstring());
+  settings.output_gap_threshold = std::chrono::milliseconds(std::max<std::int64_t>(
+      0, command_line.GetValue(arguments::kOutputGapThreshold, kDefaultOutputGapThreshold)));
+  settings.output_timeline_directory =
+      command_line.GetValue(arguments::kOutputTimelineDirectory, std::wstring());
+  settings.pipe_buffer_size = static_cast<size_t>(std::max<std::int64_t>(
+      0, command_line.GetValue(arguments::kPipeBufferSize, kDefaultPipeBufferSize)));
+  settings.sampling_interval = std::chrono::milliseconds(std::max<std::int64_t>(
+      0, command_line.GetValue(arguments::kSamplingInterval, std::int64_t(0))));
+  settings.sampling_directory =
+      command_line.GetValue(arguments::kSamplingDirectory, std::wstring());
+
+  settings.affinity.processors =
+      oven::system::ProcessorTopology::ParseList(oven::base::WideToUtf8(
+          command_line.GetValue(arguments::kCpuAffinity, std::wstring())))
+          .value_or(std::vector<unsigned int>());
+  settings.core_reservation.cores = static_cast<size_t>(std::max<std::int64_t>(
+      0, command_line.GetValue(arguments::kCpuCores, std::int64_t(0))));
+  settings.core_reservation.exclude_siblings =
+      command_line.IsSpecified(arguments::kCpuExcludeSiblings);
+  settings.core_reservation.lock_directory =
+      oven::system::CoreReservation::GetDefaultLockDirectory();
+
+  const std::int64_t shards = command_line.GetValue(arguments::kShards, std::int64_t(1));
+  settings.shards = shards == 0 ? std::max(1u, std::thread::hardware_concurrency())
+                                : static_cast<size_t>(std::max<std::int64_t>(1, shards));
+  if (command_line.IsSpecified(arguments::kShardEnvironment)) {
+    const std::vector<std::wstring> names =
+        SplitList(*command_line.GetValue<std::wstring>(arguments::kShardEnvironment));
+    settings.shard_count_variable = names[0];
+    settings.shard_index_variable = names[1];
+  }
+
+  settings.adaptive_limits.enabled = command_line.IsSpecified(arguments::kAdaptiveLimits);
+  settings.adaptive_limits.percentile = static_cast<double>(
+      command_line.GetValue(arguments::kAdaptivePercentile, std::int64_t(99)));
+  if (command_line.IsSpecified(arguments::kAdaptiveFactor)) {
+    settings.adaptive_limits.factor =
+        *ParseFactor(*command_line.GetValue<std::wstring>(arguments::kAdaptiveFactor));
+  }
+  settings.adaptive_limits.min_runs = static_cast<size_t>(std::max<std::int64_t>(
+      1, command_line.GetValue(arguments::kAdaptiveMinRuns, std::int64_t(5))));
+
+  settings.cache_inputs.environment_variables =
+      SplitList(command_line.GetValue(arguments::kCacheEnvironment, std::wstring()));
+  settings.cache_inputs.files.clear();
+  for (const std::wstring& file :
+       SplitList(command_line.GetValue(arguments::kCacheInputs, std::wstring()))) {
+    settings.cache_inputs.files.emplace_back(file);
+  }
+}
+
+// Returns names and values of oven's own arguments which affect the outcome
+// of a run, to key cached results by. They're taken as parsed, so that how
+// they were spelled doesn't matter.
+std::wstring GetCacheSalt(const oven::base::CommandLine& command_line) {
+  std::wstring salt;
+  for (const std::wstring_view name : command_line.GetSpecifiedArguments()) {
+    if (std::find(std::begin(kUncachedArguments), std::end(kUncachedArguments), name) !=
+        std::end(kUncachedArguments)) {
+      continue;
+    }
+    salt.append(name);
+    if (const auto value = command_line.GetValue<std::wstring>(name)) {
+      salt.append(L"=").append(*value);
+    } else if (const auto number = command_line.GetValue<std::int64_t>(name)) {
+      salt.append(L"=").append(std::to_wstring(*number));
+    }
+    salt.push_back(L'\n');
+  }
+  return salt;
+}
+
+// Opens passthrough of child output streams, if there is one, relative to
+// working directory of |settings|. Returns false if it can't be opened.
+bool OpenOutputPassthrough(const oven::base::CommandLine& command_line,
+                           oven::RunSettings& settings) {
+  if (!command_line.IsSpecified(arguments::kOutputPassthrough)) {
+    return true;
+  }
+  const std::wstring path = *command_line.GetValue<std::wstring>(arguments::kOutputPassthrough);
+  if (path == L"-") {
+    settings.output_passthrough = oven::system::ChildProcess::Passthrough::Console();
+    return true;
+  }
+  auto passthrough = oven::system::ChildProcess::Passthrough::OpenFile(
+      std::filesystem::path(settings.working_directory) / path);
+  if (!passthrough) {
+    return false;
+  }
+  settings.output_passthrough = std::move(*passthrough);
+  return true;
+}
+
+size_t GetParallelRuns(const oven::base::CommandLine& command_line) {
+  // Zero stands for a run per processor.
+  return static_cast<size_t>(std::max<std::int64_t>(
+      0, command_line.GetValue(arguments::kParallelRuns, std::int64_t(0))));
+}
+
+// Runs children from |manifest|, no more than |parallel_runs| at once. Pool
+// starts children and stores their outcomes, while reactor waits for all of
+// them: a run doesn't occupy a thread in between, so any number of children
+// may run at once.
+void RunManifestChildren(const std::vector<oven::ManifestEntry>& manifest,
+                         const size_t parallel_runs,
+                         const oven::RunSettings& settings,
+                         oven::BatchExecutionResult& batch_result) {
+  oven::base::WorkStealingPool pool;
+  std::mutex guard;
+  std::condition_variable child_finished;
+  size_t next_child = 0;
+  size_t children_left = manifest.size();
+
+  // Each finished child starts the next one in its place.
+  std::function<void()> start_next_child = [&]() {
+    size_t index;
+    {
+      std::lock_guard lock(guard);
+      if (next_child == manifest.size()) {
+        return;
+      }
+      index = next_child++;
+    }
+    const oven::ManifestEntry& entry = manifest[index];
+    const std::vector<std::wstring_view> child_arguments(entry.arguments.begin(),
+                                                         entry.arguments.end());
+    oven::StartChild(settings, entry.child_path, child_arguments,
+                     batch_result.child(index), pool,
+                     [&, index](const int exit_code) {
+                       batch_result.ChildExited(index, exit_code);
+                       start_next_child();
+                       std::lock_guard lock(guard);
+                       if (--children_left == 0) {
+                         child_finished.notify_one();
+                       }
+                     });
+  };
+  for (size_t run = 0; run < parallel_runs; ++run) {
+    pool.Post(start_next_child);
+  }
+
+  std::unique_lock lock(guard);
+  child_finished.wait(lock, [&]() { return children_left == 0; });
+}
+
+int RunManifest(const oven::base::CommandLine& command_line,
+                const oven::RunSettings& settings,
+                oven::BatchExecutionResult& batch_result) {
+  const auto manifest = oven::ReadManifest(
+      std::filesystem::path(settings.working_directory) /
+      *command_line.GetValue<std::wstring>(arguments::kManifest));
+  if (!manifest) {
+    batch_result.SetInternalError(L"Unable to read manifest");
+    return 1;
+  }
+  for (const oven::ManifestEntry& entry : *manifest) {
+    batch_result.AddChild(entry.command_line);
+  }
+
+  // Each child runs inside of its own job with its own limits, by default
+  // there are as many children running as there are processors, or as many
+  // as there are cores to reserve for them.
+  size_t parallel_runs = GetParallelRuns(command_line);
+  if (parallel_runs == 0 && settings.core_reservation.cores > 0) {
+    if (const auto topology = oven::system::ProcessorTopology::Query()) {
+      parallel_runs = topology->CountCores() / settings.core_reservation.cores;
+    }
+  }
+  if (parallel_runs == 0) {
+    parallel_runs = std::max(1u, std::thread::hardware_concurrency());
+#if !defined(_WIN32)
+    // Children beyond the pool would wait for displays anyway.
+    if (settings.display_pool) {
+      parallel_runs = std::min(parallel_runs, settings.display_pool->size());
+    }
+#endif
+  }
+  RunManifestChildren(*manifest, parallel_runs, settings, batch_result);
+  return 0;
+}
+
+// Runs request of oven client with the command line it was started with.
+int HandleRequest(const oven::RunSettings& server_settings,
+                  const std::vector<std::wstring>& request_arguments,
+                  const std::wstring& working_directory,
+                  std::ostream& result_stream) {
+  std::vector<std::wstring> arguments_storage(request_arguments);
+  std::vector<wchar_t*> argv;
+  bool child_arguments = false;
+  for (std::wstring& argument : arguments_storage) {
+    child_arguments = child_arguments || argument == L"--";
+    // Response files are relative to the client as well.
+    if (!child_arguments && !argument.empty() && argument.front() == L'@') {
+      argument = L'@' + (std::filesystem::path(working_directory) /
+                         argument.substr(1)).wstring();
+    }
+    argv.push_back(argument.data());
+  }
+  oven::base::CommandLine command_line(static_cast<int>(argv.size()), argv.data());
+  AddArguments(command_line);
+  // Client checks arguments before sending them, so errors here mean it's
+  // incompatible with the server.
+  if (!command_line.Parse().empty() || !CheckArguments(command_line).empty() ||
+      command_line.IsSpecified(arguments::kServe)) {
+    return 1;
+  }
+
+  oven::RunSettings settings = server_settings;
+  ReadRunSettings(command_line, settings);
+  settings.working_directory = working_directory;
+  settings.cache_inputs.salt = GetCacheSalt(command_line);
+  if (!OpenOutputPassthrough(command_line, settings)) {
+    return 1;
+  }
+
+  if (command_line.IsSpecified(arguments::kManifest)) {
+    oven::BatchExecutionResult batch_result;
+    const int exit_code = RunManifest(command_line, settings, batch_result);
+    batch_result.Write(result_stream, exit_code);
+    return exit_code;
+  }
+  oven::ExecutionResult execution_result;
+  const int exit_code = oven::RunChild(
+      settings, *command_line.GetValue<std::wstring>(arguments::kChildPath),
+      command_line.GetUnparsed(), execution_result);
+  execution_result.Write(result_stream, exit_code);
+  return exit_code;
+}
+
+// Client keeps command line contract of oven, running child on server.
+int RunClient(const oven::base::CommandLine& command_line, int argc, wchar_t* argv[]) {
+  const std::wstring result_path =
+      command_line.GetValue(arguments::kResultPath, std::wstring());
+  std::string result_document;
+  const auto exit_code = oven::SendRequest(
+      *command_line.GetValue<std::wstring>(arguments::kConnect),
+      std::vector<std::wstring_view>(argv, argv + argc), &result_document);
+  if (!exit_code || result_document.empty()) {
+    oven::ExecutionResult execution_result(result_path);
+    execution_result.SetInternalError(L"Unable to run child on oven server");
+    return execution_result.Exit(1);
+  }
+  std::ofstream(std::filesystem::path(result_path), std::ios::binary) << result_document;
+  return *exit_code;
+}
+
 int wmain(int argc, wchar_t* argv[]) {
   oven::base::CommandLine command_line(argc, argv);
   ParseArguments(command_line);
 
+  const bool serve = command_line.IsSpecified(arguments::kServe);
+  if (!serve && command_line.IsSpecified(arguments::kConnect)) {
+    return RunClient(command_line, argc, argv);
+  }
+
   oven::ExecutionResult execution_result(
       command_line.GetValue(arguments::kResultPath, std::wstring()));
 
@@ -128,24 +785,45 @@ int wmain(int argc, wchar_t* argv[]) {
 #endif
   }
 
-  JobObserver test_observer;
-  oven::system::Job limited_job;
-
-  limited_job.AddObserver(&test_observer);
-
-  oven::system::Job::BasicLimits basic_limits;
-  basic_limits.cpu_time_limit = std::chrono::milliseconds(command_line.GetValue(
-      arguments::kLimitCPUTime,
-      static_cast<std::int64_t>(std::chrono::milliseconds::max().count())));
-
-  basic_limits.overall_memory_limit = command_line.GetValue(
-      arguments::kLimitOverallMemory, std::numeric_limits<std::int64_t>::max());
-  basic_limits.per_process_memory_limit = command_line.GetValue(
-      arguments::kLimitPerProcessMemory, std::numeric_limits<std::int64_t>::max());
+  oven::RunSettings settings;
+  settings.desktop_name = desktop_name;
+
+#if !defined(_WIN32)
+  // Like desktop, display pool stays alive for all the requests.
+  std::optional<oven::system::DisplayPool> display_pool;
+  if (command_line.GetValue(arguments::kDisplayPool, std::int64_t(0)) > 0) {
+    oven::system::DisplayPool::Options options;
+    options.size =
+        static_cast<size_t>(*command_line.GetValue<std::int64_t>(arguments::kDisplayPool));
+    options.max_uses = static_cast<size_t>(std::max<std::int64_t>(
+        0, command_line.GetValue(arguments::kDisplayPoolUses,
+                                 static_cast<std::int64_t>(options.max_uses))));
+    options.lock_directory = oven::system::DisplayPool::GetDefaultLockDirectory();
+    options.server_path = oven::base::WideToUtf8(command_line.GetValue(
+        arguments::kDisplayServer, oven::base::Utf8ToWide(options.server_path)));
+    display_pool.emplace(std::move(options));
+    display_pool->Prestart();
+    settings.display_pool = &*display_pool;
+  }
+#endif
 
-  if (!limited_job.SetBasicLimits(basic_limits)) {
-    execution_result.SetInternalError(L"Unable to set limits on job");
-    return execution_result.Exit(1);
+  // Cache is shared by all the requests as well.
+  std::optional<oven::ResultCache> result_cache;
+  if (command_line.IsSpecified(arguments::kResultCache)) {
+    oven::ResultCache::Options options;
+    options.directory = *command_line.GetValue<std::wstring>(arguments::kResultCache);
+    options.size_limit = static_cast<std::uint64_t>(std::max<std::int64_t>(
+        0, command_line.GetValue(arguments::kResultCacheSize,
+                                 static_cast<std::int64_t>(options.size_limit))));
+    result_cache.emplace(std::move(options));
+    settings.result_cache = &*result_cache;
+  }
+  std::optional<oven::RunHistory> run_history;
+  if (command_line.IsSpecified(arguments::kRunHistory)) {
+    oven::RunHistory::Options options;
+    options.directory = *command_line.GetValue<std::wstring>(arguments::kRunHistory);
+    run_history.emplace(std::move(options));
+    settings.run_history = &*run_history;
   }
 
   std::optional<oven::system::ScopedDesktopActivation> scoped_activation;
@@ -153,31 +831,53 @@ int wmain(int argc, wchar_t* argv[]) {
     scoped_activation.emplace(virtual_desktop);
   }
 
-  oven::system::ChildProcess child(
-      *command_line.GetValue<std::wstring>(arguments::kChildPath),
-      false /* detached */);
-  child.SetArguments(command_line.GetUnparsed());
-  const auto pid = child.Run(limited_job, desktop_name);
-  if (!pid) {
-    execution_result.SetInternalError(L"Unable to run child process");
-    return execution_result.Exit(1);
+  if (serve) {
+    // Desktop stays alive for all the requests, the rest of the settings come
+    // with each request.
+    const bool served = oven::Serve(
+        *command_line.GetValue<std::wstring>(arguments::kServe),
+        GetParallelRuns(command_line),
+        [&settings](const std::vector<std::wstring>& arguments,
+                    const std::wstring& working_directory,
+                    std::ostream& result_stream) {
+          return HandleRequest(settings, arguments, working_directory, result_stream);
+        });
+    return served ? 0 : 1;
   }
 
-  const auto child_timeout = *command_line.GetValue<std::int64_t>(arguments::kChildTimeout);
-  auto exit_code = child.Wait(std::chrono::milliseconds(child_timeout));
-  if (!exit_code) {
-    if (child.IsAlive()) {
-      execution_result.ChildTimedOut();
-    }
-    exit_code = child.Terminate();
+  ReadRunSettings(command_line, settings);
+  settings.cache_inputs.salt = GetCacheSalt(command_line);
+  if (!OpenOutputPassthrough(command_line, settings)) {
+    execution_result.SetInternalError(L"Unable to open output passthrough file");
+    return execution_result.Exit(1);
   }
-
-  if (exit_code) {
-    execution_result.ChildExitCode(*exit_code);
+  if (command_line.IsSpecified(arguments::kManifest)) {
+    oven::BatchExecutionResult batch_result(
+        command_line.GetValue(arguments::kResultPath, std::wstring()));
+    return batch_result.Exit(RunManifest(command_line, settings, batch_result));
   }
 
-  const oven::system::ChildProcess::Outputs& outputs = child.GetOutputs();
-  execution_result.SetChildStderr(outputs.stderror);
-  execution_result.SetChildStdout(outputs.stdoutput);
-  return execution_result.Exit(0);
+  return execution_result.Exit(oven::RunChild(
+      settings, *command_line.GetValue<std::wstring>(arguments::kChildPath),
+      command_line.GetUnparsed(), execution_result));
 }
+
+#if !defined(_WIN32)
+int main(int argc, char* argv[]) {
+  std::setlocale(LC_ALL, "");
+
+  // Command line is expected to be UTF-8 encoded.
+  std::vector<std::wstring> arguments;
+  arguments.reserve(argc);
+  for (int arg = 0; arg < argc; ++arg) {
+    arguments.push_back(oven::base::Utf8ToWide(argv[arg]));
+  }
+  std::vector<wchar_t*> wide_argv;
+  wide_argv.reserve(argc + 1);
+  for (std::wstring& argument : arguments) {
+    wide_argv.push_back(argument.data());
+  }
+  wide_argv.push_back(nullptr);
+  return wmain(argc, wide_argv.data());
+}
+#endif
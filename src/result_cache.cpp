@@ -0,0 +1,240 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#include "base/hash.h"
+#include "base/string_conversion.h"
+#include "system/image_dependencies.h"
+
+namespace oven {
+namespace {
+// Bumped whenever keys or entries change their meaning.
+const std::uint64_t kFormatVersion = 1;
+const char kEntriesDirectory[] = "entries";
+const char kDigestsDirectory[] = "digests";
+const char kEntryExtension[] = ".json";
+const char kTemporaryExtension[] = ".tmp";
+// Temporary files left by crashed processes are removed after this long.
+const std::chrono::hours kTemporaryFileLifetime{1};
+// Eviction goes below the size limit, so that it doesn't happen on every
+// store once cache is full.
+const std::uint64_t kEvictionPercent = 90;
+const size_t kReadChunkSize = 1024 * 1024;
+
+// Value of variable in the current environment, nothing if it's not set.
+std::optional<std::string> GetEnvironmentVariable(const std::wstring& name) {
+#if defined(_WIN32)
+  if (const wchar_t* value = ::_wgetenv(name.c_str())) {
+    return base::WideToUtf8(value);
+  }
+#else
+  if (const char* value = std::getenv(base::WideToUtf8(name).c_str())) {
+    return std::string(value);
+  }
+#endif
+  return std::optional<std::string>();
+}
+
+// Strings are prefixed with their sizes, so that they can't run into each
+// other.
+void HashString(base::Hasher& hasher, const std::string_view value) {
+  hasher.Update(static_cast<std::uint64_t>(value.size()));
+  hasher.Update(value);
+}
+
+std::string GenerateTemporaryName() {
+  thread_local static std::mt19937_64 generator{std::random_device{}()};
+  return base::FormatHash(generator()) + kTemporaryExtension;
+}
+}  // anonymous namespace
+
+ResultCache::ResultCache(Options options) : options_(std::move(options)) {
+  std::error_code error;
+  std::filesystem::create_directories(options_.directory / kEntriesDirectory, error);
+  std::filesystem::create_directories(options_.directory / kDigestsDirectory, error);
+}
+
+std::optional<std::uint64_t> ResultCache::ComputeKey(
+    const std::filesystem::path& image, const std::wstring_view command_line,
+    const Inputs& inputs) const {
+  const auto image_digest = DigestFile(image);
+  if (!image_digest) {
+    return std::optional<std::uint64_t>();
+  }
+  base::Hasher hasher;
+  hasher.Update(kFormatVersion);
+  hasher.Update(*image_digest);
+  // Libraries are found the same way as long as the image is the same, so
+  // only their contents matter.
+  for (const std::filesystem::path& library : system::FindImageDependencies(image)) {
+    hasher.Update(DigestFile(library).value_or(0));
+  }
+  HashString(hasher, base::WideToUtf8(command_line));
+  for (const std::wstring& name : inputs.environment_variables) {
+    HashString(hasher, base::WideToUtf8(name));
+    const auto value = GetEnvironmentVariable(name);
+    hasher.Update(static_cast<std::uint64_t>(value.has_value()));
+    HashString(hasher, value.value_or(std::string()));
+  }
+  // Missing input is a state of its own.
+  for (const std::filesystem::path& file : inputs.files) {
+    HashString(hasher, base::WideToUtf8(file.wstring()));
+    const auto digest = DigestFile(file);
+    hasher.Update(static_cast<std::uint64_t>(digest.has_value()));
+    hasher.Update(digest.value_or(0));
+  }
+  HashString(hasher, base::WideToUtf8(inputs.salt));
+  return hasher.Finish();
+}
+
+std::optional<std::string> ResultCache::Find(const std::uint64_t key) const {
+  const std::filesystem::path entry = GetEntryPath(key);
+  std::ifstream file(entry, std::ios::binary);
+  if (!file) {
+    return std::optional<std::string>();
+  }
+  std::ostringstream document;
+  document << file.rdbuf();
+  if (!file) {
+    return std::optional<std::string>();
+  }
+  // Entry may have been evicted meanwhile, it's read already then.
+  std::error_code error;
+  std::filesystem::last_write_time(
+      entry, std::filesystem::file_time_type::clock::now(), error);
+  return document.str();
+}
+
+void ResultCache::Store(const std::uint64_t key, const std::string_view document) const {
+  if (WriteFile(GetEntryPath(key), document)) {
+    Evict();
+  }
+}
+
+std::optional<std::uint64_t> ResultCache::DigestFile(
+    const std::filesystem::path& path) const {
+  std::error_code error;
+  const std::uint64_t size = std::filesystem::file_size(path, error);
+  if (error) {
+    return std::optional<std::uint64_t>();
+  }
+  const auto modification_time = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return std::optional<std::uint64_t>();
+  }
+  const std::uint64_t time =
+      static_cast<std::uint64_t>(modification_time.time_since_epoch().count());
+
+  // Memo is named after the absolute path of the file, and is valid as long
+  // as file keeps its size and modification time.
+  base::Hasher path_hasher;
+  path_hasher.Update(base::WideToUtf8(std::filesystem::absolute(path, error).wstring()));
+  const std::filesystem::path memo =
+      options_.directory / kDigestsDirectory / base::FormatHash(path_hasher.Finish());
+  std::uint64_t memo_size = 0;
+  std::uint64_t memo_time = 0;
+  std::uint64_t memo_digest = 0;
+  if (std::ifstream(memo) >> memo_size >> memo_time >> memo_digest &&
+      memo_size == size && memo_time == time) {
+    return memo_digest;
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::optional<std::uint64_t>();
+  }
+  base::Hasher hasher;
+  std::string chunk(kReadChunkSize, '\0');
+  while (file) {
+    file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    hasher.Update(std::string_view(chunk.data(), static_cast<size_t>(file.gcount())));
+  }
+  if (!file.eof()) {
+    return std::optional<std::uint64_t>();
+  }
+  const std::uint64_t digest = hasher.Finish();
+  WriteFile(memo, std::to_string(size) + ' ' + std::to_string(time) + ' ' +
+                      std::to_string(digest) + '\n');
+  return digest;
+}
+
+void ResultCache::Evict() const {
+  struct Entry {
+    std::filesystem::path path;
+    std::filesystem::file_time_type time;
+    std::uint64_t size;
+  };
+  std::vector<Entry> entries;
+  std::uint64_t total_size = 0;
+  const auto now = std::filesystem::file_time_type::clock::now();
+  std::error_code error;
+  for (const auto& file : std::filesystem::directory_iterator(
+           options_.directory / kEntriesDirectory, error)) {
+    std::error_code entry_error;
+    const auto time = file.last_write_time(entry_error);
+    const std::uint64_t size = file.file_size(entry_error);
+    if (entry_error) {
+      continue;
+    }
+    if (file.path().extension() == kTemporaryExtension) {
+      if (now - time > kTemporaryFileLifetime) {
+        std::filesystem::remove(file.path(), entry_error);
+      }
+      continue;
+    }
+    entries.push_back(Entry{file.path(), time, size});
+    total_size += size;
+  }
+  if (total_size <= options_.size_limit) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& left, const Entry& right) { return left.time < right.time; });
+  const std::uint64_t target_size = options_.size_limit / 100 * kEvictionPercent;
+  for (const Entry& entry : entries) {
+    if (total_size <= target_size) {
+      break;
+    }
+    // Entry may be evicted by another process at the same time.
+    std::filesystem::remove(entry.path, error);
+    total_size -= entry.size;
+  }
+}
+
+// static
+bool ResultCache::WriteFile(const std::filesystem::path& path,
+                            const std::string_view contents) {
+  const std::filesystem::path temporary_path =
+      std::filesystem::path(path).replace_filename(
+          path.filename().string() + '.' + GenerateTemporaryName());
+  {
+    std::ofstream file(temporary_path, std::ios::binary);
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    if (!file.flush()) {
+      std::error_code error;
+      std::filesystem::remove(temporary_path, error);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary_path, path, error);
+  if (error) {
+    std::filesystem::remove(temporary_path, error);
+    return false;
+  }
+  return true;
+}
+
+std::filesystem::path ResultCache::GetEntryPath(const std::uint64_t key) const {
+  return options_.directory / kEntriesDirectory / (base::FormatHash(key) + kEntryExtension);
+}
+
+}  // namespace oven
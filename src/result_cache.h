@@ -0,0 +1,67 @@
+#ifndef _OVEN_RESULT_CACHE_H_
+#define _OVEN_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace oven {
+
+// Result documents of passed runs, keyed by a hash of everything run depends
+// on, so that an identical run can be replayed instead. Cache directory may
+// be shared by concurrent oven processes: entries are written to temporary
+// files and renamed into place, so that readers only see whole ones, and
+// their recency is kept in their modification times. Once entries take more
+// than the size limit, the least recently used ones are evicted.
+class ResultCache {
+ public:
+  struct Options {
+    std::filesystem::path directory;
+    std::uint64_t size_limit = 1024 * 1024 * 1024;
+  };
+
+  // What run depends on besides child image, its libraries and command line.
+  struct Inputs {
+    // Variables of the current environment, which children inherit.
+    std::vector<std::wstring> environment_variables;
+    std::vector<std::filesystem::path> files;
+    // Anything else the result depends on, e.g. oven's own arguments.
+    std::wstring salt;
+  };
+
+  explicit ResultCache(Options options);
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // Returns key of the run, nothing if |image| can't be read.
+  std::optional<std::uint64_t> ComputeKey(const std::filesystem::path& image,
+                                          const std::wstring_view command_line,
+                                          const Inputs& inputs) const;
+
+  std::optional<std::string> Find(const std::uint64_t key) const;
+  void Store(const std::uint64_t key, const std::string_view document) const;
+
+ private:
+  // Returns hash of file contents, memoized by its size and modification
+  // time, nothing if file can't be read.
+  std::optional<std::uint64_t> DigestFile(const std::filesystem::path& path) const;
+
+  // Removes the least recently used entries once there are too many of them.
+  void Evict() const;
+
+  // Writes |contents| to |path| atomically.
+  static bool WriteFile(const std::filesystem::path& path,
+                        const std::string_view contents);
+
+  std::filesystem::path GetEntryPath(const std::uint64_t key) const;
+
+  Options options_;
+};
+
+}  // namespace oven
+
+#endif  // _OVEN_RESULT_CACHE_H_
@@ -0,0 +1,191 @@
+#include "run_history.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <system_error>
+
+#include "base/hash.h"
+#include "base/string_conversion.h"
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace {
+const char kRunsExtension[] = ".runs";
+const char kTemporaryExtension[] = ".tmp";
+// Taken for updates of any history file, which are short.
+const char kLockFileName[] = "history.lock";
+// Written in place of values the system didn't account for.
+const char kMissingValue[] = "-";
+// Last field of each run, which histories of older versions don't have.
+const char kFailedRun[] = "failed";
+const char kPassedRun[] = "passed";
+
+std::optional<std::uint64_t> ParseValue(const std::string& value) {
+  if (value.empty() || value == kMissingValue) {
+    return std::optional<std::uint64_t>();
+  }
+  return std::stoull(value);
+}
+
+std::string FormatValue(const std::optional<std::uint64_t>& value) {
+  return value ? std::to_string(*value) : std::string(kMissingValue);
+}
+
+// Exclusive lock of history directory, held by one update at a time across
+// processes and threads, until it's destroyed.
+class HistoryLock {
+ public:
+  explicit HistoryLock(const std::filesystem::path& directory) {
+    const std::filesystem::path path = directory / kLockFileName;
+#if defined(_WIN32)
+    file_.reset(::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+    OVERLAPPED whole_file = {};
+    if (file_ && !::LockFileEx(file_.get(), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0,
+                               &whole_file)) {
+      file_.reset();
+    }
+#else
+    file_.reset(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+    int result;
+    while (file_ && (result = ::flock(file_.get(), LOCK_EX)) != 0 && errno == EINTR) {
+    }
+    if (file_ && result != 0) {
+      file_.reset();
+    }
+#endif
+  }
+
+  // Lock is released along with the file.
+  bool IsLocked() const noexcept { return file_.IsValid(); }
+
+ private:
+  system::ScopedHandle file_;
+};
+
+// Strings are prefixed with their sizes, so that they can't run into each
+// other.
+void HashString(base::Hasher& hasher, const std::wstring_view value) {
+  const std::string utf8 = base::WideToUtf8(value);
+  hasher.Update(static_cast<std::uint64_t>(utf8.size()));
+  hasher.Update(utf8);
+}
+}  // anonymous namespace
+
+RunHistory::RunHistory(Options options) : options_(std::move(options)) {
+  std::error_code error;
+  std::filesystem::create_directories(options_.directory, error);
+}
+
+// static
+std::uint64_t RunHistory::ComputeKey(
+    const std::wstring_view command_line,
+    const std::vector<std::pair<std::wstring, std::wstring>>& environment) {
+  base::Hasher hasher;
+  HashString(hasher, command_line);
+  for (const auto& [name, value] : environment) {
+    HashString(hasher, name);
+    HashString(hasher, value);
+  }
+  return hasher.Finish();
+}
+
+// Each run is a line of wall time and processor time in microseconds, peak
+// memory in bytes and whether it has failed at derived limits.
+std::vector<RunHistory::Run> RunHistory::Read(const std::uint64_t key) const {
+  std::vector<Run> runs;
+  std::ifstream file(GetRunsPath(key));
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string wall_time, cpu_time, peak_memory, outcome;
+    if (!(fields >> wall_time >> cpu_time >> peak_memory)) {
+      continue;
+    }
+    fields >> outcome;
+    try {
+      Run run;
+      run.wall_time = std::chrono::microseconds(ParseValue(wall_time).value_or(0));
+      if (const auto value = ParseValue(cpu_time)) {
+        run.cpu_time = std::chrono::microseconds(*value);
+      }
+      run.peak_memory = ParseValue(peak_memory);
+      run.failed_at_derived_limits = outcome == kFailedRun;
+      runs.push_back(run);
+    } catch (const std::exception&) {
+      // Damaged line is skipped, the rest of the history is still good.
+    }
+  }
+  return runs;
+}
+
+// History file is replaced under the lock, so that concurrent records don't
+// overwrite each other, while readers see either the old or the new one.
+void RunHistory::Record(const std::uint64_t key, const Run& run) const {
+  const HistoryLock lock(options_.directory);
+  if (!lock.IsLocked()) {
+    return;
+  }
+  std::vector<Run> runs = Read(key);
+  runs.push_back(run);
+  if (runs.size() > options_.max_runs) {
+    runs.erase(runs.begin(), runs.end() - static_cast<std::ptrdiff_t>(options_.max_runs));
+  }
+
+  thread_local static std::mt19937_64 generator{std::random_device{}()};
+  const std::filesystem::path path = GetRunsPath(key);
+  const std::filesystem::path temporary_path =
+      std::filesystem::path(path).replace_extension(
+          base::FormatHash(generator()) + kTemporaryExtension);
+  {
+    std::ofstream file(temporary_path);
+    for (const Run& recorded : runs) {
+      file << recorded.wall_time.count() << ' '
+           << FormatValue(recorded.cpu_time
+                              ? std::optional<std::uint64_t>(recorded.cpu_time->count())
+                              : std::nullopt)
+           << ' ' << FormatValue(recorded.peak_memory) << ' '
+           << (recorded.failed_at_derived_limits ? kFailedRun : kPassedRun) << '\n';
+    }
+    if (!file.flush()) {
+      std::error_code error;
+      std::filesystem::remove(temporary_path, error);
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary_path, path, error);
+  if (error) {
+    std::filesystem::remove(temporary_path, error);
+  }
+}
+
+// static
+std::optional<std::uint64_t> RunHistory::GetPercentile(std::vector<std::uint64_t> values,
+                                                       const double percentile) {
+  if (values.empty()) {
+    return std::optional<std::uint64_t>();
+  }
+  std::sort(values.begin(), values.end());
+  const double rank = std::ceil(std::clamp(percentile, 0.0, 100.0) / 100 * values.size());
+  const size_t index = std::max<size_t>(1, static_cast<size_t>(rank)) - 1;
+  return values[std::min(index, values.size() - 1)];
+}
+
+std::filesystem::path RunHistory::GetRunsPath(const std::uint64_t key) const {
+  return options_.directory / (base::FormatHash(key) + kRunsExtension);
+}
+
+}  // namespace oven
@@ -0,0 +1,81 @@
+#ifndef _OVEN_RUN_HISTORY_H_
+#define _OVEN_RUN_HISTORY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace oven {
+
+// Resource usage of the recent passed runs of each child, keyed by its
+// command line, so that limits of the next run can be derived from it. Each
+// child has a small text file of its own in the history directory, which
+// is replaced atomically under a lock of the directory, so that it may be
+// shared by concurrent oven processes.
+class RunHistory {
+ public:
+  struct Options {
+    std::filesystem::path directory;
+    // Older runs are forgotten beyond this number.
+    size_t max_runs = 100;
+  };
+
+  // Values the system doesn't account for are left empty. Run that failed
+  // under limits derived from history is only recorded as such, without
+  // values: it may have needed more than it got.
+  struct Run {
+    std::chrono::microseconds wall_time{0};
+    std::optional<std::chrono::microseconds> cpu_time;
+    std::optional<std::uint64_t> peak_memory;
+    bool failed_at_derived_limits = false;
+  };
+
+  // How limits are derived from history: |percentile| of the past runs
+  // multiplied by |factor|, no lower than the minimum and no higher than the
+  // configured limit. Configured limits apply until there are |min_runs|
+  // past passed runs, and to the run after one that failed at derived limits,
+  // so that they can grow again. Unlimited ones stay so.
+  struct AdaptiveLimits {
+    bool enabled = false;
+    double percentile = 99;
+    double factor = 3;
+    size_t min_runs = 5;
+    std::chrono::milliseconds min_timeout{1000};
+    std::chrono::milliseconds min_cpu_time{1000};
+    std::uint64_t min_memory = 64 * 1024 * 1024;
+  };
+
+  explicit RunHistory(Options options);
+
+  RunHistory(const RunHistory&) = delete;
+  RunHistory& operator=(const RunHistory&) = delete;
+
+  // Returns key of child run with |command_line| and |environment| set on
+  // top of the one of oven.
+  static std::uint64_t ComputeKey(
+      const std::wstring_view command_line,
+      const std::vector<std::pair<std::wstring, std::wstring>>& environment);
+
+  // Returns the recorded runs, the oldest first.
+  std::vector<Run> Read(const std::uint64_t key) const;
+  void Record(const std::uint64_t key, const Run& run) const;
+
+  // Returns value below which |percentile| of |values| are (nearest rank),
+  // nothing if there are no values.
+  static std::optional<std::uint64_t> GetPercentile(std::vector<std::uint64_t> values,
+                                                    const double percentile);
+
+ private:
+  std::filesystem::path GetRunsPath(const std::uint64_t key) const;
+
+  Options options_;
+};
+
+}  // namespace oven
+
+#endif  // _OVEN_RUN_HISTORY_H_
@@ -0,0 +1,117 @@
+#include "run_history.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace oven {
+namespace {
+class RunHistoryTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = std::filesystem::temp_directory_path() /
+                 ("oven-history-" + std::to_string(std::chrono::steady_clock::now()
+                                                       .time_since_epoch()
+                                                       .count()));
+  }
+
+  void TearDown() override {
+    std::error_code error;
+    std::filesystem::remove_all(directory_, error);
+  }
+
+  RunHistory::Options MakeOptions(const size_t max_runs) const {
+    RunHistory::Options options;
+    options.directory = directory_;
+    options.max_runs = max_runs;
+    return options;
+  }
+
+  static RunHistory::Run MakeRun(const std::int64_t wall_time) {
+    RunHistory::Run run;
+    run.wall_time = std::chrono::microseconds(wall_time);
+    return run;
+  }
+
+  std::filesystem::path directory_;
+};
+
+TEST_F(RunHistoryTest, KeepsRecentRuns) {
+  const RunHistory history(MakeOptions(3));
+  for (std::int64_t wall_time = 1; wall_time <= 5; ++wall_time) {
+    history.Record(1, MakeRun(wall_time));
+  }
+  const std::vector<RunHistory::Run> runs = history.Read(1);
+  ASSERT_EQ(runs.size(), 3u);
+  EXPECT_EQ(runs[0].wall_time.count(), 3);
+  EXPECT_EQ(runs[2].wall_time.count(), 5);
+  EXPECT_FALSE(runs[2].cpu_time);
+  EXPECT_FALSE(runs[2].peak_memory);
+  EXPECT_TRUE(history.Read(2).empty());
+}
+
+TEST_F(RunHistoryTest, KeepsFailureAtDerivedLimits) {
+  const RunHistory history(MakeOptions(3));
+  history.Record(1, MakeRun(1));
+  RunHistory::Run failed_run;
+  failed_run.failed_at_derived_limits = true;
+  history.Record(1, failed_run);
+  const std::vector<RunHistory::Run> runs = history.Read(1);
+  ASSERT_EQ(runs.size(), 2u);
+  EXPECT_FALSE(runs[0].failed_at_derived_limits);
+  EXPECT_TRUE(runs[1].failed_at_derived_limits);
+}
+
+// Histories written before failures were recorded have passed runs only.
+TEST_F(RunHistoryTest, ReadsRunsWithoutOutcome) {
+  const RunHistory history(MakeOptions(3));
+  history.Record(1, MakeRun(1));
+  for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+    if (entry.path().extension() == ".runs") {
+      std::ofstream(entry.path()) << "5 - 7\n";
+    }
+  }
+  const std::vector<RunHistory::Run> runs = history.Read(1);
+  ASSERT_EQ(runs.size(), 1u);
+  EXPECT_EQ(runs[0].wall_time.count(), 5);
+  EXPECT_EQ(runs[0].peak_memory, 7u);
+  EXPECT_FALSE(runs[0].failed_at_derived_limits);
+}
+
+TEST(RunHistoryPercentileTest, ReturnsNearestRank) {
+  EXPECT_FALSE(RunHistory::GetPercentile({}, 50));
+  EXPECT_EQ(RunHistory::GetPercentile({7}, 99), 7u);
+  EXPECT_EQ(RunHistory::GetPercentile({40, 10, 30, 20}, 50), 20u);
+  EXPECT_EQ(RunHistory::GetPercentile({40, 10, 30, 20}, 51), 30u);
+  EXPECT_EQ(RunHistory::GetPercentile({40, 10, 30, 20}, 99), 40u);
+  EXPECT_EQ(RunHistory::GetPercentile({40, 10, 30, 20}, 0), 10u);
+  EXPECT_EQ(RunHistory::GetPercentile({40, 10, 30, 20}, 150), 40u);
+}
+
+TEST_F(RunHistoryTest, KeepsConcurrentRecords) {
+  const size_t kThreads = 8;
+  const size_t kRecordsPerThread = 25;
+  // Every recording thread has history of its own, like separate oven
+  // processes sharing the directory would.
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([this]() {
+      const RunHistory history(MakeOptions(kThreads * kRecordsPerThread));
+      for (size_t record = 0; record < kRecordsPerThread; ++record) {
+        history.Record(1, MakeRun(static_cast<std::int64_t>(record)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(RunHistory(MakeOptions(kThreads * kRecordsPerThread)).Read(1).size(),
+            kThreads * kRecordsPerThread);
+}
+}  // anonymous namespace
+}  // namespace oven
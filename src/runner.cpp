@@ -0,0 +1,574 @@
+#include "runner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+
+#include "system/child_process.h"
+#include "system/job_sampler.h"
+#include "system/reactor.h"
+
+namespace oven {
+namespace {
+bool IsUnlimited(const std::uint64_t limit) {
+  return limit >= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+}
+
+// Spill directory is relative to the working directory of children.
+base::OutputCapture::Limits ResolveOutputLimits(const RunSettings& settings) {
+  base::OutputCapture::Limits output_limits = settings.output_limits;
+  if (!output_limits.spill_directory.empty()) {
+    output_limits.spill_directory =
+        std::filesystem::path(settings.working_directory) / output_limits.spill_directory;
+  }
+  return output_limits;
+}
+
+// Divides limits of the whole job between |shards| jobs of its shards:
+// memory, processor time, I/O rates and reserved cores. Limits of single
+// processes stay as they are.
+void DivideLimits(const size_t shards, RunSettings& settings) {
+  auto divide = [shards](std::uint64_t& limit) {
+    if (!IsUnlimited(limit)) {
+      limit = std::max<std::uint64_t>(1, limit / shards);
+    }
+  };
+  system::Job::BasicLimits& limits = settings.basic_limits;
+  divide(limits.overall_memory_limit);
+  divide(limits.memory_threshold);
+  divide(limits.io_limits.read_bytes_per_second);
+  divide(limits.io_limits.write_bytes_per_second);
+  divide(limits.io_limits.read_operations_per_second);
+  divide(limits.io_limits.write_operations_per_second);
+  if (limits.cpu_time_limit < std::chrono::milliseconds::max()) {
+    limits.cpu_time_limit = std::max(std::chrono::milliseconds(1),
+                                     limits.cpu_time_limit / static_cast<int>(shards));
+  }
+  if (settings.core_reservation.cores > 0) {
+    settings.core_reservation.cores =
+        std::max<size_t>(1, settings.core_reservation.cores / shards);
+  }
+}
+
+// Keeps memory events of the job for the result, up to |kMaxMemoryEvents| of
+// them: job may stay above its threshold for long.
+class MemoryEventRecorder : public system::Job::Observer {
+ public:
+  static const size_t kMaxMemoryEvents = 1024;
+
+  void OnEvent(const system::Job::Event& event) override {
+    using Type = system::Job::Event::Type;
+    if (event.type != Type::kMemoryThreshold && event.type != Type::kJobMemoryLimit &&
+        event.type != Type::kProcessMemoryLimit) {
+      return;
+    }
+    std::lock_guard lock(guard_);
+    if (events_.size() == kMaxMemoryEvents) {
+      ++dropped_events_;
+      return;
+    }
+    events_.push_back(event);
+  }
+
+  // Stores events observed so far in |result|, times relative to |start_time|.
+  void Store(const std::chrono::steady_clock::time_point start_time,
+             ExecutionResult& result) {
+    std::lock_guard lock(guard_);
+    std::vector<ExecutionResult::MemoryEvent> memory_events;
+    for (const system::Job::Event& event : events_) {
+      memory_events.push_back(ExecutionResult::MemoryEvent{
+          event.type,
+          std::chrono::duration_cast<std::chrono::microseconds>(event.time - start_time),
+          event.process_id, event.memory_used, event.memory_limit});
+    }
+    result.SetMemoryEvents(std::move(memory_events), dropped_events_);
+  }
+
+ private:
+  std::mutex guard_;
+  std::vector<system::Job::Event> events_;
+  size_t dropped_events_ = 0;
+};
+
+// Returns random file name like "<prefix>0123456789abcdef<extension>".
+std::filesystem::path GenerateFileName(const std::string_view prefix,
+                                       const std::string_view extension) {
+  thread_local static std::mt19937_64 generator{std::random_device{}()};
+  const char digits[] = "0123456789abcdef";
+  std::string name(prefix);
+  std::uint64_t value = generator();
+  for (int digit = 0; digit < 16; ++digit, value >>= 4) {
+    name.push_back(digits[value & 0xf]);
+  }
+  return name.append(extension);
+}
+
+const std::optional<system::ProcessorTopology>& GetProcessorTopology() {
+  static const std::optional<system::ProcessorTopology> topology =
+      system::ProcessorTopology::Query();
+  return topology;
+}
+
+// Child run inside of its own job, from start until its outcome is stored.
+class ChildRun {
+ public:
+  ChildRun(const RunSettings& settings, const std::wstring_view child_path,
+           const std::vector<std::wstring_view>& arguments,
+           ExecutionResult& result)
+      : settings_(settings),
+        result_(result),
+        image_(ResolveChildPath(settings, child_path)),
+        child_timeout_(settings.child_timeout),
+        basic_limits_(settings.basic_limits),
+        child_(image_, false /* detached */) {
+    child_.SetArguments(arguments);
+  }
+
+  system::ChildProcess& child() noexcept { return child_; }
+
+  // Timeout of the child, which is only derived from history once it's
+  // started.
+  std::chrono::milliseconds child_timeout() const noexcept { return child_timeout_; }
+
+  // Returns true if result of an identical run is cached, it's replayed into
+  // result then and child needn't run.
+  bool ReplayCachedResult();
+
+  // Tears down job of timed out child and calls |on_done| on reactor thread,
+  // so that no thread waits for hung processes to go.
+  void TearDownAsync(std::function<void()> on_done);
+
+  // Returns false if child couldn't be started, internal error is stored
+  // in result then.
+  bool Start();
+
+  // Stores the outcome of child run, which has exited with |exit_code| or
+  // timed out if there is none. Returns exit code for result. May block
+  // until child outputs are closed.
+  int Finish(std::optional<int> exit_code);
+
+ private:
+  // Returns false if affinity was requested but couldn't be set.
+  bool SetAffinity();
+
+  // Derives timeout and limits of the run from history of the child, if
+  // it's enabled.
+  void ApplyRunHistory();
+
+  static std::wstring ResolveChildPath(const RunSettings& settings,
+                                       const std::wstring_view child_path) {
+    if (settings.working_directory.empty()) {
+      return std::wstring(child_path);
+    }
+    return (std::filesystem::path(settings.working_directory) / child_path).wstring();
+  }
+
+  const RunSettings& settings_;
+  ExecutionResult& result_;
+  const std::wstring image_;
+  std::optional<std::uint64_t> cache_key_;
+  std::optional<std::uint64_t> history_key_;
+  // Some limit is tighter than configured, derived from history.
+  bool derived_limits_ = false;
+  std::chrono::milliseconds child_timeout_;
+  system::Job::BasicLimits basic_limits_;
+  MemoryEventRecorder memory_events_;
+  std::optional<system::CoreReservation> cores_;
+#if !defined(_WIN32)
+  std::optional<system::DisplayLease> display_;
+#endif
+  system::Job limited_job_;
+  system::ChildProcess child_;
+  std::optional<system::JobSampler> sampler_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::optional<system::Job::TeardownTimes> teardown_;
+};
+
+bool ChildRun::ReplayCachedResult() {
+  if (!settings_.result_cache) {
+    return false;
+  }
+  ResultCache::Inputs inputs = settings_.cache_inputs;
+  for (std::filesystem::path& file : inputs.files) {
+    file = std::filesystem::path(settings_.working_directory) / file;
+  }
+  for (const auto& [name, value] : settings_.environment) {
+    inputs.salt.append(name).append(L"=").append(value).push_back(L'\n');
+  }
+  cache_key_ = settings_.result_cache->ComputeKey(image_, child_.RenderCommandLine(), inputs);
+  if (!cache_key_) {
+    return false;
+  }
+  auto document = settings_.result_cache->Find(*cache_key_);
+  if (!document) {
+    result_.SetCacheKey(*cache_key_);
+    return false;
+  }
+  result_.Replay(*cache_key_, std::move(*document));
+  return true;
+}
+
+void ChildRun::ApplyRunHistory() {
+  if (!settings_.run_history) {
+    return;
+  }
+  history_key_ = RunHistory::ComputeKey(child_.RenderCommandLine(), settings_.environment);
+  const RunHistory::AdaptiveLimits& adaptive = settings_.adaptive_limits;
+  if (!adaptive.enabled) {
+    return;
+  }
+
+  // Times are compared in milliseconds, like the limits are set.
+  auto to_milliseconds = [](const std::chrono::microseconds time) {
+    return static_cast<std::uint64_t>(
+        std::chrono::ceil<std::chrono::milliseconds>(time).count());
+  };
+  std::vector<std::uint64_t> wall_times;
+  std::vector<std::uint64_t> cpu_times;
+  std::vector<std::uint64_t> peak_memories;
+  std::vector<RunHistory::Run> runs = settings_.run_history->Read(*history_key_);
+  // Run after one that failed at derived limits gets the configured ones,
+  // what it takes if it passes then raises the percentile.
+  if (!runs.empty() && runs.back().failed_at_derived_limits) {
+    runs.clear();
+  }
+  for (const RunHistory::Run& run : runs) {
+    if (run.failed_at_derived_limits) {
+      continue;
+    }
+    wall_times.push_back(to_milliseconds(run.wall_time));
+    if (run.cpu_time) {
+      cpu_times.push_back(to_milliseconds(*run.cpu_time));
+    }
+    if (run.peak_memory) {
+      peak_memories.push_back(*run.peak_memory);
+    }
+  }
+
+  // Unlimited ones stay so, history only makes limits tighter.
+  std::vector<ExecutionResult::AppliedLimit> applied_limits;
+  applied_limits.push_back(DeriveLimit(
+      "child_timeout", std::move(wall_times), static_cast<std::uint64_t>(child_timeout_.count()),
+      static_cast<std::uint64_t>(adaptive.min_timeout.count()), adaptive));
+  child_timeout_ = std::chrono::milliseconds(applied_limits.back().value);
+  if (basic_limits_.cpu_time_limit < std::chrono::milliseconds::max()) {
+    applied_limits.push_back(DeriveLimit(
+        "cpu_time_limit", std::move(cpu_times),
+        static_cast<std::uint64_t>(basic_limits_.cpu_time_limit.count()),
+        static_cast<std::uint64_t>(adaptive.min_cpu_time.count()), adaptive));
+    basic_limits_.cpu_time_limit = std::chrono::milliseconds(applied_limits.back().value);
+  }
+  if (!IsUnlimited(basic_limits_.overall_memory_limit)) {
+    applied_limits.push_back(DeriveLimit("overall_memory_limit", std::move(peak_memories),
+                                         basic_limits_.overall_memory_limit,
+                                         adaptive.min_memory, adaptive));
+    basic_limits_.overall_memory_limit = applied_limits.back().value;
+  }
+  derived_limits_ = std::any_of(
+      applied_limits.begin(), applied_limits.end(),
+      [](const ExecutionResult::AppliedLimit& limit) { return limit.from_history && !limit.clamped; });
+  result_.SetAppliedLimits(std::move(applied_limits));
+}
+
+bool ChildRun::Start() {
+  limited_job_.AddObserver(&memory_events_);
+
+  ApplyRunHistory();
+  if (!limited_job_.SetBasicLimits(basic_limits_)) {
+    result_.SetInternalError(L"Unable to set limits on job");
+    return false;
+  }
+  limited_job_.SetTeardownPolicy(settings_.teardown_policy);
+  if (!SetAffinity()) {
+    result_.SetInternalError(L"Unable to set affinity on job");
+    return false;
+  }
+
+  child_.SetWorkingDirectory(settings_.working_directory);
+  for (const auto& [name, value] : settings_.environment) {
+    child_.SetEnvironmentVariable(name, value);
+  }
+#if !defined(_WIN32)
+  if (settings_.display_pool) {
+    display_ = settings_.display_pool->Acquire();
+    if (!display_) {
+      result_.SetInternalError(L"Unable to lease display");
+      return false;
+    }
+    child_.SetEnvironmentVariable(L"DISPLAY", display_->GetName());
+  }
+#endif
+  child_.SetOutputLimits(ResolveOutputLimits(settings_));
+  child_.SetOutputPassthrough(settings_.output_passthrough);
+  child_.SetPipeBufferSize(settings_.pipe_buffer_size);
+  if (settings_.sampling_interval.count() > 0) {
+    sampler_.emplace(limited_job_, settings_.sampling_interval);
+    if (!sampler_->Start()) {
+      sampler_.reset();
+    }
+  }
+
+  start_time_ = std::chrono::steady_clock::now();
+  const auto pid = child_.Run(limited_job_, settings_.desktop_name);
+  if (!pid) {
+    result_.SetInternalError(L"Unable to run child process");
+    return false;
+  }
+  return true;
+}
+
+bool ChildRun::SetAffinity() {
+  system::Job::Affinity affinity = settings_.affinity;
+  if (settings_.core_reservation.cores > 0) {
+    if (const auto& topology = GetProcessorTopology()) {
+      cores_ = system::CoreReservation::Reserve(*topology, settings_.core_reservation);
+    }
+    if (cores_) {
+      affinity.processors = cores_->processors();
+      affinity.memory_nodes = {cores_->node()};
+    } else {
+      std::wclog << L"No free cores to reserve, running child unpinned\n";
+    }
+  }
+  if (affinity.processors.empty() && affinity.memory_nodes.empty()) {
+    return true;
+  }
+  if (!limited_job_.SetAffinity(affinity)) {
+    return false;
+  }
+  result_.SetAffinity(affinity);
+  return true;
+}
+
+void ChildRun::TearDownAsync(std::function<void()> on_done) {
+  limited_job_.TerminateAsync(
+      [this, on_done = std::move(on_done)](
+          const system::Job::TeardownTimes& teardown) {
+        teardown_ = teardown;
+        on_done();
+      });
+}
+
+int ChildRun::Finish(std::optional<int> exit_code) {
+  if (!exit_code) {
+    if (child_.IsAlive()) {
+      result_.ChildTimedOut();
+    }
+    if (!teardown_) {
+      teardown_ = limited_job_.Terminate();
+    }
+    result_.SetTeardown(*teardown_);
+    // Child is gone along with the rest of the job, unless teardown failed.
+    if (child_.IsAlive()) {
+      exit_code = teardown_->completed ? child_.Wait() : child_.Terminate();
+    }
+  }
+  const auto wall_time = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_time_);
+  const auto accounting = limited_job_.QueryAccounting();
+  result_.SetResourceUsage(wall_time, accounting);
+  result_.SetProcesses(limited_job_.GetProcessTable());
+  // Events job has posted by now are dispatched to the recorder.
+  system::Reactor::Get().WaitForDeferred();
+  memory_events_.Store(start_time_, result_);
+  if (sampler_) {
+    sampler_->Stop();
+    const std::filesystem::path samples_file =
+        std::filesystem::path(settings_.working_directory) /
+        settings_.sampling_directory / GenerateFileName("oven-samples-", ".csv");
+    if (sampler_->WriteCsv(samples_file)) {
+      result_.SetResourceSamplesFile(samples_file);
+    }
+  }
+
+  if (exit_code) {
+    result_.ChildExitCode(*exit_code);
+  }
+
+  system::ChildProcess::Outputs outputs = child_.TakeOutputs();
+  std::filesystem::path timeline_file;
+  if (!settings_.output_timeline_directory.empty()) {
+    timeline_file = std::filesystem::path(settings_.working_directory) /
+                    settings_.output_timeline_directory /
+                    GenerateFileName("oven-timeline-", ".txt");
+    std::ofstream timeline_stream(timeline_file, std::ios::binary);
+    outputs.timeline.Render(timeline_stream, outputs.stdoutput, outputs.stderror,
+                            settings_.output_gap_threshold);
+    if (!timeline_stream) {
+      timeline_file.clear();
+    }
+  }
+  result_.SetOutputTimeline(
+      outputs.timeline,
+      outputs.timeline.FindGaps(settings_.output_gap_threshold,
+                                std::chrono::steady_clock::now() - outputs.timeline.start_time()),
+      timeline_file);
+  result_.SetChildStderr(std::move(outputs.stderror));
+  result_.SetChildStdout(std::move(outputs.stdoutput));
+
+  // Result is stored the way it's written for a single child, batch writes
+  // its fields. Files it refers to may be gone by the time it's replayed,
+  // so results that have them aren't cached.
+  if (cache_key_ && result_.HasPassed() && !result_.HasSideFiles()) {
+    std::ostringstream document;
+    result_.WriteCacheEntry(document);
+    settings_.result_cache->Store(*cache_key_, document.str());
+  }
+  // Runs that failed may have ended early, they'd make limits too tight.
+  // Failure at derived limits is recorded still, so that the next run isn't
+  // held to them.
+  if (history_key_ && (result_.HasPassed() || derived_limits_)) {
+    RunHistory::Run run;
+    if (!result_.HasPassed()) {
+      run.failed_at_derived_limits = true;
+    } else {
+      run.wall_time = wall_time;
+      if (accounting) {
+        run.cpu_time = accounting->user_time + accounting->kernel_time;
+        run.peak_memory = accounting->peak_memory;
+      }
+    }
+    settings_.run_history->Record(*history_key_, run);
+  }
+  return 0;
+}
+
+// Runs all the shards of child at once and merges their results.
+int RunShards(const RunSettings& settings,
+              const std::wstring_view child_path,
+              const std::vector<std::wstring_view>& arguments,
+              ExecutionResult& result) {
+  const size_t shards = settings.shards;
+  std::vector<RunSettings> shard_settings(shards, settings);
+  std::vector<ExecutionResult> shard_results(shards);
+  std::vector<int> exit_codes(shards, 0);
+  std::mutex guard;
+  std::condition_variable shard_finished;
+  size_t shards_left = shards;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  {
+    // Pool is gone by the time results are merged, so are the runs.
+    base::WorkStealingPool pool;
+    for (size_t index = 0; index < shards; ++index) {
+      RunSettings& shard = shard_settings[index];
+      shard.shards = 1;
+      // Results of shards are merged from their outputs, which replayed
+      // ones don't have.
+      shard.result_cache = nullptr;
+      DivideLimits(shards, shard);
+      shard.environment.emplace_back(settings.shard_count_variable, std::to_wstring(shards));
+      shard.environment.emplace_back(settings.shard_index_variable, std::to_wstring(index));
+      StartChild(shard, child_path, arguments, shard_results[index], pool,
+                 [&, index](const int exit_code) {
+                   std::lock_guard lock(guard);
+                   exit_codes[index] = exit_code;
+                   if (--shards_left == 0) {
+                     shard_finished.notify_one();
+                   }
+                 });
+    }
+    std::unique_lock lock(guard);
+    shard_finished.wait(lock, [&]() { return shards_left == 0; });
+  }
+
+  result.MergeShards(std::move(shard_results), ResolveOutputLimits(settings));
+  result.SetResourceUsage(std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start_time),
+                          std::nullopt);
+  return *std::max_element(exit_codes.begin(), exit_codes.end());
+}
+}  // anonymous namespace
+
+ExecutionResult::AppliedLimit DeriveLimit(const char* name, std::vector<std::uint64_t> values,
+                                          const std::uint64_t configured,
+                                          const std::uint64_t minimum,
+                                          const RunHistory::AdaptiveLimits& adaptive) {
+  ExecutionResult::AppliedLimit limit;
+  limit.name = name;
+  limit.value = configured;
+  limit.history_runs = values.size();
+  if (IsUnlimited(configured) || values.size() < std::max<size_t>(1, adaptive.min_runs)) {
+    return limit;
+  }
+  limit.percentile_value = RunHistory::GetPercentile(std::move(values), adaptive.percentile);
+  const double derived = std::ceil(static_cast<double>(*limit.percentile_value) * adaptive.factor);
+  limit.from_history = true;
+  limit.clamped = derived >= static_cast<double>(configured);
+  limit.value = limit.clamped ? configured
+                              : std::min(configured, std::max(minimum, static_cast<std::uint64_t>(derived)));
+  return limit;
+}
+
+int RunChild(const RunSettings& settings,
+             const std::wstring_view child_path,
+             const std::vector<std::wstring_view>& arguments,
+             ExecutionResult& result) {
+  if (settings.shards > 1) {
+    return RunShards(settings, child_path, arguments, result);
+  }
+  ChildRun run(settings, child_path, arguments, result);
+  if (run.ReplayCachedResult()) {
+    return 0;
+  }
+  if (!run.Start()) {
+    return 1;
+  }
+  return run.Finish(run.child().Wait(run.child_timeout()));
+}
+
+void StartChild(const RunSettings& settings,
+                const std::wstring_view child_path,
+                const std::vector<std::wstring_view>& arguments,
+                ExecutionResult& result, base::WorkStealingPool& pool,
+                std::function<void(int exit_code)> on_finished) {
+  auto run = std::make_shared<ChildRun>(settings, child_path, arguments, result);
+  // Finishing right away would start the next child from this one's stack.
+  if (run->ReplayCachedResult()) {
+    pool.Post([on_finished = std::move(on_finished)]() { on_finished(0); });
+    return;
+  }
+  if (!run->Start()) {
+    // Neither is failure reported from this stack, and the run with its job
+    // is released before the next child may start.
+    run.reset();
+    pool.Post([on_finished = std::move(on_finished)]() { on_finished(1); });
+    return;
+  }
+  ChildRun* const child_run = run.get();
+  child_run->child().WaitAsync(
+      child_run->child_timeout(),
+      [run = std::move(run), &pool, on_finished = std::move(on_finished)](
+          const std::optional<int> exit_code) mutable {
+        // Reference of the run is handed over rather than copied, so that
+        // the pool holds the last one: destroying the run on reactor thread
+        // would wait for the reactor itself.
+        ChildRun* const child_run = run.get();
+        auto finish = [run = std::move(run), exit_code, &pool,
+                       on_finished = std::move(on_finished)]() mutable {
+          pool.Post([run = std::move(run), exit_code,
+                     on_finished = std::move(on_finished)]() {
+            on_finished(run->Finish(exit_code));
+          });
+        };
+        if (exit_code) {
+          finish();
+          return;
+        }
+        // Timed out job is torn down before the run gets to the pool.
+        child_run->TearDownAsync(std::move(finish));
+      });
+}
+
+}  // namespace oven
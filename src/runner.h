@@ -0,0 +1,110 @@
+#ifndef _OVEN_RUNNER_H_
+#define _OVEN_RUNNER_H_
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "base/output_capture.h"
+#include "base/work_stealing_pool.h"
+#include "execution_result.h"
+#include "result_cache.h"
+#include "run_history.h"
+#include "system/child_process.h"
+#include "system/job.h"
+#include "system/processor_topology.h"
+#if !defined(_WIN32)
+#include "system/display_pool.h"
+#endif
+
+namespace oven {
+
+// Settings shared by every child oven runs.
+struct RunSettings {
+  std::wstring desktop_name;
+#if !defined(_WIN32)
+  // Pool each child leases a display of its own from, children share the
+  // display of oven if there is none.
+  system::DisplayPool* display_pool = nullptr;
+#endif
+  std::chrono::milliseconds child_timeout;
+  system::Job::BasicLimits basic_limits;
+  // How job of a timed out child is torn down.
+  system::Job::TeardownPolicy teardown_policy;
+  // Processors children are pinned to, unless cores are reserved for them.
+  system::Job::Affinity affinity;
+  // Whole physical cores reserved for each child, none if their number is 0.
+  // Children that can't get free cores run unpinned.
+  system::CoreReservation::Options core_reservation;
+  // Limits of memory used to capture each of child output streams.
+  base::OutputCapture::Limits output_limits;
+  // Where child output streams are copied to live, besides being captured.
+  system::ChildProcess::Passthrough output_passthrough;
+  // Size of pipe buffers child output streams are written to, 0 for default.
+  size_t pipe_buffer_size = 0;
+  // Resource usage of child job is sampled at this interval, unless it's 0.
+  std::chrono::milliseconds sampling_interval{0};
+  // Directory sample files are stored in, relative to the working directory.
+  std::wstring sampling_directory;
+  // Gaps in child output longer than this are reported.
+  std::chrono::milliseconds output_gap_threshold{1000};
+  // Directory merged timelines of child outputs are rendered to, relative to
+  // the working directory. Timelines aren't rendered if it's empty.
+  std::wstring output_timeline_directory;
+  // Results of passed runs are looked up in and stored to the cache, unless
+  // it's null. Input files are relative to the working directory.
+  ResultCache* result_cache = nullptr;
+  ResultCache::Inputs cache_inputs;
+  // Resource usage of passed runs is recorded to the history, unless it's
+  // null. Timeout and limits of the next runs are derived from it if
+  // adaptive limits are enabled, the configured ones being their maximums.
+  RunHistory* run_history = nullptr;
+  RunHistory::AdaptiveLimits adaptive_limits;
+  // Child is split into this many shards running at once, each inside of
+  // its own job, unless it's 1. Shards learn their number and index from
+  // the variables named here, like gtest does.
+  size_t shards = 1;
+  std::wstring shard_count_variable = L"GTEST_TOTAL_SHARDS";
+  std::wstring shard_index_variable = L"GTEST_SHARD_INDEX";
+  // Variables set for children on top of the environment of oven.
+  std::vector<std::pair<std::wstring, std::wstring>> environment;
+  // Working directory of children and the one relative paths are resolved
+  // against. Empty to use the working directory of oven.
+  std::wstring working_directory;
+};
+
+// Returns limit named |name| derived from |values| of past runs, no lower
+// than |minimum| and no higher than the |configured| one. The configured one
+// applies while there are too few runs, and unlimited one stays so.
+ExecutionResult::AppliedLimit DeriveLimit(const char* name, std::vector<std::uint64_t> values,
+                                          const std::uint64_t configured,
+                                          const std::uint64_t minimum,
+                                          const RunHistory::AdaptiveLimits& adaptive);
+
+// Runs child inside of its own job limited according to |settings| and
+// stores the outcome in |result|. Job of a timed out child is torn down as a
+// whole. Returns exit code for |result|: 0 if child has run (whatever its
+// own exit code is), 1 on internal error. Child split into shards has them
+// all run to completion, limits of the job are divided between them.
+int RunChild(const RunSettings& settings,
+             const std::wstring_view child_path,
+             const std::vector<std::wstring_view>& arguments,
+             ExecutionResult& result);
+
+// Starts child like |RunChild| does, but returns right away: no thread waits
+// for the child while it runs. Once it exits (or times out) its outcome is
+// stored in |result| by a task posted to |pool|, which then calls
+// |on_finished| with exit code for |result|. |on_finished| is posted to
+// |pool| as well if child can't be started or its result is replayed.
+void StartChild(const RunSettings& settings,
+                const std::wstring_view child_path,
+                const std::vector<std::wstring_view>& arguments,
+                ExecutionResult& result, base::WorkStealingPool& pool,
+                std::function<void(int exit_code)> on_finished);
+
+}  // namespace oven
+
+#endif  // _OVEN_RUNNER_H_
@@ -0,0 +1,183 @@
+#include "runner.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace oven {
+namespace {
+RunSettings MakeSettings() {
+  RunSettings settings;
+  settings.child_timeout = std::chrono::milliseconds(10000);
+  settings.basic_limits.overall_memory_limit = std::numeric_limits<std::uint64_t>::max();
+  settings.basic_limits.per_process_memory_limit = std::numeric_limits<std::uint64_t>::max();
+  settings.basic_limits.cpu_time_limit = std::chrono::milliseconds::max();
+  return settings;
+}
+
+RunHistory::AdaptiveLimits MakeAdaptiveLimits() {
+  RunHistory::AdaptiveLimits adaptive;
+  adaptive.enabled = true;
+  adaptive.percentile = 50;
+  adaptive.factor = 2;
+  adaptive.min_runs = 3;
+  return adaptive;
+}
+
+TEST(DeriveLimitTest, AppliesConfiguredLimitUntilMinRuns) {
+  const ExecutionResult::AppliedLimit limit =
+      DeriveLimit("limit", {10, 20}, 1000, 1, MakeAdaptiveLimits());
+  EXPECT_EQ(limit.value, 1000u);
+  EXPECT_FALSE(limit.from_history);
+  EXPECT_EQ(limit.history_runs, 2u);
+  EXPECT_FALSE(limit.percentile_value);
+}
+
+TEST(DeriveLimitTest, MultipliesPercentileByFactor) {
+  const ExecutionResult::AppliedLimit limit =
+      DeriveLimit("limit", {30, 10, 20}, 1000, 1, MakeAdaptiveLimits());
+  EXPECT_EQ(limit.value, 40u);
+  EXPECT_TRUE(limit.from_history);
+  EXPECT_FALSE(limit.clamped);
+  EXPECT_EQ(limit.history_runs, 3u);
+  EXPECT_EQ(limit.percentile_value, 20u);
+}
+
+TEST(DeriveLimitTest, ClampsToConfiguredLimit) {
+  const ExecutionResult::AppliedLimit limit =
+      DeriveLimit("limit", {600, 600, 600}, 1000, 1, MakeAdaptiveLimits());
+  EXPECT_EQ(limit.value, 1000u);
+  EXPECT_TRUE(limit.from_history);
+  EXPECT_TRUE(limit.clamped);
+}
+
+TEST(DeriveLimitTest, KeepsMinimum) {
+  const ExecutionResult::AppliedLimit limit =
+      DeriveLimit("limit", {1, 1, 1}, 1000, 100, MakeAdaptiveLimits());
+  EXPECT_EQ(limit.value, 100u);
+  EXPECT_TRUE(limit.from_history);
+  EXPECT_FALSE(limit.clamped);
+}
+
+TEST(DeriveLimitTest, KeepsUnlimitedLimit) {
+  const std::uint64_t unlimited = std::numeric_limits<std::uint64_t>::max();
+  const ExecutionResult::AppliedLimit limit =
+      DeriveLimit("limit", {10, 10, 10}, unlimited, 1, MakeAdaptiveLimits());
+  EXPECT_EQ(limit.value, unlimited);
+  EXPECT_FALSE(limit.from_history);
+}
+
+#if !defined(_WIN32)
+// Child timed out at the timeout derived from its faster runs, the next
+// one gets the configured one and its time is what the following are
+// derived from.
+TEST(RunChildTest, RecoversFromFailureAtDerivedLimits) {
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path() /
+      ("oven-history-" +
+       std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+  RunHistory::Options options;
+  options.directory = directory;
+  RunHistory history(options);
+  RunSettings settings = MakeSettings();
+  settings.run_history = &history;
+  settings.adaptive_limits = MakeAdaptiveLimits();
+  settings.adaptive_limits.min_timeout = std::chrono::milliseconds(1);
+  const std::vector<std::wstring_view> arguments = {L"0.3"};
+  const std::uint64_t key = RunHistory::ComputeKey(L"/bin/sleep 0.3", {});
+  for (int run = 0; run < 3; ++run) {
+    RunHistory::Run fast_run;
+    fast_run.wall_time = std::chrono::milliseconds(10);
+    history.Record(key, fast_run);
+  }
+
+  ExecutionResult timed_out;
+  ASSERT_EQ(RunChild(settings, L"/bin/sleep", arguments, timed_out), 0);
+  EXPECT_FALSE(timed_out.HasPassed());
+  ASSERT_EQ(history.Read(key).size(), 4u);
+  EXPECT_TRUE(history.Read(key).back().failed_at_derived_limits);
+
+  ExecutionResult passed;
+  ASSERT_EQ(RunChild(settings, L"/bin/sleep", arguments, passed), 0);
+  EXPECT_TRUE(passed.HasPassed());
+  std::vector<RunHistory::Run> runs = history.Read(key);
+  ASSERT_EQ(runs.size(), 5u);
+  EXPECT_FALSE(runs.back().failed_at_derived_limits);
+  EXPECT_GE(runs.back().wall_time, std::chrono::milliseconds(300));
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+}
+
+size_t CountOpenFiles() {
+  return static_cast<size_t>(std::distance(
+      std::filesystem::directory_iterator("/proc/self/fd"),
+      std::filesystem::directory_iterator()));
+}
+#endif
+
+// Children are started one after another, each finished one starting the
+// next in its place, like manifest runs them with a single parallel run.
+TEST(StartChildTest, RunsManyUnstartableChildrenInSequence) {
+  const size_t kChildren = 500;
+  const RunSettings settings = MakeSettings();
+  const std::wstring child_path = L"/nonexistent/oven-child";
+  std::vector<ExecutionResult> results(kChildren);
+  std::mutex guard;
+  std::condition_variable child_finished;
+  size_t children_left = kChildren;
+  size_t next_child = 0;
+  std::atomic_int depth = 0;
+  std::atomic_int max_depth = 0;
+  std::vector<int> exit_codes(kChildren, -1);
+#if !defined(_WIN32)
+  size_t max_open_files = 0;
+#endif
+
+  base::WorkStealingPool pool;
+  std::function<void()> start_next_child = [&]() {
+    const size_t index = next_child++;
+    if (index == kChildren) {
+      return;
+    }
+    StartChild(settings, child_path, {}, results[index], pool,
+               [&, index](const int exit_code) {
+                 const int current_depth = ++depth;
+                 max_depth = std::max(max_depth.load(), current_depth);
+                 exit_codes[index] = exit_code;
+#if !defined(_WIN32)
+                 max_open_files = std::max(max_open_files, CountOpenFiles());
+#endif
+                 start_next_child();
+                 --depth;
+                 std::lock_guard lock(guard);
+                 if (--children_left == 0) {
+                   child_finished.notify_one();
+                 }
+               });
+  };
+  pool.Post(start_next_child);
+  {
+    std::unique_lock lock(guard);
+    child_finished.wait(lock, [&]() { return children_left == 0; });
+  }
+
+  // Finishing child doesn't start the next one from its own stack, which
+  // would hold every failed run until the last one.
+  EXPECT_EQ(max_depth, 1);
+  EXPECT_TRUE(std::all_of(exit_codes.begin(), exit_codes.end(),
+                          [](const int exit_code) { return exit_code == 1; }));
+#if !defined(_WIN32)
+  EXPECT_LT(max_open_files, 256u);
+#endif
+}
+}  // anonymous namespace
+}  // namespace oven
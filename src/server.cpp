@@ -0,0 +1,180 @@
+#include "server.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "base/command_line.h"
+#include "base/string_conversion.h"
+#include "base/work_stealing_pool.h"
+#include "system/error.h"
+#include "system/local_socket.h"
+
+namespace oven {
+namespace {
+// Request is not expected to be anywhere near that, it only protects server
+// from allocating whatever a broken client asks for.
+const std::uint64_t kMaxRequestSize = 16 * 1024 * 1024;
+
+bool SendString(system::LocalConnection& connection, const std::string_view value) {
+  const std::uint64_t size = value.size();
+  return connection.Send(&size, sizeof(size)) &&
+         connection.Send(value.data(), value.size());
+}
+
+bool ReceiveString(system::LocalConnection& connection, std::string* value,
+                   const std::uint64_t max_size) {
+  std::uint64_t size;
+  if (!connection.Receive(&size, sizeof(size)) || size > max_size) {
+    return false;
+  }
+  value->resize(static_cast<size_t>(size));
+  return connection.Receive(value->data(), value->size());
+}
+
+// Request: working directory, number of arguments, arguments.
+// Response: exit code, result document.
+void HandleConnection(system::LocalConnection& connection,
+                      const RequestHandler& handler) {
+  std::string working_directory;
+  std::uint32_t number_of_arguments;
+  if (!ReceiveString(connection, &working_directory, kMaxRequestSize) ||
+      !connection.Receive(&number_of_arguments, sizeof(number_of_arguments)) ||
+      number_of_arguments == 0 ||
+      number_of_arguments > base::CommandLine::kMaxNumberOfArguments) {
+    system::OutputError(L"Unable to receive request");
+    return;
+  }
+  std::vector<std::wstring> arguments;
+  arguments.reserve(number_of_arguments);
+  std::string argument;
+  for (std::uint32_t index = 0; index < number_of_arguments; ++index) {
+    if (!ReceiveString(connection, &argument, kMaxRequestSize)) {
+      system::OutputError(L"Unable to receive request");
+      return;
+    }
+    arguments.push_back(base::Utf8ToWide(argument));
+  }
+
+  std::ostringstream result_stream;
+  const std::int32_t exit_code = handler(
+      arguments, base::Utf8ToWide(working_directory), result_stream);
+  if (!connection.Send(&exit_code, sizeof(exit_code)) ||
+      !SendString(connection, result_stream.str())) {
+    system::OutputError(L"Unable to send response");
+  }
+}
+
+#if defined(_WIN32)
+const system::LocalServer* running_server = nullptr;
+
+BOOL WINAPI StopServer(DWORD /* control_type */) {
+  running_server->Stop();
+  return TRUE;
+}
+#endif
+
+// Stops |server| once termination is requested.
+class TerminationWatcher {
+ public:
+  explicit TerminationWatcher(const system::LocalServer& server) {
+#if defined(_WIN32)
+    running_server = &server;
+    ::SetConsoleCtrlHandler(StopServer, TRUE);
+#else
+    // Signals are blocked before any other thread is started, so that all the
+    // threads inherit the mask and only the watcher receives them.
+    sigemptyset(&signals_);
+    sigaddset(&signals_, SIGINT);
+    sigaddset(&signals_, SIGTERM);
+    sigaddset(&signals_, SIGHUP);
+    ::pthread_sigmask(SIG_BLOCK, &signals_, nullptr);
+    thread_ = std::thread([this, &server]() {
+      int signal;
+      ::sigwait(&signals_, &signal);
+      server.Stop();
+    });
+#endif
+  }
+
+  ~TerminationWatcher() {
+#if defined(_WIN32)
+    ::SetConsoleCtrlHandler(StopServer, FALSE);
+    running_server = nullptr;
+#else
+    // Wake the watcher up if server has stopped on its own. Signals stay
+    // blocked, as the process is about to exit anyway.
+    ::pthread_kill(thread_.native_handle(), SIGTERM);
+    thread_.join();
+#endif
+  }
+
+ private:
+#if !defined(_WIN32)
+  sigset_t signals_;
+  std::thread thread_;
+#endif
+};
+}  // anonymous namespace
+
+bool Serve(const std::wstring_view name, const size_t number_of_workers,
+           const RequestHandler& handler) {
+  system::LocalServer server(name);
+  if (!server.IsValid()) {
+    return false;
+  }
+  TerminationWatcher termination_watcher(server);
+  base::WorkStealingPool pool(number_of_workers);
+  while (auto connection = server.Accept()) {
+    // Pool tasks have to be copyable.
+    pool.Post([&handler, connection = std::make_shared<system::LocalConnection>(
+                             std::move(*connection))]() {
+      HandleConnection(*connection, handler);
+    });
+  }
+  pool.Wait();
+  return true;
+}
+
+std::optional<int> SendRequest(const std::wstring_view name,
+                               const std::vector<std::wstring_view>& arguments,
+                               std::string* result_document) {
+  auto connection = system::LocalConnection::Connect(name);
+  if (!connection) {
+    return std::optional<int>();
+  }
+
+  std::error_code error;
+  const std::filesystem::path working_directory = std::filesystem::current_path(error);
+  const std::uint32_t number_of_arguments = static_cast<std::uint32_t>(arguments.size());
+  if (error ||
+      !SendString(*connection, base::WideToUtf8(working_directory.wstring())) ||
+      !connection->Send(&number_of_arguments, sizeof(number_of_arguments))) {
+    return std::optional<int>();
+  }
+  for (const std::wstring_view argument : arguments) {
+    if (!SendString(*connection, base::WideToUtf8(argument))) {
+      return std::optional<int>();
+    }
+  }
+
+  std::int32_t exit_code;
+  if (!connection->Receive(&exit_code, sizeof(exit_code)) ||
+      !ReceiveString(*connection, result_document,
+                     std::numeric_limits<std::uint64_t>::max())) {
+    return std::optional<int>();
+  }
+  return exit_code;
+}
+
+}  // namespace oven
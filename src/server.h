@@ -0,0 +1,36 @@
+#ifndef _OVEN_SERVER_H_
+#define _OVEN_SERVER_H_
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace oven {
+
+// Server mode keeps oven process and its virtual desktop alive between runs.
+// Clients send command line arguments they were started with along with
+// their working directory, server runs the child and replies with exit code
+// and the result document (UTF-8 encoded json).
+using RequestHandler = std::function<int(
+    const std::vector<std::wstring>& arguments,
+    const std::wstring& working_directory, std::ostream& result_stream)>;
+
+// Serves requests on |number_of_workers| threads until termination is
+// requested (SIGINT/SIGTERM or Ctrl+C), waiting for the running ones to
+// complete. Returns false if server can't be started.
+bool Serve(const std::wstring_view name, const size_t number_of_workers,
+           const RequestHandler& handler);
+
+// Sends request to the server and stores the result document (UTF-8 encoded)
+// in |result_document|. Returns exit code on success.
+std::optional<int> SendRequest(const std::wstring_view name,
+                               const std::vector<std::wstring_view>& arguments,
+                               std::string* result_document);
+
+}  // namespace oven
+
+#endif  // _OVEN_SERVER_H_
@@ -0,0 +1,329 @@
+#include "system/cgroup.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "system/error.h"
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+namespace {
+const char kCgroupRootVariable[] = "OVEN_CGROUP_ROOT";
+// Job cgroups are named "oven-<pid>-<index>" after the process creating them.
+const char kCgroupPrefix[] = "oven-";
+// Controllers job cgroups make use of, if parent cgroup provides them.
+const char* const kControllers[] = {"cpu", "cpuset", "io", "memory", "pids"};
+
+std::optional<std::filesystem::path> FindCgroup2Mount() {
+  // Format: <id> <parent> <major:minor> <root> <mount point> <options> ... - <type> ...
+  std::ifstream mount_info("/proc/self/mountinfo");
+  std::string line;
+  while (std::getline(mount_info, line)) {
+    const size_t separator = line.find(" - ");
+    if (separator == line.npos ||
+        line.compare(separator + 3, 8, "cgroup2 ") != 0) {
+      continue;
+    }
+    std::istringstream fields(line.substr(0, separator));
+    std::string field;
+    for (int index = 0; index < 5 && fields >> field; ++index) {
+    }
+    return std::filesystem::path(field);
+  }
+  return std::optional<std::filesystem::path>();
+}
+
+std::optional<std::filesystem::path> GetCurrentCgroup() {
+  const auto mount = FindCgroup2Mount();
+  if (!mount) {
+    return std::optional<std::filesystem::path>();
+  }
+  // cgroup v2 hierarchy is reported as "0::<path>".
+  std::ifstream cgroup("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(cgroup, line)) {
+    if (line.compare(0, 3, "0::") == 0) {
+      return *mount / std::filesystem::path(line.substr(3)).relative_path();
+    }
+  }
+  return std::optional<std::filesystem::path>();
+}
+
+// Returns process that has created job cgroup named |name|, nothing if it's
+// not a job cgroup.
+std::optional<pid_t> GetCgroupOwner(const std::string& name) {
+  const size_t prefix_size = sizeof(kCgroupPrefix) - 1;
+  const size_t separator = name.find('-', prefix_size);
+  if (name.compare(0, prefix_size, kCgroupPrefix) != 0 || separator == name.npos ||
+      separator == prefix_size || separator + 1 == name.size() ||
+      name.find_first_not_of("0123456789", prefix_size) != separator ||
+      name.find_first_not_of("0123456789", separator + 1) != name.npos) {
+    return std::optional<pid_t>();
+  }
+  return static_cast<pid_t>(std::strtol(name.c_str() + prefix_size, nullptr, 10));
+}
+
+std::optional<std::filesystem::path> GetJobsRoot() {
+  if (const char* root = std::getenv(kCgroupRootVariable); root && *root) {
+    return std::filesystem::path(root);
+  }
+  return GetCurrentCgroup();
+}
+
+bool WriteFile(const std::filesystem::path& path, const std::string_view value) {
+  ScopedHandle file(::open(path.c_str(), O_WRONLY | O_CLOEXEC));
+  if (!file) {
+    return false;
+  }
+  return ::write(file.get(), value.data(), value.size()) ==
+         static_cast<ssize_t>(value.size());
+}
+
+std::optional<std::string> ReadFile(const std::filesystem::path& path) {
+  ScopedHandle file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (!file) {
+    return std::optional<std::string>();
+  }
+  std::string contents;
+  char buffer[4096];
+  ssize_t bytes_read;
+  while ((bytes_read = ::read(file.get(), buffer, sizeof(buffer))) > 0) {
+    contents.append(buffer, static_cast<size_t>(bytes_read));
+  }
+  if (bytes_read < 0) {
+    return std::optional<std::string>();
+  }
+  return contents;
+}
+
+// Controllers can only be enabled for children of a cgroup that has no
+// processes of its own, unless it's the root of the hierarchy. Jobs root is
+// expected to be delegated to oven for that: oven doesn't move processes out
+// of it, and job cgroups are created without controllers if it has any.
+void EnableControllers(const std::filesystem::path& root) {
+  // Every root is tried once, however it goes.
+  static std::mutex guard;
+  static std::set<std::filesystem::path> tried_roots;
+  std::lock_guard<std::mutex> lock(guard);
+  if (!tried_roots.insert(root).second) {
+    return;
+  }
+  const auto available = ReadFile(root / "cgroup.controllers");
+  if (!available) {
+    return;
+  }
+  std::string enable;
+  for (const char* controller : kControllers) {
+    std::istringstream names(*available);
+    std::string name;
+    while (names >> name) {
+      if (name == controller) {
+        enable += std::string(enable.empty() ? "+" : " +") + controller;
+        break;
+      }
+    }
+  }
+  if (enable.empty() || WriteFile(root / "cgroup.subtree_control", enable)) {
+    return;
+  }
+  if (errno == EBUSY) {
+    OutputError(L"Unable to enable controllers for job cgroups, jobs root has "
+                L"processes of its own (set OVEN_CGROUP_ROOT to an empty "
+                L"delegated cgroup), limits relying on them are unavailable");
+    return;
+  }
+  OutputError(L"Unable to enable controllers for job cgroups");
+}
+}  // anonymous namespace
+
+// static
+std::optional<Cgroup> Cgroup::Create() {
+  static std::atomic_uint next_cgroup_index = 0;
+
+  const auto root = GetJobsRoot();
+  if (!root) {
+    return std::optional<Cgroup>();
+  }
+  EnableControllers(*root);
+  RemoveStale(*root);
+
+  std::filesystem::path path =
+      *root / (kCgroupPrefix + std::to_string(::getpid()) + "-" +
+               std::to_string(next_cgroup_index++));
+  if (::mkdir(path.c_str(), 0755) != 0) {
+    return std::optional<Cgroup>();
+  }
+  ScopedHandle directory(::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (!directory) {
+    ::rmdir(path.c_str());
+    return std::optional<Cgroup>();
+  }
+  return Cgroup(std::move(path), std::move(directory));
+}
+
+Cgroup::Cgroup(std::filesystem::path path, ScopedHandle directory)
+    : path_(std::move(path)), directory_(std::move(directory)) {}
+
+// static
+void Cgroup::RemoveStale(const std::filesystem::path& root) {
+  static std::mutex guard;
+  static std::set<std::filesystem::path> swept_roots;
+  {
+    std::lock_guard<std::mutex> lock(guard);
+    if (!swept_roots.insert(root).second) {
+      return;
+    }
+  }
+  // Oven killed before it could remove its cgroups leaves them behind,
+  // possibly with processes inside. Process that exists under the owner's
+  // id, even if it's another one by now, keeps them in place.
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(root, error)) {
+    const auto owner = GetCgroupOwner(entry.path().filename().string());
+    if (!owner || *owner == ::getpid() || ::kill(*owner, 0) == 0 || errno != ESRCH) {
+      continue;
+    }
+    ScopedHandle directory(
+        ::open(entry.path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (directory) {
+      // Processes are killed and cgroup is removed once it goes.
+      const Cgroup stale(entry.path(), std::move(directory));
+    }
+  }
+}
+
+Cgroup::~Cgroup() {
+  Release();
+}
+
+Cgroup::Cgroup(Cgroup&& other) noexcept
+    : path_(std::move(other.path_)), directory_(std::move(other.directory_)) {
+  other.path_.clear();
+}
+
+Cgroup& Cgroup::operator=(Cgroup&& other) noexcept {
+  Release();
+  path_ = std::move(other.path_);
+  directory_ = std::move(other.directory_);
+  other.path_.clear();
+  return *this;
+}
+
+bool Cgroup::HasFile(const std::string_view file) const {
+  return ::access((path_ / file).c_str(), F_OK) == 0;
+}
+
+bool Cgroup::Write(const std::string_view file, const std::string_view value) const {
+  return WriteFile(path_ / file, value);
+}
+
+std::optional<std::string> Cgroup::Read(const std::string_view file) const {
+  return ReadFile(path_ / file);
+}
+
+std::optional<std::uint64_t> Cgroup::ReadValue(const std::string_view file,
+                                               const std::string_view key) const {
+  const auto contents = Read(file);
+  if (!contents) {
+    return std::optional<std::uint64_t>();
+  }
+  std::istringstream lines(*contents);
+  std::string name;
+  std::uint64_t value;
+  while (lines >> name >> value) {
+    if (name == key) {
+      return value;
+    }
+  }
+  return std::optional<std::uint64_t>();
+}
+
+bool Cgroup::AddProcess(const pid_t process_id) const {
+  return Write("cgroup.procs", std::to_string(process_id));
+}
+
+bool Cgroup::IsPopulated() const {
+  return ReadValue("cgroup.events", "populated").value_or(0) != 0;
+}
+
+bool Cgroup::Kill() const {
+  if (HasFile("cgroup.kill")) {
+    return Write("cgroup.kill", "1");
+  }
+
+  // Kernels before 5.14 have no cgroup.kill: freeze the cgroup so nothing
+  // forks while its processes are being killed one by one.
+  const bool frozen = Write("cgroup.freeze", "1");
+  bool success = true;
+  if (const auto processes = Read("cgroup.procs")) {
+    std::istringstream process_ids(*processes);
+    pid_t process_id;
+    while (process_ids >> process_id) {
+      success = ::kill(process_id, SIGKILL) == 0 && success;
+    }
+  }
+  if (frozen) {
+    Write("cgroup.freeze", "0");
+  }
+  return success;
+}
+
+bool Cgroup::WaitUntilEmpty(const std::chrono::milliseconds timeout) const {
+  ScopedHandle events(::inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+  if (!events ||
+      ::inotify_add_watch(events.get(), (path_ / "cgroup.events").c_str(),
+                          IN_MODIFY) < 0) {
+    return false;
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (IsPopulated()) {
+    const auto time_left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (time_left.count() <= 0) {
+      return false;
+    }
+    pollfd event = {events.get(), POLLIN, 0};
+    if (::poll(&event, 1, static_cast<int>(time_left.count())) < 0 &&
+        errno != EINTR) {
+      return false;
+    }
+    char buffer[4096];
+    while (::read(events.get(), buffer, sizeof(buffer)) > 0) {
+    }
+  }
+  return true;
+}
+
+void Cgroup::Release() noexcept {
+  if (path_.empty()) {
+    return;
+  }
+  if (IsPopulated() &&
+      (!Kill() || !WaitUntilEmpty(std::chrono::seconds(10)))) {
+    OutputError(L"Unable to kill processes left in job cgroup");
+  }
+  directory_.reset();
+  // Stale cgroup may be removed by another oven process at the same time.
+  if (::rmdir(path_.c_str()) != 0 && errno != ENOENT) {
+    OutputError(L"Unable to remove job cgroup");
+  }
+  path_.clear();
+}
+
+}  // namespace system
+}  // namespace oven
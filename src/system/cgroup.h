@@ -0,0 +1,81 @@
+#ifndef _OVEN_SYSTEM_CGROUP_H_
+#define _OVEN_SYSTEM_CGROUP_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+
+// Manages a cgroup v2 directory created for a single job. Destroying the
+// cgroup kills all the processes left inside of it.
+class Cgroup {
+ public:
+  // Creates a new cgroup inside of the jobs root, which is either a directory
+  // specified by OVEN_CGROUP_ROOT environment variable (usually delegated to
+  // the current user, e.g. via `systemd-run --user -p Delegate=yes`), or the
+  // cgroup of the current process otherwise. Controllers are only enabled
+  // for the new cgroup if the root has no processes of its own. Cgroups
+  // left in the root by oven processes that are gone are removed first,
+  // along with processes inside of them.
+  static std::optional<Cgroup> Create();
+  ~Cgroup();
+
+  Cgroup(const Cgroup&) = delete;
+  Cgroup(Cgroup&& other) noexcept;
+
+  Cgroup& operator=(const Cgroup&) = delete;
+  Cgroup& operator=(Cgroup&& other) noexcept;
+
+  const std::filesystem::path& path() const noexcept { return path_; }
+
+  // Descriptor of cgroup directory, suitable for CLONE_INTO_CGROUP.
+  NativeHandle handle() const noexcept { return directory_.get(); }
+
+  // Returns true if cgroup has an interface |file|, i.e. corresponding
+  // controller is enabled.
+  bool HasFile(const std::string_view file) const;
+
+  bool Write(const std::string_view file, const std::string_view value) const;
+  std::optional<std::string> Read(const std::string_view file) const;
+
+  // Reads |key| from a flat keyed file like cpu.stat or memory.events.
+  std::optional<std::uint64_t> ReadValue(const std::string_view file,
+                                         const std::string_view key) const;
+
+  bool AddProcess(const pid_t process_id) const;
+
+  // Returns true if there are live processes in the cgroup or its descendants.
+  bool IsPopulated() const;
+
+  // Kills all processes in the cgroup.
+  bool Kill() const;
+
+  // Waits until all processes in the cgroup exit, returns true on success.
+  bool WaitUntilEmpty(const std::chrono::milliseconds timeout) const;
+
+ private:
+  Cgroup(std::filesystem::path path, ScopedHandle directory);
+
+  // Removes job cgroups of oven processes that are gone from |root|, once
+  // per root.
+  static void RemoveStale(const std::filesystem::path& root);
+
+  void Release() noexcept;
+
+  std::filesystem::path path_;
+  ScopedHandle directory_;
+};
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_CGROUP_H_
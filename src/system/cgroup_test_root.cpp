@@ -0,0 +1,122 @@
+#include "system/cgroup_test_root.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+namespace oven {
+namespace system {
+namespace {
+const char kCgroupRootVariable[] = "OVEN_CGROUP_ROOT";
+
+std::optional<std::filesystem::path>& GetRootStorage() {
+  static std::optional<std::filesystem::path> root;
+  return root;
+}
+
+std::optional<std::filesystem::path> FindCgroup2Mount() {
+  std::ifstream mount_info("/proc/self/mountinfo");
+  std::string line;
+  while (std::getline(mount_info, line)) {
+    const size_t separator = line.find(" - ");
+    if (separator == line.npos || line.compare(separator + 3, 8, "cgroup2 ") != 0) {
+      continue;
+    }
+    std::istringstream fields(line.substr(0, separator));
+    std::string field;
+    for (int index = 0; index < 5 && fields >> field; ++index) {
+    }
+    return std::filesystem::path(field);
+  }
+  return std::optional<std::filesystem::path>();
+}
+
+// Finds the nearest cgroup the process may create cgroups in and move
+// processes to.
+std::optional<std::filesystem::path> FindWritableCgroup() {
+  const auto mount = FindCgroup2Mount();
+  std::ifstream cgroups("/proc/self/cgroup");
+  std::string line;
+  while (mount && std::getline(cgroups, line)) {
+    if (line.compare(0, 3, "0::") != 0) {
+      continue;
+    }
+    std::filesystem::path cgroup = *mount / std::filesystem::path(line.substr(3)).relative_path();
+    for (;; cgroup = cgroup.parent_path()) {
+      if (::access(cgroup.c_str(), W_OK) == 0 &&
+          ::access((cgroup / "cgroup.procs").c_str(), W_OK) == 0) {
+        return cgroup;
+      }
+      if (cgroup == *mount) {
+        break;
+      }
+    }
+  }
+  return std::optional<std::filesystem::path>();
+}
+
+class CgroupRootEnvironment : public testing::Environment {
+ public:
+  void SetUp() override {
+    if (const char* root = std::getenv(kCgroupRootVariable); root && *root) {
+      GetRootStorage() = std::filesystem::path(root);
+      return;
+    }
+    const auto parent = FindWritableCgroup();
+    if (!parent) {
+      return;
+    }
+    const std::filesystem::path root =
+        *parent / ("oven-tests-" + std::to_string(::getpid()));
+    std::error_code error;
+    if (!std::filesystem::create_directory(root, error)) {
+      return;
+    }
+    created_root_ = root;
+    GetRootStorage() = root;
+    ::setenv(kCgroupRootVariable, root.c_str(), 1);
+  }
+
+  void TearDown() override {
+    if (created_root_) {
+      // Job cgroups are removed by jobs, so the root is empty by now.
+      std::error_code error;
+      std::filesystem::remove(*created_root_, error);
+      ::unsetenv(kCgroupRootVariable);
+    }
+  }
+
+ private:
+  std::optional<std::filesystem::path> created_root_;
+};
+
+testing::Environment* const environment =
+    testing::AddGlobalTestEnvironment(new CgroupRootEnvironment());
+}  // anonymous namespace
+
+const std::optional<std::filesystem::path>& GetTestJobsRoot() {
+  return GetRootStorage();
+}
+
+bool HasTestController(const std::string_view controller) {
+  const auto& root = GetTestJobsRoot();
+  if (!root) {
+    return false;
+  }
+  std::ifstream controllers(*root / "cgroup.controllers");
+  std::string name;
+  while (controllers >> name) {
+    if (name == controller) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace system
+}  // namespace oven
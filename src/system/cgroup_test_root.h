@@ -0,0 +1,29 @@
+#ifndef _OVEN_SYSTEM_CGROUP_TEST_ROOT_H_
+#define _OVEN_SYSTEM_CGROUP_TEST_ROOT_H_
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace oven {
+namespace system {
+
+// Jobs root unit tests create job cgroups in, set as OVEN_CGROUP_ROOT for the
+// whole test process. Unless OVEN_CGROUP_ROOT is set already, it's an empty
+// cgroup created for the test process inside of the nearest cgroup (of the
+// process or its ancestors) the process may write to: its own one when
+// running as root, or the one of its user service delegated by systemd, e.g.
+// through `systemd-run --user --scope -p Delegate=yes`. Created root is
+// removed once the tests are done.
+//
+// Empty if there is no cgroup the tests may create jobs in, tests that need
+// one are skipped then.
+const std::optional<std::filesystem::path>& GetTestJobsRoot();
+
+// Returns true if jobs root delegates |controller| to job cgroups.
+bool HasTestController(const std::string_view controller);
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_CGROUP_TEST_ROOT_H_
@@ -0,0 +1,148 @@
+#include "system/cgroup.h"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "system/cgroup_test_root.h"
+
+namespace oven {
+namespace system {
+namespace {
+std::string ReadProcessCgroup(const pid_t process_id) {
+  std::ifstream file("/proc/" + std::to_string(process_id) + "/cgroup");
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+class CgroupTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!GetTestJobsRoot()) {
+      GTEST_SKIP() << "No cgroup to create jobs in, run as root or set "
+                      "OVEN_CGROUP_ROOT to a delegated one, e.g. through "
+                      "`systemd-run --user --scope -p Delegate=yes`";
+    }
+  }
+};
+
+TEST_F(CgroupTest, CreatesCgroupInsideOfJobsRoot) {
+  const std::string own_cgroup = ReadProcessCgroup(::getpid());
+  std::filesystem::path path;
+  {
+    const auto cgroup = Cgroup::Create();
+    ASSERT_TRUE(cgroup);
+    path = cgroup->path();
+    EXPECT_EQ(path.parent_path(), *GetTestJobsRoot());
+    EXPECT_TRUE(std::filesystem::is_directory(path));
+    EXPECT_FALSE(cgroup->IsPopulated());
+  }
+  EXPECT_FALSE(std::filesystem::exists(path));
+  // Enabling controllers must not move the process anywhere.
+  EXPECT_EQ(ReadProcessCgroup(::getpid()), own_cgroup);
+}
+
+TEST_F(CgroupTest, LeavesProcessesOfBusyRootInPlace) {
+  const std::filesystem::path busy_root = *GetTestJobsRoot() / "busy";
+  ASSERT_TRUE(std::filesystem::create_directory(busy_root));
+  const pid_t sleeper = ::fork();
+  ASSERT_GE(sleeper, 0);
+  if (sleeper == 0) {
+    ::pause();
+    ::_exit(0);
+  }
+  std::ofstream(busy_root / "cgroup.procs") << sleeper;
+  const std::string own_cgroup = ReadProcessCgroup(::getpid());
+  const std::string sleeper_cgroup = ReadProcessCgroup(sleeper);
+  EXPECT_NE(sleeper_cgroup.find("/busy"), std::string::npos);
+
+  ::setenv("OVEN_CGROUP_ROOT", busy_root.c_str(), 1);
+  {
+    // Controllers can't be enabled for children of busy root, cgroup is
+    // created without them instead.
+    const auto cgroup = Cgroup::Create();
+    ASSERT_TRUE(cgroup);
+    EXPECT_EQ(cgroup->path().parent_path(), busy_root);
+    EXPECT_FALSE(cgroup->HasFile("memory.max"));
+    EXPECT_FALSE(cgroup->HasFile("pids.max"));
+  }
+  ::setenv("OVEN_CGROUP_ROOT", GetTestJobsRoot()->c_str(), 1);
+
+  EXPECT_EQ(ReadProcessCgroup(sleeper), sleeper_cgroup);
+  EXPECT_EQ(ReadProcessCgroup(::getpid()), own_cgroup);
+  ::kill(sleeper, SIGKILL);
+  ::waitpid(sleeper, nullptr, 0);
+  EXPECT_TRUE(std::filesystem::remove(busy_root));
+}
+
+TEST_F(CgroupTest, KillsProcessesLeftInside) {
+  const auto cgroup = Cgroup::Create();
+  ASSERT_TRUE(cgroup);
+  const pid_t sleeper = ::fork();
+  ASSERT_GE(sleeper, 0);
+  if (sleeper == 0) {
+    ::pause();
+    ::_exit(0);
+  }
+  ASSERT_TRUE(cgroup->AddProcess(sleeper));
+  EXPECT_TRUE(cgroup->IsPopulated());
+  EXPECT_TRUE(cgroup->Kill());
+  int status = 0;
+  ASSERT_EQ(::waitpid(sleeper, &status, 0), sleeper);
+  EXPECT_TRUE(WIFSIGNALED(status));
+  EXPECT_TRUE(cgroup->WaitUntilEmpty(std::chrono::seconds(5)));
+}
+
+// Cgroups of oven processes that are gone are removed, the rest of the root
+// stays as it is.
+TEST_F(CgroupTest, RemovesStaleCgroups) {
+  const std::filesystem::path root = *GetTestJobsRoot() / "stale";
+  ASSERT_TRUE(std::filesystem::create_directory(root));
+  const pid_t gone = ::fork();
+  ASSERT_GE(gone, 0);
+  if (gone == 0) {
+    ::_exit(0);
+  }
+  ASSERT_EQ(::waitpid(gone, nullptr, 0), gone);
+  const std::filesystem::path stale = root / ("oven-" + std::to_string(gone) + "-0");
+  const std::filesystem::path own = root / ("oven-" + std::to_string(::getpid()) + "-100");
+  const std::filesystem::path live = root / "oven-1-0";
+  const std::filesystem::path other = root / ("other-" + std::to_string(gone) + "-0");
+  for (const std::filesystem::path& path : {stale, own, live, other}) {
+    ASSERT_TRUE(std::filesystem::create_directory(path));
+  }
+  const pid_t sleeper = ::fork();
+  ASSERT_GE(sleeper, 0);
+  if (sleeper == 0) {
+    ::pause();
+    ::_exit(0);
+  }
+  std::ofstream(stale / "cgroup.procs") << sleeper;
+
+  ::setenv("OVEN_CGROUP_ROOT", root.c_str(), 1);
+  {
+    const auto cgroup = Cgroup::Create();
+    ASSERT_TRUE(cgroup);
+  }
+  ::setenv("OVEN_CGROUP_ROOT", GetTestJobsRoot()->c_str(), 1);
+
+  int status = 0;
+  ASSERT_EQ(::waitpid(sleeper, &status, 0), sleeper);
+  EXPECT_TRUE(WIFSIGNALED(status));
+  EXPECT_FALSE(std::filesystem::exists(stale));
+  for (const std::filesystem::path& path : {own, live, other}) {
+    EXPECT_TRUE(std::filesystem::exists(path));
+    std::filesystem::remove(path);
+  }
+  EXPECT_TRUE(std::filesystem::remove(root));
+}
+}  // anonymous namespace
+}  // namespace system
+}  // namespace oven
@@ -1,80 +1,15 @@
 #include "system/child_process.h"
 
 #include <cassert>
+#include <memory>
 
 #include "system/error.h"
-#include "system/job.h"
-#include "system/pipe.h"
 
 namespace oven {
 namespace system {
 namespace {
-const int kKillExitCode = 1;
-
-ChildProcess::Outputs ReadOutputs(Pipe stdoutput, Pipe stderror) {
-  stdoutput.out().reset();
-  stderror.out().reset();
-
-  ChildProcess::Outputs outputs;
-
-  const DWORD number_of_bytes_to_read = 4096;
-  struct StreamData {
-    StreamData(Pipe* pipe, std::string* output) : pipe(pipe), output(output) {}
-    Pipe* pipe;
-    char buffer[number_of_bytes_to_read];
-    std::string* output;
-  };
-  StreamData output(&stdoutput, &outputs.stdoutput);
-  StreamData error(&stderror, &outputs.stderror);
-
-  IOCP iocp;
-  if (!::CreateIoCompletionPort(output.pipe->in().get(), iocp.handle(),
-          reinterpret_cast<ULONG_PTR>(&output), 0) ||
-      !::CreateIoCompletionPort(error.pipe->in().get(), iocp.handle(),
-          reinterpret_cast<ULONG_PTR>(&error), 0)) {
-    OutputError(L"Unable to assosiate pipe with compiltion port");
-    return outputs;
-  }
-
-  if (const auto result =
-          ::ReadFile(output.pipe->in().get(), output.buffer,
-                   number_of_bytes_to_read, NULL, &output.pipe->overlapped());
-      result == 0 && ::GetLastError() != ERROR_IO_PENDING) {
-    OutputError(L"Unable to read from pipe");
-    return outputs;
-  }
-
-  if (const auto result =
-          ::ReadFile(error.pipe->in().get(), error.buffer,
-                   number_of_bytes_to_read, NULL, &error.pipe->overlapped());
-      result == 0 && ::GetLastError() != ERROR_IO_PENDING) {
-    OutputError(L"Unable to read from pipe");
-    return outputs;
-  }
-
-  size_t completed_reading = 0;
-  IOCP::WaitResult wait_result;
-  do {
-    ULONG_PTR completion_key;
-    OVERLAPPED* overlapped;
-    DWORD bytes_transferred;
-    wait_result = iocp.Wait(std::chrono::milliseconds::max(), &completion_key,
-                            &overlapped, &bytes_transferred);
-
-    if (wait_result != IOCP::WaitResult::kSuccess)
-      continue;
-    if (bytes_transferred) {
-      StreamData* stream_data = reinterpret_cast<StreamData*>(completion_key);
-      stream_data->output->append(stream_data->buffer, bytes_transferred);
-
-      // Failure of read means pipe is closed by child.
-      ::ReadFile(stream_data->pipe->in().get(), stream_data->buffer,
-                 number_of_bytes_to_read, NULL, &stream_data->pipe->overlapped());
-    }
-  } while(wait_result == IOCP::WaitResult::kSuccess);
-  
-  return outputs;
-}
+// Longer timeouts are considered infinite, so that deadline doesn't overflow.
+const std::chrono::hours kMaxTimeout(24 * 365);
 }  // anonymous namespace
 
 ChildProcess::ChildProcess(const std::wstring_view executable_path)
@@ -85,6 +20,7 @@ ChildProcess::ChildProcess(const std::wstring_view executable_path, const bool d
 }
 
 ChildProcess::~ChildProcess() {
+  Reactor::Get().Invoke([this]() { StopWaiting(); });
   if (IsAlive() && !detached_) {
     const auto exit_code = Wait();
     if (!exit_code.has_value()) {
@@ -95,22 +31,6 @@ ChildProcess::~ChildProcess() {
   RetreiveOutputStreams();
 }
 
-std::optional<unsigned long> ChildProcess::Run(Job& job) {
-  STARTUPINFOW startup_info {
-    sizeof(STARTUPINFOW),
-  };
-  return RunImpl(job, std::move(startup_info));
-}
-
-std::optional<unsigned long> ChildProcess::Run(
-    Job& job, const std::wstring_view desktop_name) {
-  STARTUPINFOW startup_info {
-    sizeof(STARTUPINFOW),
-  };
-  startup_info.lpDesktop = const_cast<LPWSTR>(desktop_name.data());
-  return RunImpl(job, std::move(startup_info));
-}
-
 std::wstring ChildProcess::RenderCommandLine() noexcept {
   std::wstring command_line;
   for (const std::wstring& arg : arguments_) {
@@ -123,75 +43,62 @@ std::wstring ChildProcess::RenderCommandLine() noexcept {
 }
 
 std::optional<int> ChildProcess::Wait(const std::chrono::milliseconds timeout) {
+  // Promise is shared, as reactor may still hold it once waiting is over.
+  auto exit_code = std::make_shared<std::promise<std::optional<int>>>();
+  WaitAsync(timeout, [exit_code](const std::optional<int> code) {
+    exit_code->set_value(code);
+  });
+  return exit_code->get_future().get();
+}
+
+void ChildProcess::WaitAsync(const std::chrono::milliseconds timeout,
+                             ExitCallback on_exit) {
 #if defined(ENABLE_ASSERTIONS)
   assert(IsAlive() && "Cannot wait for null process");
 #endif
-  const auto wait_result = ::WaitForSingleObject(
-      child_process_handle_.get(), static_cast<DWORD>(timeout.count()));
-  if (wait_result == WAIT_OBJECT_0) {
-    DWORD exit_code;
-    if (!::GetExitCodeProcess(child_process_handle_.get(), &exit_code)) {
-       OutputError(L"Unable to retrieve exit code of child process");
-      return std::optional<int>();
+  Reactor::Get().Post([this, timeout, on_exit = std::move(on_exit)]() mutable {
+    on_exit_ = std::move(on_exit);
+    exit_completion_key_ = WatchExit();
+    if (!exit_completion_key_) {
+      OutputError(L"Unable to wait for child process");
+      FinishWaiting(std::optional<int>());
+      return;
     }
-    child_process_handle_.reset();
-    return static_cast<int>(exit_code);
-  }
-  return std::optional<int>();
+    if (timeout.count() >= 0 && timeout < kMaxTimeout) {
+      exit_timer_ = Reactor::Get().AddTimer(
+          std::chrono::steady_clock::now() + timeout,
+          [this]() { FinishWaiting(std::optional<int>()); });
+    }
+  });
 }
 
-std::optional<int> ChildProcess::Terminate() {
-#if defined(ENABLE_ASSERTIONS)
-  assert(IsAlive() && "Cannot terminate dead process");
-#endif
-  if (!::TerminateProcess(child_process_handle_.get(), kKillExitCode)) {
-    // TODO(matthewtff): Process May have terminated already, try to receive it's exit code here.
-    OutputError(L"Unable to teminate child process");
-    return {};
-  }
-  return Wait();
+void ChildProcess::HandleExit() {
+  // Process handle is only released once it's not watched anymore.
+  StopWaiting();
+  FinishWaiting(CollectExitCode());
 }
 
-std::optional<unsigned long> ChildProcess::RunImpl(
-    Job& job, STARTUPINFOW&& startup_info) {
-
-  startup_info.dwFlags = STARTF_USESTDHANDLES;
-  Pipe stdout_stream;
-  Pipe stderr_stream;
-  startup_info.hStdOutput = stdout_stream.out().get();
-  startup_info.hStdError = stderr_stream.out().get();
-  
-  std::wstring command_line = RenderCommandLine();
-  PROCESS_INFORMATION process_info;
-  if (!::CreateProcessW(const_cast<LPWSTR>(executable_path_.c_str()),
-                        const_cast<LPWSTR>(command_line.c_str()),
-                        NULL, NULL, TRUE, NULL, NULL, NULL,
-                        &startup_info, &process_info)) {
-    OutputError(L"Unable to start child process");
-    std::promise<Outputs> empty_outputs;
-    output_streams_future_ = empty_outputs.get_future();
-    empty_outputs.set_value({});
-		return std::optional<unsigned long>();
-	} else {
-    ::CloseHandle(process_info.hThread);
-    child_process_handle_.reset(process_info.hProcess);
-    if (!job.AssignProcess(child_process_handle_.get())) {
-      OutputError(L"Unable to assign child process to job object");
-    }
-    /* TODO(matthewtff): Decide whether reuiqred
-		if (!::WaitForInputIdle(child_process_handle_.get(), INFINITE)) {
-      OutputError(L"Unable to wait for child process");
-			std::optional<unsigned long>();
-		}*/
+void ChildProcess::FinishWaiting(const std::optional<int> exit_code) {
+  StopWaiting();
+  const ExitCallback on_exit = std::move(on_exit_);
+  on_exit_ = nullptr;
+  if (on_exit) {
+    on_exit(exit_code);
+  }
+}
 
-    output_streams_future_ = std::async(ReadOutputs, std::move(stdout_stream),
-                                 std::move(stderr_stream)); 
-	}
-  return process_info.dwProcessId;
+void ChildProcess::StopWaiting() {
+  if (exit_completion_key_) {
+    UnwatchExit();
+    exit_completion_key_ = 0;
+  }
+  Reactor::Get().CancelTimer(exit_timer_);
+  exit_timer_ = 0;
 }
 
 void ChildProcess::RetreiveOutputStreams() {
-  if (output_streams_)
+  // Child may have never been started.
+  if (output_streams_ || !output_streams_future_.valid())
     return;
 
   output_streams_ = output_streams_future_.get();
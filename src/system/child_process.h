@@ -1,16 +1,28 @@
 #ifndef _OVEN_SYSTEM_CHILD_PROCESS_H_
 #define _OVEN_SYSTEM_CHILD_PROCESS_H_
 
+#if defined(_WIN32)
 #include <Windows.h>
+#else
+#include <sys/types.h>
+#endif
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <future>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "base/output_capture.h"
+#include "base/output_timeline.h"
+#include "system/reactor.h"
 #include "system/scoped_handle.h"
 
 namespace oven {
@@ -18,12 +30,33 @@ namespace system {
 
 class Job;
 
+// Child process is driven by the reactor: its outputs are read and its exit
+// is waited for on reactor thread.
 class ChildProcess {
  public:
   struct Outputs {
-    std::string stdoutput;
-    std::string stderror;
+    base::OutputCapture stdoutput;
+    base::OutputCapture stderror;
+    // Chunks both streams were received in, from the time child has started.
+    base::OutputTimeline timeline;
   };
+  using ExitCallback = std::function<void(const std::optional<int> exit_code)>;
+
+  // Where output streams are copied to as they're read, besides being
+  // captured. Streams with invalid handles are only captured.
+  struct Passthrough {
+    // Copies streams to the ones of the current process.
+    static Passthrough Console();
+    // Copies both streams to file at |path|, which is truncated. Returns
+    // nothing if it can't be opened.
+    static std::optional<Passthrough> OpenFile(const std::filesystem::path& path);
+
+    NativeHandle stdoutput = kInvalidNativeHandle;
+    NativeHandle stderror = kInvalidNativeHandle;
+    // Keeps the file open for as long as any copy of passthrough is alive.
+    std::shared_ptr<ScopedHandle> file;
+  };
+
   explicit ChildProcess(const std::wstring_view executable_path);
   ChildProcess(const std::wstring_view executable_path, const bool detached);
   ~ChildProcess();
@@ -42,6 +75,7 @@ class ChildProcess {
   // If desktop from another window station (one that is not currently assigned
   // to current process) is passed, make sure it's name is prefixed in the
   // following way:  <window_station_name>\\<desktop_name>>
+  // Desktop name is ignored on POSIX systems.
   std::optional<unsigned long> Run(Job& job, const std::wstring_view desktop_name);
 
   template <typename ArgsContainer>
@@ -52,18 +86,57 @@ class ChildProcess {
     }
   }
 
+  // Limits memory used to capture each of the output streams, must be set
+  // before the process is run.
+  void SetOutputLimits(const base::OutputCapture::Limits& limits) {
+    output_limits_ = limits;
+  }
+
+  // Copies output streams to |passthrough| while they're captured, so that
+  // they can be watched live. Must be set before the process is run.
+  void SetOutputPassthrough(Passthrough passthrough) {
+    output_passthrough_ = std::move(passthrough);
+  }
+
+  // Size of pipe buffers child output streams are written to, system default
+  // is used if it's 0.
+  void SetPipeBufferSize(const size_t buffer_size) {
+    pipe_buffer_size_ = buffer_size;
+  }
+
+  // Child process starts in the working directory of the current process,
+  // unless another one is set.
+  void SetWorkingDirectory(const std::wstring_view working_directory) {
+    working_directory_ = working_directory;
+  }
+
+  // Child process inherits environment of the current process, with
+  // variables set here added or replaced. Must be set before the process is
+  // run.
+  void SetEnvironmentVariable(const std::wstring_view name,
+                              const std::wstring_view value) {
+    environment_.emplace_back(name, value);
+  }
+
   std::wstring RenderCommandLine() noexcept;
 
   // Returns true if child process has started and it's exit code wasn't yet
   // collected via |Wait|.
-  bool IsAlive() const noexcept { return child_process_handle_.get(); }
+  bool IsAlive() const noexcept { return child_process_handle_.IsValid(); }
 
   // Wait until child process exits. Returns exit code on success.
   std::optional<int> Wait() { return Wait(std::chrono::milliseconds::max()); }
 
-  // Wait for specified number of milliseconds.
+  // Wait for specified number of milliseconds. Must not be called on reactor
+  // thread.
   std::optional<int> Wait(const std::chrono::milliseconds timeout);
 
+  // Calls |on_exit| on reactor thread once child process exits, with its
+  // exit code on success. It's called with nothing if child doesn't exit
+  // within |timeout|, leaving it running. Callback must not block, only one
+  // wait may be pending at a time.
+  void WaitAsync(const std::chrono::milliseconds timeout, ExitCallback on_exit);
+
   // Marks all threads of child process as finishing and waits for child process
   // to complete it's execution, returns exit code if available.
   std::optional<int> Terminate();
@@ -73,17 +146,60 @@ class ChildProcess {
     return *output_streams_;
   }
 
+  // Gives up captured outputs, to avoid copying them.
+  Outputs TakeOutputs() {
+    RetreiveOutputStreams();
+    return std::move(*output_streams_);
+  }
+
+#if !defined(_WIN32)
+  // Makes children be forked and held until they join the job, as they are
+  // when clone3 isn't available, to test and measure that path.
+  static void SetForkFallbackForTesting(const bool use_fork);
+#endif
+
  private:
+#if defined(_WIN32)
   std::optional<unsigned long> RunImpl(Job& job, STARTUPINFOW&& startup_info);
+  // Environment block with variables set for the child, empty if it inherits
+  // the environment unchanged.
+  std::wstring RenderEnvironment() const;
+#else
+  std::optional<unsigned long> RunImpl(Job& job);
+#endif
   void RetreiveOutputStreams();
 
+  // All of the following are called on reactor thread. Watching returns
+  // completion key, 0 on failure.
+  std::uintptr_t WatchExit();
+  void UnwatchExit();
+  // Collects exit code of exited child process.
+  std::optional<int> CollectExitCode();
+  void HandleExit();
+  void FinishWaiting(const std::optional<int> exit_code);
+  void StopWaiting();
+
   std::wstring executable_path_;
   bool detached_;
 
+  // Process handle on Windows, process descriptor (pidfd) on POSIX systems.
   ScopedHandle child_process_handle_;
+#if !defined(_WIN32)
+  pid_t child_process_id_ = 0;
+#endif
   std::future<Outputs> output_streams_future_;
   std::optional<Outputs> output_streams_;
   std::vector<std::wstring> arguments_;
+  std::wstring working_directory_;
+  std::vector<std::pair<std::wstring, std::wstring>> environment_;
+  base::OutputCapture::Limits output_limits_;
+  Passthrough output_passthrough_;
+  size_t pipe_buffer_size_ = 0;
+
+  // Pending |WaitAsync|, only touched on reactor thread.
+  ExitCallback on_exit_;
+  std::uintptr_t exit_completion_key_ = 0;
+  Reactor::TimerId exit_timer_ = 0;
 
   std::atomic_bool terminated_ = false;
 };
@@ -0,0 +1,743 @@
+#include "system/child_process.h"
+
+#include <fcntl.h>
+#include <linux/sched.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "base/segment.h"
+#include "base/string_conversion.h"
+#include "system/error.h"
+#include "system/iocp.h"
+#include "system/job.h"
+#include "system/pipe.h"
+#include "system/reactor.h"
+
+namespace oven {
+namespace system {
+namespace {
+// Exit code of forked process which failed to execute child image.
+const int kExecFailedExitCode = 127;
+
+// Largest number of bytes passthrough may fall behind by before streams
+// writing to it stop being read, like they would block writing to it
+// themselves.
+const size_t kMaxPassthroughBacklog = 4 * 1024 * 1024;
+
+// Writes output streams to passthrough without blocking reactor thread, e.g.
+// if it's a terminal which is slow to scroll or a pipe into a pager. What
+// passthrough doesn't take right away is kept and written once it becomes
+// writable.
+//
+// Pipes, terminals and other devices are reopened to be made non-blocking,
+// so that oven's own streams (and whoever shares them) stay blocking, and
+// streams of all the children passed to the same one share a writer, so that
+// their chunks don't get reordered. Regular files never block and are written
+// to through a duplicate.
+//
+// Must be used on reactor thread only.
+class PassthroughWriter : public std::enable_shared_from_this<PassthroughWriter> {
+ public:
+  // Returns null if |passthrough| can't be written to.
+  static std::shared_ptr<PassthroughWriter> Get(const NativeHandle passthrough) {
+    struct stat status;
+    if (::fstat(passthrough, &status) != 0) {
+      return nullptr;
+    }
+    if (S_ISREG(status.st_mode) || S_ISBLK(status.st_mode)) {
+      ScopedHandle handle(::fcntl(passthrough, F_DUPFD_CLOEXEC, 0));
+      return handle ? std::make_shared<PassthroughWriter>(std::move(handle), false)
+                    : nullptr;
+    }
+    static std::map<std::pair<dev_t, ino_t>, std::weak_ptr<PassthroughWriter>> writers;
+    std::weak_ptr<PassthroughWriter>& shared = writers[{status.st_dev, status.st_ino}];
+    if (auto writer = shared.lock()) {
+      return writer;
+    }
+    std::shared_ptr<PassthroughWriter> writer;
+    const std::string path = "/proc/self/fd/" + std::to_string(passthrough);
+    if (ScopedHandle handle(::open(path.c_str(),
+                                   O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC));
+        handle) {
+      writer = std::make_shared<PassthroughWriter>(std::move(handle), false);
+    } else if (S_ISSOCK(status.st_mode)) {
+      // Sockets can't be reopened, but can be sent to without blocking.
+      handle.reset(::fcntl(passthrough, F_DUPFD_CLOEXEC, 0));
+      if (handle) {
+        writer = std::make_shared<PassthroughWriter>(std::move(handle), true);
+      }
+    }
+    if (!writer) {
+      OutputError(L"Unable to reopen output passthrough");
+    }
+    shared = writer;
+    return writer;
+  }
+
+  PassthroughWriter(ScopedHandle handle, const bool is_socket)
+      : handle_(std::move(handle)), is_socket_(is_socket) {}
+
+  PassthroughWriter(const PassthroughWriter&) = delete;
+  PassthroughWriter& operator=(const PassthroughWriter&) = delete;
+
+  NativeHandle handle() const noexcept { return handle_.get(); }
+
+  // Whether output can be spliced into passthrough right away: nothing is
+  // waiting to be written before it.
+  bool CanSplice() const noexcept {
+    return handle_ && !is_socket_ && backlog_.size() == backlog_offset_;
+  }
+
+  bool IsBacklogged() const noexcept {
+    return backlog_.size() - backlog_offset_ >= kMaxPassthroughBacklog;
+  }
+
+  void Write(const char* bytes, size_t size) {
+    if (!handle_) {
+      return;
+    }
+    if (backlog_.size() == backlog_offset_) {
+      const size_t bytes_written = WriteSome(bytes, size);
+      bytes += bytes_written;
+      size -= bytes_written;
+    }
+    if (size == 0 || !handle_) {
+      return;
+    }
+    backlog_.append(bytes, size);
+    if (!completion_key_) {
+      completion_key_ = Reactor::Get().Watch(
+          handle_.get(),
+          [writer = shared_from_this()](const IOCP::Completion& /* completion */) {
+            writer->WriteBacklog();
+          },
+          IOCP::Readiness::kWritable);
+      if (!completion_key_) {
+        Fail();
+      }
+    }
+  }
+
+  // Calls |callback| once everything written so far has been passed (or
+  // passthrough has failed), right away if there is nothing left.
+  void WhenFlushed(std::function<void()> callback) {
+    if (backlog_.size() == backlog_offset_) {
+      callback();
+      return;
+    }
+    flushed_callbacks_.push_back(std::move(callback));
+  }
+
+ private:
+  // Returns number of bytes passthrough took.
+  size_t WriteSome(const char* bytes, const size_t size) {
+    size_t bytes_written = 0;
+    while (bytes_written < size) {
+      const ssize_t result =
+          is_socket_ ? ::send(handle_.get(), bytes + bytes_written, size - bytes_written,
+                              MSG_DONTWAIT | MSG_NOSIGNAL)
+                     : ::write(handle_.get(), bytes + bytes_written, size - bytes_written);
+      if (result > 0) {
+        bytes_written += static_cast<size_t>(result);
+      } else if (result < 0 && errno == EINTR) {
+        continue;
+      } else {
+        if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+          Fail();
+        }
+        break;
+      }
+    }
+    return bytes_written;
+  }
+
+  void WriteBacklog() {
+    backlog_offset_ += WriteSome(backlog_.data() + backlog_offset_,
+                                 backlog_.size() - backlog_offset_);
+    if (backlog_offset_ < backlog_.size()) {
+      // Written part is dropped once it takes the most of the buffer, so
+      // that the rest isn't moved on every write.
+      if (backlog_offset_ >= backlog_.size() / 2) {
+        backlog_.erase(0, backlog_offset_);
+        backlog_offset_ = 0;
+      }
+      return;
+    }
+    Flushed();
+  }
+
+  // Output keeps being captured even if passthrough is gone.
+  void Fail() {
+    handle_.reset();
+    Flushed();
+  }
+
+  void Flushed() {
+    backlog_.clear();
+    backlog_offset_ = 0;
+    if (completion_key_) {
+      // Closed handle is already removed from epoll.
+      if (handle_) {
+        Reactor::Get().Unwatch(handle_.get(), completion_key_);
+      } else {
+        Reactor::Get().RemoveHandler(completion_key_);
+      }
+      completion_key_ = 0;
+    }
+    std::vector<std::function<void()>> callbacks = std::move(flushed_callbacks_);
+    flushed_callbacks_.clear();
+    for (auto& callback : callbacks) {
+      callback();
+    }
+  }
+
+  ScopedHandle handle_;
+  const bool is_socket_;
+  std::string backlog_;
+  size_t backlog_offset_ = 0;
+  std::uintptr_t completion_key_ = 0;
+  std::vector<std::function<void()>> flushed_callbacks_;
+};
+
+// Reads child output streams on reactor thread until child closes them.
+// Pipes are drained on each wakeup until they're empty, which takes a single
+// wakeup per pipe buffer rather than per read.
+//
+// Streams with passthrough are duplicated with tee() into a pipe of their
+// own before they're read, and that pipe is spliced into passthrough, so
+// that copying them doesn't go through user space. Passthrough that can't be
+// spliced into (e.g. a file opened for appending) is written to from the
+// capture buffer instead. Stream stops being read while its passthrough
+// falls behind, and outputs are reported once passthrough catches up.
+class OutputReader : public std::enable_shared_from_this<OutputReader> {
+ public:
+  OutputReader(Pipe stdoutput, Pipe stderror,
+               const base::OutputCapture::Limits& limits,
+               const ChildProcess::Passthrough& passthrough)
+      : outputs_{base::OutputCapture(limits), base::OutputCapture(limits),
+                 base::OutputTimeline()},
+        streams_{Stream(std::move(stdoutput), &outputs_.stdoutput,
+                        base::OutputTimeline::Stream::kStdout, passthrough.stdoutput),
+                 Stream(std::move(stderror), &outputs_.stderror,
+                        base::OutputTimeline::Stream::kStderr, passthrough.stderror)},
+        passthrough_file_(passthrough.file) {
+    for (Stream& stream : streams_) {
+      stream.pipe.out().reset();
+      if (stream.passthrough != kInvalidNativeHandle) {
+        OpenTeePipe(stream);
+      }
+    }
+  }
+
+  // Reader keeps itself alive until both streams are closed.
+  std::future<ChildProcess::Outputs> Start() {
+    std::future<ChildProcess::Outputs> outputs = outputs_promise_.get_future();
+    Reactor::Get().Post([reader = shared_from_this()]() { reader->Watch(); });
+    return outputs;
+  }
+
+ private:
+  struct Stream {
+    Stream(Pipe pipe, base::OutputCapture* output,
+           const base::OutputTimeline::Stream id, const NativeHandle passthrough)
+        : pipe(std::move(pipe)), output(output), id(id), passthrough(passthrough) {}
+
+    Pipe pipe;
+    base::OutputCapture* output;
+    base::OutputTimeline::Stream id;
+    NativeHandle passthrough = kInvalidNativeHandle;
+    std::uintptr_t completion_key = 0;
+    // Pipe stream is duplicated into to be spliced into passthrough, closed
+    // once passthrough turns out not to support splicing.
+    ScopedHandle tee_in;
+    ScopedHandle tee_out;
+    std::shared_ptr<PassthroughWriter> writer;
+  };
+
+  void Watch() {
+    for (Stream& stream : streams_) {
+      if (stream.passthrough != kInvalidNativeHandle) {
+        stream.writer = PassthroughWriter::Get(stream.passthrough);
+        if (!stream.writer) {
+          StopSplicing(stream);
+        }
+      }
+      const NativeHandle pipe = stream.pipe.in().get();
+      if (::fcntl(pipe, F_SETFL, ::fcntl(pipe, F_GETFL) | O_NONBLOCK) != 0 ||
+          !WatchPipe(stream)) {
+        OutputError(L"Unable to assosiate pipe with compiltion port");
+        Close(stream);
+      }
+    }
+  }
+
+  bool WatchPipe(Stream& stream) {
+    stream.completion_key = Reactor::Get().Watch(
+        stream.pipe.in().get(), [reader = shared_from_this(), &stream](
+                                    const IOCP::Completion& /* completion */) {
+          reader->Read(stream);
+        });
+    return stream.completion_key != 0;
+  }
+
+  void Read(Stream& stream) {
+    const auto receive_time = std::chrono::steady_clock::now();
+    for (;;) {
+      // Bytes duplicated into tee pipe are read right after, so that the rest
+      // of them can be written to passthrough from the buffer if splicing
+      // fails halfway.
+      size_t bytes_to_read = base::Segment::kCapacity;
+      size_t bytes_passed = 0;
+      if (stream.tee_out && stream.writer->CanSplice()) {
+        const ssize_t bytes_teed =
+            ::tee(stream.pipe.in().get(), stream.tee_out.get(), bytes_to_read,
+                  SPLICE_F_NONBLOCK);
+        if (bytes_teed > 0) {
+          bytes_to_read = static_cast<size_t>(bytes_teed);
+          bytes_passed = SpliceToPassthrough(stream, bytes_to_read);
+        } else if (bytes_teed < 0 && errno != EAGAIN && errno != EINTR) {
+          StopSplicing(stream);
+        }
+      }
+      const ssize_t bytes_read =
+          ::read(stream.pipe.in().get(), buffer_.data(), bytes_to_read);
+      if (bytes_read > 0) {
+        if (stream.writer && static_cast<size_t>(bytes_read) > bytes_passed) {
+          stream.writer->Write(buffer_.data() + bytes_passed,
+                               bytes_read - bytes_passed);
+        }
+        stream.output->Append(std::string_view(buffer_.data(), bytes_read));
+        outputs_.timeline.Record(stream.id, receive_time, bytes_read);
+        if (stream.writer && stream.writer->IsBacklogged()) {
+          Pause(stream);
+          break;
+        }
+        continue;
+      }
+      if (bytes_read < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes_read == 0 || errno != EAGAIN) {
+        // Pipe is closed by child.
+        Close(stream);
+      }
+      break;
+    }
+  }
+
+  // Stops reading |stream| until its passthrough catches up, so that child
+  // gets blocked writing to it instead of oven buffering its output.
+  void Pause(Stream& stream) {
+    Reactor::Get().Unwatch(stream.pipe.in().get(), stream.completion_key);
+    stream.completion_key = 0;
+    stream.writer->WhenFlushed(
+        [reader = shared_from_this(), &stream]() { reader->Resume(stream); });
+  }
+
+  void Resume(Stream& stream) {
+    if (!WatchPipe(stream)) {
+      OutputError(L"Unable to assosiate pipe with compiltion port");
+      Close(stream);
+      return;
+    }
+    // Edge of pipe getting readable may have passed while it wasn't watched,
+    // and reading is not done right away to keep writer out of the stack.
+    Reactor::Get().Post([reader = shared_from_this(), &stream]() {
+      if (stream.completion_key) {
+        reader->Read(stream);
+      }
+    });
+  }
+
+  // Returns number of bytes moved from tee pipe to passthrough.
+  size_t SpliceToPassthrough(Stream& stream, const size_t size) {
+    size_t bytes_spliced = 0;
+    while (bytes_spliced < size) {
+      const ssize_t bytes_moved =
+          ::splice(stream.tee_in.get(), nullptr, stream.writer->handle(), nullptr,
+                   size - bytes_spliced, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (bytes_moved > 0) {
+        bytes_spliced += static_cast<size_t>(bytes_moved);
+      } else if (bytes_moved < 0 && errno == EAGAIN) {
+        // Passthrough is full: the rest is dropped from tee pipe and written
+        // from the buffer once passthrough is writable again.
+        OpenTeePipe(stream);
+        break;
+      } else if (bytes_moved < 0 && errno != EINTR) {
+        StopSplicing(stream);
+        break;
+      }
+    }
+    return bytes_spliced;
+  }
+
+  void OpenTeePipe(Stream& stream) {
+    int tee_pipe[2];
+    if (::pipe2(tee_pipe, O_CLOEXEC | O_NONBLOCK) == 0) {
+      stream.tee_in.reset(tee_pipe[0]);
+      stream.tee_out.reset(tee_pipe[1]);
+    } else {
+      StopSplicing(stream);
+    }
+  }
+
+  void StopSplicing(Stream& stream) {
+    stream.tee_in.reset();
+    stream.tee_out.reset();
+  }
+
+  void Close(Stream& stream) {
+    if (stream.completion_key) {
+      Reactor::Get().Unwatch(stream.pipe.in().get(), stream.completion_key);
+      stream.completion_key = 0;
+    }
+    stream.pipe.in().reset();
+    if (--open_streams_ == 0) {
+      outputs_.stdoutput.Finish();
+      outputs_.stderror.Finish();
+      FinishWhenPassed(0);
+    }
+  }
+
+  // Reports outputs once streams from |index| on are passed.
+  void FinishWhenPassed(const size_t index) {
+    if (index == std::size(streams_)) {
+      outputs_promise_.set_value(std::move(outputs_));
+      return;
+    }
+    if (!streams_[index].writer) {
+      FinishWhenPassed(index + 1);
+      return;
+    }
+    streams_[index].writer->WhenFlushed(
+        [reader = shared_from_this(), index]() { reader->FinishWhenPassed(index + 1); });
+  }
+
+  ChildProcess::Outputs outputs_;
+  Stream streams_[2];
+  size_t open_streams_ = 2;
+  // Streams are read one at a time, so they share the buffer.
+  base::Segment buffer_;
+  std::shared_ptr<ScopedHandle> passthrough_file_;
+  std::promise<ChildProcess::Outputs> outputs_promise_;
+};
+
+// Everything process needs to execute child image is prepared before it's
+// spawned: only async-signal-safe calls are allowed between fork and exec.
+struct ExecParameters {
+  const char* executable_path;
+  char* const* argv;
+  // Null if process stays in the current working directory.
+  const char* working_directory;
+  // Null if process inherits environment of the current one.
+  char* const* environment;
+  NativeHandle stdoutput;
+  NativeHandle stderror;
+  // Read end of a pipe process waits to be closed before it starts, if valid.
+  NativeHandle start_gate;
+  NativeHandle exec_status;
+  // Job process is spawned inside of, null if process gets assigned by parent.
+  const Job* job;
+};
+
+[[noreturn]] void ExecChild(const ExecParameters& parameters) {
+  // Signal mask survives exec, and oven may block signals it waits for.
+  sigset_t signals;
+  sigemptyset(&signals);
+  ::sigprocmask(SIG_SETMASK, &signals, nullptr);
+  if (parameters.start_gate != kInvalidNativeHandle) {
+    char unused;
+    while (::read(parameters.start_gate, &unused, sizeof(unused)) < 0 &&
+           errno == EINTR) {
+    }
+  }
+  if (::dup2(parameters.stdoutput, STDOUT_FILENO) >= 0 &&
+      ::dup2(parameters.stderror, STDERR_FILENO) >= 0 &&
+      (!parameters.working_directory || ::chdir(parameters.working_directory) == 0) &&
+      (!parameters.job || parameters.job->SetupSpawnedProcess())) {
+    ::execve(parameters.executable_path, parameters.argv,
+             parameters.environment ? parameters.environment : environ);
+  }
+  const int exec_error = errno;
+  [[maybe_unused]] const auto written =
+      ::write(parameters.exec_status, &exec_error, sizeof(exec_error));
+  ::_exit(kExecFailedExitCode);
+}
+
+std::atomic_bool& ForkFallbackForced() {
+  static std::atomic_bool forced = false;
+  return forced;
+}
+
+// Forks process right inside of job's |cgroup| (if valid), so that there is
+// no window for it to escape the job. Returns process id to the parent and 0
+// to the spawned process, like fork does.
+pid_t SpawnInsideOfJob(const NativeHandle cgroup, ScopedHandle* process) {
+  int process_descriptor = kInvalidNativeHandle;
+  clone_args arguments = {};
+  arguments.flags = CLONE_PIDFD;
+  arguments.pidfd = reinterpret_cast<std::uintptr_t>(&process_descriptor);
+  arguments.exit_signal = SIGCHLD;
+  if (cgroup != kInvalidNativeHandle) {
+    arguments.flags |= CLONE_INTO_CGROUP;
+    arguments.cgroup = static_cast<std::uint64_t>(cgroup);
+  }
+  const pid_t process_id =
+      static_cast<pid_t>(::syscall(SYS_clone3, &arguments, sizeof(arguments)));
+  if (process_id > 0) {
+    process->reset(process_descriptor);
+  }
+  return process_id;
+}
+
+ScopedHandle DuplicateHandle(const ScopedHandle& handle) {
+  return ScopedHandle(::fcntl(handle.get(), F_DUPFD_CLOEXEC, 0));
+}
+
+// Follows shell convention for processes killed by signal.
+int ExitCodeFromStatus(const int status) {
+  if (WIFSIGNALED(status))
+    return 128 + WTERMSIG(status);
+  return WEXITSTATUS(status);
+}
+}  // anonymous namespace
+
+// static
+void ChildProcess::SetForkFallbackForTesting(const bool use_fork) {
+  ForkFallbackForced() = use_fork;
+}
+
+// static
+ChildProcess::Passthrough ChildProcess::Passthrough::Console() {
+  Passthrough passthrough;
+  passthrough.stdoutput = STDOUT_FILENO;
+  passthrough.stderror = STDERR_FILENO;
+  return passthrough;
+}
+
+// static
+std::optional<ChildProcess::Passthrough> ChildProcess::Passthrough::OpenFile(
+    const std::filesystem::path& path) {
+  // Not opened for appending, which splice() doesn't support. Streams are
+  // written on reactor thread only, so they don't overwrite each other.
+  auto file = std::make_shared<ScopedHandle>(
+      ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+  if (!*file) {
+    OutputError(L"Unable to open output passthrough file");
+    return std::optional<Passthrough>();
+  }
+  Passthrough passthrough;
+  passthrough.stdoutput = file->get();
+  passthrough.stderror = file->get();
+  passthrough.file = std::move(file);
+  return passthrough;
+}
+
+std::optional<unsigned long> ChildProcess::Run(Job& job) {
+  return RunImpl(job);
+}
+
+std::optional<unsigned long> ChildProcess::Run(
+    Job& job, const std::wstring_view /* desktop_name */) {
+  return RunImpl(job);
+}
+
+std::uintptr_t ChildProcess::WatchExit() {
+  // Process descriptor becomes readable once process exits.
+  return Reactor::Get().Watch(child_process_handle_.get(),
+                              [this](const IOCP::Completion& /* completion */) {
+                                HandleExit();
+                              });
+}
+
+void ChildProcess::UnwatchExit() {
+  Reactor::Get().Unwatch(child_process_handle_.get(), exit_completion_key_);
+}
+
+std::optional<int> ChildProcess::CollectExitCode() {
+  // Process has exited already, so waiting doesn't block.
+  int status;
+  pid_t wait_result;
+  do {
+    wait_result = ::waitpid(child_process_id_, &status, 0);
+  } while (wait_result < 0 && errno == EINTR);
+  if (wait_result != child_process_id_) {
+    OutputError(L"Unable to retrieve exit code of child process");
+    return std::optional<int>();
+  }
+  child_process_handle_.reset();
+  return ExitCodeFromStatus(status);
+}
+
+std::optional<int> ChildProcess::Terminate() {
+#if defined(ENABLE_ASSERTIONS)
+  assert(IsAlive() && "Cannot terminate dead process");
+#endif
+  // Process descriptor guarantees signal is not delivered to a recycled pid.
+  if (::syscall(SYS_pidfd_send_signal, child_process_handle_.get(), SIGKILL,
+                nullptr, 0) != 0) {
+    OutputError(L"Unable to teminate child process");
+    return {};
+  }
+  return Wait();
+}
+
+std::optional<unsigned long> ChildProcess::RunImpl(Job& job) {
+  Pipe stdout_stream(pipe_buffer_size_);
+  Pipe stderr_stream(pipe_buffer_size_);
+  // Reports exec failure to the parent: the pipe gets closed on successful
+  // exec, otherwise errno is written to it.
+  Pipe exec_status;
+
+  auto report_failure = [&](const wchar_t* message) {
+    OutputError(message);
+    exec_status.in().reset();
+    exec_status.out().reset();
+    stdout_stream.in().reset();
+    stdout_stream.out().reset();
+    stderr_stream.in().reset();
+    stderr_stream.out().reset();
+    std::promise<Outputs> empty_outputs;
+    output_streams_future_ = empty_outputs.get_future();
+    empty_outputs.set_value({});
+    return std::optional<unsigned long>();
+  };
+
+  const std::string executable_path = base::WideToUtf8(executable_path_);
+  std::vector<std::string> arguments;
+  arguments.reserve(arguments_.size());
+  for (const std::wstring& argument : arguments_) {
+    arguments.push_back(base::WideToUtf8(argument));
+  }
+  std::vector<char*> argv;
+  argv.reserve(arguments.size() + 1);
+  for (std::string& argument : arguments) {
+    argv.push_back(argument.data());
+  }
+  argv.push_back(nullptr);
+  const std::string working_directory = base::WideToUtf8(working_directory_);
+
+  // Variables of the current process that are not replaced, followed by the
+  // ones set for the child.
+  std::vector<std::string> variables;
+  std::vector<char*> environment;
+  if (!environment_.empty()) {
+    for (const auto& [name, value] : environment_) {
+      variables.push_back(base::WideToUtf8(name) + "=" + base::WideToUtf8(value));
+    }
+    for (char** inherited = environ; *inherited; ++inherited) {
+      const std::string_view name(*inherited, std::strcspn(*inherited, "="));
+      const bool replaced = std::any_of(
+          variables.begin(), variables.end(), [&name](const std::string& variable) {
+            return variable.size() > name.size() && variable[name.size()] == '=' &&
+                   variable.compare(0, name.size(), name) == 0;
+          });
+      if (!replaced) {
+        environment.push_back(*inherited);
+      }
+    }
+    for (std::string& variable : variables) {
+      environment.push_back(variable.data());
+    }
+    environment.push_back(nullptr);
+  }
+
+  ExecParameters parameters{
+      executable_path.c_str(), argv.data(),
+      working_directory.empty() ? nullptr : working_directory.c_str(),
+      environment.empty() ? nullptr : environment.data(),
+      stdout_stream.out().get(), stderr_stream.out().get(), kInvalidNativeHandle,
+      exec_status.out().get(), &job};
+
+  // Job has to listen for notifications before process is spawned not to
+  // miss the ones about its descendants.
+  if (!job.StartListening()) {
+    return report_failure(L"Unable to listen for job notifications");
+  }
+  ScopedHandle process;
+  bool assigned = false;
+  pid_t process_id = -1;
+  errno = ENOSYS;
+  if (!ForkFallbackForced()) {
+    process_id = SpawnInsideOfJob(job.handle(), &process);
+  }
+  if (process_id == 0) {
+    ExecChild(parameters);
+  }
+  if (process_id > 0) {
+    assigned = job.AddSpawnedProcess(process_id, DuplicateHandle(process));
+  } else if (errno == ENOSYS || errno == EPERM || errno == EINVAL) {
+    // clone3 or CLONE_INTO_CGROUP is not supported (or filtered out by
+    // seccomp): fork and hold forked process until it's assigned to the job.
+    Pipe start_gate;
+    parameters.start_gate = start_gate.in().get();
+    parameters.job = nullptr;
+    process_id = ::fork();
+    if (process_id == 0) {
+      ::close(start_gate.out().get());
+      ExecChild(parameters);
+    }
+    if (process_id > 0) {
+      process.reset(static_cast<NativeHandle>(
+          ::syscall(SYS_pidfd_open, process_id, 0)));
+      assigned = process && job.AssignProcess(process_id);
+    }
+    start_gate.in().reset();
+    start_gate.out().reset();
+  }
+  if (process_id < 0) {
+    return report_failure(L"Unable to start child process");
+  }
+  if (!assigned) {
+    const int assign_error = errno;
+    ::kill(process_id, SIGKILL);
+    ::waitpid(process_id, nullptr, 0);
+    errno = assign_error;
+    return report_failure(L"Unable to assign child process to job object");
+  }
+
+  exec_status.out().reset();
+  int exec_error = 0;
+  ssize_t bytes_read;
+  do {
+    bytes_read = ::read(exec_status.in().get(), &exec_error, sizeof(exec_error));
+  } while (bytes_read < 0 && errno == EINTR);
+  exec_status.in().reset();
+
+  if (bytes_read != 0) {
+    ::waitpid(process_id, nullptr, 0);
+    errno = exec_error;
+    return report_failure(L"Unable to start child process");
+  }
+
+  job.SetProcessImage(process_id, executable_path_, RenderCommandLine());
+  child_process_id_ = process_id;
+  child_process_handle_ = std::move(process);
+  output_streams_future_ =
+      std::make_shared<OutputReader>(std::move(stdout_stream),
+                                     std::move(stderr_stream), output_limits_,
+                                     output_passthrough_)
+          ->Start();
+  return static_cast<unsigned long>(process_id);
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,375 @@
+#include "system/child_process.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cwchar>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "base/segment.h"
+#include "system/error.h"
+#include "system/iocp.h"
+#include "system/job.h"
+#include "system/pipe.h"
+#include "system/reactor.h"
+
+namespace oven {
+namespace system {
+namespace {
+const int kKillExitCode = 1;
+
+// Number of reads kept in flight for each of output streams, so that pipe
+// keeps being drained while completed reads are processed.
+const size_t kOutstandingReads = 4;
+
+// Overlapped read into a pooled segment, |overlapped| has to be the first
+// member: completion port hands it back.
+struct ReadOperation {
+  OVERLAPPED overlapped = {};
+  base::Segment buffer;
+  bool completed = false;
+  DWORD bytes_read = 0;
+  std::chrono::steady_clock::time_point receive_time;
+};
+
+// Reads child output streams on reactor thread until child closes them.
+// Pipe reads are overlapped: a few of them are kept in flight for each of
+// the streams, so that pipe keeps being drained while completed reads are
+// processed. Streams with passthrough are written to it right from the
+// buffers reads complete into.
+class OutputReader : public std::enable_shared_from_this<OutputReader> {
+ public:
+  OutputReader(Pipe stdoutput, Pipe stderror,
+               const base::OutputCapture::Limits& limits,
+               const ChildProcess::Passthrough& passthrough)
+      : outputs_{base::OutputCapture(limits), base::OutputCapture(limits),
+                 base::OutputTimeline()},
+        streams_{Stream(std::move(stdoutput), &outputs_.stdoutput,
+                        base::OutputTimeline::Stream::kStdout, passthrough.stdoutput),
+                 Stream(std::move(stderror), &outputs_.stderror,
+                        base::OutputTimeline::Stream::kStderr, passthrough.stderror)},
+        passthrough_file_(passthrough.file) {
+    for (Stream& stream : streams_) {
+      stream.pipe.out().reset();
+    }
+  }
+
+  // Reader keeps itself alive until both streams are closed.
+  std::future<ChildProcess::Outputs> Start() {
+    std::future<ChildProcess::Outputs> outputs = outputs_promise_.get_future();
+    Reactor::Get().Post([reader = shared_from_this()]() { reader->Watch(); });
+    return outputs;
+  }
+
+ private:
+  struct Stream {
+    Stream(Pipe pipe, base::OutputCapture* output,
+           const base::OutputTimeline::Stream id, const HANDLE passthrough)
+        : pipe(std::move(pipe)), output(output), id(id), passthrough(passthrough) {}
+
+    // Returns false if pipe is closed by child.
+    bool IssueRead() {
+      auto operation = std::make_unique<ReadOperation>();
+      if (!::ReadFile(pipe.in().get(), operation->buffer.data(),
+                      static_cast<DWORD>(base::Segment::kCapacity), NULL,
+                      &operation->overlapped) &&
+          ::GetLastError() != ERROR_IO_PENDING) {
+        return false;
+      }
+      reads.push_back(std::move(operation));
+      return true;
+    }
+
+    Pipe pipe;
+    base::OutputCapture* output;
+    base::OutputTimeline::Stream id;
+    HANDLE passthrough = NULL;
+    std::uintptr_t completion_key = 0;
+    // Reads in the order they were issued, as they complete in that order.
+    std::deque<std::unique_ptr<ReadOperation>> reads;
+    bool closed = false;
+  };
+
+  void Watch() {
+    for (Stream& stream : streams_) {
+      stream.completion_key = Reactor::Get().Associate(
+          stream.pipe.in().get(),
+          [reader = shared_from_this(), &stream](const IOCP::Completion& completion) {
+            reader->HandleRead(stream, completion);
+          });
+      if (!stream.completion_key) {
+        OutputError(L"Unable to assosiate pipe with compiltion port");
+        stream.closed = true;
+      }
+      while (stream.reads.size() < kOutstandingReads && !stream.closed) {
+        stream.closed = !stream.IssueRead();
+      }
+      CloseIfDone(stream);
+    }
+  }
+
+  void HandleRead(Stream& stream, const IOCP::Completion& completion) {
+    ReadOperation* operation = reinterpret_cast<ReadOperation*>(completion.overlapped);
+    operation->completed = true;
+    operation->receive_time = std::chrono::steady_clock::now();
+    // Failed read is reported as well, e.g. once pipe is broken.
+    DWORD bytes_read = 0;
+    if (::GetOverlappedResult(stream.pipe.in().get(), &operation->overlapped,
+                              &bytes_read, FALSE)) {
+      operation->bytes_read = bytes_read;
+    } else {
+      stream.closed = true;
+    }
+
+    while (!stream.reads.empty() && stream.reads.front()->completed) {
+      const ReadOperation& completed = *stream.reads.front();
+      WriteToPassthrough(stream, completed.buffer.data(), completed.bytes_read);
+      stream.output->Append(
+          std::string_view(completed.buffer.data(), completed.bytes_read));
+      if (completed.bytes_read > 0) {
+        outputs_.timeline.Record(stream.id, completed.receive_time, completed.bytes_read);
+      }
+      stream.reads.pop_front();
+      if (!stream.closed) {
+        stream.closed = !stream.IssueRead();
+      }
+    }
+    CloseIfDone(stream);
+  }
+
+  void WriteToPassthrough(Stream& stream, const char* bytes, DWORD size) {
+    while (size > 0 && stream.passthrough) {
+      DWORD bytes_written = 0;
+      if (!::WriteFile(stream.passthrough, bytes, size, &bytes_written, NULL)) {
+        // Output keeps being captured even if passthrough is gone.
+        stream.passthrough = NULL;
+        break;
+      }
+      bytes += bytes_written;
+      size -= bytes_written;
+    }
+  }
+
+  // Pipe is only closed once there are no reads in flight, which refer to
+  // their buffers.
+  void CloseIfDone(Stream& stream) {
+    if (!stream.closed || !stream.reads.empty() || !stream.pipe.in()) {
+      return;
+    }
+    if (stream.completion_key) {
+      Reactor::Get().RemoveHandler(stream.completion_key);
+      stream.completion_key = 0;
+    }
+    stream.pipe.in().reset();
+    if (--open_streams_ == 0) {
+      outputs_.stdoutput.Finish();
+      outputs_.stderror.Finish();
+      outputs_promise_.set_value(std::move(outputs_));
+    }
+  }
+
+  ChildProcess::Outputs outputs_;
+  Stream streams_[2];
+  size_t open_streams_ = 2;
+  std::shared_ptr<ScopedHandle> passthrough_file_;
+  std::promise<ChildProcess::Outputs> outputs_promise_;
+};
+}  // anonymous namespace
+
+// static
+ChildProcess::Passthrough ChildProcess::Passthrough::Console() {
+  Passthrough passthrough;
+  passthrough.stdoutput = ::GetStdHandle(STD_OUTPUT_HANDLE);
+  passthrough.stderror = ::GetStdHandle(STD_ERROR_HANDLE);
+  return passthrough;
+}
+
+// static
+std::optional<ChildProcess::Passthrough> ChildProcess::Passthrough::OpenFile(
+    const std::filesystem::path& path) {
+  // Streams are written on reactor thread only, so they don't overwrite each
+  // other.
+  auto file = std::make_shared<ScopedHandle>(::CreateFileW(
+      path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+      CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL));
+  if (!*file) {
+    OutputError(L"Unable to open output passthrough file");
+    return std::optional<Passthrough>();
+  }
+  Passthrough passthrough;
+  passthrough.stdoutput = file->get();
+  passthrough.stderror = file->get();
+  passthrough.file = std::move(file);
+  return passthrough;
+}
+
+std::optional<unsigned long> ChildProcess::Run(Job& job) {
+  STARTUPINFOW startup_info {
+    sizeof(STARTUPINFOW),
+  };
+  return RunImpl(job, std::move(startup_info));
+}
+
+std::optional<unsigned long> ChildProcess::Run(
+    Job& job, const std::wstring_view desktop_name) {
+  STARTUPINFOW startup_info {
+    sizeof(STARTUPINFOW),
+  };
+  startup_info.lpDesktop = const_cast<LPWSTR>(desktop_name.data());
+  return RunImpl(job, std::move(startup_info));
+}
+
+std::uintptr_t ChildProcess::WatchExit() {
+  // Process handle is signalled once process exits.
+  return Reactor::Get().WatchObject(child_process_handle_.get(),
+                                    [this](const IOCP::Completion& /* completion */) {
+                                      HandleExit();
+                                    });
+}
+
+void ChildProcess::UnwatchExit() {
+  Reactor::Get().RemoveHandler(exit_completion_key_);
+}
+
+std::optional<int> ChildProcess::CollectExitCode() {
+  DWORD exit_code;
+  if (!::GetExitCodeProcess(child_process_handle_.get(), &exit_code)) {
+    OutputError(L"Unable to retrieve exit code of child process");
+    return std::optional<int>();
+  }
+  child_process_handle_.reset();
+  return static_cast<int>(exit_code);
+}
+
+std::optional<int> ChildProcess::Terminate() {
+#if defined(ENABLE_ASSERTIONS)
+  assert(IsAlive() && "Cannot terminate dead process");
+#endif
+  if (!::TerminateProcess(child_process_handle_.get(), kKillExitCode)) {
+    // TODO(matthewtff): Process May have terminated already, try to receive it's exit code here.
+    OutputError(L"Unable to teminate child process");
+    return {};
+  }
+  return Wait();
+}
+
+std::wstring ChildProcess::RenderEnvironment() const {
+  if (environment_.empty()) {
+    return std::wstring();
+  }
+  // Block is a sequence of null-terminated "name=value" strings, terminated
+  // by an extra null. Variable names are case insensitive.
+  const auto is_replaced = [this](const std::wstring_view inherited) {
+    return std::any_of(
+        environment_.begin(), environment_.end(), [&inherited](const auto& variable) {
+          const std::wstring& name = variable.first;
+          return inherited.size() > name.size() && inherited[name.size()] == L'=' &&
+                 ::CompareStringOrdinal(inherited.data(), static_cast<int>(name.size()),
+                                        name.data(), static_cast<int>(name.size()),
+                                        TRUE) == CSTR_EQUAL;
+        });
+  };
+  std::wstring environment;
+  if (wchar_t* inherited = ::GetEnvironmentStringsW()) {
+    for (const wchar_t* variable = inherited; *variable;
+         variable += std::wcslen(variable) + 1) {
+      if (!is_replaced(variable)) {
+        environment.append(variable);
+        environment.push_back(L'\0');
+      }
+    }
+    ::FreeEnvironmentStringsW(inherited);
+  }
+  for (const auto& [name, value] : environment_) {
+    environment.append(name).append(L"=").append(value);
+    environment.push_back(L'\0');
+  }
+  // Extra terminating null is the one c_str() ends with.
+  return environment;
+}
+
+std::optional<unsigned long> ChildProcess::RunImpl(
+    Job& job, STARTUPINFOW&& startup_info) {
+
+  startup_info.dwFlags = STARTF_USESTDHANDLES;
+  Pipe stdout_stream(pipe_buffer_size_);
+  Pipe stderr_stream(pipe_buffer_size_);
+  startup_info.hStdOutput = stdout_stream.out().get();
+  startup_info.hStdError = stderr_stream.out().get();
+
+  auto report_failure = [this](const wchar_t* message) {
+    OutputError(message);
+    std::promise<Outputs> empty_outputs;
+    output_streams_future_ = empty_outputs.get_future();
+    empty_outputs.set_value({});
+    return std::optional<unsigned long>();
+  };
+
+  // Process is created right inside of the job, so that there is no window
+  // for it to spawn anything outside of the job. Job has to listen for
+  // notifications before that not to miss the ones about the new process.
+  if (!job.StartListening()) {
+    return report_failure(L"Unable to listen for job notifications");
+  }
+  HANDLE job_handle = job.handle();
+  SIZE_T attribute_list_size = 0;
+  ::InitializeProcThreadAttributeList(NULL, 1, 0, &attribute_list_size);
+  std::vector<char> attribute_list_storage(attribute_list_size);
+  const auto attribute_list =
+      reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attribute_list_storage.data());
+  if (!::InitializeProcThreadAttributeList(attribute_list, 1, 0, &attribute_list_size)) {
+    return report_failure(L"Unable to initialize process attributes");
+  }
+  const bool job_list_updated = ::UpdateProcThreadAttribute(
+      attribute_list, 0, PROC_THREAD_ATTRIBUTE_JOB_LIST, &job_handle,
+      sizeof(job_handle), NULL, NULL);
+
+  STARTUPINFOEXW startup_info_ex = {};
+  startup_info_ex.StartupInfo = startup_info;
+  startup_info_ex.StartupInfo.cb = sizeof(STARTUPINFOEXW);
+  startup_info_ex.lpAttributeList = attribute_list;
+
+  std::wstring command_line = RenderCommandLine();
+  const std::wstring environment = RenderEnvironment();
+  PROCESS_INFORMATION process_info;
+  const bool process_created = job_list_updated && ::CreateProcessW(
+      const_cast<LPWSTR>(executable_path_.c_str()),
+      const_cast<LPWSTR>(command_line.c_str()),
+      NULL, NULL, TRUE,
+      EXTENDED_STARTUPINFO_PRESENT | CREATE_SUSPENDED | CREATE_NEW_PROCESS_GROUP |
+          CREATE_UNICODE_ENVIRONMENT,
+      environment.empty() ? NULL : const_cast<wchar_t*>(environment.c_str()),
+      working_directory_.empty() ? NULL : working_directory_.c_str(),
+      &startup_info_ex.StartupInfo, &process_info);
+  ::DeleteProcThreadAttributeList(attribute_list);
+  if (!process_created) {
+    return report_failure(L"Unable to start child process");
+  }
+
+  child_process_handle_.reset(process_info.hProcess);
+  const bool resumed = ::ResumeThread(process_info.hThread) != static_cast<DWORD>(-1);
+  ::CloseHandle(process_info.hThread);
+  if (!resumed) {
+    ::TerminateProcess(child_process_handle_.get(), kKillExitCode);
+    child_process_handle_.reset();
+    return report_failure(L"Unable to resume child process");
+  }
+  /* TODO(matthewtff): Decide whether reuiqred
+  if (!::WaitForInputIdle(child_process_handle_.get(), INFINITE)) {
+    OutputError(L"Unable to wait for child process");
+    std::optional<unsigned long>();
+  }*/
+
+  output_streams_future_ =
+      std::make_shared<OutputReader>(std::move(stdout_stream),
+                                     std::move(stderr_stream), output_limits_,
+                                     output_passthrough_)
+          ->Start();
+  return process_info.dwProcessId;
+}
+
+}  // namespace system
+}  // namespace oven
@@ -1,7 +1,9 @@
 #ifndef _OVEN_SYSTEM_DESKTOP_H_
 #define _OVEN_SYSTEM_DESKTOP_H_
 
+#if defined(_WIN32)
 #include <Windows.h>
+#endif
 
 #include <optional>
 #include <string>
@@ -12,6 +14,9 @@
 namespace oven {
 namespace system {
 
+// On POSIX systems there are no desktops to isolate from, so Desktop is
+// headless: it only remembers its name and heap size, and child processes
+// share the session of the current process.
 class Desktop {
  public:
   // Creates new desktop within the current window station.
@@ -26,7 +31,11 @@ class Desktop {
 
   static std::optional<Desktop> OpenInteractive();
 
+#if defined(_WIN32)
   bool IsValid() const noexcept { return desktop_handle_ != NULL; }
+#else
+  bool IsValid() const noexcept { return true; }
+#endif
 
   std::optional<std::wstring> GetName() const noexcept;
 
@@ -37,11 +46,18 @@ class Desktop {
  private:
   friend class ScopedDesktopActivation;
 
+#if defined(_WIN32)
   explicit Desktop(const HDESK desktop_handle);
+#endif
   bool Activate() const noexcept;
   void Release() noexcept;
 
+#if defined(_WIN32)
   HDESK desktop_handle_;
+#else
+  std::wstring name_;
+  size_t heap_size_;
+#endif
 };
 
 class ScopedDesktopActivation {
@@ -0,0 +1,52 @@
+#include "system/desktop.h"
+
+namespace oven {
+namespace system {
+
+Desktop::Desktop(const std::wstring_view desktop_name,
+                 const size_t heap_size)
+    : name_(desktop_name), heap_size_(heap_size) {
+}
+
+Desktop::~Desktop() {
+  Release();
+}
+
+Desktop::Desktop(Desktop&& other) noexcept
+    : name_(std::move(other.name_)), heap_size_(other.heap_size_) {
+}
+
+Desktop& Desktop::operator=(Desktop&& other) noexcept {
+  Release();
+  name_ = std::move(other.name_);
+  heap_size_ = other.heap_size_;
+  return *this;
+}
+
+// static
+std::optional<Desktop> Desktop::OpenInteractive() {
+  // There is no interactive desktop to switch back to.
+  return std::optional<Desktop>();
+}
+
+std::optional<std::wstring> Desktop::GetName() const noexcept {
+  return name_;
+}
+
+std::optional<size_t> Desktop::GetHeapSize() const noexcept {
+  return heap_size_;
+}
+
+bool Desktop::SetForCurrentThread() const {
+  return true;
+}
+
+bool Desktop::Activate() const noexcept {
+  return true;
+}
+
+void Desktop::Release() noexcept {
+}
+
+}  // namespace system
+}  // namespace oven
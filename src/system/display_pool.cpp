@@ -0,0 +1,264 @@
+#include "system/display_pool.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+namespace oven {
+namespace system {
+namespace {
+const char kLockDirectoryName[] = "oven-displays";
+// Descriptor server writes display number to once it's ready.
+const int kDisplayDescriptor = 3;
+// Time server has to exit in once asked to, before it's killed.
+const std::chrono::milliseconds kStopTimeout{2000};
+
+// Process id of X server running |display|, as written to its lock file, 0
+// if there is none. Lock file is left behind by killed server, so process
+// is checked to be the server: its id may have been reused.
+pid_t ReadServerProcessId(const unsigned int display) {
+  const std::string display_name = ":" + std::to_string(display);
+  std::ifstream lock_file("/tmp/.X" + std::to_string(display) + "-lock");
+  pid_t process_id = 0;
+  if (!(lock_file >> process_id) || process_id <= 0) {
+    return 0;
+  }
+  std::ifstream command_line("/proc/" + std::to_string(process_id) + "/cmdline");
+  std::string argument;
+  while (std::getline(command_line, argument, '\0')) {
+    if (argument == display_name) {
+      return process_id;
+    }
+  }
+  return 0;
+}
+
+// Returns true if |process_id| has exited within |timeout|.
+bool WaitForExit(const pid_t process_id, const std::chrono::milliseconds timeout) {
+  // Server isn't a child of the current process, so pidfd is the only way
+  // to wait for it.
+  ScopedHandle process(static_cast<NativeHandle>(::syscall(SYS_pidfd_open, process_id, 0)));
+  if (!process) {
+    return errno == ESRCH;
+  }
+  pollfd exit_poll = {process.get(), POLLIN, 0};
+  return ::poll(&exit_poll, 1, static_cast<int>(timeout.count())) > 0;
+}
+
+// Reads number of runs served from the lock file of display.
+size_t ReadUses(const ScopedHandle& lock) {
+  char buffer[32] = {};
+  if (::pread(lock.get(), buffer, sizeof(buffer) - 1, 0) <= 0) {
+    return 0;
+  }
+  return static_cast<size_t>(std::strtoull(buffer, nullptr, 10));
+}
+
+void WriteUses(const ScopedHandle& lock, const size_t uses) {
+  const std::string value = std::to_string(uses);
+  if (::pwrite(lock.get(), value.data(), value.size(), 0) !=
+          static_cast<ssize_t>(value.size()) ||
+      ::ftruncate(lock.get(), static_cast<off_t>(value.size())) != 0) {
+    std::wclog << L"Unable to count display use\n";
+  }
+}
+}  // anonymous namespace
+
+// static
+std::filesystem::path DisplayPool::GetDefaultLockDirectory() {
+  std::error_code error;
+  return std::filesystem::temp_directory_path(error) / kLockDirectoryName;
+}
+
+DisplayPool::DisplayPool(Options options) : options_(std::move(options)) {
+  // Directory is shared by oven processes of all users.
+  std::error_code error;
+  if (std::filesystem::create_directories(options_.lock_directory, error)) {
+    std::filesystem::permissions(
+        options_.lock_directory,
+        std::filesystem::perms::all | std::filesystem::perms::sticky_bit, error);
+  }
+}
+
+void DisplayPool::Prestart() {
+  for (size_t slot = 0; slot < options_.size; ++slot) {
+    const unsigned int display = options_.first_display + static_cast<unsigned int>(slot);
+    // Leased displays are running already.
+    const ScopedHandle lock = Lock(GetLockPath(display), false /* wait */);
+    if (lock && !Prepare(display, lock, false /* count_use */)) {
+      std::wclog << L"Unable to start server of display :" << display << L"\n";
+    }
+  }
+}
+
+std::optional<DisplayLease> DisplayPool::Acquire() {
+  if (options_.size == 0) {
+    return std::optional<DisplayLease>();
+  }
+  std::optional<unsigned int> display;
+  ScopedHandle lock;
+  for (size_t slot = 0; slot < options_.size && !lock; ++slot) {
+    display = options_.first_display + static_cast<unsigned int>(slot);
+    lock = Lock(GetLockPath(*display), false /* wait */);
+  }
+  if (!lock) {
+    display = options_.first_display +
+              static_cast<unsigned int>(next_waited_display_++ % options_.size);
+    lock = Lock(GetLockPath(*display), true /* wait */);
+  }
+  if (!lock || !Prepare(*display, lock, true /* count_use */)) {
+    return std::optional<DisplayLease>();
+  }
+  return DisplayLease(*display, std::move(lock));
+}
+
+// static
+ScopedHandle DisplayPool::Lock(const std::filesystem::path& path, const bool wait) {
+  // Lock files are shared by oven processes of all users.
+  ScopedHandle file(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666));
+  if (!file) {
+    return ScopedHandle();
+  }
+  ::fchmod(file.get(), 0666);
+  // flock locks belong to open file description, so that runs within the
+  // same process are coordinated as well.
+  int result;
+  do {
+    result = ::flock(file.get(), wait ? LOCK_EX : LOCK_EX | LOCK_NB);
+  } while (result != 0 && errno == EINTR);
+  if (result != 0) {
+    return ScopedHandle();
+  }
+  return file;
+}
+
+// static
+bool DisplayPool::IsHealthy(const unsigned int display) {
+  if (ReadServerProcessId(display) == 0) {
+    return false;
+  }
+  ScopedHandle connection(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (!connection) {
+    return false;
+  }
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  const std::string path = "/tmp/.X11-unix/X" + std::to_string(display);
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  return ::connect(connection.get(), reinterpret_cast<const sockaddr*>(&address),
+                   sizeof(address)) == 0;
+}
+
+// static
+void DisplayPool::StopServer(const unsigned int display) {
+  const pid_t process_id = ReadServerProcessId(display);
+  if (process_id == 0 || ::kill(process_id, SIGTERM) != 0) {
+    return;
+  }
+  if (!WaitForExit(process_id, kStopTimeout)) {
+    ::kill(process_id, SIGKILL);
+    WaitForExit(process_id, kStopTimeout);
+  }
+}
+
+bool DisplayPool::StartServer(const unsigned int display) const {
+  // Everything the forked process needs is prepared ahead, as it may only
+  // make async-signal-safe calls.
+  std::vector<std::string> arguments{options_.server_path, ":" + std::to_string(display),
+                                     "-displayfd", std::to_string(kDisplayDescriptor)};
+  arguments.insert(arguments.end(), options_.server_arguments.begin(),
+                   options_.server_arguments.end());
+  std::vector<char*> argv;
+  for (std::string& argument : arguments) {
+    argv.push_back(argument.data());
+  }
+  argv.push_back(nullptr);
+
+  int ready_pipe[2];
+  if (::pipe2(ready_pipe, O_CLOEXEC) != 0) {
+    return false;
+  }
+  ScopedHandle ready_read(ready_pipe[0]);
+  ScopedHandle ready_write(ready_pipe[1]);
+
+  // Server is detached into a session of its own, so that it outlives the
+  // current process and isn't signaled along with it.
+  const pid_t process_id = ::fork();
+  if (process_id < 0) {
+    return false;
+  }
+  if (process_id == 0) {
+    ::setsid();
+    if (::fork() != 0) {
+      ::_exit(0);
+    }
+    const int null_device = ::open("/dev/null", O_RDWR);
+    ::dup2(null_device, STDIN_FILENO);
+    ::dup2(null_device, STDOUT_FILENO);
+    ::dup2(null_device, STDERR_FILENO);
+    // dup2 clears close-on-exec flag of the new descriptor, unless it's the
+    // same one.
+    if (ready_write.get() == kDisplayDescriptor) {
+      ::fcntl(kDisplayDescriptor, F_SETFD, 0);
+    } else {
+      ::dup2(ready_write.get(), kDisplayDescriptor);
+    }
+    ::execvp(argv.front(), argv.data());
+    ::_exit(127);
+  }
+  ready_write.reset();
+  int status;
+  while (::waitpid(process_id, &status, 0) < 0 && errno == EINTR) {
+  }
+
+  // Server writes display number once it accepts connections, or closes the
+  // pipe if it fails to start.
+  pollfd ready_poll = {ready_read.get(), POLLIN, 0};
+  const int ready = ::poll(&ready_poll, 1, static_cast<int>(options_.start_timeout.count()));
+  char number[16];
+  if (ready <= 0 || ::read(ready_read.get(), number, sizeof(number)) <= 0) {
+    StopServer(display);
+    return false;
+  }
+  return true;
+}
+
+bool DisplayPool::Prepare(const unsigned int display, const ScopedHandle& lock,
+                          const bool count_use) const {
+  size_t uses = ReadUses(lock);
+  const bool worn_out = options_.max_uses > 0 && uses >= options_.max_uses;
+  if (worn_out || !IsHealthy(display)) {
+    StopServer(display);
+    if (!StartServer(display)) {
+      return false;
+    }
+    uses = 0;
+  }
+  if (count_use) {
+    ++uses;
+  }
+  WriteUses(lock, uses);
+  return true;
+}
+
+std::filesystem::path DisplayPool::GetLockPath(const unsigned int display) const {
+  return options_.lock_directory / ("display-" + std::to_string(display) + ".lock");
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,114 @@
+#ifndef _OVEN_SYSTEM_DISPLAY_POOL_H_
+#define _OVEN_SYSTEM_DISPLAY_POOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+
+// Display leased to a single run, which has it to itself until the lease is
+// destroyed.
+class DisplayLease {
+ public:
+  DisplayLease(const DisplayLease&) = delete;
+  DisplayLease(DisplayLease&&) noexcept = default;
+
+  DisplayLease& operator=(const DisplayLease&) = delete;
+  DisplayLease& operator=(DisplayLease&&) noexcept = default;
+
+  unsigned int display() const noexcept { return display_; }
+
+  // Value of DISPLAY environment variable for the run, like ":100".
+  std::wstring GetName() const { return L":" + std::to_wstring(display_); }
+
+ private:
+  friend class DisplayPool;
+
+  DisplayLease(const unsigned int display, ScopedHandle lock)
+      : display_(display), lock_(std::move(lock)) {}
+
+  unsigned int display_;
+  ScopedHandle lock_;
+};
+
+// Headless X servers kept running between runs, the Linux counterpart of
+// virtual Desktop: each run gets a display of its own instead of sharing the
+// one of the current session, and doesn't wait for a server to start. Pool is
+// shared by all the oven processes on the system through lock files, one per
+// display, which also keep the number of runs display has served. Servers
+// that stop responding or have served |max_uses| runs are restarted.
+class DisplayPool {
+ public:
+  struct Options {
+    size_t size = 0;
+    // Displays from |first_display| to |first_display| + |size| are reserved
+    // for the pool.
+    unsigned int first_display = 100;
+    // Runs served by a server before it's restarted, 0 for no limit.
+    size_t max_uses = 50;
+    // Directory lock files are kept in, shared by all oven processes.
+    std::filesystem::path lock_directory;
+    // Server executable, found in PATH unless it's a path, and its arguments
+    // besides display number.
+    std::string server_path = "Xvfb";
+    std::vector<std::string> server_arguments = {"-screen", "0", "1280x1024x24",
+                                                 "-nolisten", "tcp"};
+    // Time server has to start accepting connections in.
+    std::chrono::milliseconds start_timeout{10000};
+  };
+
+  // Default lock directory, inside of the temporary one.
+  static std::filesystem::path GetDefaultLockDirectory();
+
+  explicit DisplayPool(Options options);
+
+  DisplayPool(const DisplayPool&) = delete;
+  DisplayPool& operator=(const DisplayPool&) = delete;
+
+  size_t size() const noexcept { return options_.size; }
+
+  // Starts servers of displays not leased at the moment, so that the first
+  // runs don't wait for them.
+  void Prestart();
+
+  // Leases a display with a running server, waiting for one if all of them
+  // are leased. Returns nothing if server can't be started.
+  std::optional<DisplayLease> Acquire();
+
+ private:
+  // Locks file exclusively, returns invalid handle if it's locked by someone
+  // else and |wait| is false.
+  static ScopedHandle Lock(const std::filesystem::path& path, const bool wait);
+
+  // Returns true if server of |display| is alive and accepts connections.
+  static bool IsHealthy(const unsigned int display);
+  // Asks server of |display| to exit, killing it if it doesn't.
+  static void StopServer(const unsigned int display);
+  bool StartServer(const unsigned int display) const;
+
+  // Makes sure locked |display| has a server that may take one more run,
+  // which is counted in its lock file.
+  bool Prepare(const unsigned int display, const ScopedHandle& lock,
+               const bool count_use) const;
+
+  std::filesystem::path GetLockPath(const unsigned int display) const;
+
+  Options options_;
+  // Display to wait for once all of them are leased, rotated so that waiting
+  // runs don't pile up on the same one.
+  std::atomic<size_t> next_waited_display_{0};
+};
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_DISPLAY_POOL_H_
@@ -0,0 +1,30 @@
+#include "system/error.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "base/string_conversion.h"
+
+namespace oven {
+namespace system {
+std::wstring GetErrorMessage(const int message_code) {
+  std::wstring error_message;
+  if (message_code != 0) {
+    error_message = base::Utf8ToWide(std::strerror(message_code));
+  }
+  return error_message;
+}
+
+std::wstring GetErrorMessage() {
+  return GetErrorMessage(errno);
+}
+
+void OutputError(const wchar_t* message) {
+  // Collect the message first: writing to |std::wclog| may clobber errno.
+  const std::wstring error_message = GetErrorMessage();
+  std::wclog << message << L": " << error_message << L'\n';
+}
+}  // namespace system
+}  // namespace oven
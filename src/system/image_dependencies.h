@@ -0,0 +1,22 @@
+#ifndef _OVEN_SYSTEM_IMAGE_DEPENDENCIES_H_
+#define _OVEN_SYSTEM_IMAGE_DEPENDENCIES_H_
+
+#include <filesystem>
+#include <vector>
+
+namespace oven {
+namespace system {
+
+// Returns shared libraries executable |image| is linked against, directly or
+// through other libraries, as the loader would find them: ELF DT_NEEDED
+// entries searched in the run paths, LD_LIBRARY_PATH and the default
+// directories on Linux, PE imports found next to the image on Windows (the
+// rest come from the system). Libraries that can't be found, or are loaded
+// at run time, are left out.
+std::vector<std::filesystem::path> FindImageDependencies(
+    const std::filesystem::path& image);
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_IMAGE_DEPENDENCIES_H_
@@ -0,0 +1,182 @@
+#include "system/image_dependencies.h"
+
+#include <elf.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <set>
+#include <string>
+#include <system_error>
+
+namespace oven {
+namespace system {
+namespace {
+// Searched after run paths and LD_LIBRARY_PATH, like ld.so does without
+// its cache.
+const char* const kDefaultLibraryDirectories[] = {
+    "/lib64", "/usr/lib64", "/lib/x86_64-linux-gnu", "/usr/lib/x86_64-linux-gnu",
+    "/lib/aarch64-linux-gnu", "/usr/lib/aarch64-linux-gnu", "/lib", "/usr/lib",
+    "/usr/local/lib"};
+
+// Dynamic section of 64-bit ELF image: names of libraries it needs and
+// directories to look for them in.
+struct DynamicSection {
+  std::vector<std::string> needed;
+  std::vector<std::string> run_paths;
+};
+
+template <typename T>
+bool ReadAt(std::ifstream& file, const std::uint64_t offset, T* value) {
+  file.seekg(static_cast<std::streamoff>(offset));
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+std::string ReadString(std::ifstream& file, const std::uint64_t offset) {
+  file.seekg(static_cast<std::streamoff>(offset));
+  std::string value;
+  std::getline(file, value, '\0');
+  return value;
+}
+
+// Splits list like "/a:/b" of run path or LD_LIBRARY_PATH, substituting
+// $ORIGIN with |origin|.
+void AppendDirectories(const std::string& list, const std::string& origin,
+                       std::vector<std::string>* directories) {
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(':', start);
+    if (end == list.npos) {
+      end = list.size();
+    }
+    std::string directory = list.substr(start, end - start);
+    for (const char* variable : {"${ORIGIN}", "$ORIGIN"}) {
+      for (size_t position = directory.find(variable); position != directory.npos;
+           position = directory.find(variable, position + origin.size())) {
+        directory.replace(position, std::strlen(variable), origin);
+      }
+    }
+    if (!directory.empty()) {
+      directories->push_back(directory);
+    }
+    start = end + 1;
+  }
+}
+
+std::optional<DynamicSection> ReadDynamicSection(const std::filesystem::path& image) {
+  std::ifstream file(image, std::ios::binary);
+  Elf64_Ehdr header;
+  if (!ReadAt(file, 0, &header) || std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      header.e_ident[EI_CLASS] != ELFCLASS64 ||
+      header.e_phentsize != sizeof(Elf64_Phdr)) {
+    return std::optional<DynamicSection>();
+  }
+
+  // String table is referred to by address, which is translated to file
+  // offset through the segment it's loaded with.
+  std::vector<Elf64_Phdr> loads;
+  std::optional<Elf64_Phdr> dynamic;
+  for (Elf64_Half index = 0; index < header.e_phnum; ++index) {
+    Elf64_Phdr segment;
+    if (!ReadAt(file, header.e_phoff + index * sizeof(Elf64_Phdr), &segment)) {
+      return std::optional<DynamicSection>();
+    }
+    if (segment.p_type == PT_LOAD) {
+      loads.push_back(segment);
+    } else if (segment.p_type == PT_DYNAMIC) {
+      dynamic = segment;
+    }
+  }
+  // Statically linked image needs nothing.
+  DynamicSection section;
+  if (!dynamic) {
+    return section;
+  }
+
+  std::vector<std::uint64_t> needed;
+  std::vector<std::uint64_t> run_paths;
+  std::optional<std::uint64_t> string_table;
+  for (std::uint64_t offset = 0; offset + sizeof(Elf64_Dyn) <= dynamic->p_filesz;
+       offset += sizeof(Elf64_Dyn)) {
+    Elf64_Dyn entry;
+    if (!ReadAt(file, dynamic->p_offset + offset, &entry) || entry.d_tag == DT_NULL) {
+      break;
+    }
+    if (entry.d_tag == DT_NEEDED) {
+      needed.push_back(entry.d_un.d_val);
+    } else if (entry.d_tag == DT_RUNPATH || entry.d_tag == DT_RPATH) {
+      run_paths.push_back(entry.d_un.d_val);
+    } else if (entry.d_tag == DT_STRTAB) {
+      for (const Elf64_Phdr& load : loads) {
+        if (entry.d_un.d_ptr >= load.p_vaddr &&
+            entry.d_un.d_ptr < load.p_vaddr + load.p_filesz) {
+          string_table = entry.d_un.d_ptr - load.p_vaddr + load.p_offset;
+        }
+      }
+    }
+  }
+  if (!string_table) {
+    return std::optional<DynamicSection>();
+  }
+  for (const std::uint64_t name : needed) {
+    section.needed.push_back(ReadString(file, *string_table + name));
+  }
+  const std::string origin = image.parent_path().string();
+  for (const std::uint64_t run_path : run_paths) {
+    AppendDirectories(ReadString(file, *string_table + run_path), origin,
+                      &section.run_paths);
+  }
+  return section;
+}
+}  // anonymous namespace
+
+std::vector<std::filesystem::path> FindImageDependencies(
+    const std::filesystem::path& image) {
+  std::vector<std::string> library_path;
+  if (const char* variable = std::getenv("LD_LIBRARY_PATH")) {
+    AppendDirectories(variable, std::string(), &library_path);
+  }
+
+  std::vector<std::filesystem::path> dependencies;
+  std::set<std::string> seen;
+  std::deque<std::filesystem::path> pending{image};
+  while (!pending.empty()) {
+    const std::filesystem::path current = pending.front();
+    pending.pop_front();
+    const auto section = ReadDynamicSection(current);
+    if (!section) {
+      continue;
+    }
+    for (const std::string& name : section->needed) {
+      if (!seen.insert(name).second) {
+        continue;
+      }
+      std::vector<std::string> directories = section->run_paths;
+      directories.insert(directories.end(), library_path.begin(), library_path.end());
+      directories.insert(directories.end(), std::begin(kDefaultLibraryDirectories),
+                         std::end(kDefaultLibraryDirectories));
+      // Names with slashes are paths already.
+      if (name.find('/') != name.npos) {
+        directories = {std::string()};
+      }
+      for (const std::string& directory : directories) {
+        std::error_code error;
+        const std::filesystem::path library =
+            directory.empty() ? std::filesystem::path(name)
+                              : std::filesystem::path(directory) / name;
+        if (std::filesystem::is_regular_file(library, error)) {
+          dependencies.push_back(library);
+          pending.push_back(library);
+          break;
+        }
+      }
+    }
+  }
+  return dependencies;
+}
+
+}  // namespace system
+}  // namespace oven
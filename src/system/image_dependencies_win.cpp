@@ -0,0 +1,127 @@
+#include "system/image_dependencies.h"
+
+#include <Windows.h>
+
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <set>
+#include <string>
+#include <system_error>
+
+namespace oven {
+namespace system {
+namespace {
+template <typename T>
+bool ReadAt(std::ifstream& file, const std::uint64_t offset, T* value) {
+  file.seekg(static_cast<std::streamoff>(offset));
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+// Returns names of DLLs PE |image| imports, nothing if it's not a PE image.
+std::optional<std::vector<std::string>> ReadImports(const std::filesystem::path& image) {
+  std::ifstream file(image, std::ios::binary);
+  IMAGE_DOS_HEADER dos_header;
+  DWORD signature;
+  IMAGE_FILE_HEADER file_header;
+  if (!ReadAt(file, 0, &dos_header) || dos_header.e_magic != IMAGE_DOS_SIGNATURE ||
+      !ReadAt(file, dos_header.e_lfanew, &signature) ||
+      signature != IMAGE_NT_SIGNATURE ||
+      !ReadAt(file, dos_header.e_lfanew + sizeof(signature), &file_header)) {
+    return std::optional<std::vector<std::string>>();
+  }
+
+  // Import directory is located the same way in 32 and 64-bit images, only
+  // the optional header differs.
+  const std::uint64_t optional_header_offset =
+      dos_header.e_lfanew + sizeof(signature) + sizeof(file_header);
+  WORD magic;
+  IMAGE_DATA_DIRECTORY imports = {};
+  if (!ReadAt(file, optional_header_offset, &magic)) {
+    return std::optional<std::vector<std::string>>();
+  }
+  if (magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+    IMAGE_OPTIONAL_HEADER64 optional_header;
+    if (!ReadAt(file, optional_header_offset, &optional_header)) {
+      return std::optional<std::vector<std::string>>();
+    }
+    imports = optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+  } else {
+    IMAGE_OPTIONAL_HEADER32 optional_header;
+    if (!ReadAt(file, optional_header_offset, &optional_header)) {
+      return std::optional<std::vector<std::string>>();
+    }
+    imports = optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+  }
+
+  std::vector<IMAGE_SECTION_HEADER> sections(file_header.NumberOfSections);
+  for (size_t index = 0; index < sections.size(); ++index) {
+    if (!ReadAt(file,
+                optional_header_offset + file_header.SizeOfOptionalHeader +
+                    index * sizeof(IMAGE_SECTION_HEADER),
+                &sections[index])) {
+      return std::optional<std::vector<std::string>>();
+    }
+  }
+  // Imports are referred to by relative addresses, which are translated to
+  // file offsets through the sections they are loaded with.
+  const auto to_file_offset = [&sections](const DWORD address) -> std::optional<std::uint64_t> {
+    for (const IMAGE_SECTION_HEADER& section : sections) {
+      if (address >= section.VirtualAddress &&
+          address < section.VirtualAddress + section.SizeOfRawData) {
+        return address - section.VirtualAddress + section.PointerToRawData;
+      }
+    }
+    return std::optional<std::uint64_t>();
+  };
+
+  std::vector<std::string> names;
+  const auto descriptors = to_file_offset(imports.VirtualAddress);
+  if (!descriptors) {
+    return names;
+  }
+  for (std::uint64_t offset = *descriptors;; offset += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+    IMAGE_IMPORT_DESCRIPTOR descriptor;
+    if (!ReadAt(file, offset, &descriptor) || descriptor.Name == 0) {
+      break;
+    }
+    if (const auto name_offset = to_file_offset(descriptor.Name)) {
+      file.seekg(static_cast<std::streamoff>(*name_offset));
+      std::string name;
+      std::getline(file, name, '\0');
+      names.push_back(name);
+    }
+  }
+  return names;
+}
+}  // anonymous namespace
+
+std::vector<std::filesystem::path> FindImageDependencies(
+    const std::filesystem::path& image) {
+  const std::filesystem::path directory = image.parent_path();
+  std::vector<std::filesystem::path> dependencies;
+  std::set<std::filesystem::path> seen;
+  std::deque<std::filesystem::path> pending{image};
+  while (!pending.empty()) {
+    const std::filesystem::path current = pending.front();
+    pending.pop_front();
+    const auto imports = ReadImports(current);
+    if (!imports) {
+      continue;
+    }
+    for (const std::string& name : *imports) {
+      std::error_code error;
+      const std::filesystem::path library = directory / name;
+      if (seen.insert(library).second &&
+          std::filesystem::is_regular_file(library, error)) {
+        dependencies.push_back(library);
+        pending.push_back(library);
+      }
+    }
+  }
+  return dependencies;
+}
+
+}  // namespace system
+}  // namespace oven
@@ -2,12 +2,17 @@
 #define _OVEN_SYSTEM_IOCP_H_
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 #include "system/scoped_handle.h"
 
 namespace oven {
 namespace system {
 
+// I/O completion port. On POSIX systems it is emulated with epoll: handles are
+// associated with a completion key and |Wait| reports keys of handles that
+// became readable (or hung up).
 class IOCP {
  public:
   enum class WaitResult {
@@ -16,18 +21,59 @@ class IOCP {
     kFailure,
     kSuccess,
   };
+
+  struct Completion {
+    std::uintptr_t completion_key;
+#if defined(_WIN32)
+    OVERLAPPED* overlapped;
+    DWORD bytes_transferred;
+#endif
+  };
+
+  // Largest number of completions dequeued by a single |Wait|.
+  static constexpr size_t kMaxCompletions = 64;
+
   IOCP();
 
+#if defined(_WIN32)
   WaitResult Wait(const std::chrono::milliseconds timeout,
                   PULONG_PTR completion_key,
                   OVERLAPPED** overlapped, DWORD* bytes_tranferred);
+#else
+  enum class Readiness {
+    kReadable = 0,
+    kWritable,
+  };
+
+  // Starts watching |handle| for |readiness|. Handle is removed from the port
+  // automatically once it and all of its duplicates are closed.
+  bool Associate(const NativeHandle handle, const std::uintptr_t completion_key,
+                 const Readiness readiness = Readiness::kReadable);
+
+  // Stops watching |handle|.
+  bool Dissociate(const NativeHandle handle);
+
+  WaitResult Wait(const std::chrono::milliseconds timeout,
+                  std::uintptr_t* completion_key);
+#endif
+
+  // Dequeues up to |capacity| completions at once (but no more than
+  // |kMaxCompletions|), setting |count| to the number of them on success.
+  // Reports |kStopped| if port is stopped, whatever else is dequeued along.
+  WaitResult Wait(const std::chrono::milliseconds timeout,
+                  Completion* completions, const size_t capacity,
+                  size_t* count);
 
-  const HANDLE handle() const noexcept { return handle_.get(); }
+  const NativeHandle handle() const noexcept { return handle_.get(); }
 
   bool Stop() const noexcept;
 
  private:
   ScopedHandle handle_;
+#if !defined(_WIN32)
+  // eventfd signalled by |Stop|.
+  ScopedHandle stop_event_;
+#endif
 };
 
 }  // namespace system
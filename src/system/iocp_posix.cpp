@@ -0,0 +1,96 @@
+#include "system/iocp.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+
+namespace oven {
+namespace system {
+namespace {
+const std::uintptr_t kStopCompletionKey = 0xdeadbeef;
+
+int ToPollTimeout(const std::chrono::milliseconds timeout) {
+  if (timeout.count() < 0 || timeout.count() > std::numeric_limits<int>::max())
+    return -1;  // Infinite.
+  return static_cast<int>(timeout.count());
+}
+}  // anonymous namespace
+
+IOCP::IOCP()
+    : handle_(::epoll_create1(EPOLL_CLOEXEC)),
+      stop_event_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+  Associate(stop_event_.get(), kStopCompletionKey);
+}
+
+bool IOCP::Associate(const NativeHandle handle,
+                     const std::uintptr_t completion_key,
+                     const Readiness readiness) {
+  epoll_event event = {};
+  event.events = readiness == Readiness::kWritable ? EPOLLOUT : EPOLLIN;
+  event.data.u64 = completion_key;
+  return ::epoll_ctl(handle_.get(), EPOLL_CTL_ADD, handle, &event) == 0;
+}
+
+bool IOCP::Dissociate(const NativeHandle handle) {
+  return ::epoll_ctl(handle_.get(), EPOLL_CTL_DEL, handle, nullptr) == 0;
+}
+
+IOCP::WaitResult IOCP::Wait(const std::chrono::milliseconds timeout,
+                            std::uintptr_t* completion_key) {
+  epoll_event event;
+  int result;
+  do {
+    result = ::epoll_wait(handle_.get(), &event, 1, ToPollTimeout(timeout));
+  } while (result < 0 && errno == EINTR);
+
+  if (result < 0)
+    return WaitResult::kFailure;
+  if (result == 0)
+    return WaitResult::kTimeout;
+
+  *completion_key = static_cast<std::uintptr_t>(event.data.u64);
+  if (*completion_key == kStopCompletionKey) {
+    return WaitResult::kStopped;
+  }
+
+  return WaitResult::kSuccess;
+}
+
+IOCP::WaitResult IOCP::Wait(const std::chrono::milliseconds timeout,
+                            Completion* completions, const size_t capacity,
+                            size_t* count) {
+  epoll_event events[kMaxCompletions];
+  int result;
+  do {
+    result = ::epoll_wait(handle_.get(), events,
+                          static_cast<int>(std::min(capacity, kMaxCompletions)),
+                          ToPollTimeout(timeout));
+  } while (result < 0 && errno == EINTR);
+
+  if (result < 0)
+    return WaitResult::kFailure;
+  if (result == 0)
+    return WaitResult::kTimeout;
+
+  *count = 0;
+  bool stopped = false;
+  for (int index = 0; index < result; ++index) {
+    const auto completion_key = static_cast<std::uintptr_t>(events[index].data.u64);
+    if (completion_key == kStopCompletionKey) {
+      stopped = true;
+      continue;
+    }
+    completions[(*count)++].completion_key = completion_key;
+  }
+  return stopped ? WaitResult::kStopped : WaitResult::kSuccess;
+}
+
+bool IOCP::Stop() const noexcept {
+  return ::eventfd_write(stop_event_.get(), 1) == 0;
+}
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,71 @@
+#include "system/iocp.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace oven {
+namespace system {
+namespace {
+const ULONG_PTR kStopCompletionKey = 0xdeadbeef;
+
+DWORD ToWaitTimeout(const std::chrono::milliseconds timeout) {
+  if (timeout.count() < 0 || timeout.count() >= INFINITE)
+    return INFINITE;
+  return static_cast<DWORD>(timeout.count());
+}
+}
+
+IOCP::IOCP() :
+    handle_(::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0)) {}
+
+IOCP::WaitResult IOCP::Wait(
+    const std::chrono::milliseconds timeout, PULONG_PTR completion_key,
+    OVERLAPPED** overlapped, DWORD* bytes_tranferred) {
+  if (!::GetQueuedCompletionStatus(handle_.get(), bytes_tranferred,
+                                   completion_key, overlapped,
+                                   static_cast<DWORD>(timeout.count()))) {
+    const auto last_error = ::GetLastError();
+    return last_error == WAIT_TIMEOUT ? WaitResult::kTimeout : WaitResult::kFailure;
+  }
+  if (*completion_key == kStopCompletionKey) {
+    return WaitResult::kStopped;
+  }
+
+  return WaitResult::kSuccess;
+}
+
+IOCP::WaitResult IOCP::Wait(const std::chrono::milliseconds timeout,
+                            Completion* completions, const size_t capacity,
+                            size_t* count) {
+  OVERLAPPED_ENTRY entries[kMaxCompletions];
+  ULONG entries_removed = 0;
+  if (!::GetQueuedCompletionStatusEx(
+          handle_.get(), entries,
+          static_cast<ULONG>(std::min(capacity, kMaxCompletions)),
+          &entries_removed, ToWaitTimeout(timeout), FALSE)) {
+    const auto last_error = ::GetLastError();
+    return last_error == WAIT_TIMEOUT ? WaitResult::kTimeout : WaitResult::kFailure;
+  }
+
+  *count = 0;
+  bool stopped = false;
+  for (ULONG index = 0; index < entries_removed; ++index) {
+    if (entries[index].lpCompletionKey == kStopCompletionKey) {
+      stopped = true;
+      continue;
+    }
+    Completion& completion = completions[(*count)++];
+    completion.completion_key = entries[index].lpCompletionKey;
+    completion.overlapped = entries[index].lpOverlapped;
+    completion.bytes_transferred = entries[index].dwNumberOfBytesTransferred;
+  }
+  return stopped ? WaitResult::kStopped : WaitResult::kSuccess;
+}
+
+bool IOCP::Stop() const noexcept {
+  return ::PostQueuedCompletionStatus(handle_.get(), 0, kStopCompletionKey, NULL);
+}
+}  // namespace system
+}  // namespace oven
@@ -1,160 +1,179 @@
 #include "system/job.h"
 
-#include <Windows.h>
-
-#include <cassert>
-#include <chrono>
-#include <iostream>
+#include <future>
+#include <memory>
+#include <thread>
 
 #include "system/error.h"
 
 namespace oven {
 namespace system {
-namespace {
-const ULONG_PTR kJobNotificationCompletionKey = 0xbad;
-}
 
-void Job::Observer::HandleNotification(
-    const HANDLE job_handle,
-    OVERLAPPED* overlapped, const DWORD value) {
-  const unsigned long process_id = (unsigned long)overlapped;
-  switch (value) {
-    case JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS:
-      OnAbnormalExitProcess(process_id);
-      break;
-    case JOB_OBJECT_MSG_ACTIVE_PROCESS_LIMIT:
-      OnActiveProcessLimit();
-      break;
-    case JOB_OBJECT_MSG_ACTIVE_PROCESS_ZERO:
-      OnActiveProcessZero();
-      break;
-    case JOB_OBJECT_MSG_END_OF_JOB_TIME:
-      OnEndOfJobTime();
-      break;
-    case JOB_OBJECT_MSG_END_OF_PROCESS_TIME:
-      OnEndOfProcessTime(process_id);
-      break;
-    case JOB_OBJECT_MSG_EXIT_PROCESS:
-      OnExitProcess(process_id);
-      break;
-    case JOB_OBJECT_MSG_JOB_MEMORY_LIMIT:
-      OnExitProcess(process_id);
-      break;
-    case JOB_OBJECT_MSG_NEW_PROCESS:
-      OnNewProcess(process_id);
-      break;
-    case JOB_OBJECT_MSG_NOTIFICATION_LIMIT:
-      OnNotification(job_handle, process_id);
-      break;
-    default:
-      break;
+void Job::AddObserver(Observer* observer) {
+  std::lock_guard lock(observers_guard_);
+  const std::vector<Observer*>* current_observers = observers_.load();
+  auto observers = current_observers
+                       ? std::make_unique<std::vector<Observer*>>(*current_observers)
+                       : std::make_unique<std::vector<Observer*>>();
+  if (std::find(observers->begin(), observers->end(), observer) !=
+      observers->end()) {
+    return;
   }
+  observers->push_back(observer);
+  observers_ = observers.get();
+  observer_lists_.push_back(std::move(observers));
 }
 
-void Job::Observer::OnNotification(
-    const HANDLE job_handle, const unsigned long process_id) {
-  JOBOBJECT_LIMIT_VIOLATION_INFORMATION limit_violation;
-
-  if (!::QueryInformationJobObject(job_handle,
-      JobObjectLimitViolationInformation, &limit_violation,
-      sizeof(limit_violation), NULL)) {
-    OutputError(L"Unable to query job object information");
-  }
-
-  // TODO(matthewtff): Cleanup following outputs.
-  if (limit_violation.ViolationLimitFlags & JOB_OBJECT_LIMIT_JOB_MEMORY) {
-    std::wcout << L"Job reached memory limit with up to "
-               << limit_violation.JobMemory << L" bytes consumed";
+void Job::PostEvent(const Event::Type type, const unsigned long process_id,
+                    const std::uint64_t memory_used,
+                    const std::uint64_t memory_limit) {
+  const Event event{type, process_id, std::chrono::steady_clock::now(),
+                    memory_used, memory_limit};
+  // Dispatching thread is awake while queue is full, as every event in it
+  // is deferred: notifications are never dropped.
+  while (!events_.TryPush(event)) {
+    std::this_thread::yield();
   }
+  reactor_.Defer(this);
+}
 
-  if (limit_violation.ViolationLimitFlags & JOB_OBJECT_LIMIT_JOB_TIME) {
-    std::wcout << L"Job reached user-mode execution time limit with up to "
-               << static_cast<std::uint64_t>(limit_violation.PerJobUserTime.QuadPart)
-               << L" * 100ns consumed";
+void Job::RunDeferred() {
+  Event event;
+  if (events_.TryPop(&event)) {
+    DispatchEvent(event);
   }
 }
 
-Job::Job() : handle_(::CreateJobObjectW(NULL, NULL)) {}
-
-Job::~Job() {
-  stop_ = true;
-  job_iocp_.Stop();
-  if (listening_thread_.joinable()) {
-    listening_thread_.join();
+void Job::DispatchEvent(const Event& event) const {
+  const std::vector<Observer*>* observers = observers_.load();
+  if (!observers) {
+    return;
+  }
+  const unsigned long process_id = event.process_id;
+  for (Observer* observer : *observers) {
+    observer->OnEvent(event);
+    switch (event.type) {
+      case Event::Type::kAbnormalExitProcess:
+        observer->OnAbnormalExitProcess(process_id);
+        break;
+      case Event::Type::kActiveProcessLimit:
+        observer->OnActiveProcessLimit();
+        break;
+      case Event::Type::kActiveProcessZero:
+        observer->OnActiveProcessZero();
+        break;
+      case Event::Type::kEndOfJobTime:
+        observer->OnEndOfJobTime();
+        break;
+      case Event::Type::kEndOfProcessTime:
+        observer->OnEndOfProcessTime(process_id);
+        break;
+      case Event::Type::kExitProcess:
+        observer->OnExitProcess(process_id);
+        break;
+      case Event::Type::kJobMemoryLimit:
+        observer->OnJobMemoryLimit(event.memory_used, event.memory_limit);
+        break;
+      case Event::Type::kMemoryThreshold:
+        observer->OnMemoryThreshold(event.memory_used, event.memory_limit);
+        break;
+      case Event::Type::kNewProcess:
+        observer->OnNewProcess(process_id);
+        break;
+      case Event::Type::kProcessMemoryLimit:
+        observer->OnProcessMemoryLimit(process_id, event.memory_used,
+                                       event.memory_limit);
+        break;
+    }
   }
 }
 
-bool Job::SetBasicLimits(const BasicLimits& limits) {
-  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_information;
-  limit_information.JobMemoryLimit = static_cast<size_t>(limits.overall_memory_limit);
-  limit_information.ProcessMemoryLimit = static_cast<size_t>(limits.per_process_memory_limit);
-  limit_information.BasicLimitInformation.PerJobUserTimeLimit.QuadPart = limits.cpu_time_limit.count() * 1000;
-  limit_information.BasicLimitInformation.LimitFlags =
-      JOB_OBJECT_LIMIT_JOB_TIME | JOB_OBJECT_LIMIT_JOB_MEMORY |
-      JOB_OBJECT_LIMIT_PROCESS_MEMORY;
-  if (!::SetInformationJobObject(handle_.get(), ::JobObjectExtendedLimitInformation,
-          &limit_information, sizeof(limit_information))) {
-    OutputError(L"Unable to set basic limits for job");
-    return false;
+void Job::HandleActiveProcessZero() {
+  PostEvent(Event::Type::kActiveProcessZero);
+  if (on_teardown_done_) {
+    FinishTeardown(true);
   }
+}
 
-  return true;
+Job::TeardownTimes Job::Terminate() {
+  // Promise is shared, as reactor may still hold it once teardown is over.
+  auto times = std::make_shared<std::promise<TeardownTimes>>();
+  TerminateAsync([times](const TeardownTimes& teardown_times) {
+    times->set_value(teardown_times);
+  });
+  return times->get_future().get();
 }
 
-bool Job::AssignProcess(const HANDLE process) {
-  if (!::AssignProcessToJobObject(handle_.get(), process)) {
-    return false;
-  }
+void Job::TerminateAsync(TeardownCallback on_done) {
+  reactor_.Post([this, on_done = std::move(on_done)]() mutable {
+    on_teardown_done_ = std::move(on_done);
+    teardown_times_ = TeardownTimes();
+    teardown_killing_ = false;
+    teardown_phase_start_ = std::chrono::steady_clock::now();
+    if (!HasActiveProcesses()) {
+      FinishTeardown(true);
+      return;
+    }
+    if (teardown_policy_.grace_period.count() <= 0 || !StopProcesses()) {
+      KillOnTeardown();
+      return;
+    }
+    teardown_timer_ = reactor_.AddTimer(
+        teardown_phase_start_ + teardown_policy_.grace_period, [this]() {
+          teardown_timer_ = 0;
+          EndTeardownPhase();
+          KillOnTeardown();
+        });
+  });
+}
 
-  if (!listening_thread_.joinable()) {
-    listening_thread_ = std::thread(&Job::ListenForNotifications, this);
+void Job::KillOnTeardown() {
+  teardown_killing_ = true;
+  teardown_phase_start_ = std::chrono::steady_clock::now();
+  if (!KillProcesses()) {
+    OutputError(L"Unable to terminate job");
   }
+  teardown_timer_ = reactor_.AddTimer(
+      teardown_phase_start_ + teardown_policy_.kill_timeout, [this]() {
+        teardown_timer_ = 0;
+        FinishTeardown(false);
+      });
+}
 
-  JOBOBJECT_ASSOCIATE_COMPLETION_PORT iocp_association;
-  iocp_association.CompletionKey = PVOID(kJobNotificationCompletionKey);
-  iocp_association.CompletionPort = job_iocp_.handle();
+void Job::FinishTeardown(const bool completed) {
+  reactor_.CancelTimer(teardown_timer_);
+  teardown_timer_ = 0;
+  EndTeardownPhase();
+  teardown_times_.completed = completed;
+  const TeardownCallback on_done = std::move(on_teardown_done_);
+  on_teardown_done_ = nullptr;
+  on_done(teardown_times_);
+}
 
-  if (!::SetInformationJobObject(handle_.get(), JobObjectAssociateCompletionPortInformation,
-      &iocp_association, sizeof(iocp_association))) {
-    return false;
+void Job::EndTeardownPhase() {
+  const auto phase_time = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - teardown_phase_start_);
+  if (teardown_killing_) {
+    teardown_times_.kill_time = phase_time;
+  } else {
+    teardown_times_.stop_time = phase_time;
   }
-
-  return true;
 }
 
-void Job::ListenForNotifications() {
-  while (!stop_) {
-    OVERLAPPED* overlapped;
-    DWORD bytes_transferred;
-    ULONG_PTR completion_key;
-    const IOCP::WaitResult wait_result = job_iocp_.Wait(
-        std::chrono::seconds(1), &completion_key,
-        &overlapped, &bytes_transferred);
-
-    switch (wait_result) {
-      case IOCP::WaitResult::kTimeout:
-        continue;
-      case IOCP::WaitResult::kStopped:
-        return;
-      case IOCP::WaitResult::kFailure:
-        OutputError(L"Unable to dequeue message from iocp");
-        return;
-      case IOCP::WaitResult::kSuccess:
-#if defined(ENABLE_ASSERTIONS)
-        assert(kJobNotificationCompletionKey == completion_key &&
-               "Received unexpected completion key");
-#endif
-        NotifyObservers(overlapped, bytes_transferred);
-        break;
-    }
-  }
+Job::ProcessInfo& Job::AddProcessInfo(const unsigned long process_id) {
+  process_table_index_[process_id] = process_table_.size();
+  ProcessInfo& info = process_table_.emplace_back();
+  info.process_id = process_id;
+  return info;
 }
 
-void Job::NotifyObservers(OVERLAPPED* overlapped, const DWORD value) {
-  std::lock_guard lock(observers_guard_);
-  for (Observer* observer : observers_) {
-    observer->HandleNotification(handle_.get(), overlapped, value);
+Job::ProcessInfo* Job::FindProcessInfo(const unsigned long process_id) {
+  const auto index = process_table_index_.find(process_id);
+  if (index == process_table_index_.end()) {
+    return nullptr;
   }
+  return &process_table_[index->second];
 }
+
 }  // namespace system
 }  // namespace oven
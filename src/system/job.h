@@ -1,25 +1,84 @@
 #ifndef _OVEN_SYSTEM_JOB_H_
 #define _OVEN_SYSTEM_JOB_H_
 
+#if !defined(_WIN32)
+#include <sched.h>
+#include <sys/types.h>
+#endif
+
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <thread>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "base/spsc_queue.h"
+#if !defined(_WIN32)
+#include "system/cgroup.h"
+#endif
 #include "system/iocp.h"
+#include "system/reactor.h"
 #include "system/scoped_handle.h"
 
 namespace oven {
 namespace system {
-// Manages an unnamed job object.
-class Job {
+// Manages an unnamed job object. On Linux job is a cgroup v2 subtree, which
+// gets all the remaining processes killed on job destruction. If cgroup can't
+// be created job falls back to a process group, which only supports
+// per-process limits and tracks explicitly assigned processes.
+//
+// Job keeps a table of every process it has seen running inside of it. On
+// Linux processes are discovered from fork events of the kernel process
+// connector, which needs CAP_NET_ADMIN. Without it they are discovered by
+// rescanning the cgroup every |kProcessScanInterval|, so the ones that live
+// for less than that may be missed.
+//
+// Job is driven by the reactor: notifications are handled on reactor thread,
+// while observers are notified on its dispatching thread, so that a slow
+// observer doesn't hold jobs back from handling notifications.
+class Job : private Reactor::Deferrable {
  public:
+  struct Event {
+    enum class Type {
+      kAbnormalExitProcess,
+      kActiveProcessLimit,
+      kActiveProcessZero,
+      kEndOfJobTime,
+      kEndOfProcessTime,
+      kExitProcess,
+      kJobMemoryLimit,
+      kMemoryThreshold,
+      kNewProcess,
+      kProcessMemoryLimit,
+    };
+    Type type;
+    unsigned long process_id;
+    // Time job has received the notification at.
+    std::chrono::steady_clock::time_point time;
+    // Memory events carry memory used (by the job, or by the process for
+    // process limit) and the limit or threshold it has reached, in bytes.
+    // Values that couldn't be retrieved are 0.
+    std::uint64_t memory_used = 0;
+    std::uint64_t memory_limit = 0;
+  };
+
   class Observer {
    public:
     virtual ~Observer() = default;
+
+    // Called for every event ahead of the specific observation below, e.g. to
+    // learn when the event has happened.
+    virtual void OnEvent(const Event& event) {}
+
     // In all the following obervations |process_id| may equal 0 if it's value
     // wasn't delivered properly.
 
@@ -48,28 +107,113 @@ class Job {
 
     // Indicates that a process associated with the job caused
     // the job to exceed the job-wide memory limit (if one is in effect).
-    virtual void OnJobMemoryLimit() {}
+    // On Linux it's reported once the kernel fails to reclaim memory.
+    virtual void OnJobMemoryLimit(const std::uint64_t memory_used,
+                                  const std::uint64_t memory_limit) {}
+
+    // Indicates that memory used by the job has exceeded its memory
+    // threshold, ahead of reaching the limit. Reported again while job
+    // stays above the threshold, on Linux job is throttled meanwhile.
+    virtual void OnMemoryThreshold(const std::uint64_t memory_used,
+                                   const std::uint64_t memory_threshold) {}
 
     // Indicates that a process has been added to the job.
     virtual void OnNewProcess(const unsigned long process_id) {}
 
-    // Indicates that a process associated with a job that has
-    // registered for resource limit notifications has exceeded
-    // one or more limits.
-    void OnNotification(const HANDLE job_handle, const unsigned long process_id);
-
-    // TODO(matthewtff): Consider adding OnProcessMemoryLimit.
+    // Indicates that a process has exceeded the per-process memory limit.
+    // Only reported on Windows: on Linux process just fails to allocate.
+    virtual void OnProcessMemoryLimit(const unsigned long process_id,
+                                      const std::uint64_t memory_used,
+                                      const std::uint64_t memory_limit) {}
+  };
 
-    void HandleNotification(const HANDLE job_handle,
-        OVERLAPPED* overlapped, const DWORD value);
+  // Rates of block device I/O of all the processes of the job together,
+  // unlimited by default. Windows only limits overall I/O of the job, which
+  // is set to the lowest of the limits.
+  struct IoLimits {
+    std::uint64_t read_bytes_per_second = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t write_bytes_per_second = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t read_operations_per_second = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t write_operations_per_second = std::numeric_limits<std::uint64_t>::max();
   };
 
   struct BasicLimits {
     std::uint64_t overall_memory_limit;
     std::uint64_t per_process_memory_limit;
     std::chrono::milliseconds cpu_time_limit;
+    // Soft limit of memory used by the job: observers are notified once it's
+    // exceeded. Unlimited (or not lower than the overall limit) disables it.
+    std::uint64_t memory_threshold = std::numeric_limits<std::uint64_t>::max();
+    IoLimits io_limits;
+  };
+
+  // Processors (and NUMA nodes memory is allocated from) processes of the
+  // job may use, empty lists leave them unrestricted. Nodes are only
+  // enforced on Linux, on Windows memory follows processors by default.
+  struct Affinity {
+    std::vector<unsigned int> processors;
+    std::vector<unsigned int> memory_nodes;
+  };
+
+  // Resources consumed by all the processes of the job, including exited
+  // ones. Values the system doesn't account for are left empty.
+  struct Accounting {
+    struct IoCounters {
+      std::uint64_t read_operations = 0;
+      std::uint64_t write_operations = 0;
+      std::uint64_t read_bytes = 0;
+      std::uint64_t write_bytes = 0;
+    };
+    std::chrono::microseconds user_time{0};
+    std::chrono::microseconds kernel_time{0};
+    std::optional<std::uint64_t> peak_memory;
+    // Peak memory of the most demanding single process.
+    std::optional<std::uint64_t> peak_process_memory;
+    std::optional<std::uint64_t> total_processes;
+    // Block device I/O on Linux, all I/O requests on Windows.
+    std::optional<IoCounters> io;
+  };
+
+  // Lifecycle of a process that has been running inside of the job. Times
+  // are relative to job creation, values that couldn't be retrieved (e.g.
+  // process was gone already) are left empty.
+  struct ProcessInfo {
+    unsigned long process_id = 0;
+    unsigned long parent_process_id = 0;
+    std::wstring image_path;
+    std::wstring command_line;
+    std::chrono::microseconds start_time{0};
+    std::optional<std::chrono::microseconds> exit_time;
+    std::optional<int> exit_code;
+    std::chrono::microseconds user_time{0};
+    std::chrono::microseconds kernel_time{0};
+    // Peak resident memory on Linux, peak committed memory on Windows.
+    std::optional<std::uint64_t> peak_memory;
   };
 
+  // Processes are torn down in phases: they are asked to stop first (SIGTERM
+  // on Linux, CTRL_BREAK on Windows) and are killed once |grace_period|
+  // passes, unless all of them have exited by then.
+  struct TeardownPolicy {
+    // Zero kills processes right away.
+    std::chrono::milliseconds grace_period{0};
+    // Time killed processes have to exit, teardown fails after that.
+    std::chrono::milliseconds kill_timeout{10000};
+  };
+
+  // Durations of teardown phases, the ones that weren't reached are empty.
+  struct TeardownTimes {
+    std::optional<std::chrono::microseconds> stop_time;
+    std::optional<std::chrono::microseconds> kill_time;
+    // False if processes were still running once kill timeout passed.
+    bool completed = false;
+  };
+  using TeardownCallback = std::function<void(const TeardownTimes& times)>;
+
+#if !defined(_WIN32)
+  static constexpr std::chrono::milliseconds kProcessScanInterval{20};
+#endif
+
   Job();
   ~Job();
 
@@ -77,37 +221,233 @@ class Job {
   Job(Job&&) = delete;
   Job& operator=(Job&&) = delete;
 
+  // Limits have to be set before processes are spawned inside of the job.
   bool SetBasicLimits(const BasicLimits& limits);
 
+  // Affinity has to be set before processes are spawned inside of the job.
+  // On Linux job cgroup needs cpuset controller, otherwise affinity is
+  // applied to every process joining the job.
+  bool SetAffinity(const Affinity& affinity);
+
+  // Policy has to be set before the job is torn down.
+  void SetTeardownPolicy(const TeardownPolicy& policy) {
+    teardown_policy_ = policy;
+  }
+
+  // Tears down all the processes of the job according to the policy and
+  // calls |on_done| on reactor thread once active process count reaches
+  // zero, without polling. Only one teardown may be pending at a time.
+  void TerminateAsync(TeardownCallback on_done);
+
+  // Tears down the job like |TerminateAsync| and waits for it. Must not be
+  // called on reactor thread.
+  TeardownTimes Terminate();
+
+  // Returns accounting collected so far, nothing if job can't account for
+  // its processes (e.g. it's a process group).
+  std::optional<Accounting> QueryAccounting() const;
+
+  // Returns processes job has seen so far, in the order they were seen.
+  // Processes that have exited by now are reported as such, even if job
+  // wasn't notified about it yet.
+  std::vector<ProcessInfo> GetProcessTable();
+
+#if defined(_WIN32)
   // Assigns process to job and starts listening for notifications on iocp.
   bool AssignProcess(const HANDLE process);
 
+  // Job object handle, processes may be created inside of the job directly
+  // by passing it with PROC_THREAD_ATTRIBUTE_JOB_LIST.
+  HANDLE handle() const noexcept { return handle_.get(); }
+#else
+  // Moves process to job's cgroup (or process group), applies per-process
+  // limits to it and starts listening for notifications. Creation and exit
+  // of descendants are only reported if job is a cgroup.
+  bool AssignProcess(const pid_t process_id);
+
+  // Descriptor of job's cgroup, processes may be created inside of the job
+  // directly by passing it to clone3 with CLONE_INTO_CGROUP. Invalid if job
+  // is a process group.
+  NativeHandle handle() const noexcept {
+    return cgroup_ ? cgroup_->handle() : kInvalidNativeHandle;
+  }
+
+  // Joins process group and applies per-process limits, must be called by
+  // a process spawned inside of the job before it executes child image.
+  // Async-signal-safe, sets errno on failure.
+  bool SetupSpawnedProcess() const noexcept;
+
+  // Starts tracking process that was spawned inside of the job.
+  bool AddSpawnedProcess(const pid_t process_id, ScopedHandle process);
+
+  // Returns true if job is notified about every process of its cgroup, even
+  // the ones exiting before a scan would find them, which takes the process
+  // connector. Valid once job listens for notifications.
+  bool ReportsEveryProcess() const noexcept { return process_connector_ != nullptr; }
+
+  // Records image process has executed, job may have seen the process
+  // before it did.
+  void SetProcessImage(const pid_t process_id, const std::wstring_view image_path,
+                       const std::wstring_view command_line);
+#endif
+
+  // Starts handling notifications on reactor thread, if not handling yet.
+  // Call before creating processes inside of the job to not miss
+  // notifications about them.
+  bool StartListening();
+
   // Job doesn't own observers, so it's caller's responsibility to make sure
   // observers do outlive job.
-  void AddObserver(Observer* observer) {
-    std::lock_guard lock(observers_guard_);
-    if (std::find(observers_.begin(), observers_.end(), observer) ==
-            observers_.end()) {
-      observers_.push_back(observer);
-    }
-  }
+  void AddObserver(Observer* observer);
 
  private:
-  void ListenForNotifications();
-  void NotifyObservers(OVERLAPPED* overlapped, const DWORD value);
+  // Capacity of the queue of events not yet dispatched to observers, job
+  // waits for observers to catch up once it's full.
+  static constexpr size_t kEventQueueCapacity = 1024;
+
+  // Both are called on reactor thread.
+  bool ListenForNotifications();
+  void StopListening();
+
+  // Events are only posted on reactor thread.
+  void PostEvent(const Event::Type type, const unsigned long process_id = 0,
+                 const std::uint64_t memory_used = 0,
+                 const std::uint64_t memory_limit = 0);
+  // Posts the event and finishes pending teardown.
+  void HandleActiveProcessZero();
+  // Dispatches the oldest event posted, called once per event.
+  void RunDeferred() override;
+  void DispatchEvent(const Event& event) const;
+
+  // Lookup is O(1), it finds the latest process if process id has been
+  // reused.
+  ProcessInfo& AddProcessInfo(const unsigned long process_id);
+  ProcessInfo* FindProcessInfo(const unsigned long process_id);
 
-  // Use our own |stop_| flag in case iocp get's a large
-  // queue of never-ending notifications for any reason.
-  std::thread listening_thread_;
-  std::atomic_bool stop_ = false;  // True, if job is destructing.
+  // Teardown steps, all of them are called on reactor thread.
+  void KillOnTeardown();
+  void FinishTeardown(const bool completed);
+  void EndTeardownPhase();
+  // Platform specific parts of teardown. Stopping returns false if no
+  // process could be asked to stop.
+  bool HasActiveProcesses() const;
+  bool StopProcesses();
+  bool KillProcesses();
+
+#if defined(_WIN32)
+  void HandleMessage(OVERLAPPED* overlapped, const DWORD value);
+
+  void RecordNewProcess(const unsigned long process_id);
+  void RecordProcessExit(const unsigned long process_id);
+#else
+  struct TrackedProcess {
+    // Process descriptor.
+    ScopedHandle handle;
+    // Key its exit is handled by.
+    std::uintptr_t completion_key = 0;
+  };
 
+  // Receives fork and exit events of all the processes from the kernel
+  // process connector and hands the ones of job processes to their jobs, so
+  // that processes living shorter than a scan are reported too.
+  class ProcessConnector;
+
+  // Starts tracking process, returns true if it's tracked already.
+  bool TrackProcess(const pid_t process_id, ScopedHandle process);
+  void HandleForkEvent(const pid_t process_id, const pid_t parent_process_id);
+  void HandleExitEvent(const pid_t process_id, const int status);
+  void HandleProcessExit(const pid_t process_id);
+  // Records exit of |process| in the process table, if not recorded yet.
+  void RecordProcessExit(const pid_t process_id, const ScopedHandle& process);
+  void HandleCgroupEvents();
+  bool SetMemoryLimits(const BasicLimits& limits);
+  bool SetIoLimits(const BasicLimits& limits);
+  std::uint64_t ReadMemoryUsage() const;
+
+  // Tracks processes that appeared in the cgroup and refreshes the
+  // information about the ones that are still running, every
+  // |kProcessScanInterval| while cgroup is populated.
+  void ScheduleProcessScan();
+  void ScanProcesses();
+  void UpdateProcessInfo(const pid_t process_id, const bool reread_image);
+
+  // Checks CPU time limit once job may have exceeded it.
+  void ScheduleCpuTimeCheck();
+  // Terminates job if its CPU time limit is exceeded, otherwise returns
+  // time it takes for the job to exceed the limit at best.
+  std::chrono::milliseconds CheckCpuTime();
+#endif
+
+  Reactor& reactor_ = Reactor::Get();
+  // Members below are only touched on reactor thread, unless noted
+  // otherwise.
+  bool listening_ = false;
+
+  // Observers are copied on write: dispatching thread reads the latest list
+  // without locking, replaced lists are kept until job is destroyed.
   std::mutex observers_guard_;
-  std::vector<Observer*> observers_;
-  
+  std::atomic<const std::vector<Observer*>*> observers_ = nullptr;
+  std::vector<std::unique_ptr<const std::vector<Observer*>>> observer_lists_;
+
+  // Events posted on reactor thread and dispatched on dispatching one.
+  base::SpscQueue<Event> events_{kEventQueueCapacity};
+
+  std::vector<ProcessInfo> process_table_;
+  std::unordered_map<unsigned long, size_t> process_table_index_;
+
+  // Teardown is pending while |on_teardown_done_| is set.
+  TeardownPolicy teardown_policy_;
+  TeardownCallback on_teardown_done_;
+  TeardownTimes teardown_times_;
+  bool teardown_killing_ = false;
+  std::chrono::steady_clock::time_point teardown_phase_start_;
+  Reactor::TimerId teardown_timer_ = 0;
+
+#if defined(_WIN32)
   ScopedHandle handle_;
-  IOCP job_iocp_;
+  // Time job was created at, in 100ns ticks since 1601.
+  std::uint64_t creation_time_ = 0;
+  std::uintptr_t notifications_completion_key_ = 0;
+  // Handles of processes that are still running.
+  std::unordered_map<unsigned long, ScopedHandle> process_handles_;
+#else
+  // Set before processes are spawned, read by any thread.
+  std::optional<BasicLimits> limits_;
+  // Applied per process if cgroup can't apply them.
+  std::optional<cpu_set_t> processor_mask_;
+  std::optional<unsigned long> memory_node_mask_;
+  std::optional<Cgroup> cgroup_;
+  pid_t process_group_ = 0;
+
+  // inotify instance watching cgroup.events and memory.events of |cgroup_|.
+  ScopedHandle cgroup_events_;
+  std::uintptr_t cgroup_events_completion_key_ = 0;
+  bool populated_ = false;
+  std::uint64_t memory_limit_events_ = 0;
+  std::uint64_t memory_threshold_events_ = 0;
+  bool cpu_time_exceeded_ = false;
+  Reactor::TimerId process_scan_timer_ = 0;
+  Reactor::TimerId cpu_time_timer_ = 0;
+
+  // Time job was created at, per CLOCK_BOOTTIME which process start times are
+  // based on.
+  std::chrono::microseconds creation_time_;
+
+  // Assigned processes that are still running.
+  std::unordered_map<pid_t, TrackedProcess> processes_;
+
+  // Null if job is a process group or connector isn't available, e.g. oven
+  // lacks CAP_NET_ADMIN: job relies on cgroup scans then.
+  ProcessConnector* process_connector_ = nullptr;
+  // Processes reported to observers which connector hasn't reported exit of
+  // yet, so that the ones found by scans or spawned aren't reported twice.
+  std::unordered_set<pid_t> reported_processes_;
+  // Processes reaped before they could be tracked, their exits are reported
+  // by connector.
+  std::unordered_set<pid_t> reaped_processes_;
+#endif
 };
 }  // namespace system
 }  // namespace oven
 
-#endif _OVEN_SYSTEM_JOB_H_
+#endif  // _OVEN_SYSTEM_JOB_H_
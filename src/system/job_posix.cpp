@@ -0,0 +1,1058 @@
+#include "system/job.h"
+
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/mempolicy.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "base/string_conversion.h"
+
+#include "system/error.h"
+#include "system/processor_topology.h"
+
+namespace oven {
+namespace system {
+namespace {
+const char kBlockDevicesDirectory[] = "/sys/block";
+
+bool IsUnlimited(const std::uint64_t limit) {
+  return limit >= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+}
+
+bool IsUnlimited(const std::chrono::milliseconds limit) {
+  return limit == std::chrono::milliseconds::max();
+}
+
+bool SetResourceLimit(const pid_t process_id,
+                      const decltype(RLIMIT_AS) resource,
+                      const std::uint64_t value) {
+  rlimit limit;
+  limit.rlim_cur = static_cast<rlim_t>(value);
+  limit.rlim_max = static_cast<rlim_t>(value);
+  return ::prlimit(process_id, resource, &limit, nullptr) == 0;
+}
+
+std::chrono::microseconds GetBootTime() {
+  timespec time;
+  ::clock_gettime(CLOCK_BOOTTIME, &time);
+  return std::chrono::seconds(time.tv_sec) +
+         std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::nanoseconds(time.tv_nsec));
+}
+
+std::chrono::microseconds FromClockTicks(const std::uint64_t ticks) {
+  static const std::uint64_t ticks_per_second =
+      static_cast<std::uint64_t>(::sysconf(_SC_CLK_TCK));
+  return std::chrono::microseconds(ticks * 1000000 / ticks_per_second);
+}
+
+// Process may be gone at any moment, failing reads with ESRCH.
+std::optional<std::string> ReadProcessFile(const pid_t process_id,
+                                           const char* name) {
+  const std::string path = "/proc/" + std::to_string(process_id) + "/" + name;
+  ScopedHandle file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (!file) {
+    return std::optional<std::string>();
+  }
+  std::string contents;
+  char buffer[4096];
+  ssize_t bytes_read;
+  while ((bytes_read = ::read(file.get(), buffer, sizeof(buffer))) > 0) {
+    contents.append(buffer, static_cast<size_t>(bytes_read));
+  }
+  if (bytes_read < 0) {
+    return std::optional<std::string>();
+  }
+  return contents;
+}
+
+// Fields of /proc/<pid>/stat, indexed by their numbers in proc(5). Process
+// name goes in parentheses and may contain anything, so fields are counted
+// from the last closing one.
+class ProcessStat {
+ public:
+  explicit ProcessStat(const pid_t process_id) {
+    const auto stat = ReadProcessFile(process_id, "stat");
+    if (!stat) {
+      return;
+    }
+    const size_t name_end = stat->rfind(')');
+    if (name_end == stat->npos) {
+      return;
+    }
+    // Process id and name are the fields 1 and 2.
+    fields_.resize(3);
+    std::istringstream fields(stat->substr(name_end + 1));
+    std::string field;
+    while (fields >> field) {
+      fields_.push_back(field);
+    }
+  }
+
+  bool IsValid() const noexcept { return !fields_.empty(); }
+
+  std::optional<std::uint64_t> Get(const size_t number) const {
+    if (number >= fields_.size()) {
+      return std::optional<std::uint64_t>();
+    }
+    return std::strtoull(fields_[number].c_str(), nullptr, 10);
+  }
+
+ private:
+  std::vector<std::string> fields_;
+};
+
+const size_t kParentProcessIdField = 4;
+const size_t kUserTimeField = 14;
+const size_t kKernelTimeField = 15;
+const size_t kStartTimeField = 22;
+const size_t kExitCodeField = 52;
+
+// Process descriptor information, available since Linux 6.13. Exit status
+// is kept since 6.15, even once process is reaped by its parent.
+struct PidfdInfo {
+  std::uint64_t mask;
+  std::uint64_t cgroup_id;
+  std::uint32_t ids[11];
+  std::int32_t exit_code;
+};
+const unsigned long kPidfdGetInfo = _IOWR(0xFF, 11, PidfdInfo);
+const std::uint64_t kPidfdInfoExit = 1 << 3;
+
+// Follows shell convention for processes killed by signal.
+int ExitCodeFromStatus(const int status) {
+  if (WIFSIGNALED(status))
+    return 128 + WTERMSIG(status);
+  return WEXITSTATUS(status);
+}
+}  // anonymous namespace
+
+class Job::ProcessConnector {
+ public:
+  // Returns null if connector isn't available. Called on reactor thread, like
+  // the rest of the methods.
+  static ProcessConnector* Get() {
+    // Connector lives as long as the reactor it's watched by.
+    static ProcessConnector* const connector = []() -> ProcessConnector* {
+      auto connector = std::make_unique<ProcessConnector>();
+      return connector->Listen() ? connector.release() : nullptr;
+    }();
+    return connector;
+  }
+
+  // Jobs get processes spawned right inside of their cgroups, which has to
+  // be added before spawning them.
+  void AddJob(Job* job) { jobs_.push_back(job); }
+
+  // Events received by now are handed to |job| before it's removed.
+  void RemoveJob(Job* job) {
+    HandleEvents();
+    jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+    for (auto owner = owners_.begin(); owner != owners_.end();) {
+      owner = owner->second == job ? owners_.erase(owner) : std::next(owner);
+    }
+  }
+
+  // Descendants of the process forked from now on belong to |job|.
+  void SetOwner(const pid_t process_id, Job* job) { owners_[process_id] = job; }
+
+ private:
+  // Events of fork-heavy jobs come in bursts, which default buffer of the
+  // socket doesn't fit.
+  static constexpr int kReceiveBufferSize = 8 * 1024 * 1024;
+
+  // Event types are declared inside of proc_event by older kernel headers.
+  static constexpr std::uint32_t kAcknowledgement = 0;
+  static constexpr std::uint32_t kForkEvent = 0x00000001;
+  static constexpr std::uint32_t kExitEvent = 0x80000000;
+
+  static std::uint32_t GetEventType(const proc_event& event) {
+    return static_cast<std::uint32_t>(event.what);
+  }
+
+  bool Listen() {
+    socket_.reset(::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                           NETLINK_CONNECTOR));
+    sockaddr_nl address = {};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    if (!socket_ ||
+        ::bind(socket_.get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+      return false;
+    }
+    if (::setsockopt(socket_.get(), SOL_SOCKET, SO_RCVBUFFORCE, &kReceiveBufferSize,
+                     sizeof(kReceiveBufferSize)) != 0) {
+      ::setsockopt(socket_.get(), SOL_SOCKET, SO_RCVBUF, &kReceiveBufferSize,
+                   sizeof(kReceiveBufferSize));
+    }
+
+    alignas(nlmsghdr) char request[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+    nlmsghdr* header = reinterpret_cast<nlmsghdr*>(request);
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    header->nlmsg_type = NLMSG_DONE;
+    cn_msg* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(proc_cn_mcast_op);
+    const proc_cn_mcast_op operation = PROC_CN_MCAST_LISTEN;
+    std::memcpy(message->data, &operation, sizeof(operation));
+    if (::send(socket_.get(), request, header->nlmsg_len, 0) < 0) {
+      return false;
+    }
+
+    // Kernel acknowledges the request right away, unless oven is outside of
+    // the initial namespaces, where it ignores it.
+    std::optional<std::uint32_t> error;
+    while (!error) {
+      const ssize_t bytes_received = ::recv(socket_.get(), buffer_, sizeof(buffer_), 0);
+      if (bytes_received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes_received <= 0) {
+        return false;
+      }
+      ForEachEvent(static_cast<size_t>(bytes_received), [&error](const proc_event& event) {
+        if (GetEventType(event) != kAcknowledgement) {
+          return true;
+        }
+        error = event.event_data.ack.err;
+        return false;
+      });
+    }
+    if (*error != 0) {
+      return false;
+    }
+
+    completion_key_ = Reactor::Get().Watch(
+        socket_.get(),
+        [this](const IOCP::Completion& /* completion */) { HandleEvents(); });
+    return completion_key_ != 0;
+  }
+
+  // Calls |handler| for events received, while it returns true.
+  template <typename Handler>
+  void ForEachEvent(size_t size, const Handler& handler) {
+    for (const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(buffer_);
+         NLMSG_OK(header, size); header = NLMSG_NEXT(header, size)) {
+      const cn_msg* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+      if (message->id.idx != CN_IDX_PROC || message->len < sizeof(proc_event)) {
+        continue;
+      }
+      proc_event event;
+      std::memcpy(&event, message->data, sizeof(event));
+      if (!handler(event)) {
+        return;
+      }
+    }
+  }
+
+  void HandleEvents() {
+    for (;;) {
+      const ssize_t bytes_received = ::recv(socket_.get(), buffer_, sizeof(buffer_), 0);
+      if (bytes_received < 0 && errno == ENOBUFS) {
+        // Jobs catch up with cgroup scans meanwhile.
+        static std::once_flag warn_once;
+        std::call_once(warn_once, []() {
+          OutputError(L"Process events were lost, falling back to cgroup scans");
+        });
+        continue;
+      }
+      if (bytes_received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes_received <= 0) {
+        return;
+      }
+      ForEachEvent(static_cast<size_t>(bytes_received), [this](const proc_event& event) {
+        HandleEvent(event);
+        return true;
+      });
+    }
+  }
+
+  void HandleEvent(const proc_event& event) {
+    if (GetEventType(event) == kForkEvent) {
+      const auto& fork = event.event_data.fork;
+      // Threads belong to the processes that own them.
+      if (fork.child_pid != fork.child_tgid) {
+        return;
+      }
+      Job* job = nullptr;
+      if (const auto owner = owners_.find(fork.parent_tgid); owner != owners_.end()) {
+        job = owner->second;
+      } else if (fork.parent_tgid == ::getpid()) {
+        job = FindJobOfSpawnedProcess(fork.child_tgid);
+      }
+      if (job) {
+        owners_[fork.child_tgid] = job;
+        job->HandleForkEvent(fork.child_tgid, fork.parent_tgid);
+      }
+    } else if (GetEventType(event) == kExitEvent) {
+      const auto& exit = event.event_data.exit;
+      if (exit.process_pid != exit.process_tgid) {
+        return;
+      }
+      if (const auto owner = owners_.find(exit.process_tgid); owner != owners_.end()) {
+        Job* job = owner->second;
+        owners_.erase(owner);
+        job->HandleExitEvent(exit.process_tgid, static_cast<int>(exit.exit_code));
+      }
+    }
+  }
+
+  // Process spawned by oven for a job is created right inside of job's
+  // cgroup, and can't be reaped before oven waits for it.
+  Job* FindJobOfSpawnedProcess(const pid_t process_id) const {
+    const auto cgroups = ReadProcessFile(process_id, "cgroup");
+    if (!cgroups || jobs_.empty()) {
+      return nullptr;
+    }
+    // cgroup v2 hierarchy is reported as "0::<path>", relative to its mount.
+    const size_t start = cgroups->find("0::");
+    if (start == cgroups->npos) {
+      return nullptr;
+    }
+    const std::string_view cgroup =
+        std::string_view(*cgroups).substr(start + 3, cgroups->find('\n', start) - start - 3);
+    for (Job* job : jobs_) {
+      const std::string_view path = job->cgroup_->path().native();
+      if (path.size() >= cgroup.size() &&
+          path.compare(path.size() - cgroup.size(), cgroup.size(), cgroup) == 0) {
+        return job;
+      }
+    }
+    return nullptr;
+  }
+
+  ScopedHandle socket_;
+  std::uintptr_t completion_key_ = 0;
+  alignas(nlmsghdr) char buffer_[16 * 1024];
+  std::vector<Job*> jobs_;
+  std::unordered_map<pid_t, Job*> owners_;
+};
+
+Job::Job() : cgroup_(Cgroup::Create()), creation_time_(GetBootTime()) {
+  if (!cgroup_) {
+    static std::once_flag warn_once;
+    std::call_once(warn_once, []() {
+      OutputError(L"Unable to create job cgroup, falling back to process group");
+    });
+    return;
+  }
+
+  // Both files produce modification events when their values change.
+  cgroup_events_.reset(::inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+  if (!cgroup_events_ ||
+      ::inotify_add_watch(cgroup_events_.get(),
+                          (cgroup_->path() / "cgroup.events").c_str(),
+                          IN_MODIFY) < 0 ||
+      (cgroup_->HasFile("memory.events") &&
+       ::inotify_add_watch(cgroup_events_.get(),
+                           (cgroup_->path() / "memory.events").c_str(),
+                           IN_MODIFY) < 0)) {
+    OutputError(L"Unable to watch job cgroup events");
+    cgroup_events_.reset();
+  }
+}
+
+Job::~Job() {
+  reactor_.Invoke([this]() { StopListening(); });
+  // Events posted before that are still dispatched to observers.
+  reactor_.WaitForDeferred();
+}
+
+bool Job::SetBasicLimits(const BasicLimits& limits) {
+  limits_ = limits;
+  return SetMemoryLimits(limits) && SetIoLimits(limits);
+}
+
+bool Job::SetMemoryLimits(const BasicLimits& limits) {
+  const bool has_threshold = !IsUnlimited(limits.memory_threshold) &&
+                             limits.memory_threshold < limits.overall_memory_limit;
+  if (IsUnlimited(limits.overall_memory_limit) && !has_threshold) {
+    return true;
+  }
+
+  if (!cgroup_) {
+    std::wclog << L"Overall memory limit and threshold are not supported for "
+                  L"process groups, ignoring them\n";
+    return true;
+  }
+  if (!IsUnlimited(limits.overall_memory_limit)) {
+    if (!cgroup_->Write("memory.max", std::to_string(limits.overall_memory_limit))) {
+      OutputError(L"Unable to set basic limits for job");
+      return false;
+    }
+    // Do not let job go past its limit by swapping out, if swap is accounted.
+    cgroup_->Write("memory.swap.max", "0");
+  }
+  // Kernel throttles job above memory.high and reports it in memory.events,
+  // which gives it a chance to shrink before it's killed at memory.max.
+  if (!has_threshold) {
+    return true;
+  }
+  if (!cgroup_->HasFile("memory.high")) {
+    std::wclog << L"Memory threshold needs memory controller, ignoring it\n";
+    return true;
+  }
+  if (!cgroup_->Write("memory.high", std::to_string(limits.memory_threshold))) {
+    OutputError(L"Unable to set memory threshold for job");
+    return false;
+  }
+  return true;
+}
+
+bool Job::SetIoLimits(const BasicLimits& limits) {
+  // Format: <major>:<minor> rbps=<n> wbps=<n> riops=<n> wiops=<n>, limits
+  // are per device and "max" stands for unlimited.
+  std::string io_limits;
+  auto add_limit = [&io_limits](const char* key, const std::uint64_t limit) {
+    if (!IsUnlimited(limit)) {
+      io_limits += std::string(" ") + key + "=" + std::to_string(limit);
+    }
+  };
+  add_limit("rbps", limits.io_limits.read_bytes_per_second);
+  add_limit("wbps", limits.io_limits.write_bytes_per_second);
+  add_limit("riops", limits.io_limits.read_operations_per_second);
+  add_limit("wiops", limits.io_limits.write_operations_per_second);
+  if (io_limits.empty()) {
+    return true;
+  }
+
+  if (!cgroup_ || !cgroup_->HasFile("io.max")) {
+    std::wclog << L"I/O limits need job cgroup with io controller, "
+                  L"ignoring them\n";
+    return true;
+  }
+  // Limits can only be set for whole disks, some of which (e.g. ram disks)
+  // may not support them.
+  bool limited = false;
+  std::error_code error;
+  for (const auto& disk : std::filesystem::directory_iterator(kBlockDevicesDirectory, error)) {
+    std::string device;
+    std::ifstream(disk.path() / "dev") >> device;
+    if (!device.empty() && cgroup_->Write("io.max", device + io_limits)) {
+      limited = true;
+    }
+  }
+  if (!limited) {
+    OutputError(L"Unable to set I/O limits for job");
+    return false;
+  }
+  return true;
+}
+
+bool Job::SetAffinity(const Affinity& affinity) {
+  if (cgroup_ && cgroup_->HasFile("cpuset.cpus")) {
+    if ((!affinity.processors.empty() &&
+         !cgroup_->Write("cpuset.cpus",
+                         ProcessorTopology::FormatList(affinity.processors))) ||
+        (!affinity.memory_nodes.empty() &&
+         !cgroup_->Write("cpuset.mems",
+                         ProcessorTopology::FormatList(affinity.memory_nodes)))) {
+      OutputError(L"Unable to set affinity for job");
+      return false;
+    }
+    return true;
+  }
+
+  if (!affinity.processors.empty()) {
+    cpu_set_t processor_mask;
+    CPU_ZERO(&processor_mask);
+    for (const unsigned int processor : affinity.processors) {
+      if (processor >= CPU_SETSIZE) {
+        std::wclog << L"Processor " << processor << L" is out of range\n";
+        return false;
+      }
+      CPU_SET(processor, &processor_mask);
+    }
+    processor_mask_ = processor_mask;
+  }
+  if (!affinity.memory_nodes.empty()) {
+    unsigned long memory_node_mask = 0;
+    for (const unsigned int node : affinity.memory_nodes) {
+      if (node >= sizeof(memory_node_mask) * 8) {
+        std::wclog << L"Memory node " << node << L" is out of range\n";
+        return false;
+      }
+      memory_node_mask |= 1ul << node;
+    }
+    memory_node_mask_ = memory_node_mask;
+  }
+  return true;
+}
+
+std::optional<Job::Accounting> Job::QueryAccounting() const {
+  if (!cgroup_) {
+    return std::optional<Accounting>();
+  }
+  const auto user_time = cgroup_->ReadValue("cpu.stat", "user_usec");
+  const auto kernel_time = cgroup_->ReadValue("cpu.stat", "system_usec");
+  if (!user_time || !kernel_time) {
+    OutputError(L"Unable to read job CPU usage");
+    return std::optional<Accounting>();
+  }
+
+  Accounting accounting;
+  accounting.user_time = std::chrono::microseconds(*user_time);
+  accounting.kernel_time = std::chrono::microseconds(*kernel_time);
+  // memory.peak appeared in Linux 5.19.
+  if (const auto peak_memory = cgroup_->Read("memory.peak")) {
+    accounting.peak_memory = std::strtoull(peak_memory->c_str(), nullptr, 10);
+  }
+
+  // Format: <major>:<minor> rbytes=<n> wbytes=<n> rios=<n> wios=<n> ...
+  // per device, devices cgroup never touched are not listed.
+  if (const auto io_stat = cgroup_->Read("io.stat")) {
+    Accounting::IoCounters io;
+    std::istringstream fields(*io_stat);
+    std::string field;
+    while (fields >> field) {
+      const size_t separator = field.find('=');
+      if (separator == field.npos) {
+        continue;
+      }
+      const std::string_view name(field.data(), separator);
+      const std::uint64_t value =
+          std::strtoull(field.c_str() + separator + 1, nullptr, 10);
+      if (name == "rbytes") {
+        io.read_bytes += value;
+      } else if (name == "wbytes") {
+        io.write_bytes += value;
+      } else if (name == "rios") {
+        io.read_operations += value;
+      } else if (name == "wios") {
+        io.write_operations += value;
+      }
+    }
+    accounting.io = io;
+  }
+  return accounting;
+}
+
+bool Job::AssignProcess(const pid_t process_id) {
+  if (cgroup_) {
+    if (!cgroup_->AddProcess(process_id)) {
+      return false;
+    }
+  } else if (::setpgid(process_id, process_group_) != 0) {
+    // Both the first process of the job and the job itself use the same
+    // process group id.
+    return false;
+  }
+
+  if (limits_) {
+    if (!IsUnlimited(limits_->per_process_memory_limit) &&
+        !SetResourceLimit(process_id, RLIMIT_AS, limits_->per_process_memory_limit)) {
+      return false;
+    }
+    // Job-wide CPU time is accounted by cgroup, process groups can only limit
+    // CPU time of each process. Round it up to whole seconds, as it's the
+    // resolution of RLIMIT_CPU.
+    if (!cgroup_ && !IsUnlimited(limits_->cpu_time_limit) &&
+        !SetResourceLimit(process_id, RLIMIT_CPU,
+                          std::chrono::ceil<std::chrono::seconds>(
+                              limits_->cpu_time_limit).count())) {
+      return false;
+    }
+  }
+
+  // Memory policy can only be set by process itself, so memory nodes are
+  // left to cgroup for assigned processes.
+  if (processor_mask_ &&
+      ::sched_setaffinity(process_id, sizeof(*processor_mask_), &*processor_mask_) != 0) {
+    return false;
+  }
+
+  ScopedHandle process(static_cast<NativeHandle>(
+      ::syscall(SYS_pidfd_open, process_id, 0)));
+  if (!process) {
+    return false;
+  }
+  return AddSpawnedProcess(process_id, std::move(process));
+}
+
+bool Job::SetupSpawnedProcess() const noexcept {
+  if (!cgroup_ && ::setpgid(0, process_group_) != 0) {
+    return false;
+  }
+  if (processor_mask_ &&
+      ::sched_setaffinity(0, sizeof(*processor_mask_), &*processor_mask_) != 0) {
+    return false;
+  }
+  if (memory_node_mask_ &&
+      ::syscall(SYS_set_mempolicy, MPOL_BIND, &*memory_node_mask_,
+                sizeof(*memory_node_mask_) * 8) != 0) {
+    return false;
+  }
+  if (!limits_) {
+    return true;
+  }
+  rlimit limit;
+  if (!IsUnlimited(limits_->per_process_memory_limit)) {
+    limit.rlim_cur = limit.rlim_max =
+        static_cast<rlim_t>(limits_->per_process_memory_limit);
+    if (::setrlimit(RLIMIT_AS, &limit) != 0) {
+      return false;
+    }
+  }
+  if (!cgroup_ && !IsUnlimited(limits_->cpu_time_limit)) {
+    limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(
+        std::chrono::ceil<std::chrono::seconds>(limits_->cpu_time_limit).count());
+    if (::setrlimit(RLIMIT_CPU, &limit) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Job::AddSpawnedProcess(const pid_t process_id, ScopedHandle process) {
+  if (!cgroup_ && process_group_ == 0) {
+    process_group_ = process_id;
+  }
+  bool tracked = false;
+  reactor_.Invoke([this, process_id, &process, &tracked]() {
+    if (!ListenForNotifications() || !TrackProcess(process_id, std::move(process))) {
+      return;
+    }
+    tracked = true;
+    if (!cgroup_ || populated_) {
+      return;
+    }
+    populated_ = true;
+    if (!process_scan_timer_) {
+      ScheduleProcessScan();
+    }
+    // Process may have exited already, and cgroup events reporting that
+    // could have been handled before the flag is raised.
+    if (!cgroup_->IsPopulated()) {
+      populated_ = false;
+      HandleActiveProcessZero();
+    }
+  });
+  return tracked;
+}
+
+bool Job::TrackProcess(const pid_t process_id, ScopedHandle process) {
+  // Cgroup scan or connector may discover spawned process before it's
+  // added, and process may have exited by then.
+  if (processes_.count(process_id) != 0 || reported_processes_.count(process_id) != 0) {
+    return true;
+  }
+  // Exited process may still be added as spawned, or found by a scan and
+  // opened before it's reaped: it's not a new one then.
+  if (const ProcessInfo* info = FindProcessInfo(static_cast<unsigned long>(process_id));
+      info && info->exit_time) {
+    return true;
+  }
+  const std::uintptr_t completion_key = reactor_.Watch(
+      process.get(), [this, process_id](const IOCP::Completion& /* completion */) {
+        HandleProcessExit(process_id);
+      });
+  if (!completion_key) {
+    return false;
+  }
+  processes_.emplace(process_id, TrackedProcess{std::move(process), completion_key});
+  if (process_connector_) {
+    process_connector_->SetOwner(process_id, this);
+    reported_processes_.insert(process_id);
+  }
+  AddProcessInfo(static_cast<unsigned long>(process_id));
+  UpdateProcessInfo(process_id, true);
+  PostEvent(Event::Type::kNewProcess, static_cast<unsigned long>(process_id));
+  return true;
+}
+
+void Job::HandleForkEvent(const pid_t process_id, const pid_t parent_process_id) {
+  if (reported_processes_.count(process_id) != 0) {
+    return;
+  }
+  ScopedHandle process(static_cast<NativeHandle>(
+      ::syscall(SYS_pidfd_open, process_id, 0)));
+  if (process) {
+    if (!TrackProcess(process_id, std::move(process))) {
+      OutputError(L"Unable to track process of the job");
+    }
+    return;
+  }
+  // Process has been reaped already, its exit event is still to come.
+  ProcessInfo& info = AddProcessInfo(static_cast<unsigned long>(process_id));
+  info.parent_process_id = static_cast<unsigned long>(parent_process_id);
+  reported_processes_.insert(process_id);
+  reaped_processes_.insert(process_id);
+  PostEvent(Event::Type::kNewProcess, static_cast<unsigned long>(process_id));
+}
+
+void Job::HandleExitEvent(const pid_t process_id, const int status) {
+  reported_processes_.erase(process_id);
+  // Exits of tracked processes are handled once their descriptors signal.
+  if (reaped_processes_.erase(process_id) == 0) {
+    return;
+  }
+  if (ProcessInfo* info = FindProcessInfo(static_cast<unsigned long>(process_id))) {
+    info->exit_time = GetBootTime() - creation_time_;
+    info->exit_code = ExitCodeFromStatus(status);
+  }
+  if (WIFSIGNALED(status)) {
+    PostEvent(Event::Type::kAbnormalExitProcess, static_cast<unsigned long>(process_id));
+  }
+  PostEvent(Event::Type::kExitProcess, static_cast<unsigned long>(process_id));
+}
+
+void Job::SetProcessImage(const pid_t process_id,
+                          const std::wstring_view image_path,
+                          const std::wstring_view command_line) {
+  reactor_.Invoke([this, process_id, image_path, command_line]() {
+    if (ProcessInfo* info = FindProcessInfo(static_cast<unsigned long>(process_id))) {
+      info->image_path = image_path;
+      info->command_line = command_line;
+    }
+  });
+}
+
+void Job::UpdateProcessInfo(const pid_t process_id, const bool reread_image) {
+  ProcessInfo* info = FindProcessInfo(static_cast<unsigned long>(process_id));
+  if (!info || info->exit_time) {
+    return;
+  }
+
+  const ProcessStat stat(process_id);
+  if (!stat.IsValid()) {
+    return;
+  }
+  info->parent_process_id =
+      static_cast<unsigned long>(stat.Get(kParentProcessIdField).value_or(0));
+  info->user_time = FromClockTicks(stat.Get(kUserTimeField).value_or(0));
+  info->kernel_time = FromClockTicks(stat.Get(kKernelTimeField).value_or(0));
+  // Start time has a resolution of a clock tick, process spawned right after
+  // job creation may seem to start before it.
+  info->start_time = std::max(
+      FromClockTicks(stat.Get(kStartTimeField).value_or(0)) - creation_time_,
+      std::chrono::microseconds(0));
+
+  // Peak resident set size, reported as "VmHWM:   <n> kB".
+  if (const auto status = ReadProcessFile(process_id, "status")) {
+    if (const size_t peak = status->find("VmHWM:"); peak != status->npos) {
+      info->peak_memory =
+          std::strtoull(status->c_str() + peak + 6, nullptr, 10) * 1024;
+    }
+  }
+
+  // Forked process runs the image of its parent until it executes another
+  // one, so image is reread while process is running.
+  std::error_code error;
+  const std::filesystem::path image = std::filesystem::read_symlink(
+      "/proc/" + std::to_string(process_id) + "/exe", error);
+  if (!error && (reread_image || image.wstring() != info->image_path)) {
+    info->image_path = image.wstring();
+    if (const auto arguments = ReadProcessFile(process_id, "cmdline")) {
+      // Arguments are separated (and terminated) by zeroes.
+      std::string command_line = *arguments;
+      while (!command_line.empty() && command_line.back() == '\0') {
+        command_line.pop_back();
+      }
+      std::replace(command_line.begin(), command_line.end(), '\0', ' ');
+      info->command_line = base::Utf8ToWide(command_line);
+    }
+  }
+}
+
+void Job::ScheduleProcessScan() {
+  process_scan_timer_ = reactor_.AddTimer(
+      std::chrono::steady_clock::now() + kProcessScanInterval, [this]() {
+        process_scan_timer_ = 0;
+        if (populated_) {
+          ScanProcesses();
+          ScheduleProcessScan();
+        }
+      });
+}
+
+void Job::ScanProcesses() {
+  const auto processes = cgroup_->Read("cgroup.procs");
+  if (!processes) {
+    return;
+  }
+  std::istringstream process_ids(*processes);
+  pid_t process_id;
+  while (process_ids >> process_id) {
+    if (processes_.count(process_id) != 0) {
+      UpdateProcessInfo(process_id, false);
+      continue;
+    }
+    // Process may be gone already, there is nothing to track then.
+    ScopedHandle process(static_cast<NativeHandle>(
+        ::syscall(SYS_pidfd_open, process_id, 0)));
+    if (process && !TrackProcess(process_id, std::move(process))) {
+      OutputError(L"Unable to track process of the job");
+    }
+  }
+}
+
+std::vector<Job::ProcessInfo> Job::GetProcessTable() {
+  std::vector<ProcessInfo> process_table;
+  reactor_.Invoke([this, &process_table]() {
+    for (const auto& [process_id, process] : processes_) {
+      pollfd exit = {process.handle.get(), POLLIN, 0};
+      if (::poll(&exit, 1, 0) > 0) {
+        RecordProcessExit(process_id, process.handle);
+      }
+    }
+    process_table = process_table_;
+  });
+  return process_table;
+}
+
+bool Job::StartListening() {
+  bool listening = false;
+  reactor_.Invoke([this, &listening]() { listening = ListenForNotifications(); });
+  return listening;
+}
+
+bool Job::ListenForNotifications() {
+  if (listening_) {
+    return true;
+  }
+  if (cgroup_events_) {
+    cgroup_events_completion_key_ = reactor_.Watch(
+        cgroup_events_.get(), [this](const IOCP::Completion& /* completion */) {
+          HandleCgroupEvents();
+        });
+    if (!cgroup_events_completion_key_) {
+      return false;
+    }
+  }
+  if (cgroup_) {
+    process_connector_ = ProcessConnector::Get();
+    if (process_connector_) {
+      process_connector_->AddJob(this);
+    }
+  }
+  listening_ = true;
+  ScheduleCpuTimeCheck();
+  return true;
+}
+
+void Job::StopListening() {
+  // Job may be destroyed before it's notified that its processes have
+  // exited, which is delivered still.
+  if (process_connector_) {
+    process_connector_->RemoveJob(this);
+    process_connector_ = nullptr;
+  }
+  std::vector<pid_t> exited_processes;
+  for (const auto& [process_id, process] : processes_) {
+    pollfd exit = {process.handle.get(), POLLIN, 0};
+    if (::poll(&exit, 1, 0) > 0) {
+      exited_processes.push_back(process_id);
+    }
+  }
+  for (const pid_t process_id : exited_processes) {
+    HandleProcessExit(process_id);
+  }
+  if (cgroup_ && populated_ && !cgroup_->IsPopulated()) {
+    populated_ = false;
+    HandleActiveProcessZero();
+  }
+
+  if (cgroup_events_completion_key_) {
+    reactor_.Unwatch(cgroup_events_.get(), cgroup_events_completion_key_);
+  }
+  for (const auto& [process_id, process] : processes_) {
+    reactor_.Unwatch(process.handle.get(), process.completion_key);
+  }
+  reactor_.CancelTimer(process_scan_timer_);
+  reactor_.CancelTimer(cpu_time_timer_);
+  reactor_.CancelTimer(teardown_timer_);
+  listening_ = false;
+}
+
+bool Job::HasActiveProcesses() const {
+  return cgroup_ ? cgroup_->IsPopulated() : !processes_.empty();
+}
+
+bool Job::StopProcesses() {
+  if (!cgroup_) {
+    return process_group_ != 0 && ::kill(-process_group_, SIGTERM) == 0;
+  }
+  // Processes that fork meanwhile are killed once grace period passes.
+  const auto processes = cgroup_->Read("cgroup.procs");
+  if (!processes) {
+    return false;
+  }
+  bool stopped = false;
+  std::istringstream process_ids(*processes);
+  pid_t process_id;
+  while (process_ids >> process_id) {
+    stopped = ::kill(process_id, SIGTERM) == 0 || stopped;
+  }
+  return stopped;
+}
+
+bool Job::KillProcesses() {
+  if (!cgroup_) {
+    return process_group_ != 0 && ::kill(-process_group_, SIGKILL) == 0;
+  }
+  return cgroup_->Kill();
+}
+
+void Job::HandleProcessExit(const pid_t process_id) {
+  const auto process = processes_.find(process_id);
+  if (process == processes_.end()) {
+    return;
+  }
+  reactor_.Unwatch(process->second.handle.get(), process->second.completion_key);
+  const ScopedHandle process_handle = std::move(process->second.handle);
+  processes_.erase(process);
+  RecordProcessExit(process_id, process_handle);
+
+  // Peek at exit status without reaping the process: that's up to its parent.
+  siginfo_t exit_info = {};
+  if (::waitid(P_PID, static_cast<id_t>(process_id), &exit_info,
+               WEXITED | WNOHANG | WNOWAIT) == 0 &&
+      exit_info.si_pid == process_id && exit_info.si_code != CLD_EXITED) {
+    PostEvent(Event::Type::kAbnormalExitProcess,
+              static_cast<unsigned long>(process_id));
+  }
+
+  PostEvent(Event::Type::kExitProcess, static_cast<unsigned long>(process_id));
+
+  // Cgroup reports when all of its processes exit, including descendants of
+  // assigned processes. Process group has no way to notify about the latter.
+  if (!cgroup_ && processes_.empty()) {
+    HandleActiveProcessZero();
+  }
+}
+
+void Job::RecordProcessExit(const pid_t process_id, const ScopedHandle& process) {
+  ProcessInfo* info = FindProcessInfo(static_cast<unsigned long>(process_id));
+  if (!info || info->exit_time) {
+    return;
+  }
+
+  // Exited process stays a zombie until its parent reaps it, which may
+  // have happened already: process descriptor keeps exit status then.
+  const ProcessStat stat(process_id);
+  std::optional<int> exit_code;
+  PidfdInfo pidfd_info = {};
+  pidfd_info.mask = kPidfdInfoExit;
+  siginfo_t exit_info = {};
+  if (::waitid(P_PID, static_cast<id_t>(process_id), &exit_info,
+               WEXITED | WNOHANG | WNOWAIT) == 0 &&
+      exit_info.si_pid == process_id) {
+    exit_code = exit_info.si_code == CLD_EXITED ? exit_info.si_status
+                                                : 128 + exit_info.si_status;
+  } else if (stat.IsValid() && stat.Get(kExitCodeField)) {
+    exit_code = ExitCodeFromStatus(static_cast<int>(*stat.Get(kExitCodeField)));
+  } else if (::ioctl(process.get(), kPidfdGetInfo, &pidfd_info) == 0 &&
+             (pidfd_info.mask & kPidfdInfoExit)) {
+    exit_code = ExitCodeFromStatus(pidfd_info.exit_code);
+  }
+
+  info->exit_time = GetBootTime() - creation_time_;
+  info->exit_code = exit_code;
+  if (stat.IsValid()) {
+    info->user_time = FromClockTicks(stat.Get(kUserTimeField).value_or(0));
+    info->kernel_time = FromClockTicks(stat.Get(kKernelTimeField).value_or(0));
+  }
+}
+
+void Job::HandleCgroupEvents() {
+  // Events only tell that files have changed, so drain them and reread values.
+  char events[4096];
+  while (::read(cgroup_events_.get(), events, sizeof(events)) > 0) {
+  }
+
+  // Kernel fails allocation or invokes OOM killer once reclaim can't keep
+  // job below memory.max.
+  if (const auto memory_limit_events = cgroup_->ReadValue("memory.events", "oom");
+      memory_limit_events && *memory_limit_events > memory_limit_events_) {
+    memory_limit_events_ = *memory_limit_events;
+    PostEvent(Event::Type::kJobMemoryLimit, 0, ReadMemoryUsage(),
+              limits_ ? limits_->overall_memory_limit : 0);
+  }
+  // Counts times job was throttled above memory.high. Cgroup notifies about
+  // changes at most every 10ms, so are the events.
+  if (const auto memory_threshold_events = cgroup_->ReadValue("memory.events", "high");
+      memory_threshold_events && *memory_threshold_events > memory_threshold_events_) {
+    memory_threshold_events_ = *memory_threshold_events;
+    PostEvent(Event::Type::kMemoryThreshold, 0, ReadMemoryUsage(),
+              limits_ ? limits_->memory_threshold : 0);
+  }
+
+  if (populated_ && !cgroup_->IsPopulated()) {
+    populated_ = false;
+    HandleActiveProcessZero();
+  }
+}
+
+std::uint64_t Job::ReadMemoryUsage() const {
+  const auto memory_used = cgroup_->Read("memory.current");
+  return memory_used ? std::strtoull(memory_used->c_str(), nullptr, 10) : 0;
+}
+
+void Job::ScheduleCpuTimeCheck() {
+  const std::chrono::milliseconds delay = CheckCpuTime();
+  if (delay == std::chrono::milliseconds::max()) {
+    return;
+  }
+  cpu_time_timer_ = reactor_.AddTimer(std::chrono::steady_clock::now() + delay,
+                                      [this]() { ScheduleCpuTimeCheck(); });
+}
+
+std::chrono::milliseconds Job::CheckCpuTime() {
+  if (!cgroup_ || !limits_ || IsUnlimited(limits_->cpu_time_limit) ||
+      cpu_time_exceeded_) {
+    return std::chrono::milliseconds::max();
+  }
+  const auto user_time = cgroup_->ReadValue("cpu.stat", "user_usec");
+  if (!user_time) {
+    return std::chrono::milliseconds::max();
+  }
+
+  const std::chrono::microseconds time_used(*user_time);
+  if (time_used >= limits_->cpu_time_limit) {
+    cpu_time_exceeded_ = true;
+    if (!cgroup_->Kill()) {
+      OutputError(L"Unable to terminate job");
+    }
+    PostEvent(Event::Type::kEndOfJobTime);
+    return std::chrono::milliseconds::max();
+  }
+
+  // Job can't consume CPU time faster than all the processors together, so
+  // there is no need to check again until then.
+  const unsigned int processors = std::max(1u, std::thread::hardware_concurrency());
+  const auto time_left = std::chrono::ceil<std::chrono::milliseconds>(
+      (limits_->cpu_time_limit - time_used) / processors);
+  return std::max(time_left, std::chrono::milliseconds(1));
+}
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,376 @@
+#include "system/job.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <linux/loop.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "system/cgroup_test_root.h"
+#include "system/child_process.h"
+#include "system/reactor.h"
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+namespace {
+constexpr std::chrono::milliseconds kChildTimeout{10000};
+
+// Observers are notified asynchronously, so tests poll for what they expect.
+template <typename Predicate>
+bool WaitUntil(Predicate predicate) {
+  const auto deadline = std::chrono::steady_clock::now() + kChildTimeout;
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+class CountingObserver : public Job::Observer {
+ public:
+  void OnActiveProcessZero() override { ++active_process_zero; }
+  void OnEndOfJobTime() override { ++end_of_job_time; }
+  void OnExitProcess(const unsigned long process_id) override {
+    std::lock_guard lock(guard);
+    ++exits[process_id];
+  }
+  void OnJobMemoryLimit(const std::uint64_t /* memory_used */,
+                        const std::uint64_t /* memory_limit */) override {
+    ++memory_limit_reached;
+  }
+  void OnNewProcess(const unsigned long process_id) override {
+    std::lock_guard lock(guard);
+    ++creations[process_id];
+  }
+
+  std::atomic_int active_process_zero = 0;
+  std::atomic_int end_of_job_time = 0;
+  std::atomic_int memory_limit_reached = 0;
+  // Number of times each process was reported.
+  std::mutex guard;
+  std::map<unsigned long, int> creations;
+  std::map<unsigned long, int> exits;
+};
+
+// Expects every process to be reported created and exited exactly once, and
+// to have a single entry in |process_table|.
+void ExpectReportedOnce(CountingObserver& observer,
+                        const std::vector<Job::ProcessInfo>& process_table) {
+  std::lock_guard lock(observer.guard);
+  for (const auto& [process_id, creations] : observer.creations) {
+    EXPECT_EQ(creations, 1) << "Process " << process_id;
+  }
+  for (const auto& [process_id, exits] : observer.exits) {
+    EXPECT_EQ(exits, 1) << "Process " << process_id;
+    EXPECT_EQ(observer.creations.count(process_id), 1u) << "Process " << process_id;
+  }
+  EXPECT_EQ(observer.exits.size(), observer.creations.size());
+  std::map<unsigned long, int> entries;
+  for (const Job::ProcessInfo& process : process_table) {
+    EXPECT_EQ(++entries[process.process_id], 1) << "Process " << process.process_id;
+  }
+  EXPECT_EQ(entries.size(), observer.creations.size());
+}
+
+class JobTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!GetTestJobsRoot()) {
+      GTEST_SKIP() << "No cgroup to create jobs in, run as root or set "
+                      "OVEN_CGROUP_ROOT to a delegated one, e.g. through "
+                      "`systemd-run --user --scope -p Delegate=yes`";
+    }
+  }
+
+  // Runs |script| by shell inside of |job| and waits for it to exit.
+  static std::optional<int> RunShell(Job& job, const std::wstring& script) {
+    ChildProcess child(L"/bin/sh");
+    child.SetArguments(std::vector<std::wstring>{L"-c", script});
+    if (!child.Run(job)) {
+      return std::optional<int>();
+    }
+    return child.Wait(kChildTimeout);
+  }
+
+  static Job::BasicLimits Unlimited() {
+    Job::BasicLimits limits;
+    limits.overall_memory_limit = std::numeric_limits<std::uint64_t>::max();
+    limits.per_process_memory_limit = std::numeric_limits<std::uint64_t>::max();
+    limits.cpu_time_limit = std::chrono::milliseconds::max();
+    return limits;
+  }
+};
+
+TEST_F(JobTest, ReportsEveryProcess) {
+  CountingObserver observer;
+  std::vector<Job::ProcessInfo> process_table;
+  bool reports_every_process = false;
+  {
+    Job job;
+    job.AddObserver(&observer);
+    ASSERT_EQ(RunShell(job, L"for i in 1 2 3 4 5; do /bin/true; done"), 0);
+    reports_every_process = job.ReportsEveryProcess();
+    EXPECT_TRUE(WaitUntil([&observer]() { return observer.active_process_zero > 0; }));
+    EXPECT_TRUE(job.Terminate().completed);
+    process_table = job.GetProcessTable();
+  }
+  Reactor::Get().WaitForDeferred();
+  ExpectReportedOnce(observer, process_table);
+  // Shell and the processes it has spawned, scans may miss the latter.
+  if (reports_every_process) {
+    EXPECT_EQ(observer.creations.size(), 6u);
+  } else {
+    EXPECT_GE(observer.creations.size(), 1u);
+  }
+}
+
+// Child may exit before it's added to the job, or be found by a scan while
+// it's not reaped yet, neither of which makes it a new process.
+TEST_F(JobTest, ReportsExitedChildOnce) {
+  for (int run = 0; run < 20; ++run) {
+    CountingObserver observer;
+    std::vector<Job::ProcessInfo> process_table;
+    {
+      Job job;
+      job.AddObserver(&observer);
+      ChildProcess child(L"/bin/true");
+      ASSERT_TRUE(child.Run(job));
+      ASSERT_EQ(child.Wait(kChildTimeout), 0);
+      EXPECT_TRUE(WaitUntil([&observer]() { return observer.active_process_zero > 0; }));
+      process_table = job.GetProcessTable();
+    }
+    Reactor::Get().WaitForDeferred();
+    ExpectReportedOnce(observer, process_table);
+    EXPECT_EQ(observer.creations.size(), 1u);
+  }
+}
+
+// Job destroyed as soon as its child exits, which is before cgroup reports
+// that on reactor thread, still tells it has no processes left.
+TEST_F(JobTest, ReportsActiveProcessZeroOnTeardown) {
+  for (int run = 0; run < 50; ++run) {
+    CountingObserver observer;
+    std::optional<Job> job(std::in_place);
+    job->AddObserver(&observer);
+    ChildProcess child(L"/bin/true");
+    ASSERT_TRUE(child.Run(*job));
+    std::promise<std::optional<int>> exit_code;
+    child.WaitAsync(kChildTimeout, [&job, &exit_code](const std::optional<int> code) {
+      job.reset();
+      exit_code.set_value(code);
+    });
+    ASSERT_EQ(exit_code.get_future().get(), 0);
+    Reactor::Get().WaitForDeferred();
+    EXPECT_EQ(observer.creations.size(), 1u);
+    EXPECT_EQ(observer.exits.size(), 1u);
+    EXPECT_EQ(observer.active_process_zero, 1);
+  }
+}
+
+// Every process of a job spawning short living ones back to back is
+// reported, and so is the job running out of processes, even if job is
+// destroyed right after its child has exited.
+TEST_F(JobTest, ReportsProcessChurn) {
+  const int kSpawnedProcesses = 2000;
+  CountingObserver observer;
+  std::vector<Job::ProcessInfo> process_table;
+  {
+    Job job;
+    job.AddObserver(&observer);
+    ASSERT_EQ(RunShell(job, L"i=0; while [ $i -lt " + std::to_wstring(kSpawnedProcesses) +
+                                L" ]; do /bin/true; i=$((i + 1)); done"),
+              0);
+    if (!job.ReportsEveryProcess()) {
+      GTEST_SKIP() << "Process connector isn't available, which takes CAP_NET_ADMIN";
+    }
+    process_table = job.GetProcessTable();
+  }
+  Reactor::Get().WaitForDeferred();
+  ExpectReportedOnce(observer, process_table);
+  EXPECT_EQ(observer.creations.size(), static_cast<size_t>(kSpawnedProcesses + 1));
+  EXPECT_EQ(observer.active_process_zero, 1);
+}
+
+TEST_F(JobTest, TeardownKillsDescendants) {
+  Job job;
+  ASSERT_EQ(RunShell(job, L"sleep 60 >/dev/null 2>&1 & sleep 60 >/dev/null 2>&1 & exit 0"), 0);
+  const Job::TeardownTimes times = job.Terminate();
+  EXPECT_TRUE(times.completed);
+  const auto processes = job.GetProcessTable();
+  EXPECT_GE(processes.size(), 3u);
+  for (const Job::ProcessInfo& process : processes) {
+    EXPECT_TRUE(process.exit_time) << "Process " << process.process_id;
+  }
+}
+
+TEST_F(JobTest, CpuTimeLimitKillsJob) {
+  CountingObserver observer;
+  {
+    Job job;
+    job.AddObserver(&observer);
+    Job::BasicLimits limits = Unlimited();
+    limits.cpu_time_limit = std::chrono::milliseconds(200);
+    ASSERT_TRUE(job.SetBasicLimits(limits));
+    const auto exit_code = RunShell(job, L"while :; do :; done");
+    ASSERT_TRUE(exit_code);
+    EXPECT_NE(*exit_code, 0);
+    job.Terminate();
+  }
+  Reactor::Get().WaitForDeferred();
+  EXPECT_EQ(observer.end_of_job_time, 1);
+}
+
+TEST_F(JobTest, MemoryLimitKillsJob) {
+  if (!HasTestController("memory")) {
+    GTEST_SKIP() << "Jobs root doesn't delegate memory controller";
+  }
+  CountingObserver observer;
+  {
+    Job job;
+    job.AddObserver(&observer);
+    Job::BasicLimits limits = Unlimited();
+    limits.overall_memory_limit = 32 * 1024 * 1024;
+    ASSERT_TRUE(job.SetBasicLimits(limits));
+    // Shell variable keeps growing until the job is out of memory.
+    const auto exit_code = RunShell(
+        job, L"x=0123456789abcdef; while :; do x=$x$x; done");
+    ASSERT_TRUE(exit_code);
+    EXPECT_NE(*exit_code, 0);
+    job.Terminate();
+  }
+  Reactor::Get().WaitForDeferred();
+  EXPECT_GE(observer.memory_limit_reached, 1);
+}
+
+// Runs jobs against a loop device backed by a temporary file, so that I/O
+// limits can be checked on a device nothing else uses.
+class IoLimitsTest : public JobTest {
+ protected:
+  static constexpr off_t kDeviceSize = 16 * 1024 * 1024;
+
+  void SetUp() override {
+    JobTest::SetUp();
+    if (IsSkipped()) {
+      return;
+    }
+    if (!HasTestController("io")) {
+      GTEST_SKIP() << "Jobs root doesn't delegate io controller";
+    }
+    ScopedHandle control(::open("/dev/loop-control", O_RDWR | O_CLOEXEC));
+    const int index = control ? ::ioctl(control.get(), LOOP_CTL_GET_FREE) : -1;
+    if (index < 0) {
+      GTEST_SKIP() << "No loop device available";
+    }
+    backing_file_ = std::filesystem::temp_directory_path() /
+                    ("oven-io-" + std::to_string(::getpid()));
+    ScopedHandle backing(::open(backing_file_.c_str(),
+                                O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    ASSERT_TRUE(backing);
+    ASSERT_EQ(::ftruncate(backing.get(), kDeviceSize), 0);
+    device_path_ = "/dev/loop" + std::to_string(index);
+    device_.reset(::open(device_path_.c_str(), O_RDWR | O_CLOEXEC));
+    ASSERT_TRUE(device_);
+    if (::ioctl(device_.get(), LOOP_SET_FD, backing.get()) != 0) {
+      device_.reset();
+      GTEST_SKIP() << "Unable to set up " << device_path_;
+    }
+    struct stat device_stat;
+    ASSERT_EQ(::fstat(device_.get(), &device_stat), 0);
+    device_number_ = std::to_string(major(device_stat.st_rdev)) + ":" +
+                     std::to_string(minor(device_stat.st_rdev));
+  }
+
+  void TearDown() override {
+    if (device_) {
+      ::ioctl(device_.get(), LOOP_CLR_FD, 0);
+    }
+    if (!backing_file_.empty()) {
+      std::filesystem::remove(backing_file_);
+    }
+  }
+
+  // Returns io.max line of the loop device, job cgroup is the only one in
+  // the jobs root while the test runs.
+  std::string ReadDeviceIoLimits() const {
+    std::error_code error;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(*GetTestJobsRoot(), error)) {
+      if (entry.path().filename().string().rfind("oven-", 0) != 0) {
+        continue;
+      }
+      std::ifstream io_max(entry.path() / "io.max");
+      std::string line;
+      while (std::getline(io_max, line)) {
+        if (line.rfind(device_number_ + " ", 0) == 0) {
+          return line;
+        }
+      }
+    }
+    return std::string();
+  }
+
+  std::filesystem::path backing_file_;
+  std::string device_path_;
+  std::string device_number_;
+  ScopedHandle device_;
+};
+
+TEST_F(IoLimitsTest, WritesDeviceLimits) {
+  Job job;
+  Job::BasicLimits limits = Unlimited();
+  limits.io_limits.write_bytes_per_second = 1024 * 1024;
+  limits.io_limits.read_operations_per_second = 100;
+  ASSERT_TRUE(job.SetBasicLimits(limits));
+
+  std::istringstream fields(ReadDeviceIoLimits());
+  std::string device;
+  std::string field;
+  std::set<std::string> values;
+  fields >> device;
+  while (fields >> field) {
+    values.insert(field);
+  }
+  EXPECT_EQ(device, device_number_);
+  EXPECT_EQ(values, (std::set<std::string>{"rbps=max", "wbps=1048576",
+                                           "riops=100", "wiops=max"}));
+}
+
+TEST_F(IoLimitsTest, ThrottlesWrites) {
+  Job job;
+  Job::BasicLimits limits = Unlimited();
+  limits.io_limits.write_bytes_per_second = 1024 * 1024;
+  ASSERT_TRUE(job.SetBasicLimits(limits));
+
+  // 4 MiB written past page cache take 4 seconds at the limit, leave room
+  // for the burst throttling lets through.
+  const std::wstring device(device_path_.begin(), device_path_.end());
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(RunShell(job, L"dd if=/dev/zero of=" + device +
+                              L" bs=64k count=64 oflag=direct 2>/dev/null"),
+            0);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  job.Terminate();
+}
+}  // anonymous namespace
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,90 @@
+#include "system/job_sampler.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+
+JobSampler::JobSampler(const Job& job, const std::chrono::milliseconds interval,
+                       const size_t capacity)
+    : job_(job), interval_(std::max(interval, std::chrono::milliseconds(1))) {
+  // Decimation keeps every other sample, so capacity has to be even.
+  samples_.reserve(std::max<size_t>(2, capacity + capacity % 2));
+}
+
+JobSampler::~JobSampler() {
+  Stop();
+}
+
+bool JobSampler::Start() {
+  if (!Open()) {
+    return false;
+  }
+  start_time_ = std::chrono::steady_clock::now();
+  AddSample();
+  sampling_ = true;
+  reactor_.Invoke([this]() {
+    next_sample_time_ = start_time_;
+    ScheduleSample();
+  });
+  return true;
+}
+
+void JobSampler::Stop() {
+  if (!sampling_) {
+    return;
+  }
+  sampling_ = false;
+  reactor_.Invoke([this]() { reactor_.CancelTimer(timer_); });
+  AddSample();
+}
+
+void JobSampler::ScheduleSample() {
+  next_sample_time_ += interval_;
+  timer_ = reactor_.AddTimer(next_sample_time_, [this]() {
+    AddSample();
+    ScheduleSample();
+  });
+}
+
+void JobSampler::AddSample() {
+  Sample sample;
+  if (!TakeSample(&sample)) {
+    return;
+  }
+  sample.time = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_time_);
+
+  if (samples_.size() == samples_.capacity()) {
+    // Keeps the first sample and every other one after it, at the cost of
+    // resolution of the samples to come.
+    for (size_t index = 1; 2 * index < samples_.size(); ++index) {
+      samples_[index] = samples_[2 * index];
+    }
+    samples_.resize(samples_.size() / 2);
+    interval_ *= 2;
+  }
+  samples_.push_back(sample);
+}
+
+bool JobSampler::WriteCsv(const std::filesystem::path& path) const {
+  std::ofstream file(path, std::ios::binary);
+  file << "time,cpu_time,memory,active_processes,read_bytes,write_bytes\n";
+  for (const Sample& sample : samples_) {
+    file << sample.time.count() << ',' << sample.cpu_time.count() << ','
+         << sample.memory << ',' << sample.active_processes << ','
+         << sample.read_bytes << ',' << sample.write_bytes << '\n';
+  }
+  file.close();
+  if (!file) {
+    OutputError(L"Unable to write resource samples");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,91 @@
+#ifndef _OVEN_SYSTEM_JOB_SAMPLER_H_
+#define _OVEN_SYSTEM_JOB_SAMPLER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "system/reactor.h"
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+
+class Job;
+
+// Samples resource usage of a job at a fixed interval on reactor thread.
+// Memory for samples is allocated up front: once it's exhausted, every other
+// sample is dropped and the interval is doubled, so that samples keep
+// covering the whole run.
+class JobSampler {
+ public:
+  struct Sample {
+    // Time since sampling has started.
+    std::chrono::microseconds time{0};
+    // User and kernel time of all the processes of the job.
+    std::chrono::microseconds cpu_time{0};
+    // Memory charged to the job on Linux, committed by the job on Windows.
+    std::uint64_t memory = 0;
+    std::uint64_t active_processes = 0;
+    std::uint64_t read_bytes = 0;
+    std::uint64_t write_bytes = 0;
+  };
+
+  static const size_t kDefaultCapacity = 4096;
+
+  JobSampler(const Job& job, const std::chrono::milliseconds interval,
+             const size_t capacity = kDefaultCapacity);
+  ~JobSampler();
+
+  JobSampler(const JobSampler&) = delete;
+  JobSampler& operator=(const JobSampler&) = delete;
+
+  // Starts sampling, returns false if job's resource usage can't be sampled.
+  bool Start();
+
+  // Takes the last sample and stops sampling.
+  void Stop();
+
+  // Samples taken so far, valid once sampling is stopped.
+  const std::vector<Sample>& samples() const noexcept { return samples_; }
+
+  // Writes samples as CSV with a header row, times are in microseconds.
+  bool WriteCsv(const std::filesystem::path& path) const;
+
+ private:
+  // Opens whatever sampling needs, called once before sampling starts.
+  bool Open();
+  // Reads current usage of the job, must not allocate.
+  bool TakeSample(Sample* sample);
+
+  // Called on reactor thread.
+  void ScheduleSample();
+  void AddSample();
+
+  const Job& job_;
+  std::chrono::milliseconds interval_;
+  std::vector<Sample> samples_;
+  std::chrono::steady_clock::time_point start_time_;
+
+#if !defined(_WIN32)
+  // Interface files of job's cgroup, kept open to be reread.
+  ScopedHandle cpu_stat_;
+  ScopedHandle memory_current_;
+  ScopedHandle io_stat_;
+  ScopedHandle pids_current_;
+  ScopedHandle procs_;
+  char buffer_[4096];
+#endif
+
+  Reactor& reactor_ = Reactor::Get();
+  bool sampling_ = false;
+  // Only touched on reactor thread.
+  std::chrono::steady_clock::time_point next_sample_time_;
+  Reactor::TimerId timer_ = 0;
+};
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_JOB_SAMPLER_H_
@@ -0,0 +1,114 @@
+#include "system/job_sampler.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string_view>
+
+#include "system/error.h"
+#include "system/job.h"
+
+namespace oven {
+namespace system {
+namespace {
+ScopedHandle OpenInterfaceFile(const NativeHandle cgroup, const char* name) {
+  return ScopedHandle(::openat(cgroup, name, O_RDONLY | O_CLOEXEC));
+}
+
+// Reads interface file from the start, returns its contents truncated to
+// the |buffer| size.
+std::string_view Reread(const ScopedHandle& file, char* buffer, const size_t size) {
+  if (!file) {
+    return std::string_view();
+  }
+  const ssize_t bytes_read = ::pread(file.get(), buffer, size, 0);
+  return std::string_view(buffer, bytes_read > 0 ? static_cast<size_t>(bytes_read) : 0);
+}
+
+std::uint64_t ParseValue(const std::string_view text) {
+  std::uint64_t value = 0;
+  for (const char digit : text) {
+    if (digit < '0' || digit > '9') {
+      break;
+    }
+    value = value * 10 + static_cast<std::uint64_t>(digit - '0');
+  }
+  return value;
+}
+
+// Sums values of |key| over a file of "key value" lines, or of "key=value"
+// pairs if |key| ends with '='.
+std::uint64_t SumValues(std::string_view contents, const std::string_view key) {
+  std::uint64_t sum = 0;
+  for (size_t position = contents.find(key); position != contents.npos;
+       position = contents.find(key, position + key.size())) {
+    const bool starts_field = position == 0 || contents[position - 1] == ' ' ||
+                              contents[position - 1] == '\n';
+    if (!starts_field) {
+      continue;
+    }
+    std::string_view value = contents.substr(position + key.size());
+    if (key.back() != '=') {
+      if (value.empty() || value.front() != ' ') {
+        continue;
+      }
+      value.remove_prefix(1);
+    }
+    sum += ParseValue(value);
+  }
+  return sum;
+}
+}  // anonymous namespace
+
+bool JobSampler::Open() {
+  const NativeHandle cgroup = job_.handle();
+  if (cgroup == kInvalidNativeHandle) {
+    OutputError(L"Resource sampling is not supported for process groups");
+    return false;
+  }
+  cpu_stat_ = OpenInterfaceFile(cgroup, "cpu.stat");
+  if (!cpu_stat_) {
+    OutputError(L"Unable to open job CPU usage");
+    return false;
+  }
+  // The rest are missing unless corresponding controllers are enabled.
+  memory_current_ = OpenInterfaceFile(cgroup, "memory.current");
+  io_stat_ = OpenInterfaceFile(cgroup, "io.stat");
+  pids_current_ = OpenInterfaceFile(cgroup, "pids.current");
+  if (!pids_current_) {
+    procs_ = OpenInterfaceFile(cgroup, "cgroup.procs");
+  }
+  return true;
+}
+
+bool JobSampler::TakeSample(Sample* sample) {
+  const std::string_view cpu_stat = Reread(cpu_stat_, buffer_, sizeof(buffer_));
+  if (cpu_stat.empty()) {
+    return false;
+  }
+  sample->cpu_time = std::chrono::microseconds(SumValues(cpu_stat, "usage_usec"));
+  sample->memory = ParseValue(Reread(memory_current_, buffer_, sizeof(buffer_)));
+  const std::string_view io_stat = Reread(io_stat_, buffer_, sizeof(buffer_));
+  sample->read_bytes = SumValues(io_stat, "rbytes=");
+  sample->write_bytes = SumValues(io_stat, "wbytes=");
+
+  if (pids_current_) {
+    sample->active_processes = ParseValue(Reread(pids_current_, buffer_, sizeof(buffer_)));
+    return true;
+  }
+  // Without pids controller processes are counted by lines of cgroup.procs,
+  // which may not fit into the buffer.
+  sample->active_processes = 0;
+  if (procs_ && ::lseek(procs_.get(), 0, SEEK_SET) == 0) {
+    ssize_t bytes_read;
+    while ((bytes_read = ::read(procs_.get(), buffer_, sizeof(buffer_))) > 0) {
+      sample->active_processes += static_cast<std::uint64_t>(
+          std::count(buffer_, buffer_ + bytes_read, '\n'));
+    }
+  }
+  return true;
+}
+
+}  // namespace system
+}  // namespace oven
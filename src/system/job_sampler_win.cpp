@@ -0,0 +1,41 @@
+#include "system/job_sampler.h"
+
+#include <Windows.h>
+
+#include "system/error.h"
+#include "system/job.h"
+
+namespace oven {
+namespace system {
+
+bool JobSampler::Open() {
+  return true;
+}
+
+bool JobSampler::TakeSample(Sample* sample) {
+  JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting;
+  if (!::QueryInformationJobObject(job_.handle(),
+          JobObjectBasicAndIoAccountingInformation, &accounting,
+          sizeof(accounting), NULL)) {
+    return false;
+  }
+  // Times are reported in 100ns ticks.
+  sample->cpu_time = std::chrono::microseconds(
+      (accounting.BasicInfo.TotalUserTime.QuadPart +
+       accounting.BasicInfo.TotalKernelTime.QuadPart) / 10);
+  sample->active_processes = accounting.BasicInfo.ActiveProcesses;
+  sample->read_bytes = accounting.IoInfo.ReadTransferCount;
+  sample->write_bytes = accounting.IoInfo.WriteTransferCount;
+
+  // Available since Windows 10, memory is left 0 on older systems.
+  JOBOBJECT_MEMORY_USAGE_INFORMATION memory_usage;
+  sample->memory = ::QueryInformationJobObject(job_.handle(),
+                       JobObjectMemoryUsageInformation, &memory_usage,
+                       sizeof(memory_usage), NULL)
+                       ? memory_usage.JobMemory
+                       : 0;
+  return true;
+}
+
+}  // namespace system
+}  // namespace oven
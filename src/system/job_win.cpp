@@ -0,0 +1,431 @@
+#include "system/job.h"
+
+#include <Windows.h>
+#include <psapi.h>
+#include <winternl.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+namespace {
+const UINT kKillExitCode = 1;
+
+// Not declared by winternl.h, available since Windows 8.1.
+const PROCESSINFOCLASS kProcessCommandLineInformation =
+    static_cast<PROCESSINFOCLASS>(60);
+
+std::uint64_t ToTicks(const FILETIME& time) {
+  return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+std::chrono::microseconds FromTicks(const std::uint64_t ticks) {
+  return std::chrono::microseconds(ticks / 10);
+}
+
+// ntdll is always loaded, but has no import library in older SDKs.
+NTSTATUS QueryInformationProcess(const HANDLE process,
+                                 const PROCESSINFOCLASS information_class,
+                                 void* information, const ULONG size,
+                                 ULONG* return_size) {
+  using QueryFunction = NTSTATUS(NTAPI*)(HANDLE, PROCESSINFOCLASS, PVOID, ULONG, PULONG);
+  static const auto query = reinterpret_cast<QueryFunction>(::GetProcAddress(
+      ::GetModuleHandleW(L"ntdll.dll"), "NtQueryInformationProcess"));
+  if (!query) {
+    return static_cast<NTSTATUS>(0xC0000002L);  // STATUS_NOT_IMPLEMENTED
+  }
+  return query(process, information_class, information, size, return_size);
+}
+
+std::wstring GetProcessCommandLine(const HANDLE process) {
+  ULONG size = 0;
+  QueryInformationProcess(process, kProcessCommandLineInformation, nullptr, 0, &size);
+  if (size < sizeof(UNICODE_STRING)) {
+    return std::wstring();
+  }
+  std::vector<char> buffer(size);
+  if (!NT_SUCCESS(QueryInformationProcess(process, kProcessCommandLineInformation,
+                                          buffer.data(), size, &size))) {
+    return std::wstring();
+  }
+  const auto command_line = reinterpret_cast<const UNICODE_STRING*>(buffer.data());
+  return std::wstring(command_line->Buffer, command_line->Length / sizeof(wchar_t));
+}
+}  // anonymous namespace
+
+Job::Job() : handle_(::CreateJobObjectW(NULL, NULL)) {
+  FILETIME creation_time;
+  ::GetSystemTimeAsFileTime(&creation_time);
+  creation_time_ = ToTicks(creation_time);
+}
+
+Job::~Job() {
+  reactor_.Invoke([this]() { StopListening(); });
+  // Events posted before that are still dispatched to observers.
+  reactor_.WaitForDeferred();
+}
+
+bool Job::SetBasicLimits(const BasicLimits& limits) {
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_information;
+  limit_information.JobMemoryLimit = static_cast<size_t>(limits.overall_memory_limit);
+  limit_information.ProcessMemoryLimit = static_cast<size_t>(limits.per_process_memory_limit);
+  limit_information.BasicLimitInformation.PerJobUserTimeLimit.QuadPart = limits.cpu_time_limit.count() * 1000;
+  limit_information.BasicLimitInformation.LimitFlags =
+      JOB_OBJECT_LIMIT_JOB_TIME | JOB_OBJECT_LIMIT_JOB_MEMORY |
+      JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+  if (!::SetInformationJobObject(handle_.get(), ::JobObjectExtendedLimitInformation,
+          &limit_information, sizeof(limit_information))) {
+    OutputError(L"Unable to set basic limits for job");
+    return false;
+  }
+
+  // Windows limits rate of all the I/O of the job together. NULL volume name
+  // applies limits to all the volumes.
+  const IoLimits& io_limits = limits.io_limits;
+  const std::uint64_t bandwidth_limit =
+      std::min(io_limits.read_bytes_per_second, io_limits.write_bytes_per_second);
+  const std::uint64_t operations_limit =
+      std::min(io_limits.read_operations_per_second,
+               io_limits.write_operations_per_second);
+  const auto unlimited =
+      static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+  if (bandwidth_limit < unlimited || operations_limit < unlimited) {
+    JOBOBJECT_IO_RATE_CONTROL_INFORMATION io_rate_control = {};
+    io_rate_control.ControlFlags = JOB_OBJECT_IO_RATE_CONTROL_ENABLE;
+    io_rate_control.MaxBandwidth =
+        bandwidth_limit < unlimited ? static_cast<LONG64>(bandwidth_limit) : 0;
+    io_rate_control.MaxIops =
+        operations_limit < unlimited ? static_cast<LONG64>(operations_limit) : 0;
+    if (!::SetIoRateControlInformationJobObject(handle_.get(), &io_rate_control)) {
+      OutputError(L"Unable to set I/O limits for job");
+      return false;
+    }
+  }
+
+  // Job keeps running past notification limit, it's only reported.
+  if (limits.memory_threshold < limits.overall_memory_limit &&
+      limits.memory_threshold <
+          static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())) {
+    JOBOBJECT_NOTIFICATION_LIMIT_INFORMATION notification_information = {};
+    notification_information.JobMemoryLimit = limits.memory_threshold;
+    notification_information.LimitFlags = JOB_OBJECT_LIMIT_JOB_MEMORY;
+    if (!::SetInformationJobObject(handle_.get(),
+            JobObjectNotificationLimitInformation, &notification_information,
+            sizeof(notification_information))) {
+      OutputError(L"Unable to set memory threshold for job");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Job::SetAffinity(const Affinity& affinity) {
+  if (affinity.processors.empty()) {
+    return true;
+  }
+  // Processor ids are numbered across groups, job gets a mask per group.
+  const unsigned int processors_per_group = sizeof(KAFFINITY) * 8;
+  std::vector<GROUP_AFFINITY> group_affinities;
+  for (const unsigned int processor : affinity.processors) {
+    const WORD group = static_cast<WORD>(processor / processors_per_group);
+    auto group_affinity = std::find_if(
+        group_affinities.begin(), group_affinities.end(),
+        [group](const GROUP_AFFINITY& candidate) { return candidate.Group == group; });
+    if (group_affinity == group_affinities.end()) {
+      group_affinity = group_affinities.insert(group_affinities.end(), GROUP_AFFINITY{});
+      group_affinity->Group = group;
+    }
+    group_affinity->Mask |= KAFFINITY(1) << (processor % processors_per_group);
+  }
+  if (!::SetInformationJobObject(handle_.get(), JobObjectGroupInformationEx,
+          group_affinities.data(),
+          static_cast<DWORD>(group_affinities.size() * sizeof(GROUP_AFFINITY)))) {
+    OutputError(L"Unable to set affinity for job");
+    return false;
+  }
+  return true;
+}
+
+std::optional<Job::Accounting> Job::QueryAccounting() const {
+  JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting_information;
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_information;
+  if (!::QueryInformationJobObject(handle_.get(),
+          JobObjectBasicAndIoAccountingInformation, &accounting_information,
+          sizeof(accounting_information), NULL) ||
+      !::QueryInformationJobObject(handle_.get(),
+          JobObjectExtendedLimitInformation, &limit_information,
+          sizeof(limit_information), NULL)) {
+    OutputError(L"Unable to query job object accounting");
+    return std::optional<Accounting>();
+  }
+
+  // Times are reported in 100ns ticks.
+  const JOBOBJECT_BASIC_ACCOUNTING_INFORMATION& basic =
+      accounting_information.BasicInfo;
+  Accounting accounting;
+  accounting.user_time =
+      std::chrono::microseconds(basic.TotalUserTime.QuadPart / 10);
+  accounting.kernel_time =
+      std::chrono::microseconds(basic.TotalKernelTime.QuadPart / 10);
+  accounting.peak_memory = limit_information.PeakJobMemoryUsed;
+  accounting.peak_process_memory = limit_information.PeakProcessMemoryUsed;
+  accounting.total_processes = basic.TotalProcesses;
+
+  const IO_COUNTERS& io_counters = accounting_information.IoInfo;
+  Accounting::IoCounters io;
+  io.read_operations = io_counters.ReadOperationCount;
+  io.write_operations = io_counters.WriteOperationCount;
+  io.read_bytes = io_counters.ReadTransferCount;
+  io.write_bytes = io_counters.WriteTransferCount;
+  accounting.io = io;
+  return accounting;
+}
+
+bool Job::AssignProcess(const HANDLE process) {
+  if (!StartListening()) {
+    return false;
+  }
+
+  if (!::AssignProcessToJobObject(handle_.get(), process)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool Job::StartListening() {
+  bool listening = false;
+  reactor_.Invoke([this, &listening]() { listening = ListenForNotifications(); });
+  return listening;
+}
+
+bool Job::ListenForNotifications() {
+  if (listening_) {
+    return true;
+  }
+  // Job reports process id as overlapped and message as number of bytes.
+  notifications_completion_key_ =
+      reactor_.AddHandler([this](const IOCP::Completion& completion) {
+        HandleMessage(completion.overlapped, completion.bytes_transferred);
+      });
+
+  // Completion port may only be associated with job once.
+  JOBOBJECT_ASSOCIATE_COMPLETION_PORT iocp_association;
+  iocp_association.CompletionKey = PVOID(notifications_completion_key_);
+  iocp_association.CompletionPort = reactor_.port();
+
+  if (!::SetInformationJobObject(handle_.get(), JobObjectAssociateCompletionPortInformation,
+      &iocp_association, sizeof(iocp_association))) {
+    reactor_.RemoveHandler(notifications_completion_key_);
+    return false;
+  }
+
+  listening_ = true;
+  return true;
+}
+
+void Job::StopListening() {
+  // Notifications job may still post are dropped by reactor.
+  reactor_.RemoveHandler(notifications_completion_key_);
+  reactor_.CancelTimer(teardown_timer_);
+  listening_ = false;
+}
+
+bool Job::HasActiveProcesses() const {
+  JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting_information;
+  if (!::QueryInformationJobObject(handle_.get(),
+          JobObjectBasicAccountingInformation, &accounting_information,
+          sizeof(accounting_information), NULL)) {
+    // Let teardown kill whatever is there.
+    return true;
+  }
+  return accounting_information.ActiveProcesses != 0;
+}
+
+bool Job::StopProcesses() {
+  // Children are created in process groups of their own, which the rest of
+  // the tree inherits, so break is sent to the groups of topmost processes.
+  // Processes without a console are killed once grace period passes.
+  bool stopped = false;
+  for (const auto& [process_id, process] : process_handles_) {
+    const ProcessInfo* info = FindProcessInfo(process_id);
+    if (info && process_handles_.count(info->parent_process_id) == 0) {
+      stopped = ::GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, process_id) || stopped;
+    }
+  }
+  return stopped;
+}
+
+bool Job::KillProcesses() {
+  return ::TerminateJobObject(handle_.get(), kKillExitCode) != FALSE;
+}
+
+std::vector<Job::ProcessInfo> Job::GetProcessTable() {
+  std::vector<ProcessInfo> process_table;
+  reactor_.Invoke([this, &process_table]() {
+    std::vector<unsigned long> exited_processes;
+    for (const auto& [process_id, process] : process_handles_) {
+      if (::WaitForSingleObject(process.get(), 0) == WAIT_OBJECT_0) {
+        exited_processes.push_back(process_id);
+      }
+    }
+    for (const unsigned long process_id : exited_processes) {
+      RecordProcessExit(process_id);
+    }
+    process_table = process_table_;
+  });
+  return process_table;
+}
+
+void Job::RecordNewProcess(const unsigned long process_id) {
+  ScopedHandle process(::OpenProcess(
+      PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, process_id));
+
+  ProcessInfo info;
+  info.process_id = process_id;
+  if (process) {
+    PROCESS_BASIC_INFORMATION basic_information;
+    if (NT_SUCCESS(QueryInformationProcess(process.get(), ProcessBasicInformation,
+                                           &basic_information,
+                                           sizeof(basic_information), NULL))) {
+      // Field is documented as reserved, it holds parent process id.
+      info.parent_process_id = static_cast<unsigned long>(
+          reinterpret_cast<ULONG_PTR>(basic_information.Reserved3));
+    }
+    std::wstring image_path(32768, L'\0');
+    DWORD image_path_size = static_cast<DWORD>(image_path.size());
+    if (::QueryFullProcessImageNameW(process.get(), 0, image_path.data(),
+                                     &image_path_size)) {
+      image_path.resize(image_path_size);
+      info.image_path = std::move(image_path);
+    }
+    info.command_line = GetProcessCommandLine(process.get());
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (::GetProcessTimes(process.get(), &creation_time, &exit_time,
+                          &kernel_time, &user_time)) {
+      info.start_time = FromTicks(ToTicks(creation_time) - creation_time_);
+    }
+  }
+
+  AddProcessInfo(process_id) = std::move(info);
+  if (process) {
+    process_handles_[process_id] = std::move(process);
+  }
+}
+
+void Job::RecordProcessExit(const unsigned long process_id) {
+  // Exit may have been recorded already by |GetProcessTable|.
+  const auto process_handle = process_handles_.find(process_id);
+  if (process_handle == process_handles_.end()) {
+    return;
+  }
+  const ScopedHandle process = std::move(process_handle->second);
+  process_handles_.erase(process_handle);
+
+  ProcessInfo info;
+  DWORD exit_code;
+  if (::GetExitCodeProcess(process.get(), &exit_code)) {
+    info.exit_code = static_cast<int>(exit_code);
+  }
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (::GetProcessTimes(process.get(), &creation_time, &exit_time,
+                        &kernel_time, &user_time)) {
+    info.exit_time = FromTicks(ToTicks(exit_time) - creation_time_);
+    info.kernel_time = FromTicks(ToTicks(kernel_time));
+    info.user_time = FromTicks(ToTicks(user_time));
+  }
+  PROCESS_MEMORY_COUNTERS memory_counters;
+  if (::GetProcessMemoryInfo(process.get(), &memory_counters,
+                             sizeof(memory_counters))) {
+    info.peak_memory = memory_counters.PeakPagefileUsage;
+  }
+
+  if (ProcessInfo* current_info = FindProcessInfo(process_id)) {
+    current_info->exit_time = info.exit_time;
+    current_info->exit_code = info.exit_code;
+    current_info->kernel_time = info.kernel_time;
+    current_info->user_time = info.user_time;
+    current_info->peak_memory = info.peak_memory;
+  }
+}
+
+void Job::HandleMessage(OVERLAPPED* overlapped, const DWORD value) {
+  const unsigned long process_id = (unsigned long)overlapped;
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_information = {};
+  auto query_limits = [this, &limit_information]() {
+    if (!::QueryInformationJobObject(handle_.get(),
+            JobObjectExtendedLimitInformation, &limit_information,
+            sizeof(limit_information), NULL)) {
+      OutputError(L"Unable to query job object information");
+    }
+  };
+  switch (value) {
+    case JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS:
+      RecordProcessExit(process_id);
+      PostEvent(Event::Type::kAbnormalExitProcess, process_id);
+      break;
+    case JOB_OBJECT_MSG_ACTIVE_PROCESS_LIMIT:
+      PostEvent(Event::Type::kActiveProcessLimit);
+      break;
+    case JOB_OBJECT_MSG_ACTIVE_PROCESS_ZERO:
+      HandleActiveProcessZero();
+      break;
+    case JOB_OBJECT_MSG_END_OF_JOB_TIME:
+      PostEvent(Event::Type::kEndOfJobTime);
+      break;
+    case JOB_OBJECT_MSG_END_OF_PROCESS_TIME:
+      PostEvent(Event::Type::kEndOfProcessTime, process_id);
+      break;
+    case JOB_OBJECT_MSG_EXIT_PROCESS:
+      RecordProcessExit(process_id);
+      PostEvent(Event::Type::kExitProcess, process_id);
+      break;
+    case JOB_OBJECT_MSG_JOB_MEMORY_LIMIT:
+      query_limits();
+      PostEvent(Event::Type::kJobMemoryLimit, process_id,
+                limit_information.PeakJobMemoryUsed,
+                limit_information.JobMemoryLimit);
+      break;
+    case JOB_OBJECT_MSG_PROCESS_MEMORY_LIMIT: {
+      query_limits();
+      PROCESS_MEMORY_COUNTERS memory_counters = {};
+      if (const auto process = process_handles_.find(process_id);
+          process != process_handles_.end()) {
+        ::GetProcessMemoryInfo(process->second.get(), &memory_counters,
+                               sizeof(memory_counters));
+      }
+      PostEvent(Event::Type::kProcessMemoryLimit, process_id,
+                memory_counters.PeakPagefileUsage,
+                limit_information.ProcessMemoryLimit);
+      break;
+    }
+    case JOB_OBJECT_MSG_NEW_PROCESS:
+      RecordNewProcess(process_id);
+      PostEvent(Event::Type::kNewProcess, process_id);
+      break;
+    case JOB_OBJECT_MSG_NOTIFICATION_LIMIT: {
+      // Memory threshold is the only notification limit job sets.
+      JOBOBJECT_LIMIT_VIOLATION_INFORMATION limit_violation = {};
+      if (!::QueryInformationJobObject(handle_.get(),
+              JobObjectLimitViolationInformation, &limit_violation,
+              sizeof(limit_violation), NULL)) {
+        OutputError(L"Unable to query job object information");
+      }
+      PostEvent(Event::Type::kMemoryThreshold, process_id,
+                limit_violation.JobMemory, limit_violation.JobMemoryLimit);
+      break;
+    }
+    default:
+      break;
+  }
+}
+}  // namespace system
+}  // namespace oven
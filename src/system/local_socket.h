@@ -0,0 +1,74 @@
+#ifndef _OVEN_SYSTEM_LOCAL_SOCKET_H_
+#define _OVEN_SYSTEM_LOCAL_SOCKET_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#if !defined(_WIN32)
+#include "system/iocp.h"
+#endif
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+// Connection between processes of the same machine: Unix domain socket on
+// POSIX systems and named pipe on Windows. Server |name| is a socket path on
+// POSIX systems and a pipe name (with or without \\.\pipe\ prefix) on Windows.
+class LocalConnection {
+ public:
+  static std::optional<LocalConnection> Connect(const std::wstring_view name);
+
+  explicit LocalConnection(ScopedHandle handle);
+
+  LocalConnection(const LocalConnection&) = delete;
+  LocalConnection(LocalConnection&&) = default;
+
+  LocalConnection& operator=(const LocalConnection&) = delete;
+  LocalConnection& operator=(LocalConnection&&) = default;
+
+  // Both block until all |size| bytes are transferred, return false on
+  // failure or if connection gets closed.
+  bool Send(const void* data, const size_t size);
+  bool Receive(void* data, const size_t size);
+
+ private:
+  ScopedHandle handle_;
+};
+
+class LocalServer {
+ public:
+  explicit LocalServer(const std::wstring_view name);
+  ~LocalServer();
+
+  LocalServer(const LocalServer&) = delete;
+  LocalServer& operator=(const LocalServer&) = delete;
+
+  bool IsValid() const noexcept;
+
+  // Blocks until a client connects. Returns nothing on failure or if server
+  // gets stopped.
+  std::optional<LocalConnection> Accept();
+
+  // Makes pending and all the following |Accept| calls fail, may be called
+  // from any thread.
+  bool Stop() const noexcept;
+
+ private:
+#if defined(_WIN32)
+  std::wstring name_;
+  // Manual-reset event, signalled by |Stop|.
+  ScopedHandle stop_event_;
+#else
+  std::filesystem::path path_;
+  ScopedHandle socket_;
+  IOCP iocp_;
+#endif
+};
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_LOCAL_SOCKET_H_
@@ -0,0 +1,167 @@
+#include "system/local_socket.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "base/string_conversion.h"
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+namespace {
+const std::uintptr_t kListeningSocketCompletionKey = 1;
+
+std::optional<sockaddr_un> MakeAddress(const std::filesystem::path& path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  // Path must fit with its terminating zero.
+  if (path.native().size() >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return std::optional<sockaddr_un>();
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.native().size());
+  return address;
+}
+
+ScopedHandle ConnectTo(const sockaddr_un& address) {
+  ScopedHandle socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (!socket) {
+    return socket;
+  }
+  int result;
+  do {
+    result = ::connect(socket.get(), reinterpret_cast<const sockaddr*>(&address),
+                       sizeof(address));
+  } while (result != 0 && errno == EINTR);
+  if (result != 0) {
+    socket.reset();
+  }
+  return socket;
+}
+}  // anonymous namespace
+
+// static
+std::optional<LocalConnection> LocalConnection::Connect(const std::wstring_view name) {
+  const auto address = MakeAddress(base::WideToUtf8(name));
+  if (!address) {
+    return std::optional<LocalConnection>();
+  }
+  ScopedHandle socket = ConnectTo(*address);
+  if (!socket) {
+    return std::optional<LocalConnection>();
+  }
+  return LocalConnection(std::move(socket));
+}
+
+LocalConnection::LocalConnection(ScopedHandle handle) : handle_(std::move(handle)) {}
+
+bool LocalConnection::Send(const void* data, const size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  size_t bytes_left = size;
+  while (bytes_left) {
+    // Peer may have gone away, do not let SIGPIPE kill the process.
+    const ssize_t bytes_sent = ::send(handle_.get(), bytes, bytes_left, MSG_NOSIGNAL);
+    if (bytes_sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += bytes_sent;
+    bytes_left -= static_cast<size_t>(bytes_sent);
+  }
+  return true;
+}
+
+bool LocalConnection::Receive(void* data, const size_t size) {
+  char* bytes = static_cast<char*>(data);
+  size_t bytes_left = size;
+  while (bytes_left) {
+    const ssize_t bytes_received = ::recv(handle_.get(), bytes, bytes_left, 0);
+    if (bytes_received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_received <= 0) {
+      return false;
+    }
+    bytes += bytes_received;
+    bytes_left -= static_cast<size_t>(bytes_received);
+  }
+  return true;
+}
+
+LocalServer::LocalServer(const std::wstring_view name)
+    : path_(base::WideToUtf8(name)) {
+  const auto address = MakeAddress(path_);
+  if (!address) {
+    OutputError(L"Unable to use server socket path");
+    path_.clear();
+    return;
+  }
+  // Socket file is left behind by a server that hasn't exited cleanly. It's
+  // only safe to replace if there is nobody listening on it.
+  if (ConnectTo(*address)) {
+    errno = EADDRINUSE;
+    OutputError(L"Another server is listening on the socket");
+    path_.clear();
+    return;
+  }
+  ::unlink(path_.c_str());
+
+  socket_.reset(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0));
+  if (!socket_ ||
+      ::bind(socket_.get(), reinterpret_cast<const sockaddr*>(&*address),
+             sizeof(*address)) != 0) {
+    OutputError(L"Unable to bind server socket");
+    socket_.reset();
+    path_.clear();
+    return;
+  }
+  if (::listen(socket_.get(), SOMAXCONN) != 0 ||
+      !iocp_.Associate(socket_.get(), kListeningSocketCompletionKey)) {
+    OutputError(L"Unable to listen on server socket");
+    socket_.reset();
+  }
+}
+
+LocalServer::~LocalServer() {
+  socket_.reset();
+  if (!path_.empty()) {
+    ::unlink(path_.c_str());
+  }
+}
+
+bool LocalServer::IsValid() const noexcept {
+  return socket_.IsValid();
+}
+
+std::optional<LocalConnection> LocalServer::Accept() {
+  while (true) {
+    std::uintptr_t completion_key;
+    if (iocp_.Wait(std::chrono::milliseconds::max(), &completion_key) !=
+        IOCP::WaitResult::kSuccess) {
+      return std::optional<LocalConnection>();
+    }
+    ScopedHandle connection(::accept4(socket_.get(), nullptr, nullptr, SOCK_CLOEXEC));
+    if (connection) {
+      return LocalConnection(std::move(connection));
+    }
+    // Client may have given up connecting before it was accepted.
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED &&
+        errno != EINTR) {
+      OutputError(L"Unable to accept connection");
+      return std::optional<LocalConnection>();
+    }
+  }
+}
+
+bool LocalServer::Stop() const noexcept {
+  return iocp_.Stop();
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,165 @@
+#include "system/local_socket.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+namespace {
+const wchar_t kPipePrefix[] = LR"RAW(\\.\pipe\)RAW";
+const DWORD kPipeBufferSize = 64 * 1024;
+const DWORD kConnectTimeoutMs = 5000;
+
+std::wstring GetPipeName(const std::wstring_view name) {
+  if (name.substr(0, std::size(kPipePrefix) - 1) == kPipePrefix) {
+    return std::wstring(name);
+  }
+  return kPipePrefix + std::wstring(name);
+}
+
+// Waits for an overlapped operation to complete. Works for handles opened
+// without FILE_FLAG_OVERLAPPED as well, those just complete right away.
+bool CompleteOverlapped(const HANDLE handle, const BOOL started,
+                        OVERLAPPED* overlapped, DWORD* bytes_transferred) {
+  if (!started && ::GetLastError() != ERROR_IO_PENDING) {
+    return false;
+  }
+  return ::GetOverlappedResult(handle, overlapped, bytes_transferred, TRUE);
+}
+}  // anonymous namespace
+
+// static
+std::optional<LocalConnection> LocalConnection::Connect(const std::wstring_view name) {
+  const std::wstring pipe_name = GetPipeName(name);
+  while (true) {
+    ScopedHandle pipe(::CreateFileW(pipe_name.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                    0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED,
+                                    NULL));
+    if (pipe) {
+      return LocalConnection(std::move(pipe));
+    }
+    // All pipe instances are busy until server creates a new one.
+    if (::GetLastError() != ERROR_PIPE_BUSY ||
+        !::WaitNamedPipeW(pipe_name.c_str(), kConnectTimeoutMs)) {
+      return std::optional<LocalConnection>();
+    }
+  }
+}
+
+LocalConnection::LocalConnection(ScopedHandle handle) : handle_(std::move(handle)) {}
+
+bool LocalConnection::Send(const void* data, const size_t size) {
+  ScopedHandle event(::CreateEventW(NULL, TRUE, FALSE, NULL));
+  if (!event) {
+    return false;
+  }
+  const char* bytes = static_cast<const char*>(data);
+  size_t bytes_left = size;
+  while (bytes_left) {
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = event.get();
+    DWORD bytes_sent = 0;
+    const DWORD bytes_to_send = static_cast<DWORD>(
+        std::min<size_t>(bytes_left, std::numeric_limits<DWORD>::max()));
+    if (!CompleteOverlapped(
+            handle_.get(),
+            ::WriteFile(handle_.get(), bytes, bytes_to_send, NULL, &overlapped),
+            &overlapped, &bytes_sent)) {
+      return false;
+    }
+    bytes += bytes_sent;
+    bytes_left -= bytes_sent;
+  }
+  return true;
+}
+
+bool LocalConnection::Receive(void* data, const size_t size) {
+  ScopedHandle event(::CreateEventW(NULL, TRUE, FALSE, NULL));
+  if (!event) {
+    return false;
+  }
+  char* bytes = static_cast<char*>(data);
+  size_t bytes_left = size;
+  while (bytes_left) {
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = event.get();
+    DWORD bytes_received = 0;
+    const DWORD bytes_to_receive = static_cast<DWORD>(
+        std::min<size_t>(bytes_left, std::numeric_limits<DWORD>::max()));
+    if (!CompleteOverlapped(
+            handle_.get(),
+            ::ReadFile(handle_.get(), bytes, bytes_to_receive, NULL, &overlapped),
+            &overlapped, &bytes_received) ||
+        bytes_received == 0) {
+      return false;
+    }
+    bytes += bytes_received;
+    bytes_left -= bytes_received;
+  }
+  return true;
+}
+
+LocalServer::LocalServer(const std::wstring_view name)
+    : name_(GetPipeName(name)),
+      stop_event_(::CreateEventW(NULL, TRUE, FALSE, NULL)) {
+  if (!stop_event_) {
+    OutputError(L"Unable to create server stop event");
+  }
+}
+
+LocalServer::~LocalServer() = default;
+
+bool LocalServer::IsValid() const noexcept {
+  return stop_event_.IsValid();
+}
+
+std::optional<LocalConnection> LocalServer::Accept() {
+  // Every client gets its own pipe instance.
+  ScopedHandle pipe(::CreateNamedPipeW(
+      name_.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+      PIPE_UNLIMITED_INSTANCES, kPipeBufferSize, kPipeBufferSize, 0, NULL));
+  ScopedHandle connected_event(::CreateEventW(NULL, TRUE, FALSE, NULL));
+  if (!pipe || !connected_event) {
+    OutputError(L"Unable to create server pipe");
+    return std::optional<LocalConnection>();
+  }
+
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = connected_event.get();
+  if (!::ConnectNamedPipe(pipe.get(), &overlapped)) {
+    const auto error = ::GetLastError();
+    if (error == ERROR_PIPE_CONNECTED) {
+      return LocalConnection(std::move(pipe));
+    }
+    if (error != ERROR_IO_PENDING) {
+      OutputError(L"Unable to connect server pipe");
+      return std::optional<LocalConnection>();
+    }
+  }
+
+  const HANDLE events[] = {connected_event.get(), stop_event_.get()};
+  const DWORD wait_result =
+      ::WaitForMultipleObjects(2, events, FALSE, INFINITE);
+  DWORD unused;
+  if (wait_result != WAIT_OBJECT_0 ||
+      !::GetOverlappedResult(pipe.get(), &overlapped, &unused, FALSE)) {
+    // Pending connect has to be cancelled before |overlapped| goes away.
+    ::CancelIoEx(pipe.get(), &overlapped);
+    ::GetOverlappedResult(pipe.get(), &overlapped, &unused, TRUE);
+    return std::optional<LocalConnection>();
+  }
+  return LocalConnection(std::move(pipe));
+}
+
+bool LocalServer::Stop() const noexcept {
+  return ::SetEvent(stop_event_.get());
+}
+
+}  // namespace system
+}  // namespace oven
@@ -1,15 +1,19 @@
 #ifndef _OVEN_SYSTEM_PIPE_H_
 #define _OVEN_SYSTEM_PIPE_H_
 
-#include <Windows.h>
+#include <cstddef>
 
 #include "system/scoped_handle.h"
 
 namespace oven {
 namespace system {
+// Anonymous pipe, |in| end is meant to be read by the current process and
+// |out| end is meant to be inherited by a child process.
 class Pipe {
  public:
-  Pipe();
+  // Pipe capacity is left at the system default unless |buffer_size| is set.
+  // Larger buffer lets a child write more before it blocks on a full pipe.
+  explicit Pipe(const size_t buffer_size = 0);
   ~Pipe();
 
   Pipe(const Pipe&) = delete;
@@ -23,10 +27,14 @@ class Pipe {
   ScopedHandle& in() { return in_; }
   ScopedHandle& out() { return out_; }
 
+#if defined(_WIN32)
   OVERLAPPED& overlapped() { return overlapped_; }
+#endif
 
  private:
+#if defined(_WIN32)
   OVERLAPPED overlapped_;
+#endif
   ScopedHandle in_;
   ScopedHandle out_;
 };
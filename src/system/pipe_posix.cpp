@@ -0,0 +1,37 @@
+#include "system/pipe.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+Pipe::Pipe(const size_t buffer_size) {
+  // Both ends are close-on-exec: child process gets its end duplicated
+  // onto standard streams, which clears the flag.
+  int pipe_ends[2];
+  if (::pipe2(pipe_ends, O_CLOEXEC) != 0) {
+    OutputError(L"Unable to create pipe");
+    return;
+  }
+  in_.reset(pipe_ends[0]);
+  out_.reset(pipe_ends[1]);
+  // Unprivileged processes can't go past /proc/sys/fs/pipe-max-size, pipe
+  // keeps working with the default capacity then.
+  if (buffer_size) {
+    ::fcntl(in_.get(), F_SETPIPE_SZ,
+            static_cast<int>(std::min<size_t>(buffer_size, INT_MAX)));
+  }
+}
+
+Pipe::~Pipe() {
+  if (IsValid()) {
+    OutputError(L"Closing valid pipe!");
+  }
+}
+}  // namespace system
+}  // namespace oven
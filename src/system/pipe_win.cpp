@@ -16,14 +16,14 @@ std::wstring GeneratePipeName() {
 
 namespace oven {
 namespace system {
-Pipe::Pipe() : overlapped_({0}) {
+Pipe::Pipe(const size_t buffer_size) : overlapped_({0}) {
   const std::wstring name = LR"RAW(\\.\pipe\oven-)RAW" + GeneratePipeName();
 
   in_.reset(::CreateNamedPipeW(
       name.c_str(),
       PIPE_ACCESS_INBOUND | FILE_FLAG_FIRST_PIPE_INSTANCE | FILE_FLAG_OVERLAPPED,
-      PIPE_TYPE_BYTE | PIPE_REJECT_REMOTE_CLIENTS, 1, 
-      0, 0, 0, NULL));
+      PIPE_TYPE_BYTE | PIPE_REJECT_REMOTE_CLIENTS, 1,
+      0, static_cast<DWORD>(std::min<size_t>(buffer_size, MAXDWORD)), 0, NULL));
 
   if (!in_) {
     OutputError(L"Unable to create named pipe");
@@ -0,0 +1,148 @@
+#include "system/processor_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <system_error>
+
+namespace oven {
+namespace system {
+namespace {
+const char kLockDirectoryName[] = "oven-cores";
+}  // anonymous namespace
+
+ProcessorTopology::ProcessorTopology(std::vector<Processor> processors)
+    : processors_(std::move(processors)) {
+  std::sort(processors_.begin(), processors_.end(),
+            [](const Processor& left, const Processor& right) {
+              return left.id < right.id;
+            });
+}
+
+// static
+std::optional<std::vector<unsigned int>> ProcessorTopology::ParseList(
+    const std::string_view list) {
+  std::vector<unsigned int> ids;
+  size_t position = 0;
+  // Trailing newline is left by sysfs.
+  const std::string_view ranges = list.substr(0, list.find_last_not_of(" \n") + 1);
+  while (position < ranges.size()) {
+    size_t range_end = ranges.find(',', position);
+    if (range_end == ranges.npos) {
+      range_end = ranges.size();
+    }
+    const std::string range(ranges.substr(position, range_end - position));
+    char* end = nullptr;
+    const unsigned long first = std::strtoul(range.c_str(), &end, 10);
+    unsigned long last = first;
+    if (end == range.c_str()) {
+      return std::optional<std::vector<unsigned int>>();
+    }
+    if (*end == '-') {
+      const char* last_start = end + 1;
+      last = std::strtoul(last_start, &end, 10);
+      if (end == last_start || last < first) {
+        return std::optional<std::vector<unsigned int>>();
+      }
+    }
+    if (*end != '\0') {
+      return std::optional<std::vector<unsigned int>>();
+    }
+    for (unsigned long id = first; id <= last; ++id) {
+      ids.push_back(static_cast<unsigned int>(id));
+    }
+    position = range_end + 1;
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+// static
+std::string ProcessorTopology::FormatList(const std::vector<unsigned int>& ids) {
+  std::string list;
+  for (size_t index = 0; index < ids.size();) {
+    // Consecutive ids are collapsed into ranges.
+    size_t last = index;
+    while (last + 1 < ids.size() && ids[last + 1] == ids[last] + 1) {
+      ++last;
+    }
+    if (!list.empty()) {
+      list += ',';
+    }
+    list += std::to_string(ids[index]);
+    if (last != index) {
+      list += '-' + std::to_string(ids[last]);
+    }
+    index = last + 1;
+  }
+  return list;
+}
+
+size_t ProcessorTopology::CountCores() const {
+  std::vector<unsigned int> cores;
+  for (const Processor& processor : processors_) {
+    cores.push_back(processor.core);
+  }
+  std::sort(cores.begin(), cores.end());
+  return static_cast<size_t>(std::unique(cores.begin(), cores.end()) - cores.begin());
+}
+
+// static
+std::filesystem::path CoreReservation::GetDefaultLockDirectory() {
+  std::error_code error;
+  return std::filesystem::temp_directory_path(error) / kLockDirectoryName;
+}
+
+// static
+std::optional<CoreReservation> CoreReservation::Reserve(
+    const ProcessorTopology& topology, const Options& options) {
+  if (options.cores == 0) {
+    return std::optional<CoreReservation>();
+  }
+  // Directory is shared by oven processes of all users.
+  std::error_code error;
+  if (std::filesystem::create_directories(options.lock_directory, error)) {
+    std::filesystem::permissions(
+        options.lock_directory,
+        std::filesystem::perms::all | std::filesystem::perms::sticky_bit, error);
+  }
+
+  // Processors of every core, cores of every node, all in the order of ids.
+  std::map<unsigned int, std::map<unsigned int, std::vector<unsigned int>>> nodes;
+  for (const ProcessorTopology::Processor& processor : topology.processors()) {
+    nodes[processor.node][processor.core].push_back(processor.id);
+  }
+
+  for (const auto& [node, cores] : nodes) {
+    if (cores.size() < options.cores) {
+      continue;
+    }
+    // Cores locked by others are skipped, the ones locked here are released
+    // along with reservation if node turns out to have not enough of them.
+    CoreReservation reservation;
+    reservation.node_ = node;
+    for (const auto& [core, processors] : cores) {
+      ScopedHandle lock = TryLock(options.lock_directory /
+                                  ("core-" + std::to_string(core) + ".lock"));
+      if (!lock) {
+        continue;
+      }
+      reservation.locks_.push_back(std::move(lock));
+      if (options.exclude_siblings) {
+        reservation.processors_.push_back(processors.front());
+      } else {
+        reservation.processors_.insert(reservation.processors_.end(),
+                                       processors.begin(), processors.end());
+      }
+      if (reservation.locks_.size() == options.cores) {
+        std::sort(reservation.processors_.begin(), reservation.processors_.end());
+        return reservation;
+      }
+    }
+  }
+  return std::optional<CoreReservation>();
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,96 @@
+#ifndef _OVEN_SYSTEM_PROCESSOR_TOPOLOGY_H_
+#define _OVEN_SYSTEM_PROCESSOR_TOPOLOGY_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+
+// Logical processors current process may run on, along with physical cores
+// and NUMA nodes they belong to.
+class ProcessorTopology {
+ public:
+  struct Processor {
+    // Number system refers to processor by: CPU number on Linux, group * 64
+    // + number within the group on Windows.
+    unsigned int id = 0;
+    // Physical core, identified by the lowest id of its processors, so that
+    // it's the same for every process on the system.
+    unsigned int core = 0;
+    unsigned int node = 0;
+  };
+
+  // Returns nothing if topology can't be retrieved.
+  static std::optional<ProcessorTopology> Query();
+
+  // Parses list of processors (or nodes) like "0-3,8,10-11", the format of
+  // cpuset.cpus. Returns ids sorted, nothing if list is malformed.
+  static std::optional<std::vector<unsigned int>> ParseList(const std::string_view list);
+  static std::string FormatList(const std::vector<unsigned int>& ids);
+
+  // Processors ordered by id.
+  const std::vector<Processor>& processors() const noexcept { return processors_; }
+
+  size_t CountCores() const;
+
+ private:
+  explicit ProcessorTopology(std::vector<Processor> processors);
+
+  std::vector<Processor> processors_;
+};
+
+// Whole physical cores of a single NUMA node reserved for a job. Reservations
+// are coordinated between all the oven processes on the system through lock
+// files, one per core, which system unlocks once reservation is destroyed or
+// its process dies.
+class CoreReservation {
+ public:
+  struct Options {
+    size_t cores = 0;
+    // Reserves only one processor of each core, leaving its SMT siblings
+    // idle.
+    bool exclude_siblings = false;
+    // Directory lock files are kept in, shared by all oven processes.
+    std::filesystem::path lock_directory;
+  };
+
+  // Default lock directory, inside of the temporary one.
+  static std::filesystem::path GetDefaultLockDirectory();
+
+  // Reserves cores on the first node that has enough of them free. Returns
+  // nothing if there is no such node.
+  static std::optional<CoreReservation> Reserve(const ProcessorTopology& topology,
+                                                const Options& options);
+
+  CoreReservation(const CoreReservation&) = delete;
+  CoreReservation(CoreReservation&&) noexcept = default;
+
+  CoreReservation& operator=(const CoreReservation&) = delete;
+  CoreReservation& operator=(CoreReservation&&) noexcept = default;
+
+  const std::vector<unsigned int>& processors() const noexcept { return processors_; }
+  unsigned int node() const noexcept { return node_; }
+
+ private:
+  CoreReservation() = default;
+
+  // Locks file exclusively without waiting, returns invalid handle if it's
+  // locked by someone else.
+  static ScopedHandle TryLock(const std::filesystem::path& path);
+
+  std::vector<unsigned int> processors_;
+  unsigned int node_ = 0;
+  std::vector<ScopedHandle> locks_;
+};
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_PROCESSOR_TOPOLOGY_H_
@@ -0,0 +1,103 @@
+#include "system/processor_topology.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+namespace oven {
+namespace system {
+namespace {
+const char kCpuDirectory[] = "/sys/devices/system/cpu";
+const char kNodeDirectory[] = "/sys/devices/system/node";
+
+std::optional<std::string> ReadSysfsFile(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  if (!file) {
+    return std::optional<std::string>();
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+}  // anonymous namespace
+
+// static
+std::optional<ProcessorTopology> ProcessorTopology::Query() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return std::optional<ProcessorTopology>();
+  }
+
+  // Systems without NUMA have no node directory, all processors are on node 0
+  // then.
+  std::vector<unsigned int> node_of_processor(CPU_SETSIZE, 0);
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(kNodeDirectory, error)) {
+    const std::string name = entry.path().filename().string();
+    if (name.compare(0, 4, "node") != 0 ||
+        name.find_first_not_of("0123456789", 4) != name.npos) {
+      continue;
+    }
+    const auto processors = ReadSysfsFile(entry.path() / "cpulist");
+    const auto ids = processors ? ParseList(*processors) : std::nullopt;
+    if (!ids) {
+      continue;
+    }
+    for (const unsigned int id : *ids) {
+      if (id < CPU_SETSIZE) {
+        node_of_processor[id] = static_cast<unsigned int>(std::stoul(name.substr(4)));
+      }
+    }
+  }
+
+  std::vector<Processor> processors;
+  for (unsigned int id = 0; id < CPU_SETSIZE; ++id) {
+    if (!CPU_ISSET(id, &allowed)) {
+      continue;
+    }
+    Processor processor;
+    processor.id = id;
+    processor.core = id;
+    processor.node = node_of_processor[id];
+    const auto siblings = ReadSysfsFile(std::filesystem::path(kCpuDirectory) /
+                                        ("cpu" + std::to_string(id)) /
+                                        "topology/thread_siblings_list");
+    if (const auto ids = siblings ? ParseList(*siblings) : std::nullopt;
+        ids && !ids->empty()) {
+      processor.core = ids->front();
+    }
+    processors.push_back(processor);
+  }
+  if (processors.empty()) {
+    return std::optional<ProcessorTopology>();
+  }
+  return ProcessorTopology(std::move(processors));
+}
+
+// static
+ScopedHandle CoreReservation::TryLock(const std::filesystem::path& path) {
+  // Lock files are shared by oven processes of all users.
+  ScopedHandle file(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666));
+  if (!file) {
+    return ScopedHandle();
+  }
+  ::fchmod(file.get(), 0666);
+  // flock locks belong to open file description, so that runs within the
+  // same process are coordinated as well.
+  if (::flock(file.get(), LOCK_EX | LOCK_NB) != 0) {
+    return ScopedHandle();
+  }
+  return file;
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,98 @@
+#include "system/processor_topology.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace oven {
+namespace system {
+namespace {
+const unsigned int kProcessorsPerGroup = 64;
+
+std::vector<unsigned int> GetProcessorIds(const GROUP_AFFINITY& affinity) {
+  std::vector<unsigned int> ids;
+  for (unsigned int bit = 0; bit < kProcessorsPerGroup; ++bit) {
+    if (affinity.Mask & (KAFFINITY(1) << bit)) {
+      ids.push_back(affinity.Group * kProcessorsPerGroup + bit);
+    }
+  }
+  return ids;
+}
+}  // anonymous namespace
+
+// static
+std::optional<ProcessorTopology> ProcessorTopology::Query() {
+  DWORD size = 0;
+  ::GetLogicalProcessorInformationEx(RelationAll, NULL, &size);
+  if (::GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    return std::optional<ProcessorTopology>();
+  }
+  std::vector<char> buffer(size);
+  if (!::GetLogicalProcessorInformationEx(
+          RelationAll,
+          reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()),
+          &size)) {
+    return std::optional<ProcessorTopology>();
+  }
+
+  // Cores are listed ahead of nodes, so node is filled in afterwards.
+  std::vector<Processor> processors;
+  std::vector<std::pair<unsigned int, std::vector<unsigned int>>> nodes;
+  for (DWORD offset = 0; offset < size;) {
+    const auto information =
+        reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data() + offset);
+    offset += information->Size;
+    if (information->Relationship == RelationProcessorCore) {
+      std::vector<unsigned int> ids;
+      for (WORD group = 0; group < information->Processor.GroupCount; ++group) {
+        const std::vector<unsigned int> group_ids =
+            GetProcessorIds(information->Processor.GroupMask[group]);
+        ids.insert(ids.end(), group_ids.begin(), group_ids.end());
+      }
+      for (const unsigned int id : ids) {
+        Processor processor;
+        processor.id = id;
+        processor.core = ids.front();
+        processors.push_back(processor);
+      }
+    } else if (information->Relationship == RelationNumaNode) {
+      nodes.emplace_back(information->NumaNode.NodeNumber,
+                         GetProcessorIds(information->NumaNode.GroupMask));
+    }
+  }
+  for (const auto& [node, ids] : nodes) {
+    for (Processor& processor : processors) {
+      if (std::find(ids.begin(), ids.end(), processor.id) != ids.end()) {
+        processor.node = node;
+      }
+    }
+  }
+  if (processors.empty()) {
+    return std::optional<ProcessorTopology>();
+  }
+  return ProcessorTopology(std::move(processors));
+}
+
+// static
+ScopedHandle CoreReservation::TryLock(const std::filesystem::path& path) {
+  ScopedHandle file(::CreateFileW(
+      path.c_str(), GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+      OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL));
+  if (!file) {
+    return ScopedHandle();
+  }
+  // Locks belong to file handle, so that runs within the same process are
+  // coordinated as well.
+  OVERLAPPED overlapped = {};
+  if (!::LockFileEx(file.get(), LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                    0, 1, 0, &overlapped)) {
+    return ScopedHandle();
+  }
+  return file;
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,188 @@
+#include "system/reactor.h"
+
+#include <future>
+#include <memory>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+
+Reactor& Reactor::Get() {
+  static Reactor reactor;
+  return reactor;
+}
+
+Reactor::~Reactor() {
+  iocp_.Stop();
+  reactor_thread_.join();
+  {
+    std::lock_guard lock(dispatching_guard_);
+    stop_dispatching_ = true;
+  }
+  deferred_posted_.notify_one();
+  dispatching_thread_.join();
+}
+
+void Reactor::Post(Task task) {
+  bool wake_up;
+  {
+    std::lock_guard lock(tasks_guard_);
+    // Reactor takes all the posted tasks at once, so it only needs to be
+    // woken up for the first of them.
+    wake_up = posted_tasks_.empty();
+    posted_tasks_.push_back(std::move(task));
+  }
+  if (wake_up) {
+    WakeUp();
+  }
+}
+
+void Reactor::Invoke(const Task& task) {
+  if (IsReactorThread()) {
+    task();
+    return;
+  }
+  // Promise is shared, as reactor may still hold it once task is done.
+  auto done = std::make_shared<std::promise<void>>();
+  Post([&task, done]() {
+    task();
+    done->set_value();
+  });
+  done->get_future().wait();
+}
+
+std::uintptr_t Reactor::AddHandlerImpl(Handler handler) {
+  const std::uintptr_t completion_key = next_completion_key_++;
+  handlers_.emplace(completion_key, std::make_unique<Handler>(std::move(handler)));
+  return completion_key;
+}
+
+Reactor::TimerId Reactor::AddTimer(
+    const std::chrono::steady_clock::time_point deadline, Task task) {
+  const TimerId timer = next_timer_++;
+  timers_.emplace(std::make_pair(deadline, timer), std::move(task));
+  timer_deadlines_.emplace(timer, deadline);
+  return timer;
+}
+
+void Reactor::CancelTimer(const TimerId timer) {
+  const auto deadline = timer_deadlines_.find(timer);
+  if (deadline == timer_deadlines_.end()) {
+    return;
+  }
+  timers_.erase(std::make_pair(deadline->second, timer));
+  timer_deadlines_.erase(deadline);
+}
+
+void Reactor::Defer(Deferrable* deferrable) {
+  // Dispatching thread is awake while queue is full, nothing is dropped.
+  while (!deferred_.TryPush(deferrable)) {
+    std::this_thread::yield();
+  }
+  deferred_count_.fetch_add(1, std::memory_order_release);
+  // Pairs with the fence of dispatching thread: either it sees the deferral
+  // before going to sleep, or it's seen sleeping here.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (dispatcher_sleeping_.load(std::memory_order_relaxed)) {
+    std::lock_guard lock(dispatching_guard_);
+    deferred_posted_.notify_one();
+  }
+}
+
+void Reactor::WaitForDeferred() {
+  const std::uint64_t deferred_count =
+      deferred_count_.load(std::memory_order_acquire);
+  std::unique_lock lock(dispatching_guard_);
+  deferred_dispatched_.wait(lock, [this, deferred_count]() {
+    return dispatched_count_.load(std::memory_order_acquire) >= deferred_count;
+  });
+}
+
+void Reactor::Run() {
+  IOCP::Completion completions[IOCP::kMaxCompletions];
+  for (;;) {
+    const std::chrono::milliseconds timeout = RunTimers();
+    size_t count = 0;
+    const IOCP::WaitResult wait_result =
+        iocp_.Wait(timeout, completions, IOCP::kMaxCompletions, &count);
+
+    switch (wait_result) {
+      case IOCP::WaitResult::kTimeout:
+        continue;
+      case IOCP::WaitResult::kFailure:
+        OutputError(L"Unable to dequeue completion from iocp");
+        return;
+      case IOCP::WaitResult::kStopped:
+      case IOCP::WaitResult::kSuccess:
+        for (size_t index = 0; index < count; ++index) {
+          const auto handler = handlers_.find(completions[index].completion_key);
+          if (handler != handlers_.end()) {
+            (*handler->second)(completions[index]);
+          }
+        }
+        removed_handlers_.clear();
+        if (wait_result == IOCP::WaitResult::kStopped) {
+          return;
+        }
+        break;
+    }
+  }
+}
+
+void Reactor::RunPostedTasks() {
+  std::vector<Task> tasks;
+  {
+    std::lock_guard lock(tasks_guard_);
+    tasks.swap(posted_tasks_);
+  }
+  for (const Task& task : tasks) {
+    task();
+  }
+}
+
+std::chrono::milliseconds Reactor::RunTimers() {
+  const auto now = std::chrono::steady_clock::now();
+  while (!timers_.empty() && timers_.begin()->first.first <= now) {
+    const auto timer = timers_.begin();
+    const Task task = std::move(timer->second);
+    timer_deadlines_.erase(timer->first.second);
+    timers_.erase(timer);
+    task();
+  }
+  if (timers_.empty()) {
+    return std::chrono::milliseconds::max();
+  }
+  return std::chrono::ceil<std::chrono::milliseconds>(
+      timers_.begin()->first.first - now);
+}
+
+void Reactor::Dispatch() {
+  for (;;) {
+    bool dispatched = false;
+    Deferrable* deferrable;
+    while (deferred_.TryPop(&deferrable)) {
+      deferrable->RunDeferred();
+      dispatched_count_.fetch_add(1, std::memory_order_release);
+      dispatched = true;
+    }
+
+    std::unique_lock lock(dispatching_guard_);
+    if (dispatched) {
+      deferred_dispatched_.notify_all();
+    }
+    // Nothing is deferred once dispatching is stopped.
+    if (stop_dispatching_ && deferred_.empty()) {
+      return;
+    }
+    dispatcher_sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    deferred_posted_.wait(lock, [this]() {
+      return !deferred_.empty() || stop_dispatching_;
+    });
+    dispatcher_sleeping_.store(false, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace system
+}  // namespace oven
@@ -0,0 +1,171 @@
+#ifndef _OVEN_SYSTEM_REACTOR_H_
+#define _OVEN_SYSTEM_REACTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/spsc_queue.h"
+#include "system/iocp.h"
+#include "system/scoped_handle.h"
+
+namespace oven {
+namespace system {
+
+// Event loop shared by all the jobs and child processes: a single thread
+// waits on a completion port and runs handlers of whatever it dequeues, so
+// the number of threads doesn't grow with the number of children. Handlers
+// and timers run on reactor thread and must not block.
+//
+// Work that may take long (e.g. notifying job observers) is deferred to a
+// single dispatching thread instead.
+//
+// Unless noted otherwise, methods must be called on reactor thread: use
+// |Post| or |Invoke| to get there.
+class Reactor {
+ public:
+  using Task = std::function<void()>;
+  using Handler = std::function<void(const IOCP::Completion& completion)>;
+  using TimerId = std::uint64_t;
+
+  // Receives work deferred to the dispatching thread.
+  class Deferrable {
+   public:
+    virtual ~Deferrable() = default;
+    virtual void RunDeferred() = 0;
+  };
+
+  // Process-wide reactor, started on first use.
+  static Reactor& Get();
+
+  Reactor();
+  ~Reactor();
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+  // May be called on any thread.
+  bool IsReactorThread() const noexcept {
+    return std::this_thread::get_id() == reactor_thread_.get_id();
+  }
+
+  // Runs |task| on reactor thread, tasks run in the order they were posted.
+  // May be called on any thread.
+  void Post(Task task);
+
+  // Runs |task| on reactor thread and waits for it to complete, right away
+  // if called on reactor thread. May be called on any thread.
+  void Invoke(const Task& task);
+
+#if defined(_WIN32)
+  // Associates |handle| with the completion port, so that completions of
+  // overlapped I/O on it are passed to |handler|. Returns completion key, 0
+  // on failure.
+  std::uintptr_t Associate(const HANDLE handle, Handler handler);
+
+  // Returns completion key for completions posted to the port by others,
+  // e.g. job notifications.
+  std::uintptr_t AddHandler(Handler handler);
+
+  // Calls |handler| once |object| is signalled, e.g. process exits. Waits
+  // are served by system thread pool, which hands them over to reactor.
+  // Returns completion key, 0 on failure.
+  std::uintptr_t WatchObject(const HANDLE object, Handler handler);
+
+  const HANDLE port() const noexcept { return iocp_.handle(); }
+#else
+  // Calls |handler| whenever |handle| is readable (or writable, if asked
+  // for), or hung up, until it's unwatched. Returns completion key, 0 on
+  // failure.
+  std::uintptr_t Watch(const NativeHandle handle, Handler handler,
+                       const IOCP::Readiness readiness = IOCP::Readiness::kReadable);
+
+  // Stops watching |handle| and removes its handler.
+  void Unwatch(const NativeHandle handle, const std::uintptr_t completion_key);
+#endif
+
+  // Removes handler, completions that were dequeued but not handled yet are
+  // dropped. Handler may remove itself.
+  void RemoveHandler(const std::uintptr_t completion_key);
+
+  // Runs |task| once |deadline| comes.
+  TimerId AddTimer(const std::chrono::steady_clock::time_point deadline,
+                   Task task);
+  void CancelTimer(const TimerId timer);
+
+  // Makes dispatching thread call |RunDeferred| of |deferrable| once, in
+  // the order of deferrals.
+  void Defer(Deferrable* deferrable);
+
+  // Waits until everything deferred so far has run. Must not be called on
+  // reactor or dispatching thread.
+  void WaitForDeferred();
+
+ private:
+  // Capacity of the queue of deferred work, reactor waits for dispatching
+  // thread to catch up once it's full.
+  static constexpr size_t kDeferredQueueCapacity = 16384;
+
+  std::uintptr_t AddHandlerImpl(Handler handler);
+  void WakeUp();
+
+  void Run();
+  void RunPostedTasks();
+  // Runs expired timers and returns time until the next one.
+  std::chrono::milliseconds RunTimers();
+
+  void Dispatch();
+
+  IOCP iocp_;
+#if !defined(_WIN32)
+  // eventfd signalled once tasks are posted.
+  ScopedHandle tasks_event_;
+#else
+  std::uintptr_t tasks_completion_key_ = 0;
+
+  struct ObjectWait;
+  static void CALLBACK OnObjectSignalled(void* context, BOOLEAN timed_out);
+  std::unordered_map<std::uintptr_t, std::unique_ptr<ObjectWait>> object_waits_;
+#endif
+
+  std::mutex tasks_guard_;
+  std::vector<Task> posted_tasks_;
+
+  std::uintptr_t next_completion_key_ = 1;
+  // Handlers are kept by pointer and removed ones are destroyed once all
+  // the dequeued completions are handled, so that handler may remove itself.
+  std::unordered_map<std::uintptr_t, std::unique_ptr<Handler>> handlers_;
+  std::vector<std::unique_ptr<Handler>> removed_handlers_;
+
+  TimerId next_timer_ = 1;
+  std::map<std::pair<std::chrono::steady_clock::time_point, TimerId>, Task> timers_;
+  std::unordered_map<TimerId, std::chrono::steady_clock::time_point> timer_deadlines_;
+
+  base::SpscQueue<Deferrable*> deferred_{kDeferredQueueCapacity};
+  // Number of deferrals made by reactor and run by dispatching thread.
+  std::atomic<std::uint64_t> deferred_count_ = 0;
+  std::atomic<std::uint64_t> dispatched_count_ = 0;
+  std::mutex dispatching_guard_;
+  std::condition_variable deferred_posted_;
+  std::condition_variable deferred_dispatched_;
+  std::atomic_bool dispatcher_sleeping_ = false;
+  bool stop_dispatching_ = false;
+
+  std::thread reactor_thread_;
+  std::thread dispatching_thread_;
+};
+
+}  // namespace system
+}  // namespace oven
+
+#endif  // _OVEN_SYSTEM_REACTOR_H_
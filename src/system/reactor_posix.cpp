@@ -0,0 +1,56 @@
+#include "system/reactor.h"
+
+#include <sys/eventfd.h>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+
+Reactor::Reactor() : tasks_event_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+  const std::uintptr_t completion_key =
+      AddHandlerImpl([this](const IOCP::Completion& /* completion */) {
+        eventfd_t unused;
+        ::eventfd_read(tasks_event_.get(), &unused);
+        RunPostedTasks();
+      });
+  if (!iocp_.Associate(tasks_event_.get(), completion_key)) {
+    OutputError(L"Unable to watch reactor tasks");
+  }
+  reactor_thread_ = std::thread(&Reactor::Run, this);
+  dispatching_thread_ = std::thread(&Reactor::Dispatch, this);
+}
+
+std::uintptr_t Reactor::Watch(const NativeHandle handle, Handler handler,
+                              const IOCP::Readiness readiness) {
+  const std::uintptr_t completion_key = AddHandlerImpl(std::move(handler));
+  if (!iocp_.Associate(handle, completion_key, readiness)) {
+    handlers_.erase(completion_key);
+    return 0;
+  }
+  return completion_key;
+}
+
+void Reactor::Unwatch(const NativeHandle handle,
+                      const std::uintptr_t completion_key) {
+  // Descriptor may have been duplicated, so closing it is not enough to
+  // remove it from epoll.
+  iocp_.Dissociate(handle);
+  RemoveHandler(completion_key);
+}
+
+void Reactor::RemoveHandler(const std::uintptr_t completion_key) {
+  const auto handler = handlers_.find(completion_key);
+  if (handler == handlers_.end()) {
+    return;
+  }
+  removed_handlers_.push_back(std::move(handler->second));
+  handlers_.erase(handler);
+}
+
+void Reactor::WakeUp() {
+  ::eventfd_write(tasks_event_.get(), 1);
+}
+
+}  // namespace system
+}  // namespace oven
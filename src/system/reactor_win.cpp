@@ -0,0 +1,86 @@
+#include "system/reactor.h"
+
+#include <Windows.h>
+
+#include "system/error.h"
+
+namespace oven {
+namespace system {
+
+// Wait registered with system thread pool, its callback posts completion
+// with the key of the wait to reactor.
+struct Reactor::ObjectWait {
+  HANDLE port = NULL;
+  std::uintptr_t completion_key = 0;
+  HANDLE wait_handle = NULL;
+};
+
+Reactor::Reactor() {
+  // Posted tasks come as completions with their own key.
+  tasks_completion_key_ = AddHandlerImpl([this](const IOCP::Completion& /* completion */) {
+    RunPostedTasks();
+  });
+  reactor_thread_ = std::thread(&Reactor::Run, this);
+  dispatching_thread_ = std::thread(&Reactor::Dispatch, this);
+}
+
+std::uintptr_t Reactor::Associate(const HANDLE handle, Handler handler) {
+  const std::uintptr_t completion_key = AddHandlerImpl(std::move(handler));
+  if (!::CreateIoCompletionPort(handle, iocp_.handle(), completion_key, 0)) {
+    handlers_.erase(completion_key);
+    return 0;
+  }
+  return completion_key;
+}
+
+std::uintptr_t Reactor::AddHandler(Handler handler) {
+  return AddHandlerImpl(std::move(handler));
+}
+
+std::uintptr_t Reactor::WatchObject(const HANDLE object, Handler handler) {
+  const std::uintptr_t completion_key = AddHandlerImpl(std::move(handler));
+  auto object_wait = std::make_unique<ObjectWait>();
+  object_wait->port = iocp_.handle();
+  object_wait->completion_key = completion_key;
+  // Callback only posts a completion, so it runs right in the wait thread.
+  if (!::RegisterWaitForSingleObject(&object_wait->wait_handle, object,
+                                     &Reactor::OnObjectSignalled,
+                                     object_wait.get(), INFINITE,
+                                     WT_EXECUTEINWAITTHREAD | WT_EXECUTEONLYONCE)) {
+    handlers_.erase(completion_key);
+    return 0;
+  }
+  object_waits_.emplace(completion_key, std::move(object_wait));
+  return completion_key;
+}
+
+void CALLBACK Reactor::OnObjectSignalled(void* context, BOOLEAN /* timed_out */) {
+  const ObjectWait* object_wait = static_cast<const ObjectWait*>(context);
+  ::PostQueuedCompletionStatus(object_wait->port, 0, object_wait->completion_key,
+                               NULL);
+}
+
+void Reactor::RemoveHandler(const std::uintptr_t completion_key) {
+  const auto object_wait = object_waits_.find(completion_key);
+  if (object_wait != object_waits_.end()) {
+    // Blocks until callback completes, if it's running.
+    ::UnregisterWaitEx(object_wait->second->wait_handle, INVALID_HANDLE_VALUE);
+    object_waits_.erase(object_wait);
+  }
+  const auto handler = handlers_.find(completion_key);
+  if (handler == handlers_.end()) {
+    return;
+  }
+  removed_handlers_.push_back(std::move(handler->second));
+  handlers_.erase(handler);
+}
+
+void Reactor::WakeUp() {
+  if (!::PostQueuedCompletionStatus(iocp_.handle(), 0, tasks_completion_key_,
+                                    NULL)) {
+    OutputError(L"Unable to wake reactor up");
+  }
+}
+
+}  // namespace system
+}  // namespace oven
@@ -1,28 +1,42 @@
 #include "system/scoped_handle.h"
 
-#include "error.h"
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "system/error.h"
 
 namespace oven {
 namespace system {
-ScopedHandle::ScopedHandle(const HANDLE open_handle)
+namespace {
+bool CloseNativeHandle(const NativeHandle handle) {
+#if defined(_WIN32)
+  return ::CloseHandle(handle);
+#else
+  return ::close(handle) == 0;
+#endif
+}
+}  // anonymous namespace
+
+ScopedHandle::ScopedHandle(const NativeHandle open_handle)
     : open_handle_(open_handle) {
 }
 
 ScopedHandle::ScopedHandle(ScopedHandle&& other) noexcept
     : open_handle_(other.open_handle_) {
-  other.open_handle_ = NULL;
+  other.open_handle_ = kInvalidNativeHandle;
 }
 
 ScopedHandle& ScopedHandle::operator=(ScopedHandle&& other) noexcept {
   reset();
   open_handle_ = other.open_handle_;
-  other.open_handle_ = NULL;
+  other.open_handle_ = kInvalidNativeHandle;
   return *this;
 }
 
-void ScopedHandle::reset(const HANDLE new_open_handle) {
+void ScopedHandle::reset(const NativeHandle new_open_handle) {
   if (IsValid()) {
-    if (!::CloseHandle(open_handle_)) {
+    if (!CloseNativeHandle(open_handle_)) {
       OutputError(L"Unable to close handle");
     }
   }
@@ -1,14 +1,25 @@
 #ifndef _OVEN_SYSTEM_SCOPED_HANDLE_H_
 #define _OVEN_SYSTEM_SCOPED_HANDLE_H_
 
+#if defined(_WIN32)
 #include <Windows.h>
+#endif
 
 namespace oven {
 namespace system {
+#if defined(_WIN32)
+using NativeHandle = HANDLE;
+const NativeHandle kInvalidNativeHandle = NULL;
+#else
+// File descriptor.
+using NativeHandle = int;
+const NativeHandle kInvalidNativeHandle = -1;
+#endif
+
 class ScopedHandle {
  public:
-  ScopedHandle() : ScopedHandle(NULL) {}
-  explicit ScopedHandle(HANDLE open_handle);
+  ScopedHandle() : ScopedHandle(kInvalidNativeHandle) {}
+  explicit ScopedHandle(NativeHandle open_handle);
   ~ScopedHandle() noexcept { reset(); }
 
   ScopedHandle(const ScopedHandle&) = delete;
@@ -18,17 +29,28 @@ class ScopedHandle {
   ScopedHandle& operator=(ScopedHandle&& other) noexcept;
 
   bool IsValid() const noexcept {
+#if defined(_WIN32)
     return open_handle_ != NULL && open_handle_ != INVALID_HANDLE_VALUE;
+#else
+    return open_handle_ >= 0;
+#endif
   }
 
-  HANDLE get() const noexcept { return open_handle_; }
-  void reset() noexcept { reset(NULL); }
-  void reset(const HANDLE new_open_handle);
+  NativeHandle get() const noexcept { return open_handle_; }
+  void reset() noexcept { reset(kInvalidNativeHandle); }
+  void reset(const NativeHandle new_open_handle);
+
+  // Gives up ownership of the handle without closing it.
+  NativeHandle release() noexcept {
+    const NativeHandle handle = open_handle_;
+    open_handle_ = kInvalidNativeHandle;
+    return handle;
+  }
 
   operator bool() const noexcept { return IsValid(); }
 
  private:
-  HANDLE open_handle_;
+  NativeHandle open_handle_;
 };
 }  // namespace system
 }  // namespace oven